@@ -4,7 +4,9 @@
 ** GNU General Public License version 3. See the file LICENSE for details.
 **/
 
+#include <QProgressDialog>
 #include <set>
+#include <atomic>
 #include "collectwordsform.h"
 #include "ui_collectwordsform.h"
 #include "globalui.h"
@@ -534,110 +536,79 @@ void CollectWordsForm::on_generateButton_clicked()
     std::vector<int> words;
     dict->getKanjiWords(kanji, words);
 
-    int minfreq = ui->freqEdit->text().toInt();
-    int maxklen = ui->kanaLenEdit->text().toInt();
+    WordFilter filter;
+    filter.minfreq = ui->freqEdit->text().toInt();
+    filter.maxklen = ui->kanaLenEdit->text().toInt();
 
-    int minkanji;
-    int maxkanji;
-    if (!findStrIntMinMax(ui->kanjiNumEdit->text(), 0, 99, minkanji, maxkanji))
-        minkanji = 0;
-    if (maxkanji == -1 || maxkanji == 100)
-        maxkanji = 99;
+    if (!findStrIntMinMax(ui->kanjiNumEdit->text(), 0, 99, filter.minkanji, filter.maxkanji))
+        filter.minkanji = 0;
+    if (filter.maxkanji == -1 || filter.maxkanji == 100)
+        filter.maxkanji = 99;
 
-    bool limit = ui->limitBox->isChecked();
-    bool strict = ui->strictBox->isChecked();
+    filter.limit = ui->limitBox->isChecked();
+    filter.strict = ui->strictBox->isChecked();
     //int minjlpt = ui->jlptMinCBox->currentIndex() == 0 ? 6 : 6 - ui->jlptMinCBox->currentIndex();
     //int maxjlpt = ui->jlptMaxCBox->currentIndex() == 0 ? -1 : 6 - ui->jlptMaxCBox->currentIndex();
 
-    // [kanji index, <checked readings, placement in word>]
-    std::map<ushort, std::pair<ushort, KanjiPlacement>> listkanji;
-    bool checkkanji = false;
-    bool needfuri = false;
+    filter.checkkanji = false;
+    filter.needfuri = false;
+    filter.kanji.resize(0x10000, { 0, KanjiPlacement::Anywhere, 0 });
 
     for (int ix = 0, siz = kanji.size(); ix != siz; ++ix)
     {
-
         ushort kindex = kanji[ix];
         ushort reading = readings[ix];
         // Kanji with no reading checked should be skipped.
         if (reading == 0)
             continue;
         KanjiPlacement place = placement[ix];
-        listkanji[ZKanji::kanjis[kindex]->ch.unicode()] = std::make_pair(reading, place);
+        filter.kanji[ZKanji::kanjis[kindex]->ch.unicode()] = { reading, place, kindex };
         if (place != KanjiPlacement::Anywhere || reading != 0xffff)
-            checkkanji = true;
+            filter.checkkanji = true;
         if (reading != 0xffff)
-            needfuri = true;
+            filter.needfuri = true;
     }
 
-    for (int ix = 0, siz = words.size(); ix != siz; ++ix)
-    {
-        int windex = words[ix];
-        const WordEntry *e = dict->wordEntry(windex);
-        //WordCommons *cm;
-        if (e->freq < minfreq || (maxklen > 0 && e->kana.size() > maxklen) /*|| 
-            ((minjlpt != 6 || maxjlpt != -1) && ((cm = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data())) == nullptr || cm->jlptn < maxjlpt || cm->jlptn > minjlpt))*/)
-            words[ix] = -1;
-        else if (limit || maxkanji != -1 || checkkanji)
+    // Finding the furigana of words looks up kanji by their character.
+    if (filter.needfuri)
+        ZKanji::mapKanjiIndexes();
+
+    // The dictionary must not change while the words are checked on other threads, which
+    // the application modal progress dialog prevents.
+    QProgressDialog progress(tr("Collecting words..."), tr("Cancel"), 0, words.size(), this);
+    progress.setWindowModality(Qt::ApplicationModal);
+
+    // The words are split into ranges checked on the thread pool. This thread only updates
+    // the progress with the words checked so far, so the dialog stays responsive and can be
+    // canceled.
+    int siz = words.size();
+    std::atomic_int checked(0);
+    std::atomic_bool canceled(false);
+
+    ParallelRanges ranges(siz, 1000, [&](int, int first, int last) {
+        for (int pos = first; pos != last && !canceled; ++pos)
         {
-            int kanjicnt = 0;
-            bool kanjifound = !checkkanji;
-
-            std::vector<FuriganaData> furi;
-                
-            for (int iy = 0, siz2 = e->kanji.size(); iy != siz2; ++iy)
-            {
-                if (KANJI(e->kanji[iy].unicode()))
-                {
-                    ++kanjicnt;
-
-                    std::map<ushort, std::pair<ushort, KanjiPlacement>>::iterator it;
-                    if ((maxkanji != -1 && (/*kanjicnt < minkanji ||*/ kanjicnt > maxkanji)) || (limit && ((it = listkanji.find(e->kanji[iy].unicode())) == listkanji.end() || it->second.first == 0)))
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-                    else if (!limit)
-                        it = listkanji.find(e->kanji[iy].unicode());
-
-                    if (!checkkanji || it == listkanji.end() || it->second.first == 0)
-                        continue;
-
-                    bool goodplace = (it->second.second == KanjiPlacement::Anywhere ||
-                        (iy == 0 && (it->second.second == KanjiPlacement::Front || it->second.second == KanjiPlacement::FrontEnd || it->second.second == KanjiPlacement::FrontMiddle)) ||
-                        (iy == siz2 - 1 && (it->second.second == KanjiPlacement::End || it->second.second == KanjiPlacement::FrontEnd || it->second.second == KanjiPlacement::MiddleEnd)) ||
-                        (iy != 0 && iy != siz2 - 1 && (it->second.second == KanjiPlacement::FrontMiddle || it->second.second == KanjiPlacement::MiddleEnd || it->second.second == KanjiPlacement::Middle)));
-                    if (!goodplace && strict)
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-
-                    bool goodfuri = !needfuri;
-                    if (needfuri)
-                    {
-                        if (furi.empty())
-                            findFurigana(e->kanji, e->kana, furi);
-
-                        int r = findKanjiReading(e->kanji, e->kana, iy, nullptr, &furi);
-                        if ((it->second.first & (1 << r)) != 0)
-                            goodfuri = true;
-                    }
-                    if (!goodfuri && strict)
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-
-                    if (goodfuri && goodplace)
-                        kanjifound = true;
-                }
-            }
-            if (!kanjifound || kanjicnt < minkanji)
-                words[ix] = -1;
+            if (!wordMatches(words[pos], filter))
+                words[pos] = -1;
+
+            if ((pos % 256) == 255)
+                checked += 256;
         }
+    });
+
+    while (!ranges.wait(50))
+    {
+        progress.setValue(checked);
+        // Setting the same value doesn't process the events of the dialog.
+        qApp->processEvents();
+        if (progress.wasCanceled())
+            canceled = true;
     }
 
+    progress.reset();
+    if (canceled)
+        return;
+
     words.resize(std::remove(words.begin(), words.end(), -1) - words.begin());
     if (wmodel != nullptr)
         wmodel->deleteLater();
@@ -721,6 +692,63 @@ void CollectWordsForm::dictionaryToBeRemoved(int index, int orderindex, Dictiona
         ui->dictCBox->setCurrentIndex(orderindex == 0 ? 1 : 0);
 }
 
+bool CollectWordsForm::wordMatches(int windex, const WordFilter &filter) const
+{
+    const WordEntry *e = dict->wordEntry(windex);
+    //WordCommons *cm;
+    if (e->freq < filter.minfreq || (filter.maxklen > 0 && e->kana.size() > filter.maxklen) /*||
+        ((minjlpt != 6 || maxjlpt != -1) && ((cm = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data())) == nullptr || cm->jlptn < maxjlpt || cm->jlptn > minjlpt))*/)
+        return false;
+
+    if (!filter.limit && filter.maxkanji == -1 && !filter.checkkanji)
+        return true;
+
+    int kanjicnt = 0;
+    bool kanjifound = !filter.checkkanji;
+
+    std::vector<FuriganaData> furi;
+
+    for (int ix = 0, siz = e->kanji.size(); ix != siz; ++ix)
+    {
+        if (!KANJI(e->kanji[ix].unicode()))
+            continue;
+
+        ++kanjicnt;
+
+        const WordFilter::Kanji &k = filter.kanji[e->kanji[ix].unicode()];
+        if ((filter.maxkanji != -1 && kanjicnt > filter.maxkanji) || (filter.limit && k.readings == 0))
+            return false;
+
+        if (!filter.checkkanji || k.readings == 0)
+            continue;
+
+        bool goodplace = (k.place == KanjiPlacement::Anywhere ||
+            (ix == 0 && (k.place == KanjiPlacement::Front || k.place == KanjiPlacement::FrontEnd || k.place == KanjiPlacement::FrontMiddle)) ||
+            (ix == siz - 1 && (k.place == KanjiPlacement::End || k.place == KanjiPlacement::FrontEnd || k.place == KanjiPlacement::MiddleEnd)) ||
+            (ix != 0 && ix != siz - 1 && (k.place == KanjiPlacement::FrontMiddle || k.place == KanjiPlacement::MiddleEnd || k.place == KanjiPlacement::Middle)));
+        if (!goodplace && filter.strict)
+            return false;
+
+        bool goodfuri = !filter.needfuri;
+        if (filter.needfuri)
+        {
+            if (furi.empty())
+                findFurigana(e->kanji, e->kana, furi);
+
+            int r = findKanjiReading(e->kanji, e->kana, ix, ZKanji::kanjis[k.kindex], &furi);
+            if (r != -1 && (k.readings & (1 << r)) != 0)
+                goodfuri = true;
+        }
+        if (!goodfuri && filter.strict)
+            return false;
+
+        if (goodfuri && goodplace)
+            kanjifound = true;
+    }
+
+    return kanjifound && kanjicnt >= filter.minkanji;
+}
+
 
 //-------------------------------------------------------------
 
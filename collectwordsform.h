@@ -119,6 +119,36 @@ protected slots:
 private:
     enum KanjiPlacement { Anywhere, Front, Middle, End, FrontEnd, FrontMiddle, MiddleEnd };
 
+    // Conditions of the words listed when generating the word list.
+    struct WordFilter
+    {
+        int minfreq;
+        int maxklen;
+        int minkanji;
+        int maxkanji;
+        // Words can only contain kanji from the kanji list.
+        bool limit;
+        // Every kanji from the list in a word must match its reading and placement.
+        bool strict;
+        // The reading or placement of kanji in words must be checked.
+        bool checkkanji;
+        // The reading of kanji in words must be checked.
+        bool needfuri;
+
+        // Checked reading bits, placement and kanji index of the kanji in the list, indexed
+        // by their character code. Characters not in the list have no reading bits set.
+        struct Kanji
+        {
+            ushort readings;
+            KanjiPlacement place;
+            ushort kindex;
+        };
+        std::vector<Kanji> kanji;
+    };
+
+    // Returns whether the word at windex matches filter. Safe to call from multiple threads.
+    bool wordMatches(int windex, const WordFilter &filter) const;
+
     Ui::CollectWordsForm *ui;
 
     Dictionary *dict;
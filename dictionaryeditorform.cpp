@@ -252,6 +252,8 @@ void DictionaryEditorForm::on_delButton_clicked(bool checked)
     f.remove();
     f.setFileName(ZKanji::userFolder() + "/data/" + name + ".zkuser");
     f.remove();
+    f.setFileName(ZKanji::userFolder() + "/data/" + name + ".zkuser.journal");
+    f.remove();
 
     ZKanji::deleteDictionary(ZKanji::dictionaryPosition(ui->dictView->currentRow()));
 }
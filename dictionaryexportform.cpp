@@ -7,6 +7,8 @@
 #include <QPushButton>
 #include <QFileDialog>
 #include <QSet>
+#include <QProgressDialog>
+#include <QMessageBox>
 #include "dictionaryexportform.h"
 #include "ui_dictionaryexportform.h"
 #include "zgrouptreemodel.h"
@@ -57,7 +59,10 @@ void DictionaryExportForm::exportClicked()
 {
     QString fname = QFileDialog::getSaveFileName(gUI->activeMainForm(), tr("Save export file"), QString(), QString("%1 (*.zkanji.dictionary)").arg(tr("Dictionary export file")));
     if (fname.isEmpty())
+    {
         closeCancel();
+        return;
+    }
 
     std::vector<ushort> klist;
     std::vector<int> wlist;
@@ -106,7 +111,23 @@ void DictionaryExportForm::exportClicked()
     }
 
     Dictionary *dict = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
-    dict->exportDictionary(fname, ui->groupBox->isChecked(), klist, wlist);
+
+    QProgressDialog progress(tr("Exporting dictionary..."), tr("Cancel"), 0, 1, this);
+    progress.setWindowModality(Qt::WindowModal);
+    bool result = dict->exportDictionary(fname, ui->groupBox->isChecked(), klist, wlist, [&progress](int done, int total) {
+        progress.setMaximum(total);
+        progress.setValue(done);
+        return !progress.wasCanceled();
+    });
+    bool canceled = progress.wasCanceled();
+    progress.reset();
+
+    if (!result)
+    {
+        if (!canceled)
+            QMessageBox::warning(this, "zkanji", tr("The export file couldn't be written."));
+        return;
+    }
 
     closeOk();
 }
@@ -4,14 +4,13 @@
 ** GNU General Public License version 3. See the file LICENSE for details.
 **/
 
-#include <QSet>
 #include <QDesktopServices>
 #include <QPushButton>
 #include <QScrollBar>
 #include <QDesktopWidget>
-#include <chrono>
-#include <thread>
+#include <QHeaderView>
 #include <list>
+#include <numeric>
 #include "dictionarystatsform.h"
 #include "ui_dictionarystatsform.h"
 
@@ -24,70 +23,136 @@
 #include "zkanjimain.h"
 #include "zui.h"
 #include "formstates.h"
+#include "grammar_enums.h"
+#include "zstrings.h"
 
 
 //-------------------------------------------------------------
 
 
-StatsThread::StatsThread(DictionaryStatsForm *owner, Dictionary *dict) : base(), owner(owner), dict(dict), valentry(0), valdef(0), valkanji(0)
+namespace
 {
-    terminate = false;
-    done = false;
-
-    setAutoDelete(false);
+    // Lowest frequency of each frequency range after the one holding the entries without
+    // frequency.
+    const int freqranges[] = { 1, 500, 1000, 1500, 2000, 2500, 3000, 4000, 5000, 7500, 10000 };
 }
 
-StatsThread::~StatsThread()
+DictionaryStatsCounter::DictionaryStatsCounter(Dictionary *dict) : dict(dict)
 {
-#ifdef _DEBUG
-    if (!done)
-        throw "Deleting thread during work.";
-#endif
+    terminate = false;
+    valentry = -1;
+    valdef = -1;
+    valkanji = -1;
+    aggregatesdone = false;
+
+    // The aggregates look up kanji from several threads.
+    ZKanji::mapKanjiIndexes();
+
+    work.reset(new ParallelRanges(4, 1, [this](int index, int, int) {
+        if (terminate)
+            return;
+
+        switch (index)
+        {
+        case 0:
+            calculateAggregates();
+            break;
+        case 1:
+            calculateEntries();
+            break;
+        case 2:
+            calculateDefinitions();
+            break;
+        case 3:
+            calculateKanji();
+            break;
+        }
+    }));
 }
 
-void StatsThread::run()
+DictionaryStatsCounter::~DictionaryStatsCounter()
 {
-    if (calculateEntries() && calculateDefinitions() && calculateKanji())
-        done = true;
+    terminate = true;
+    work.reset();
 }
 
-int StatsThread::entryResult() const
+int DictionaryStatsCounter::entryResult() const
 {
     return valentry;
 }
-int StatsThread::definitionResult() const
+
+int DictionaryStatsCounter::definitionResult() const
 {
     return valdef;
 }
 
-int StatsThread::kanjiResult() const
+int DictionaryStatsCounter::kanjiResult() const
 {
     return valkanji;
 }
 
-bool StatsThread::checkTerminate()
+std::shared_ptr<const DictionaryAggregates> DictionaryStatsCounter::aggregateResult() const
 {
-    if (terminate)
-    {
-        done = true;
-        return true;
-    }
-    return false;
+    if (!aggregatesdone)
+        return nullptr;
+    return aggregates;
 }
 
-bool StatsThread::calculateEntries()
+bool DictionaryStatsCounter::done() const
 {
-    if (dict->entryCount() == 0)
-        return true;
+    return valentry != -1 && valdef != -1 && valkanji != -1 && aggregatesdone;
+}
 
-    if (checkTerminate())
-        return false;
+int DictionaryStatsCounter::freqRangeCount()
+{
+    return sizeof(freqranges) / sizeof(int) + 1;
+}
+
+int DictionaryStatsCounter::freqRange(int index)
+{
+    return index == 0 ? 0 : freqranges[index - 1];
+}
+
+template<typename T, typename Comp>
+bool DictionaryStatsCounter::sort(std::vector<T> &list, Comp cmp)
+{
+    int siz = list.size();
+    int cnt = ParallelRanges::rangeCount(siz, 10000);
+
+    // Same bounds as the ranges sorted on the thread pool.
+    std::vector<int> bounds(cnt + 1);
+    for (int ix = 0; ix != cnt + 1; ++ix)
+        bounds[ix] = (qint64)siz * ix / cnt;
+
+    ParallelRanges::run(siz, 10000, [&](int, int first, int last) {
+        interruptSort(list.begin() + first, list.begin() + last, cmp);
+    });
+
+    // Merge the sorted ranges in pairs until a single range is left.
+    auto mergecmp = [&cmp](const T &a, const T &b) {
+        bool stop = false;
+        return cmp(a, b, stop);
+    };
+    for (int step = 1; step < cnt && !terminate; step *= 2)
+        for (int ix = 0; ix + step < cnt && !terminate; ix += step * 2)
+            std::inplace_merge(list.begin() + bounds[ix], list.begin() + bounds[ix + step], list.begin() + bounds[std::min(cnt, ix + step * 2)], mergecmp);
+
+    return !terminate;
+}
+
+void DictionaryStatsCounter::calculateEntries()
+{
+    if (dict->entryCount() == 0)
+    {
+        valentry = 0;
+        return;
+    }
 
     std::vector<int> list;
     list.resize(dict->entryCount());
     std::iota(list.begin(), list.end(), 0);
 
-    interruptSort(list.begin(), list.end(), [this](int a, int b, bool &localdone) {
+    if (!sort(list, [this](int a, int b, bool &localdone) {
         localdone = terminate;
         if (localdone)
             return false;
@@ -105,42 +170,38 @@ bool StatsThread::calculateEntries()
         }
 
         return false;
-    });
-    if (checkTerminate())
-        return false;
+    }))
+        return;
 
-    valentry = 1;
+    int cnt = 1;
     for (int ix = 1, siz = list.size(); ix != siz; ++ix)
     {
         const auto &defa = dict->wordEntry(list[ix - 1])->defs;
         const auto &defb = dict->wordEntry(list[ix])->defs;
 
         if (defa.size() != defb.size())
-            ++valentry;
+            ++cnt;
         else
         {
             for (int iy = 0, siz = defa.size(); iy != siz; ++iy)
             {
                 if (defa[iy].def != defb[iy].def)
                 {
-                    ++valentry;
+                    ++cnt;
                     break;
                 }
             }
         }
 
-        if ((ix % 5 == 0) && checkTerminate())
-            return false;
+        if ((ix % 1024) == 0 && terminate)
+            return;
     }
 
-    return true;
+    valentry = cnt;
 }
 
-bool StatsThread::calculateDefinitions()
+void DictionaryStatsCounter::calculateDefinitions()
 {
-    if (checkTerminate())
-        return false;
-
     // Word index, definition index pairs.
     typedef std::pair<int, int> DefPair;
     std::vector<DefPair> pairs;
@@ -153,12 +214,12 @@ bool StatsThread::calculateDefinitions()
     }
 
     if (pairs.empty())
-        return true;
-
-    if (checkTerminate())
-        return false;
+    {
+        valdef = 0;
+        return;
+    }
 
-    interruptSort(pairs.begin(), pairs.end(), [this](const DefPair &a, const DefPair &b, bool &localdone) {
+    if (!sort(pairs, [this](const DefPair &a, const DefPair &b, bool &localdone) {
         localdone = terminate;
         if (localdone)
             return false;
@@ -167,63 +228,147 @@ bool StatsThread::calculateDefinitions()
         WordEntry *eb = dict->wordEntry(b.first);
 
         return ea->defs[a.second].def < eb->defs[b.second].def;
-    });
-    if (checkTerminate())
-        return false;
+    }))
+        return;
 
-    valdef = 1;
+    int cnt = 1;
     for (int ix = 1, siz = pairs.size(); ix != siz; ++ix)
     {
         if (dict->wordEntry(pairs[ix - 1].first)->defs[pairs[ix - 1].second].def != dict->wordEntry(pairs[ix].first)->defs[pairs[ix].second].def)
-            ++valdef;
+            ++cnt;
 
-        if ((ix % 10) && checkTerminate())
-            return false;
+        if ((ix % 1024) == 0 && terminate)
+            return;
     }
 
-    return true;
+    valdef = cnt;
 }
 
-bool StatsThread::calculateKanji()
+void DictionaryStatsCounter::calculateKanji()
 {
-    if (checkTerminate())
-        return false;
+    // Kanji already found in a group.
+    std::vector<char> found(ZKanji::kanjis.size(), 0);
+    int cnt = 0;
 
-    QSet<int> found;
     KanjiGroupCategory *cat = &dict->kanjiGroups();
 
     std::list<KanjiGroupCategory*> stack;
     stack.push_back(cat);
     while (!stack.empty())
     {
-        if (checkTerminate())
-            return false;
+        if (terminate)
+            return;
 
         cat = stack.front();
         stack.pop_front();
         for (int ix = 0, siz = cat->categoryCount(); ix != siz; ++ix)
             stack.push_back(cat->categories(ix));
-        if (checkTerminate())
-            return false;
 
         for (int ix = 0, siz = cat->size(); ix != siz; ++ix)
         {
             KanjiGroup *grp = cat->items(ix);
             for (int iy = 0, siy = grp->size(); iy != siy; ++iy)
             {
-                if ((iy % 10) == 0 && checkTerminate())
-                    return false;
                 int i = grp->items(iy)->index;
-                if (!found.contains(i))
+                if (found[i] == 0)
                 {
-                    found.insert(i);
-                    ++valkanji;
+                    found[i] = 1;
+                    ++cnt;
                 }
             }
         }
     }
 
-    return true;
+    valkanji = cnt;
+}
+
+void DictionaryStatsCounter::calculateAggregates()
+{
+    const int typecnt = (int)WordTypes::Count;
+    const int freqcnt = freqRangeCount();
+    const int kanjicnt = ZKanji::kanjis.size();
+
+    // Values counted separately for each range of entries, merged when every range is done.
+    struct RangeCounts
+    {
+        std::vector<int> types;
+        std::vector<int> freqs;
+        // Kanji found in the written form of the entries.
+        std::vector<char> found;
+    };
+
+    int siz = dict->entryCount();
+    std::vector<RangeCounts> counts(ParallelRanges::rangeCount(siz, 5000));
+
+    ParallelRanges::run(siz, 5000, [&](int index, int first, int last) {
+        RangeCounts &c = counts[index];
+        c.types.resize(typecnt, 0);
+        c.freqs.resize(freqcnt, 0);
+        c.found.resize(kanjicnt, 0);
+
+        for (int ix = first; ix != last; ++ix)
+        {
+            if ((ix % 1024) == 0 && terminate)
+                return;
+
+            WordEntry *e = dict->wordEntry(ix);
+
+            uint types = 0;
+            for (int iy = 0, siy = e->defs.size(); iy != siy; ++iy)
+                types |= e->defs[iy].attrib.types;
+            for (int iy = 0; iy != typecnt; ++iy)
+                if ((types & (1 << iy)) != 0)
+                    ++c.types[iy];
+
+            ++c.freqs[std::upper_bound(std::begin(freqranges), std::end(freqranges), (int)e->freq) - std::begin(freqranges)];
+
+            for (int iy = 0, siy = e->kanji.size(); iy != siy; ++iy)
+            {
+                if (!KANJI(e->kanji[iy].unicode()))
+                    continue;
+                int k = ZKanji::kanjiIndex(e->kanji[iy]);
+                if (k != -1)
+                    c.found[k] = 1;
+            }
+        }
+    });
+
+    if (terminate)
+        return;
+
+    DictionaryAggregates *r = new DictionaryAggregates;
+    r->types.resize(typecnt, 0);
+    r->freqs.resize(freqcnt, 0);
+    std::vector<char> found(kanjicnt, 0);
+    for (const RangeCounts &c : counts)
+    {
+        for (int ix = 0; ix != typecnt; ++ix)
+            r->types[ix] += c.types[ix];
+        for (int ix = 0; ix != freqcnt; ++ix)
+            r->freqs[ix] += c.freqs[ix];
+        for (int ix = 0; ix != kanjicnt; ++ix)
+            found[ix] |= c.found[ix];
+    }
+
+    r->kanji = 0;
+    r->jouyou = 0;
+    std::fill(std::begin(r->jlpt), std::end(r->jlpt), 0);
+    for (int ix = 0; ix != kanjicnt; ++ix)
+    {
+        if (found[ix] == 0)
+            continue;
+        ++r->kanji;
+
+        KanjiEntry *k = ZKanji::kanjis[ix];
+        // Grades 1 to 6 are taught in elementary school and 8 in secondary school.
+        if (k->jouyou >= 1 && k->jouyou <= 8)
+            ++r->jouyou;
+        if (k->jlpt >= 1 && k->jlpt <= 5)
+            ++r->jlpt[k->jlpt - 1];
+    }
+
+    aggregates.reset(r);
+    aggregatesdone = true;
 }
 
 
@@ -284,6 +429,21 @@ DictionaryStatsForm::DictionaryStatsForm(int index, QWidget *prnt) : base(prnt),
     restrictWidgetSize(ui->kanjiGrpNumLabel, 8);
     restrictWidgetSize(ui->wordGrpLabel, 8);
     restrictWidgetSize(ui->wordGrpNumLabel, 8);
+    restrictWidgetSize(ui->kanjiUsedLabel, 12);
+    restrictWidgetSize(ui->jouyouUsedLabel, 12);
+    restrictWidgetSize(ui->jlpt5Label, 12);
+    restrictWidgetSize(ui->jlpt4Label, 12);
+    restrictWidgetSize(ui->jlpt3Label, 12);
+    restrictWidgetSize(ui->jlpt2Label, 12);
+    restrictWidgetSize(ui->jlpt1Label, 12);
+
+    ui->typeTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->typeTree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    ui->typeTree->header()->setStretchLastSection(false);
+    ui->freqTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    ui->freqTree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    ui->freqTree->header()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+    ui->freqTree->header()->setStretchLastSection(false);
 
     updateData();
 
@@ -321,20 +481,25 @@ bool DictionaryStatsForm::event(QEvent *e)
         QTimerEvent *te = (QTimerEvent*)e;
         if (te->timerId() == timer.timerId())
         {
-            if (thread != nullptr && !thread->terminate && thread->done)
+            if (counter != nullptr)
             {
-                timer.stop();
-
-                Dictionary *d = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
-                StatResult &r = results[d];
-                r.entries = thread->entryResult();
-                r.defs = thread->definitionResult();
-                r.kanji = thread->kanjiResult();
-
-                thread.reset();
+                // Values already counted are shown while waiting for the rest.
+                StatResult r;
+                r.entries = counter->entryResult();
+                r.defs = counter->definitionResult();
+                r.kanji = counter->kanjiResult();
+                r.aggregates = counter->aggregateResult();
 
                 updateLabels(r);
 
+                if (counter->done())
+                {
+                    timer.stop();
+                    counter.reset();
+
+                    Dictionary *d = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
+                    results[d] = r;
+                }
             }
 
             return true;
@@ -435,6 +600,17 @@ void DictionaryStatsForm::updateData()
     ui->kanjiJouyouLabel->setText(QString::number(cnt));
     ui->kanjiJLPTLabel->setText(QString::number(cnt2));
 
+    std::fill(std::begin(jlptkanji), std::end(jlptkanji), 0);
+    jouyoukanji = 0;
+    for (int ix = 0, siz = ZKanji::kanjis.size(); ix != siz; ++ix)
+    {
+        KanjiEntry *k = ZKanji::kanjis[ix];
+        if (k->jlpt >= 1 && k->jlpt <= 5)
+            ++jlptkanji[k->jlpt - 1];
+        if (k->jouyou >= 1 && k->jouyou <= 8)
+            ++jouyoukanji;
+    }
+
     if (d == ZKanji::dictionary(0))
         setHtmlInfoText(d->infoText());
     else
@@ -449,9 +625,7 @@ void DictionaryStatsForm::updateData()
         return;
     }
 
-    ui->entryUniqueLabel->setText(tr("?"));
-    ui->defUniqueLabel->setText(tr("?"));
-    ui->kanjiGrpNumLabel->setText(tr("?"));
+    updateLabels({ -1, -1, -1 });
 
     startThreads(d);
 }
@@ -463,32 +637,78 @@ void DictionaryStatsForm::stopThreads()
 
     timer.stop();
 
-    if (thread == nullptr)
-        return;
-
-    thread->terminate = true;
-
-    auto mil1 = std::chrono::milliseconds(1);
-    while (!thread->done)
-        std::this_thread::sleep_for(mil1);
-
-    thread.reset();
+    // The counter interrupts the work and waits for its threads when destroyed.
+    counter.reset();
 }
 
 void DictionaryStatsForm::startThreads(Dictionary *d)
 {
-    thread.reset(new StatsThread(this, d));
-
-    QThreadPool::globalInstance()->start(thread.get());
+    counter.reset(new DictionaryStatsCounter(d));
 
     timer.start(100, this);
 }
 
 void DictionaryStatsForm::updateLabels(const StatResult &r)
 {
-    ui->entryUniqueLabel->setText(QString::number(r.entries));
-    ui->defUniqueLabel->setText(QString::number(r.defs));
-    ui->kanjiGrpNumLabel->setText(QString::number(r.kanji));
+    ui->entryUniqueLabel->setText(r.entries == -1 ? tr("?") : QString::number(r.entries));
+    ui->defUniqueLabel->setText(r.defs == -1 ? tr("?") : QString::number(r.defs));
+    ui->kanjiGrpNumLabel->setText(r.kanji == -1 ? tr("?") : QString::number(r.kanji));
+
+    updateAggregates(r.aggregates);
+}
+
+void DictionaryStatsForm::updateAggregates(const std::shared_ptr<const DictionaryAggregates> &a)
+{
+    if (a == shownaggregates && a != nullptr)
+        return;
+    shownaggregates = a;
+
+    ui->typeTree->clear();
+    ui->freqTree->clear();
+
+    QLabel *jlptlabels[] = { ui->jlpt1Label, ui->jlpt2Label, ui->jlpt3Label, ui->jlpt4Label, ui->jlpt5Label };
+    if (a == nullptr)
+    {
+        ui->kanjiUsedLabel->setText(tr("?"));
+        ui->jouyouUsedLabel->setText(tr("?"));
+        for (QLabel *lb : jlptlabels)
+            lb->setText(tr("?"));
+        return;
+    }
+
+    Dictionary *d = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
+
+    QList<QTreeWidgetItem*> items;
+    for (int ix = 0, siz = a->types.size(); ix != siz; ++ix)
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem({ Strings::capitalize(Strings::wordTypeLong(ix)), QString::number(a->types[ix]) });
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        items << item;
+    }
+    ui->typeTree->addTopLevelItems(items);
+
+    items.clear();
+    for (int ix = 0, siz = a->freqs.size(); ix != siz; ++ix)
+    {
+        QString range;
+        if (ix == 0)
+            range = tr("None");
+        else if (ix == siz - 1)
+            range = QString("%1+").arg(DictionaryStatsCounter::freqRange(ix));
+        else
+            range = QString("%1 - %2").arg(DictionaryStatsCounter::freqRange(ix)).arg(DictionaryStatsCounter::freqRange(ix + 1) - 1);
+
+        QTreeWidgetItem *item = new QTreeWidgetItem({ range, QString::number(a->freqs[ix]), QString("%1%").arg(d->entryCount() == 0 ? 0. : a->freqs[ix] * 100. / d->entryCount(), 0, 'f', 1) });
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
+        items << item;
+    }
+    ui->freqTree->addTopLevelItems(items);
+
+    ui->kanjiUsedLabel->setText(QString("%1 / %2").arg(a->kanji).arg(ZKanji::kanjis.size()));
+    ui->jouyouUsedLabel->setText(QString("%1 / %2").arg(a->jouyou).arg(jouyoukanji));
+    for (int ix = 0; ix != 5; ++ix)
+        jlptlabels[ix]->setText(QString("%1 / %2").arg(a->jlpt[ix]).arg(jlptkanji[ix]));
 }
 
 void DictionaryStatsForm::setHtmlInfoText(const QString &str)
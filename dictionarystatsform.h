@@ -7,49 +7,86 @@
 #ifndef DICTIONARYSTATSFORM_H
 #define DICTIONARYSTATSFORM_H
 
-#include <QThread>
 #include <QBasicTimer>
 #include <atomic>
 #include <memory>
+#include <vector>
 #include "dialogwindow.h"
 
 namespace Ui {
     class DictionaryStatsForm;
 }
 
-class DictionaryStatsForm;
+// Values counted in a single pass over the entries of a dictionary.
+struct DictionaryAggregates
+{
+    // Number of entries with a definition of each word type. See WordTypes in
+    // grammar_enums.h.
+    std::vector<int> types;
+    // Number of entries in each frequency range. See DictionaryStatsCounter::freqRange().
+    std::vector<int> freqs;
+    // Number of different kanji written in the entries.
+    int kanji;
+    // Number of different jouyou kanji written in the entries.
+    int jouyou;
+    // Number of different kanji of each JLPT level written in the entries, starting at N1.
+    int jlpt[5];
+};
+
 class Dictionary;
-class StatsThread : public QRunnable
+class ParallelRanges;
+// Counts the statistics of a dictionary that take long to compute. Each statistic is counted
+// on the global thread pool, and the lists sorted for counting unique values and the
+// entries for the aggregates are split into ranges processed on further pool threads. The
+// finished values can be read while the rest are counted.
+class DictionaryStatsCounter
 {
 public:
-    StatsThread(DictionaryStatsForm *owner, Dictionary *dict);
-    virtual ~StatsThread();
+    // Starts counting the statistics of dict.
+    DictionaryStatsCounter(Dictionary *dict);
+    // Interrupts the counting and waits for the work to finish.
+    ~DictionaryStatsCounter();
 
-    virtual void run() override;
-    // Returns the calculated value. Only valid when the variable "done" is set to true.
+    // Returns the counted value, or -1 if it's still being counted.
     int entryResult() const;
     int definitionResult() const;
     int kanjiResult() const;
+    // Returns the aggregates, or null if they are still being counted.
+    std::shared_ptr<const DictionaryAggregates> aggregateResult() const;
 
-    std::atomic_bool terminate;
-    std::atomic_bool done;
+    // Returns true when every value has been counted.
+    bool done() const;
+
+    // Number of frequency ranges in DictionaryAggregates::freqs.
+    static int freqRangeCount();
+    // Returns the lowest frequency in the range at index. Range 0 holds the entries without
+    // frequency.
+    static int freqRange(int index);
 private:
-    // Checks whether the thread should be terminated. If so, sets done to true and returns 
-    // true.
-    bool checkTerminate();
+    void calculateEntries();
+    void calculateDefinitions();
+    void calculateKanji();
+    void calculateAggregates();
 
-    bool calculateEntries();
-    bool calculateDefinitions();
-    bool calculateKanji();
+    // Sorts list with a comparison function taking a third bool& argument like in
+    // interruptSort(). Returns false if the sort was interrupted.
+    template<typename T, typename Comp>
+    bool sort(std::vector<T> &list, Comp cmp);
 
-    DictionaryStatsForm *owner;
     Dictionary *dict;
 
-    int valentry;
-    int valdef;
-    int valkanji;
+    std::atomic_bool terminate;
+
+    std::atomic_int valentry;
+    std::atomic_int valdef;
+    std::atomic_int valkanji;
 
-    typedef QRunnable base;
+    // Set after aggregates has been filled.
+    std::atomic_bool aggregatesdone;
+    std::shared_ptr<const DictionaryAggregates> aggregates;
+
+    // Runs the calculations on the global thread pool.
+    std::unique_ptr<ParallelRanges> work;
 };
 
 struct StatResult
@@ -57,6 +94,7 @@ struct StatResult
     int entries;
     int defs;
     int kanji;
+    std::shared_ptr<const DictionaryAggregates> aggregates;
 };
 
 class Dictionary;
@@ -80,16 +118,26 @@ private:
     void startThreads(Dictionary *d);
 
     void updateLabels(const StatResult &result);
+    // Fills the lists and labels of the aggregates counted in a single pass, or shows that
+    // they are still being counted when a is null.
+    void updateAggregates(const std::shared_ptr<const DictionaryAggregates> &a);
 
     void setHtmlInfoText(const QString &str);
 
     Ui::DictionaryStatsForm *ui;
     QBasicTimer timer;
 
-    std::unique_ptr<StatsThread> thread;
+    std::unique_ptr<DictionaryStatsCounter> counter;
 
     std::map<Dictionary *, StatResult> results;
 
+    // Aggregates shown in the widgets. Used to avoid filling the lists again while waiting
+    // for the other values.
+    std::shared_ptr<const DictionaryAggregates> shownaggregates;
+    // Number of kanji of each JLPT level starting at N1, and the number of jouyou kanji.
+    int jlptkanji[5];
+    int jouyoukanji;
+
     typedef DialogWindow    base;
 };
 
@@ -14,6 +14,9 @@
 #include <QFormLayout>
 #include <QSplitter>
 #include <QDesktopWidget>
+#include <QInputDialog>
+#include <QPushButton>
+#include <QProgressDialog>
 
 #include "globalui.h"
 #include "zui.h"
@@ -47,6 +50,7 @@
 #include "colorsettings.h"
 #include "wordtogroupform.h"
 #include "wordtodictionaryform.h"
+#include "textvocabulary.h"
 
 //// Mode button icon image width.
 //static const int _iconW = 16;
@@ -964,7 +968,7 @@ void GlobalUI::timerEvent(QTimerEvent *e)
         if (lastsave.secsTo(now) >= Settings::data.interval * 60)
         {
             lastsave = now;
-            ZKanji::saveUserData();
+            ZKanji::saveUserData(false, true);
         }
     }
 }
@@ -1395,6 +1399,106 @@ void GlobalUI::dictImportAction()
         QMessageBox::warning(!mainforms.empty() ? mainforms[0] : nullptr, "zkanji", tr("The dictionary update was aborted."));
 }
 
+void GlobalUI::dictDeltaExportAction()
+{
+    GetDictEvent d;
+
+    qApp->sendEvent(qApp->activeWindow(), &d);
+
+    if (d.result() == -1)
+        return;
+
+    QWidget *parent = !mainforms.empty() ? mainforms[0] : nullptr;
+    Dictionary *dict = ZKanji::dictionary(d.result());
+
+    QString basename = QFileDialog::getOpenFileName(parent, tr("Open earlier dictionary file to compare with"), ZKanji::userFolder() + "/data", QString("%1 (*.zkdict)").arg(tr("Dictionary file")));
+    if (basename.isEmpty())
+        return;
+
+    QString fname = QFileDialog::getSaveFileName(parent, tr("Save dictionary update file"), QString(), QString("%1 (*.zkanji.delta)").arg(tr("Dictionary update file")));
+    if (fname.isEmpty())
+        return;
+
+    std::unique_ptr<Dictionary> base(new Dictionary);
+    try
+    {
+        base->loadFile(basename, dict == ZKanji::dictionary(0), true);
+
+        // The groups and decks are compared with the user data saved with the dictionary.
+        QFileInfo inf(basename);
+        QString userbasename = inf.path() + "/" + inf.completeBaseName() + ".zkuser";
+        if (QFileInfo::exists(userbasename))
+            base->loadUserDataFile(userbasename);
+    }
+    catch (...)
+    {
+        QMessageBox::warning(parent, "zkanji", tr("The selected dictionary file or its user data couldn't be loaded."));
+        return;
+    }
+
+    Error err = dict->saveDelta(fname, base.get());
+    if (!err)
+        QMessageBox::warning(parent, "zkanji", tr("The dictionary update file couldn't be written.") % QString("\n\n%1").arg(err.toString()));
+}
+
+void GlobalUI::dictDeltaImportAction()
+{
+    GetDictEvent d;
+
+    qApp->sendEvent(qApp->activeWindow(), &d);
+
+    if (d.result() == -1)
+        return;
+
+    QWidget *parent = !mainforms.empty() ? mainforms[0] : nullptr;
+    Dictionary *dict = ZKanji::dictionary(d.result());
+
+    QString fname = QFileDialog::getOpenFileName(parent, tr("Open dictionary update file"), QString(), QString("%1 (*.zkanji.delta)").arg(tr("Dictionary update file")));
+    if (fname.isEmpty())
+        return;
+
+    Error err = dict->applyDelta(fname);
+    if (!err)
+    {
+        QMessageBox::warning(parent, "zkanji", tr("The dictionary update file couldn't be read. The dictionary wasn't changed.") % QString("\n\n%1").arg(err.toString()));
+        return;
+    }
+
+    QMessageBox::information(parent, "zkanji", tr("The dictionary has been updated."));
+}
+
+void GlobalUI::textWordsAction()
+{
+    GetDictEvent d;
+
+    qApp->sendEvent(qApp->activeWindow(), &d);
+
+    if (d.result() == -1)
+        return;
+
+    QStringList fnames = QFileDialog::getOpenFileNames(!mainforms.empty() ? mainforms[0] : nullptr, tr("Open text files"), QString(), QString("%1 (*.txt);;%2 (*)").arg(tr("Text files")).arg(tr("All files")));
+    if (fnames.isEmpty())
+        return;
+
+    collectTextWords(ZKanji::dictionary(d.result()), fnames);
+}
+
+void GlobalUI::textFolderWordsAction()
+{
+    GetDictEvent d;
+
+    qApp->sendEvent(qApp->activeWindow(), &d);
+
+    if (d.result() == -1)
+        return;
+
+    QString path = QFileDialog::getExistingDirectory(!mainforms.empty() ? mainforms[0] : nullptr, tr("Select folder of text files"));
+    if (path.isEmpty())
+        return;
+
+    collectTextWords(ZKanji::dictionary(d.result()), QStringList() << path);
+}
+
 void GlobalUI::saveUserData()
 {
     ZKanji::saveUserData(true);
@@ -1808,6 +1912,70 @@ void GlobalUI::installShortcuts(bool install)
     }
 }
 
+void GlobalUI::collectTextWords(Dictionary *dict, const QStringList &paths)
+{
+    QWidget *parent = !mainforms.empty() ? mainforms[0] : nullptr;
+
+    QStringList levels;
+    levels << tr("Keep every word") << tr("Skip N5 words") << tr("Skip N5 to N4 words") << tr("Skip N5 to N3 words") << tr("Skip N5 to N2 words") << tr("Skip every JLPT word");
+    bool ok;
+    QString level = QInputDialog::getItem(parent, "zkanji", tr("Words already in a group or a deck are skipped. Select the known JLPT levels:"), levels, 0, false, &ok);
+    if (!ok)
+        return;
+
+    TextVocabularyFilter filter;
+    // The bit of N5 is the lowest in the format of WordAttributeFilter::jlpt.
+    filter.skipjlpt = (1 << levels.indexOf(level)) - 1;
+
+    TextVocabulary vocab(dict);
+    bool result = true;
+    {
+        // The size of the text is not known in advance, so the dialog only shows that the
+        // processing is running.
+        QProgressDialog progress(tr("Collecting words from the text..."), tr("Cancel"), 0, 0, parent);
+        progress.setWindowModality(Qt::ApplicationModal);
+        progress.setMinimumDuration(500);
+
+        // The value must change for the dialog to process the events.
+        int blocks = 0;
+        auto callback = [&progress, &blocks]() {
+            progress.setValue(++blocks);
+            return !progress.wasCanceled();
+        };
+
+        for (int ix = 0; result && ix != paths.size(); ++ix)
+            result = vocab.add(paths.at(ix), callback);
+
+        if (progress.wasCanceled())
+            return;
+    }
+
+    std::vector<int> windexes;
+    vocab.words(filter, windexes);
+
+    if (!result)
+        QMessageBox::warning(parent, "zkanji", tr("Some of the text files couldn't be read."));
+    if (windexes.empty())
+    {
+        QMessageBox::information(parent, "zkanji", tr("No new words were found in the text."));
+        return;
+    }
+
+    QMessageBox box(QMessageBox::Question, "zkanji", tr("Found %1 new words. Where should they be added?").arg(windexes.size()), QMessageBox::Cancel, parent);
+    QPushButton *groupbutton = box.addButton(tr("Word group..."), QMessageBox::AcceptRole);
+    QPushButton *deckbutton = box.addButton(tr("Study deck..."), QMessageBox::AcceptRole);
+    box.exec();
+
+    if (box.clickedButton() == groupbutton)
+    {
+        WordGroup *dest = dynamic_cast<WordGroup*>(GroupPickerForm::select(GroupWidget::Modes::Words, tr("Select a word group for the words found in the text."), dict, false, false, parent));
+        if (dest != nullptr)
+            dest->add(windexes);
+    }
+    else if (box.clickedButton() == deckbutton)
+        addWordsToDeck(dict, windexes, parent);
+}
+
 void GlobalUI::_scaleSpacerItem(QSpacerItem *s)
 {
     QSizePolicy sp = s->sizePolicy();
@@ -288,6 +288,16 @@ public slots:
     void userImportAction();
     void dictExportAction();
     void dictImportAction();
+    // Writes the differences of a dictionary from an earlier copy of its file to a delta file.
+    void dictDeltaExportAction();
+    // Applies the changes in a delta file to a dictionary.
+    void dictDeltaImportAction();
+    // Lets the user select text files and collects the dictionary words found in them into
+    // a word group or a deck.
+    void textWordsAction();
+    // Lets the user select a folder and collects the dictionary words found in its text
+    // files into a word group or a deck.
+    void textFolderWordsAction();
     void saveUserData();
     void showSettingsWindow();
     // Called at the start of the program to load the scaling value from the ini file. All
@@ -360,6 +370,10 @@ private:
     // Installs and uninstalls system wide shortcuts for the popup dictionaries.
     void installShortcuts(bool install);
 
+    // Counts the words in the text files or folders at paths, and adds those not yet studied
+    // to a word group or a deck selected by the user, in the order of their frequency.
+    void collectTextWords(Dictionary *dict, const QStringList &paths);
+
     // Helper for scaleWidget(). Scales spacer items in layouts.
     void _scaleSpacerItem(QSpacerItem *s);
     // Helper for scaleWidget(). Scales layouts.
@@ -5,6 +5,7 @@
 **/
 
 #include <QFileDialog>
+#include <QMessageBox>
 
 #include "ui_groupexportform.h"
 #include "groupexportform.h"
@@ -53,7 +54,10 @@ void GroupExportForm::exportClicked()
 {
     QString fname = QFileDialog::getSaveFileName(nullptr, tr("Save export file"), QString(), QString("%1 (*.zkanji.export)").arg(tr("Export file")));
     if (fname.isEmpty())
+    {
         closeCancel();
+        return;
+    }
 
     std::vector<KanjiGroup*> kanjilist;
     std::vector<WordGroup*> wordslist;
@@ -78,7 +82,11 @@ void GroupExportForm::exportClicked()
     }
 
     Dictionary *dict = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
-    dict->exportUserData(fname, kanjilist, ui->kanjiBox->isChecked(), wordslist, ui->wordsBox->isChecked());
+    if (!dict->exportUserData(fname, kanjilist, ui->kanjiBox->isChecked(), wordslist, ui->wordsBox->isChecked()))
+    {
+        QMessageBox::warning(this, "zkanji", tr("The export file couldn't be written."));
+        return;
+    }
 
     closeOk();
 }
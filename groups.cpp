@@ -104,7 +104,7 @@ void GroupBase::setName(QString newname)
     // whether the / character or some other should be forbidden and used as path separator.
 
     _name = newname;
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 }
 
 const QString GroupBase::fullEncodedName() const
@@ -328,7 +328,7 @@ int GroupCategoryBase::addCategory(QString name)
 {
     list.push_back(createCategory(name));
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
     emit owner->categoryAdded(this, list.size() - 1);
     return list.size() - 1;
 }
@@ -337,7 +337,7 @@ int GroupCategoryBase::addGroup(QString name)
 {
     groups.push_back(createGroup(name));
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
     emit owner->groupAdded(this, groups.size() - 1);
 
     return groups.size() - 1;
@@ -356,7 +356,7 @@ void GroupCategoryBase::deleteCategory(int index)
     emit owner->categoryAboutToBeDeleted(this, index, list[index]);
 
     list.erase(list.begin() + index);
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 
     emit owner->categoryDeleted(this, index, oldptr);
 }
@@ -378,7 +378,7 @@ void GroupCategoryBase::deleteGroup(int index)
     emit owner->groupAboutToBeDeleted(this, index, groups[index]);
 
     groups.erase(groups.begin() + index);
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 
     owner->emitGroupDeleted(this, index, oldptr);
     //emit owner->groupDeleted(this, index, oldptr);
@@ -412,7 +412,7 @@ void GroupCategoryBase::remove(const std::vector<GroupBase*> &which)
         }
     }
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 }
 
 bool GroupCategoryBase::moveCategory(GroupCategoryBase *what, GroupCategoryBase *destparent, int destindex)
@@ -459,7 +459,7 @@ bool GroupCategoryBase::moveCategory(GroupCategoryBase *what, GroupCategoryBase
         destparent->list.insert(destparent->list.begin() + destindex, what);
     }
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
     emit categoryMoved(p, ix, destparent, destindex);
 
     return true;
@@ -509,7 +509,7 @@ bool GroupCategoryBase::moveGroup(GroupBase *what, GroupCategoryBase *destparent
         destparent->groups.insert(destparent->groups.begin() + destindex, what);
     }
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
     emit groupMoved(p, ix, destparent, destindex);
 
     return true;
@@ -569,7 +569,7 @@ void GroupCategoryBase::moveCategories(const std::vector<GroupCategoryBase*> &mo
         }
     }
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 }
 
 void GroupCategoryBase::moveGroups(const std::vector<GroupBase*> &moved, GroupCategoryBase *destparent, int destindex)
@@ -627,7 +627,7 @@ void GroupCategoryBase::moveGroups(const std::vector<GroupBase*> &moved, GroupCa
         }
     }
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(UserDataSection::Groups);
 }
 
 int GroupCategoryBase::categoryIndex(GroupCategoryBase *child)
@@ -998,6 +998,74 @@ void GroupCategoryBase::selectTopItems(const std::vector<GroupBase*> &src, std::
 //-------------------------------------------------------------
 
 
+template<typename T>
+void GroupPositionIndex<T>::appended(const std::vector<T> &list, int first)
+{
+    if (!valid)
+        return;
+
+    if (list.size() * 2 > table.size())
+    {
+        valid = false;
+        return;
+    }
+
+    for (int ix = first, siz = list.size(); ix != siz; ++ix)
+        place(list, ix);
+}
+
+template<typename T>
+int GroupPositionIndex<T>::find(const std::vector<T> &list, T val) const
+{
+    if (list.empty())
+        return -1;
+
+    if (!valid)
+        rebuild(list);
+
+    int mask = table.size() - 1;
+    for (int ix = slot(val); table[ix] != -1; ix = (ix + 1) & mask)
+        if (list[table[ix]] == val)
+            return table[ix];
+
+    return -1;
+}
+
+template<typename T>
+void GroupPositionIndex<T>::rebuild(const std::vector<T> &list) const
+{
+    bits = 4;
+    while ((1 << bits) < list.size() * 2)
+        ++bits;
+
+    table.assign(1 << bits, -1);
+    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
+        place(list, ix);
+
+    valid = true;
+}
+
+template<typename T>
+void GroupPositionIndex<T>::place(const std::vector<T> &list, int pos) const
+{
+    int mask = table.size() - 1;
+    int ix = slot(list[pos]);
+    while (table[ix] != -1)
+        ix = (ix + 1) & mask;
+    table[ix] = pos;
+}
+
+template<typename T>
+int GroupPositionIndex<T>::slot(T val) const
+{
+    // Fibonacci hashing. The top bits of the product are the best mixed.
+    return (int)(((quint32)val * 0x9E3779B1u) >> (32 - bits));
+}
+
+
+//-------------------------------------------------------------
+
+
 //WordGroup::WordGroup(WordGroups *parent) : base(parent, QString()), study(this)
 //{
 //    ;
@@ -1018,6 +1086,7 @@ WordGroup& WordGroup::operator=(WordGroup &&src)
     base::operator=(std::forward<WordGroup>(src));
     std::swap(study, src.study);
     std::swap(list, src.list);
+    std::swap(posindex, src.posindex);
     //std::swap(defs, src.defs);
 
     return *this;
@@ -1030,12 +1099,17 @@ WordGroup::~WordGroup()
 
 void WordGroup::load(QDataStream &stream)
 {
+    // Groups are loaded again when replaying the user data journal.
+    clear();
+
     base::load(stream);
 
     stream >> make_zvec<qint32, qint32>(list);
+    posindex.invalidate();
     for (int ix = 0; ix != list.size(); ++ix)
     {
-        owner().groupsOfWord(list[ix])->push_front(this);
+        std::vector<WordGroup*> &wg = *owner().groupsOfWord(list[ix]);
+        wg.insert(wg.begin(), this);
         dictionary()->wordEntry(list[ix])->dat |= (1 << (int)WordRuntimeData::InGroup);
     }
 
@@ -1070,33 +1144,21 @@ void WordGroup::copy(GroupBase *src)
     base::copy(src);
     modelptr.reset();
     list = ((WordGroup*)src)->list;
+    posindex.invalidate();
     study.copy(&((WordGroup*)src)->study);
 }
 
-void WordGroup::applyChanges(const std::map<int, int> &changes)
+void WordGroup::applyChanges(const WordIndexMap &changes)
 {
-    QSet<int> found;
+    bool changed = !list.empty();
 
-    bool changed = false;
-    for (int ix = 0; ix != list.size(); ++ix)
-    {
-        auto it = changes.find(list[ix]);
-        if (it == changes.end() || it->second == -1 || found.contains(it->second))
-        {
-            list.erase(list.begin() + ix);
-            --ix;
-            changed = true;
-            continue;
-        }
-        list[ix] = it->second;
-        changed = true;
-        found.insert(it->second);
-    }
+    changes.apply(list);
+    posindex.invalidate();
 
     study.applyChanges(changes);
 
     if (changed)
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(UserDataSection::Groups);
 }
 
 void WordGroup::processRemovedWord(int windex)
@@ -1104,6 +1166,7 @@ void WordGroup::processRemovedWord(int windex)
     study.processRemovedWord(windex);
 
     int pos = removeIndexFromList(windex, list);
+    posindex.invalidate();
     if (pos != -1)
         emit owner().itemsRemoved(this, { { pos, pos } });
 }
@@ -1113,23 +1176,15 @@ void WordGroup::clear()
     for (int ix = 0; ix != size(); ++ix)
     {
         auto &g = *owner().groupsOfWord(list[ix]);
-        auto it = g.before_begin();
-        auto itn = std::next(it);
-        while (itn != g.end())
-        {
-            if (*itn == this)
-            {
-                g.erase_after(it);
-                break;
-            }
-            ++it;
-            ++itn;
-        }
+        auto it = std::find(g.begin(), g.end(), this);
+        if (it != g.end())
+            g.erase(it);
 
         if (g.empty())
             owner().checkGroupsOfWord(list[ix]);
     }
     list.clear();
+    posindex.invalidate();
 }
 
 int WordGroup::size() const
@@ -1200,11 +1255,7 @@ int WordGroup::indexes(int pos) const
 
 int WordGroup::indexOf(int windex) const
 {
-    auto it = std::find(list.begin(), list.end(), windex);
-    if (it == list.end())
-        return -1;
-
-    return it - list.begin();
+    return posindex.find(list, windex);
 }
 
 void WordGroup::indexOf(const std::vector<int> &windexes, std::vector<int> &positions) const
@@ -1212,39 +1263,19 @@ void WordGroup::indexOf(const std::vector<int> &windexes, std::vector<int> &posi
     if (windexes.empty())
         return;
 
-    // An ordering of list by word index.
-    std::vector<int> order;
-    order.reserve(list.size());
-    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
-        order.push_back(ix);
-    std::sort(order.begin(), order.end(), [this](int a, int b) { return list[a] < list[b]; });
-
-    std::vector<int> worder = windexes;
-    std::sort(worder.begin(), worder.end());
-
-    positions.clear();
-
-    int opos = std::lower_bound(order.begin(), order.end(), worder.front(), [this](int ord, int wix) { return list[ord] < wix; }) - order.begin();
-    for (int wpos = 0, wsiz = worder.size(), osiz = order.size(); wpos != wsiz && opos != osiz;)
+    std::vector<int> found;
+    found.reserve(windexes.size());
+    for (int windex : windexes)
     {
-        while (wpos != wsiz && worder[wpos] < list[order[opos]])
-            ++wpos;
-        if (wpos == wsiz)
-            break;
-        while (opos != osiz && worder[wpos] > list[order[opos]])
-            ++opos;
-        if (opos == osiz)
-            break;
-
-        while (opos != osiz && wpos != wsiz && worder[wpos] == list[order[opos]])
-        {
-            positions.push_back(order[opos]);
-            ++opos;
-            ++wpos;
-        }
+        int pos = posindex.find(list, windex);
+        if (pos != -1)
+            found.push_back(pos);
     }
 
-    std::sort(positions.begin(), positions.end());
+    std::sort(found.begin(), found.end());
+    found.resize(std::unique(found.begin(), found.end()) - found.begin());
+
+    std::swap(positions, found);
 }
 
 
@@ -1315,25 +1346,27 @@ int WordGroup::insert(int windex, int pos)
 
     // Check whether the entry is already added to this group to not add it again.
 
-    std::forward_list<WordGroup*> &wg = *owner().groupsOfWord(windex);
+    std::vector<WordGroup*> &wg = *owner().groupsOfWord(windex);
     auto git = std::find(wg.begin(), wg.end(), this);
     if (git != wg.end())
     {
         // Word entry already added. Just return its position.
-
-        auto it = std::find(list.begin(), list.end(), windex);
-        return it - list.begin();
+        return posindex.find(list, windex);
     }
 
     // Word entry wasn't added. Set its dat to remember that it has been added here.
 
     dictionary()->wordEntry(windex)->dat |= (1 << (int)WordRuntimeData::InGroup);
     list.insert(list.begin() + pos, windex);
+    if (pos == list.size() - 1)
+        posindex.appended(list, pos);
+    else
+        posindex.invalidate();
 
     // The wg list holds which groups have the word entry. It must be updated.
-    wg.push_front(this);
+    wg.insert(wg.begin(), this);
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(this);
     emit owner().itemsInserted(this, { { pos, 1 } });
 
     return pos;
@@ -1354,8 +1387,7 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
     if (pos == -1)
         pos = list.size();
 
-    // To avoid adding duplicate words, the list of words and the windexes are both sorted
-    // and checked for duplicates.
+    // To avoid adding duplicate words, windexes are looked up in the group first.
 
     if (windexes.empty())
         return 0;
@@ -1374,52 +1406,27 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
         return s == list.size() ? 0 : 1;
     }
 
-    // Pairs of [index in list, word index].
-    std::vector<std::pair<int, int>> listorder;
-    listorder.reserve(list.size());
-    for (int ix = 0; ix != list.size(); ++ix)
-        listorder.push_back(std::make_pair(ix, list[ix]));
-    std::sort(listorder.begin(), listorder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-
-    // Pairs of [index in windexes, word index].
-    std::vector<std::pair<int, int>> worder;
+    // Word indexes in windexes. To show that a word has already been added, its word index
+    // is changed to a negative value. The value is set to [-1 - word's old position in list].
+    // This value will be used later to update the positions list.
+    std::vector<int> worder;
     worder.reserve(windexes.size());
-    for (int ix = 0; ix != windexes.size(); ++ix)
-        worder.push_back(std::make_pair(ix, windexes[ix]));
-    std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-
-    if (positions != nullptr)
-        positions->reserve(windexes.size());
 
     int added = windexes.size();
-
-    for (int ix = 0, wix = 0; ix != listorder.size() && wix != worder.size(); )
+    for (int ix = 0; ix != windexes.size(); ++ix)
     {
-        if (listorder[ix].second < worder[wix].second)
+        int oldpos = posindex.find(list, windexes[ix]);
+        if (oldpos != -1)
         {
-            // Word in group but not in windexes.
-            ++ix;
-            continue;
-        }
-    
-        if (listorder[ix].second == worder[wix].second)
-        {
-            // To show that a word has already been added, its word index is changed to a
-            // negative value. The value is set to [-1 - word's old position in list]. This
-            // value will be used later to update the positions list.
-            worder[wix].second = -1 - listorder[ix].first;
-
-            ++ix;
+            worder.push_back(-1 - oldpos);
             --added;
         }
-
-        ++wix;
+        else
+            worder.push_back(windexes[ix]);
     }
 
-    // Restore the original order of the entry indexes to be inserted.
-    std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
-        return a.first < b.first;
-    });
+    if (positions != nullptr)
+        positions->reserve(windexes.size());
 
     if (positions == nullptr && added == 0)
         return 0;
@@ -1427,7 +1434,7 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
     list.insert(list.begin() + pos, added, 0);
     for (int ix = 0, aix = 0; ix != worder.size(); ++ix)
     {
-        int val = worder[ix].second;
+        int val = worder[ix];
         if (val < 0)
         {
             // Word already in group.
@@ -1452,8 +1459,8 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
         list[pos + aix] = val;
 
         // The list that holds which groups have the word entry must be updated.
-        std::forward_list<WordGroup*> &wg = *owner().groupsOfWord(val);
-        wg.push_front(this);
+        std::vector<WordGroup*> &wg = *owner().groupsOfWord(val);
+        wg.insert(wg.begin(), this);
 
         if (positions != nullptr)
             positions->push_back(pos + aix);
@@ -1461,9 +1468,14 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
         ++aix;
     }
 
+    if (pos + added == list.size())
+        posindex.appended(list, pos);
+    else
+        posindex.invalidate();
+
     if (added != 0)
     {
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(this);
         emit owner().itemsInserted(this, { { pos, added } });
     }
 
@@ -1513,13 +1525,16 @@ void WordGroup::remove(const smartvector<Range> &ranges)
     //    lastpos = firstpos;
     //}
 
-    for (int ix = ranges.size() - 1; ix != -1; --ix)
+    // The words between the ranges are moved to their new positions in a single pass.
+    int dest = ranges[0]->first;
+    for (int ix = 0, siz = ranges.size(); ix != siz; ++ix)
     {
         const Range *r = ranges[ix];
         for (int iy = r->first, last = r->last; iy != last + 1; ++iy)
             removeFromGroup(iy);
 
-        list.erase(list.begin() + r->first, list.begin() + r->last + 1);
+        int next = ix == siz - 1 ? list.size() : ranges[ix + 1]->first;
+        dest = std::move(list.begin() + r->last + 1, list.begin() + next, list.begin() + dest) - list.begin();
 
         //if (prev == -1 || sorted[prev + 1] - sorted[prev] != 1)
         //{
@@ -1527,8 +1542,10 @@ void WordGroup::remove(const smartvector<Range> &ranges)
         //    pos = prev;
         //}
     }
+    list.resize(dest);
+    posindex.invalidate();
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(this);
     emit owner().itemsRemoved(this, ranges);
 }
 
@@ -1541,7 +1558,8 @@ void WordGroup::move(const smartvector<Range> &ranges, int pos)
         pos = list.size();
 
     if (_moveRanges(ranges, pos, list))
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(this);
+    posindex.invalidate();
     emit owner().itemsMoved(this, ranges, pos);
 }
 
@@ -1552,7 +1570,8 @@ void WordGroup::removeAt(int index)
     //emit owner().beginItemsRemove(this, index, index);
 
     list.erase(list.begin() + index);
-    dictionary()->setToUserModified();
+    posindex.invalidate();
+    dictionary()->setToUserModified(this);
 
     emit owner().itemsRemoved(this, { { index, 1 } }/*, index, index*/);
 }
@@ -1570,7 +1589,8 @@ void WordGroup::removeRange(int first, int last)
         removeFromGroup(ix);
 
     list.erase(list.begin() + first, list.begin() + last + 1);
-    dictionary()->setToUserModified();
+    posindex.invalidate();
+    dictionary()->setToUserModified(this);
 
     emit owner().itemsRemoved(this, { { first, last } }/*, first, last*/);
 }
@@ -1622,25 +1642,14 @@ void WordGroup::removeFromGroup(int index)
 
     // Check whether the word is added to this group first, and erase it from the list of
     // groups for this word.
-    std::forward_list<WordGroup*> &wg = *owner().groupsOfWord(windex);
+    std::vector<WordGroup*> &wg = *owner().groupsOfWord(windex);
     bool found = false;
 
-    if (!wg.empty())
+    auto it = std::find(wg.begin(), wg.end(), this);
+    if (it != wg.end())
     {
-        auto preit = wg.before_begin();
-        auto it = std::next(preit);
-        while (it != wg.end())
-        {
-            if (*it == this)
-            {
-                wg.erase_after(preit);
-                found = true;
-                break;
-            }
-            preit = it;
-            it = std::next(preit);
-        }
-
+        wg.erase(it);
+        found = true;
     }
 
 #ifdef _DEBUG
@@ -1983,30 +1992,32 @@ void WordGroups::clear()
     emit groupsReseted();
 }
 
-void WordGroups::applyChanges(const std::map<int, int> &changes)
+void WordGroups::applyChanges(const WordIndexMap &changes)
 {
     // Fix the words' groups listing.
-    std::map<int, std::forward_list<WordGroup*>> tmp;
+    std::unordered_map<int, std::vector<WordGroup*>> tmp;
+    tmp.reserve(wordsgroups.size());
     for (auto it = wordsgroups.begin(); it != wordsgroups.end(); ++it)
     {
-        auto ch = changes.find(it->first);
-        if (ch->second != -1)
+        int newindex = changes[it->first];
+        if (newindex != -1)
         {
-            std::forward_list<WordGroup*> &tmplist = tmp[ch->second];
+            std::vector<WordGroup*> &tmplist = tmp[newindex];
             if (tmplist.empty())
             {
                 tmplist = std::move(it->second);
-                dictionary()->wordEntry(ch->second)->dat |= (1 << (int)WordRuntimeData::InGroup);
+                dictionary()->wordEntry(newindex)->dat |= (1 << (int)WordRuntimeData::InGroup);
             }
             else
-                tmplist.insert_after(tmplist.before_begin(), it->second.begin(), it->second.end());
+                tmplist.insert(tmplist.end(), it->second.begin(), it->second.end());
         }
     }
     std::swap(tmp, wordsgroups);
     for (auto it = wordsgroups.begin(); it != wordsgroups.end(); ++it)
     {
-        it->second.sort();
-        it->second.unique();
+        std::vector<WordGroup*> &list = it->second;
+        std::sort(list.begin(), list.end());
+        list.resize(std::unique(list.begin(), list.end()) - list.begin());
     }
     
     // Apply changes in categories and their groups recursively.
@@ -2028,8 +2039,9 @@ void WordGroups::processRemovedWord(int windex)
 {
     // Rebuilding the wordsgroups mapping.
 
-    std::map<int, std::forward_list<WordGroup*>> tmp;
+    std::unordered_map<int, std::vector<WordGroup*>> tmp;
     std::swap(tmp, wordsgroups);
+    wordsgroups.reserve(tmp.size());
 
     for (auto it = tmp.begin(); it != tmp.end(); ++it)
     {
@@ -2054,7 +2066,7 @@ const Dictionary* WordGroups::dictionary() const
     return owner->dictionary();
 }
 
-std::forward_list<WordGroup*>* WordGroups::groupsOfWord(int windex, bool creation)
+std::vector<WordGroup*>* WordGroups::groupsOfWord(int windex, bool creation)
 {
     auto it = wordsgroups.find(windex);
 
@@ -2116,7 +2128,7 @@ void WordGroups::emitGroupDeleted(GroupCategoryBase *parent, int index, void *ol
         lastgroup = nullptr;
 }
 
-void WordGroups::groupsApplyChanges(GroupCategoryBase *cat, const std::map<int, int> &changes)
+void WordGroups::groupsApplyChanges(GroupCategoryBase *cat, const WordIndexMap &changes)
 {
     for (int ix = 0, siz = cat->size(); ix != siz; ++ix)
         ((WordGroup*)cat->items(ix))->applyChanges(changes);
@@ -2147,7 +2159,7 @@ void WordGroups::fixWordsGroups()
             for (int iy = 0, siy = g->size(); iy != siy; ++iy)
             {
                 auto &wg = *groupsOfWord(g->indexes(iy), true);
-                wg.push_front(g);
+                wg.insert(wg.begin(), g);
             }
         }
     }
@@ -2177,6 +2189,7 @@ KanjiGroup& KanjiGroup::operator=(KanjiGroup &&src)
 {
     base::operator=(std::forward<KanjiGroup>(src));
     std::swap(list, src.list);
+    std::swap(posindex, src.posindex);
     return *this;
 }
 
@@ -2189,6 +2202,7 @@ void KanjiGroup::load(QDataStream &stream)
 {
     base::load(stream);
     stream >> make_zvec<qint32, qint32>(list);
+    posindex.invalidate();
 }
 
 void KanjiGroup::save(QDataStream &stream) const
@@ -2217,6 +2231,7 @@ void KanjiGroup::copy(GroupBase *src)
     base::copy(src);
     modelptr.reset();
     list = ((KanjiGroup*)src)->list;
+    posindex.invalidate();
 }
 
 KanjiEntry* KanjiGroup::items(int index)
@@ -2276,48 +2291,24 @@ const std::vector<ushort>& KanjiGroup::getIndexes() const
 
 int KanjiGroup::indexOf(ushort kindex) const
 {
-    auto it = std::find(list.begin(), list.end(), kindex);
-    if (it == list.end())
-        return -1;
-
-    return it - list.begin();
+    return posindex.find(list, kindex);
 }
 
 void KanjiGroup::indexOf(const std::vector<ushort> &kindexes, std::vector<int> &positions) const
 {
-    // Pairs of [index in list, kanji index].
-    std::vector<std::pair<int, ushort>> listorder;
-    listorder.reserve(list.size());
-    for (int ix = 0; ix != list.size(); ++ix)
-        listorder.push_back(std::make_pair(ix, list[ix]));
-
-    std::sort(listorder.begin(), listorder.end(), [](const std::pair<int, ushort> &a, const std::pair<int, ushort> &b) {
-        return a.second < b.second;
-    });
-
-    std::vector<ushort> ordered = kindexes;
-    std::sort(ordered.begin(), ordered.end());
-
-    positions.clear();
-    positions.reserve(ordered.size());
-
-    for (int ix = 0, iy = 0; ix != listorder.size() && iy != ordered.size(); )
+    std::vector<int> found;
+    found.reserve(kindexes.size());
+    for (ushort kindex : kindexes)
     {
-        if (listorder[ix].second < ordered[iy])
-        {
-            ++ix;
-            continue;
-        }
-        else if (listorder[ix].second == ordered[iy])
-        {
-            positions.push_back(listorder[ix].first);
-            ++ix;
-        }
-
-        ++iy;
+        int pos = posindex.find(list, kindex);
+        if (pos != -1)
+            found.push_back(pos);
     }
 
-    std::sort(positions.begin(), positions.end());
+    std::sort(found.begin(), found.end());
+    found.resize(std::unique(found.begin(), found.end()) - found.begin());
+
+    std::swap(positions, found);
 }
 
 int KanjiGroup::add(ushort kindex)
@@ -2330,12 +2321,16 @@ int KanjiGroup::insert(ushort kindex, int pos)
     if (pos == -1)
         pos = list.size();
 
-    auto it = std::find(list.begin(), list.end(), kindex);
-    if (it != list.end())
-        return it - list.begin();
+    int oldpos = posindex.find(list, kindex);
+    if (oldpos != -1)
+        return oldpos;
 
     list.insert(list.begin() + pos, kindex);
-    dictionary()->setToUserModified();
+    if (pos == list.size() - 1)
+        posindex.appended(list, pos);
+    else
+        posindex.invalidate();
+    dictionary()->setToUserModified(this);
     emit owner().itemsInserted(this, { { pos, 1 } });
 
     return pos;
@@ -2370,11 +2365,14 @@ void KanjiGroup::remove(const smartvector<Range> &ranges)
     //    lastpos = firstpos;
     //}
 
-    for (int ix = ranges.size() - 1; ix != -1; --ix)
+    // The kanji between the ranges are moved to their new positions in a single pass.
+    int dest = ranges[0]->first;
+    for (int ix = 0, siz = ranges.size(); ix != siz; ++ix)
     {
         const Range *r = ranges[ix];
 
-        list.erase(list.begin() + r->first, list.begin() + r->last + 1);
+        int next = ix == siz - 1 ? list.size() : ranges[ix + 1]->first;
+        dest = std::move(list.begin() + r->last + 1, list.begin() + next, list.begin() + dest) - list.begin();
 
     //for (int pos = sorted.size() - 1, prev = pos - 1; pos != -1; --prev)
     //{
@@ -2383,8 +2381,10 @@ void KanjiGroup::remove(const smartvector<Range> &ranges)
     //        list.erase(list.begin() + (prev + 1), list.begin() + (pos + 1));
     //        pos = prev;
     }
+    list.resize(dest);
+    posindex.invalidate();
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(this);
     emit owner().itemsRemoved(this, ranges);
 }
 
@@ -2398,8 +2398,7 @@ int KanjiGroup::insert(const std::vector<ushort> &kindexes, int pos, std::vector
     if (pos == -1)
         pos = list.size();
 
-    // To avoid adding duplicate kanji, the list of kanji and the kindexes are both sorted
-    // and checked for duplicates.
+    // To avoid adding duplicate kanji, kindexes are looked up in the group first.
 
     if (kindexes.empty())
         return 0;
@@ -2418,60 +2417,35 @@ int KanjiGroup::insert(const std::vector<ushort> &kindexes, int pos, std::vector
         return s == list.size() ? 0 : 1;
     }
 
-    // Pairs of [index in list, kanji index].
-    std::vector<std::pair<int, int>> listorder;
-    listorder.reserve(list.size());
-    for (int ix = 0; ix != list.size(); ++ix)
-        listorder.push_back(std::make_pair(ix, list[ix]));
-    std::sort(listorder.begin(), listorder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-
-    // Pairs of [index in kindexes, kanji index].
-    std::vector<std::pair<int, int>> korder;
+    // Kanji indexes in kindexes. To show that a kanji has already been added, its kanji index
+    // is changed to a negative value. The value is set to [-1 - kanji's old position in
+    // list]. This value will be used later to update the positions list.
+    std::vector<int> korder;
     korder.reserve(kindexes.size());
-    for (int ix = 0; ix != kindexes.size(); ++ix)
-        korder.push_back(std::make_pair(ix, kindexes[ix]));
-    std::sort(korder.begin(), korder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-
-    if (positions != nullptr)
-        positions->reserve(kindexes.size());
 
     int added = kindexes.size();
-
-    for (int ix = 0, wix = 0; ix != listorder.size() && wix != korder.size();)
+    for (int ix = 0; ix != kindexes.size(); ++ix)
     {
-        if (listorder[ix].second < korder[wix].second)
-        {
-            // Kanji in group but not in kindexes.
-            ++ix;
-            continue;
-        }
-
-        if (listorder[ix].second == korder[wix].second)
+        int oldpos = posindex.find(list, kindexes[ix]);
+        if (oldpos != -1)
         {
-            // To show that a kanji has already been added, its kanji index is changed to a
-            // negative value. The value is set to [-1 - kanji's old position in list]. This
-            // value will be used later to update the positions list.
-            korder[wix].second = -1 - listorder[ix].first;
-
-            ++ix;
+            korder.push_back(-1 - oldpos);
             --added;
         }
-
-        ++wix;
+        else
+            korder.push_back(kindexes[ix]);
     }
 
+    if (positions != nullptr)
+        positions->reserve(kindexes.size());
+
     if (positions == nullptr && added == 0)
         return 0;
 
-    // Restore the original order of the kanji indexes to be inserted.
-    std::sort(korder.begin(), korder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
-        return a.first < b.first;
-    });
-
     list.insert(list.begin() + pos, added, 0);
     for (int ix = 0, aix = 0; ix != korder.size(); ++ix)
     {
-        int val = korder[ix].second;
+        int val = korder[ix];
         if (val < 0)
         {
             // Kanji already in group.
@@ -2498,7 +2472,12 @@ int KanjiGroup::insert(const std::vector<ushort> &kindexes, int pos, std::vector
         ++aix;
     }
 
-    dictionary()->setToUserModified();
+    if (pos + added == list.size())
+        posindex.appended(list, pos);
+    else
+        posindex.invalidate();
+
+    dictionary()->setToUserModified(this);
     emit owner().itemsInserted(this, { { pos, added } });
 
     return added;
@@ -2510,7 +2489,8 @@ void KanjiGroup::move(const smartvector<Range> &ranges, int pos)
         return;
 
     if (_moveRanges(ranges, pos, list))
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(this);
+    posindex.invalidate();
 
     emit owner().itemsMoved(this, ranges, pos);
 }
@@ -2524,7 +2504,8 @@ void KanjiGroup::removeAt(int index)
 
     //emit owner().beginItemsRemove(this, index, index);
     list.erase(list.begin() + index);
-    dictionary()->setToUserModified();
+    posindex.invalidate();
+    dictionary()->setToUserModified(this);
 
     emit owner().itemsRemoved(this, { { index, index } }/*, first, last*/);
 }
@@ -2538,7 +2519,8 @@ void KanjiGroup::removeRange(int first, int last)
 
     //emit owner().beginItemsRemove(this, first, last);
     list.erase(list.begin() + first, list.begin() + last + 1);
-    dictionary()->setToUserModified();
+    posindex.invalidate();
+    dictionary()->setToUserModified(this);
 
     emit owner().itemsRemoved(this, { { first, last } }/*, first, last*/);
 }
@@ -2747,7 +2729,7 @@ const Dictionary* Groups::dictionary() const
     return dict;
 }
 
-void Groups::applyChanges(std::map<int, int> &changes)
+void Groups::applyChanges(const WordIndexMap &changes)
 {
     wordgroups.applyChanges(changes);
 }
@@ -10,7 +10,7 @@
 #include <QCoreApplication>
 #include <QDateTime>
 #include <memory>
-#include <forward_list>
+#include <unordered_map>
 #include <functional>
 #include <memory>
 #include "smartvector.h"
@@ -20,6 +20,7 @@ enum class GroupTypes { Kanji, Words };
 
 class DictionaryGroupItemModel;
 class KanjiGroupModel;
+class WordIndexMap;
 class GroupCategoryBase;
 class Dictionary;
 class Groups;
@@ -374,6 +375,44 @@ private:
 typedef GroupCategory<WordGroup>    WordGroupCategory;
 typedef GroupCategory<KanjiGroup>   KanjiGroupCategory;
 
+// Open addressing hash table of the positions of values in a group's list, to find a value
+// in the list without going through it. Values in the list must be unique. The table is
+// rebuilt on the first lookup after it was invalidated. Call invalidate() after every change
+// to the list, except for values added to its end, which can be added with appended().
+template<typename T>
+class GroupPositionIndex
+{
+public:
+    GroupPositionIndex() : valid(false) { ; }
+
+    // Discards the table. It'll be rebuilt from the list on the next lookup.
+    void invalidate()
+    {
+        valid = false;
+    }
+
+    // Adds the values in list from position first to its end to the table, after they were
+    // appended to the list.
+    void appended(const std::vector<T> &list, int first);
+
+    // Returns the position of val in list, or -1 if val is not in the list.
+    int find(const std::vector<T> &list, T val) const;
+private:
+    // Recreates the table from the values in list.
+    void rebuild(const std::vector<T> &list) const;
+    // Places the position of a value in list in the first free slot of the table.
+    void place(const std::vector<T> &list, int pos) const;
+    // Returns the slot of val in the table where the search for it starts.
+    int slot(T val) const;
+
+    // Positions in the list, or -1 for unused slots. The size is always a power of 2, and at
+    // least twice the size of the list.
+    mutable std::vector<int> table;
+    // Number of bits in the size of the table.
+    mutable int bits;
+    mutable bool valid;
+};
+
 struct WordEntry;
 struct WordStudySettings;
 
@@ -403,7 +442,7 @@ public:
     // Changes the word indexes from the original values to the mapped values.
     // Words with no original or a mapped value of -1 will be removed.
     // Duplicates are removed too.
-    void applyChanges(const std::map<int, int> &changes);
+    void applyChanges(const WordIndexMap &changes);
 
     // Removes the passed index from the group's words list, decrements the index of words
     // above this value, and checks whether study is valid after the removal.
@@ -516,6 +555,8 @@ private:
     //void _move(int first, int last, int pos);
 
     std::vector<int> list;
+    // Positions of the word indexes in list.
+    GroupPositionIndex<int> posindex;
 
     std::unique_ptr<DictionaryGroupItemModel> modelptr;
 
@@ -546,7 +587,7 @@ public:
     void loadLegacy(QDataStream &stream, bool study, int version);
     // End legacy load functions
 
-    void applyChanges(const std::map<int, int> &changes);
+    void applyChanges(const WordIndexMap &changes);
 
     void copy(WordGroups *src);
 
@@ -557,10 +598,11 @@ public:
     virtual Dictionary* dictionary() override;
     virtual const Dictionary* dictionary() const override;
 
-    // Returns the list of groups a word is placed in. If the word was not added to a group,
-    // by default an empty list is returned that can be used for expanding. To avoid creating
-    // this list for words not in a group, set creation to false.
-    std::forward_list<WordGroup*>* groupsOfWord(int windex, bool creation = true);
+    // Returns the list of groups a word is placed in, starting with the group it was added to
+    // last. If the word was not added to a group, by default an empty list is returned that
+    // can be used for expanding. To avoid creating this list for words not in a group, set
+    // creation to false.
+    std::vector<WordGroup*>* groupsOfWord(int windex, bool creation = true);
 
     // Returns the total number of words added to a group.
     int wordsInGroups() const;
@@ -585,15 +627,16 @@ private:
     virtual void emitGroupDeleted(GroupCategoryBase *parent, int index, void *oldaddress) override;
 
     // Calls applyChanges for the passed category's items and sub categories.
-    void groupsApplyChanges(GroupCategoryBase *cat, const std::map<int, int> &changes);
+    void groupsApplyChanges(GroupCategoryBase *cat, const WordIndexMap &changes);
 
     // Newly creates the data in wordsgroups.
     void fixWordsGroups();
 
     Groups *owner;
 
-    // [word index, groups list] where the word is found in.
-    std::map<int, std::forward_list<WordGroup*>> wordsgroups;
+    // [word index, groups list] where the word is found in. A word is only in a few groups
+    // at most, so the groups are kept in a vector that's looked up in order.
+    std::unordered_map<int, std::vector<WordGroup*>> wordsgroups;
 
     // Group last selected in a word to group dialog as destination.
     WordGroup *lastgroup;
@@ -700,6 +743,8 @@ private:
     //void _move(int first, int last, int pos);
 
     std::vector<ushort> list;
+    // Positions of the kanji indexes in list.
+    GroupPositionIndex<ushort> posindex;
 
     std::unique_ptr<KanjiGroupModel> modelptr;
 
@@ -789,7 +834,7 @@ public:
     // contains the words' original index in the old dictionary, and the new index in newdict.
     // If the new index is -1, the word was not found in the new dictionary and its data
     // should be removed.
-    void applyChanges(std::map<int, int> &changes);
+    void applyChanges(const WordIndexMap &changes);
 
     void copy(Groups *src);
 
@@ -45,7 +45,7 @@ void WordGroup::loadLegacy(QDataStream &stream, bool isstudy, int version)
         // Check whether we have a duplicate because another meaning of the
         // same word was added to the group.
         bool duplicate = 0;
-        std::forward_list<WordGroup*> &wg = *owner().groupsOfWord(index);
+        std::vector<WordGroup*> &wg = *owner().groupsOfWord(index);
         for (WordGroup *g : wg)
         {
             if (g == this)
@@ -59,13 +59,15 @@ void WordGroup::loadLegacy(QDataStream &stream, bool isstudy, int version)
         {
             indextmp.push_back(list.size());
             list.push_back(index);
-            wg.push_front(this);
+            wg.insert(wg.begin(), this);
             dictionary()->wordEntry(index)->dat |= (1 << (int)WordRuntimeData::InGroup);
         }
         else
             indextmp.push_back(-1);
     }
 
+    posindex.invalidate();
+
     if (isstudy)
         study.loadLegacy(stream, studymethod, version, indextmp);
 }
@@ -123,7 +125,7 @@ void KanjiGroup::loadLegacy(QDataStream &stream)
             //        AddExample(j, collection->kanjidat[Kanjis[j]->index].card->Examples[k]->ix);
         }
     }
-
+    posindex.invalidate();
 }
 
 void KanjiGroups::loadLegacy(QDataStream &stream)
@@ -183,6 +183,8 @@ void WordStudy::load(QDataStream &stream)
 
         state->load(stream);
     }
+    else
+        state.reset();
 }
 
 void WordStudy::save(QDataStream &stream) const
@@ -214,7 +216,7 @@ WordGroup* WordStudy::getOwner()
     return owner;
 }
 
-void WordStudy::applyChanges(const std::map<int, int> &changes)
+void WordStudy::applyChanges(const WordIndexMap &changes)
 {
     std::set<int> found;
 
@@ -223,33 +225,30 @@ void WordStudy::applyChanges(const std::map<int, int> &changes)
     list.reserve(tmp.size());
     for (int ix = 0; ix != tmp.size(); ++ix)
     {
-        auto it = changes.find(tmp[ix].windex);
-        if (it == changes.end() || it->second == -1 || found.count(it->second))
+        int newindex = changes[tmp[ix].windex];
+        if (newindex == -1 || (changes.merged(newindex) && !found.insert(newindex).second))
         {
-            if (it != changes.end())
+            // Position of the removed item after the items removed before it.
+            int pos = list.size();
+            for (int iy = testitems.size() - 1; iy != -1; --iy)
             {
-                for (int iy = testitems.size() - 1; iy != -1; --iy)
+                if (testitems[iy].pos > pos)
+                    --testitems[iy].pos;
+                else if (testitems[iy].pos == pos)
                 {
-                    if (testitems[iy].pos > ix)
-                        --testitems[iy].pos;
-                    else if (testitems[iy].pos == ix)
+                    testitems.erase(testitems.begin() + iy);
+
+                    if (state != nullptr && !state->itemRemoved(iy, testSize()))
                     {
-                        testitems.erase(testitems.begin() + iy);
-
-                        if (state != nullptr && !state->itemRemoved(iy, testSize()))
-                        {
-                            // TODO: notify the user that the study of the group has been abandoned.
-                            // If possible in a single message about every group.
-                            state.reset();
-                        }
+                        // TODO: notify the user that the study of the group has been abandoned.
+                        // If possible in a single message about every group.
+                        state.reset();
                     }
                 }
-                --ix;
             }
             continue;
         }
-        found.insert(it->second);
-        tmp[ix].windex = it->second;
+        tmp[ix].windex = newindex;
         list.push_back(tmp[ix]);
     }
 
@@ -449,19 +448,19 @@ void WordStudy::initTest()
     }
 
     state->init(testSize());
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 bool WordStudy::initNext()
 {
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
     return state->initNext(testSize());
 }
 
 void WordStudy::finish()
 {
     state->finish(testSize());
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 const WordStudySettings& WordStudy::studySettings() const
@@ -491,7 +490,7 @@ void WordStudy::setup(const WordStudySettings &newsettings, const std::vector<Wo
 
     state.reset();
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 void WordStudy::abort()
@@ -502,7 +501,7 @@ void WordStudy::abort()
 
     state.reset();
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 void WordStudy::excludeWord(int windex)
@@ -511,7 +510,7 @@ void WordStudy::excludeWord(int windex)
     if (it == list.end() || it->excluded)
         return;
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
     it->excluded = true;
 }
 
@@ -520,7 +519,7 @@ void WordStudy::includeWord(int windex)
     auto it = std::find_if(list.begin(), list.end(), [windex](const WordStudyItem &item) { return item.windex == windex; });
     if (it == list.end() || !it->excluded)
         return;
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
     it->excluded = false;
 }
 
@@ -598,14 +597,14 @@ void WordStudy::answer(bool correct)
     if (!correct)
         ++testitems[pos].incorrect;
     state->answer(correct, testSize());
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 void WordStudy::changeAnswer(bool correct)
 {
     int p = state->roundPosition() - 1;
     setTestedCorrect(p, correct);
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 bool WordStudy::canUndo() const
@@ -643,7 +642,7 @@ void WordStudy::applyScore()
         titem.correct = titem.incorrect = 0;
     }
     if (changed)
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(owner);
 }
 
 int WordStudy::testedCount() const
@@ -704,7 +703,7 @@ void WordStudy::setTestedCorrect(int pos, bool correct)
         --testitems[p].correct;
         ++testitems[p].incorrect;
     }
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
 }
 
 bool WordStudy::previousCorrect() const
@@ -729,7 +728,7 @@ int WordStudy::newCount() const
 {
     if (settings.method != WordStudyMethod::Gradual)
         return 0;
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(owner);
     return ((const WordStudyGradual*)state.get())->newCount(testSize());
 }
 
@@ -103,6 +103,7 @@ class WordStudyGradual;
 class WordStudySingle;
 class WordStudyState;
 class Dictionary;
+class WordIndexMap;
 class WordStudy
 {
 public:
@@ -126,7 +127,7 @@ public:
     // Changes the word indexes from the original values to the mapped values. Words with no
     // original or a mapped value of -1 will be removed. Duplicates are removed too.
     // It's possible a suspended study becomes unusable after too many changes.
-    void applyChanges(const std::map<int, int> &changes);
+    void applyChanges(const WordIndexMap &changes);
 
     // Creates an exact copy of source, apart from the owner group, which stays the same.
     void copy(WordStudy *src);
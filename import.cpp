@@ -18,6 +18,7 @@
 #include "words.h"
 #include "sentences.h"
 #include "kanji.h"
+#include "kanjiindex.h"
 #include "grammar_enums.h"
 #include "romajizer.h"
 #include "zkanjimain.h"
@@ -497,6 +498,11 @@ bool DictImport::event(QEvent *e)
             else
             {
                 ZKanji::setNoData(false);
+                if (fullimport)
+                {
+                    ZKanji::kanjiFilterIndex().reset();
+                    ZKanji::kanjiReadingIndex().reset();
+                }
 
                 QString s1 = tr("Import finished.");
                 QString s2 = tr("Press \"%1\" to close the importer and continue starting the program.").arg(tr("Finish"));
@@ -86,7 +86,7 @@ bool ImportReplaceForm::exec()
     return true;
 }
 
-std::map<int, int>& ImportReplaceForm::changes()
+const WordIndexMap& ImportReplaceForm::changes() const
 {
     return list;
 }
@@ -156,7 +156,7 @@ void ImportReplaceForm::dictRowChanged(int row, int oldrow)
 
 void ImportReplaceForm::useClicked()
 {
-    list[model->indexes(ui->missingTable->currentRow())] = ui->dict->currentIndex();
+    list.set(model->indexes(ui->missingTable->currentRow()), ui->dict->currentIndex());
 
     if (ui->missingTable->currentRow() == model->rowCount() - 1)
     {
@@ -269,23 +269,16 @@ bool ImportReplaceForm::init()
 
     std::vector<int> l;
 
-    // Creating word index mapping of words (that were added to groups, study data etc.) of
-    // the original dictionary to indexes in the new dictionary. Result in list is:
-    // [old word index, new word index]. The new word index is set to -1 if the same word is
-    // not found.
+    // Creating word index mapping of every word of the original dictionary to indexes in the
+    // new dictionary. The new word index is -1 if the same word is not found.
+    newdir->mapWords(olddir, list);
+
+    // Fill l to contain words (that were added to groups, study data etc.) in need of a
+    // replacement.
     olddir->listUsedWords(l);
-    list = newdir->mapWords(olddir, l);
     dlg.hide();
 
-    // Fill l to contain words in need of a replacement.
-    std::vector<int>().swap(l);
-    int ix = 0;
-    for (auto p : list)
-    {
-        if (p.second == -1)
-            l.push_back(p.first);
-        ++ix;
-    }
+    l.resize(std::remove_if(l.begin(), l.end(), [this](int windex) { return list[windex] != -1; }) - l.begin());
     if (l.empty())
         return false;
 
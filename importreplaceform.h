@@ -44,9 +44,9 @@ public:
     // accepted by the user, and false on cancel.
     bool exec();
 
-    // Indexes of words in olddir from groups and study lists, and the index
-    // they should be changed to in the new dictionary.
-    std::map<int, int>& changes();
+    // Indexes of words in olddir, and the index they should be changed to in the new
+    // dictionary.
+    const WordIndexMap& changes() const;
     Dictionary* dictionary();
     OriginalWordsList& originals();
 protected:
@@ -81,10 +81,9 @@ private:
 
     OriginalWordsList orig;
 
-    // List of word indexes in olddir and their corresponding indexes in
-    // newdir. If a word is only found in olddir, the other index is
-    // set to -1.
-    std::map<int, int> list;
+    // Word indexes in olddir mapped to their corresponding indexes in newdir. If a word is
+    // only found in olddir, the new index is -1.
+    WordIndexMap list;
 
     typedef DialogWindow    base;
 };
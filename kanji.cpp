@@ -202,6 +202,12 @@ namespace ZKanji
         return -1;
     }
 
+    void mapKanjiIndexes()
+    {
+        for (; kmapchecked != kanjis.size(); ++kmapchecked)
+            kanjiindexmap[kanjis[kmapchecked]->ch] = kmapchecked;
+    }
+
     bool isKanjiMissing()
     {
         if (kanjis.size() == 0)
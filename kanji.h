@@ -170,6 +170,9 @@ namespace ZKanji
 
     KanjiEntry* addKanji(QChar ch, int kindex = -1);
     int kanjiIndex(QChar kanjichar);
+    // Maps every kanji for kanjiIndex(), which otherwise fills the mapping when a character
+    // is looked up. Call before kanjiIndex() might be used from multiple threads.
+    void mapKanjiIndexes();
 
     // Returns true if the ZKanji::kanjis list has nullptr items or the list is empty.
     bool isKanjiMissing();
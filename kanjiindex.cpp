@@ -0,0 +1,695 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <bitset>
+#include <algorithm>
+
+#include "kanjiindex.h"
+#include "zkanjimain.h"
+#include "kanji.h"
+#include "words.h"
+#include "romajizer.h"
+#include "kanjisearchwidget.h"
+#include "zradicalgrid.h"
+
+
+//-------------------------------------------------------------
+
+
+KanjiBitSet::KanjiBitSet(bool fill) : bits((ZKanji::kanjicount + 63) / 64, 0)
+{
+    if (fill)
+        this->fill(true);
+}
+
+void KanjiBitSet::fill(bool toggle)
+{
+    if (!toggle)
+    {
+        std::fill(bits.begin(), bits.end(), 0);
+        return;
+    }
+
+    std::fill(bits.begin(), bits.end(), ~(quint64)0);
+    // The bits over the kanji count must stay unset or count() and next() would find them.
+    if ((ZKanji::kanjicount % 64) != 0 && !bits.empty())
+        bits.back() = ((quint64)1 << (ZKanji::kanjicount % 64)) - 1;
+}
+
+bool KanjiBitSet::toggled(int kindex) const
+{
+    return (bits[kindex / 64] & ((quint64)1 << (kindex % 64))) != 0;
+}
+
+void KanjiBitSet::set(int kindex, bool toggle)
+{
+    if (toggle)
+        bits[kindex / 64] |= ((quint64)1 << (kindex % 64));
+    else
+        bits[kindex / 64] &= ~((quint64)1 << (kindex % 64));
+}
+
+bool KanjiBitSet::empty() const
+{
+    for (quint64 w : bits)
+        if (w != 0)
+            return false;
+    return true;
+}
+
+bool KanjiBitSet::intersects(const KanjiBitSet &other) const
+{
+    for (int ix = 0, siz = std::min(bits.size(), other.bits.size()); ix != siz; ++ix)
+        if ((bits[ix] & other.bits[ix]) != 0)
+            return true;
+    return false;
+}
+
+int KanjiBitSet::count() const
+{
+    int result = 0;
+    for (quint64 w : bits)
+        result += (int)std::bitset<64>(w).count();
+    return result;
+}
+
+int KanjiBitSet::next(int kindex) const
+{
+    if (kindex < 0)
+        kindex = 0;
+
+    int pos = kindex / 64;
+    if (pos >= (int)bits.size())
+        return -1;
+
+    // Mask out the bits below kindex in the first word.
+    quint64 w = bits[pos] & (~(quint64)0 << (kindex % 64));
+    while (w == 0)
+    {
+        if (++pos == (int)bits.size())
+            return -1;
+        w = bits[pos];
+    }
+
+    int bit = 0;
+    while ((w & ((quint64)1 << bit)) == 0)
+        ++bit;
+    return pos * 64 + bit;
+}
+
+KanjiBitSet& KanjiBitSet::operator&=(const KanjiBitSet &other)
+{
+    int siz = std::min(bits.size(), other.bits.size());
+    for (int ix = 0; ix != siz; ++ix)
+        bits[ix] &= other.bits[ix];
+    for (int ix = siz, siz2 = (int)bits.size(); ix < siz2; ++ix)
+        bits[ix] = 0;
+    return *this;
+}
+
+KanjiBitSet& KanjiBitSet::operator|=(const KanjiBitSet &other)
+{
+    int siz = std::min(bits.size(), other.bits.size());
+    for (int ix = 0; ix != siz; ++ix)
+        bits[ix] |= other.bits[ix];
+    return *this;
+}
+
+KanjiBitSet& KanjiBitSet::remove(const KanjiBitSet &other)
+{
+    int siz = std::min(bits.size(), other.bits.size());
+    for (int ix = 0; ix != siz; ++ix)
+        bits[ix] &= ~other.bits[ix];
+    return *this;
+}
+
+bool KanjiBitSet::operator==(const KanjiBitSet &other) const
+{
+    return bits == other.bits;
+}
+
+bool KanjiBitSet::operator!=(const KanjiBitSet &other) const
+{
+    return bits != other.bits;
+}
+
+void KanjiBitSet::toList(std::vector<ushort> &list) const
+{
+    list.clear();
+    list.reserve(count());
+    for (int ix = 0, siz = (int)bits.size(); ix != siz; ++ix)
+    {
+        quint64 w = bits[ix];
+        for (int bit = 0; w != 0; ++bit, w >>= 1)
+            if ((w & 1) != 0)
+                list.push_back(ix * 64 + bit);
+    }
+}
+
+
+//-------------------------------------------------------------
+
+
+// Returns whether the kanji is in the kanji list or reference book of type.
+static bool kanjiFrom(const KanjiEntry *k, KanjiFromT type)
+{
+    switch (type)
+    {
+    case KanjiFromT::Common:
+        return k->frequency != 0;
+    case KanjiFromT::Jouyou:
+        return k->jouyou != 0;
+    case KanjiFromT::JLPT:
+        return k->jlpt != 0;
+    case KanjiFromT::Oneil:
+        return k->oneil != 0;
+    case KanjiFromT::Gakken:
+        return k->gakken != 0;
+    case KanjiFromT::Halpern:
+        return k->halpern != 0;
+    case KanjiFromT::Heisig:
+        return k->heisig != 0;
+    case KanjiFromT::HeisigN:
+        return k->heisign != 0;
+    case KanjiFromT::HeisigF:
+        return k->heisigf != 0;
+    case KanjiFromT::Henshall:
+        return k->henshall != 0;
+    case KanjiFromT::Nelson:
+        return k->nelson != 0;
+    case KanjiFromT::NewNelson:
+        return k->newnelson != 0;
+    case KanjiFromT::SnH:
+        return k->snh[0] != 0;
+    case KanjiFromT::KnK:
+        return k->knk != 0;
+    case KanjiFromT::KnKOld:
+        return k->knk != 0 && k->knk <= 1945;
+    case KanjiFromT::Busy:
+        return k->busy[0] != 0;
+    case KanjiFromT::Crowley:
+        return k->crowley != 0;
+    case KanjiFromT::FlashC:
+        return k->flashc != 0;
+    case KanjiFromT::KGuide:
+        return k->kguide != 0;
+    case KanjiFromT::HalpernN:
+        return k->halpernn != 0;
+    case KanjiFromT::Deroo:
+        return k->deroo != 0;
+    case KanjiFromT::Sakade:
+        return k->sakade != 0;
+    case KanjiFromT::HenshallG:
+        return k->henshallg != 0;
+    case KanjiFromT::Context:
+        return k->context != 0;
+    case KanjiFromT::HalpernK:
+        return k->halpernk != 0;
+    case KanjiFromT::HalpernL:
+        return k->halpernl != 0;
+    case KanjiFromT::Tuttle:
+        return k->tuttle != 0;
+    default:
+        return true;
+    }
+}
+
+// Sets the bit of kindex in the set at list[val], growing list when val is out of range.
+static void addToColumn(std::vector<KanjiBitSet> &list, int val, int kindex)
+{
+    if ((int)list.size() <= val)
+        list.resize(val + 1);
+    list[val].set(kindex, true);
+}
+
+KanjiFilterIndex::KanjiFilterIndex() : built(false)
+{
+
+}
+
+void KanjiFilterIndex::reset()
+{
+    built = false;
+
+    strokelist.clear();
+    jlptlist.clear();
+    jouyoulist.clear();
+    for (int ix = 0; ix != 3; ++ix)
+        skiplist[ix].clear();
+    radicallist.clear();
+    partlist.clear();
+    namedlist.clear();
+    fromlist.clear();
+}
+
+void KanjiFilterIndex::strokes(int first, int last, KanjiBitSet &result)
+{
+    build();
+    unite(strokelist, first, last, result);
+}
+
+void KanjiFilterIndex::jlpt(int first, int last, KanjiBitSet &result)
+{
+    build();
+    unite(jlptlist, first, last, result);
+}
+
+void KanjiFilterIndex::jouyou(int first, int last, KanjiBitSet &result)
+{
+    build();
+    unite(jouyoulist, first, last, result);
+}
+
+const KanjiBitSet& KanjiFilterIndex::skip(int pos, int val)
+{
+    build();
+    if (pos < 0 || pos > 2 || val < 0 || val >= (int)skiplist[pos].size())
+        return none;
+    return skiplist[pos][val];
+}
+
+const KanjiBitSet& KanjiFilterIndex::radical(int rad)
+{
+    build();
+    if (rad < 0 || rad >= (int)radicallist.size())
+        return none;
+    return radicallist[rad];
+}
+
+const KanjiBitSet& KanjiFilterIndex::part(int index)
+{
+    build();
+    if (index < 0 || index >= (int)partlist.size())
+        return none;
+    return partlist[index];
+}
+
+const KanjiBitSet& KanjiFilterIndex::namedRadical(int index)
+{
+    build();
+    if (index < 0 || index >= (int)namedlist.size())
+        return none;
+    return namedlist[index];
+}
+
+void KanjiFilterIndex::namedRadical(int index, bool grouped, KanjiBitSet &result)
+{
+    build();
+    if (index < 0 || index >= (int)namedlist.size())
+        return;
+
+    result |= namedlist[index];
+    if (!grouped)
+        return;
+
+    for (int ix = index + 1, siz = (int)namedlist.size(); ix != siz && ZKanji::radlist[ix]->radical == ZKanji::radlist[ix - 1]->radical; ++ix)
+        result |= namedlist[ix];
+}
+
+const KanjiBitSet& KanjiFilterIndex::from(KanjiFromT type)
+{
+    build();
+    if ((int)type < 0 || (int)type >= (int)fromlist.size() || type == KanjiFromT::All || type == KanjiFromT::Clipbrd)
+        return all;
+    return fromlist[(int)type];
+}
+
+void KanjiFilterIndex::build()
+{
+    if (built)
+        return;
+    built = true;
+
+    none = KanjiBitSet(false);
+    all = KanjiBitSet(true);
+
+    fromlist.resize((int)KanjiFromT::Tuttle + 1);
+
+    for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
+    {
+        const KanjiEntry *k = ZKanji::kanjis[ix];
+
+        addToColumn(strokelist, k->strokes, ix);
+        addToColumn(jlptlist, k->jlpt, ix);
+        addToColumn(jouyoulist, k->jouyou, ix);
+        for (int iy = 0; iy != 3; ++iy)
+            addToColumn(skiplist[iy], k->skips[iy], ix);
+        addToColumn(radicallist, k->rad, ix);
+
+        for (int iy = (int)KanjiFromT::Common, siz = (int)fromlist.size(); iy != siz; ++iy)
+            if (kanjiFrom(k, (KanjiFromT)iy))
+                fromlist[iy].set(ix, true);
+    }
+
+    partlist.resize(ZKanji::radklist.size());
+    for (int ix = 0, siz = (int)ZKanji::radklist.size(); ix != siz; ++ix)
+    {
+        const fastarray<ushort> &klist = ZKanji::radklist[ix].second;
+        for (int iy = 0, siz2 = klist.size(); iy != siz2; ++iy)
+            partlist[ix].set(klist[iy], true);
+    }
+
+    namedlist.resize(ZKanji::radlist.size());
+    for (int ix = 0, siz = ZKanji::radlist.size(); ix != siz; ++ix)
+    {
+        const std::vector<ushort> &klist = ZKanji::radlist[ix]->kanji;
+        for (int iy = 0, siz2 = (int)klist.size(); iy != siz2; ++iy)
+            namedlist[ix].set(klist[iy], true);
+    }
+}
+
+void KanjiFilterIndex::unite(const std::vector<KanjiBitSet> &list, int first, int last, KanjiBitSet &result) const
+{
+    result.fill(false);
+    first = std::max(first, 0);
+    last = std::min(last, (int)list.size() - 1);
+    for (int ix = first; ix <= last; ++ix)
+        result |= list[ix];
+}
+
+
+//-------------------------------------------------------------
+
+
+KanjiReadingIndex::KanjiReadingIndex() : built(false)
+{
+
+}
+
+void KanjiReadingIndex::reset()
+{
+    built = false;
+    onlist.clear();
+    kunlist.clear();
+    stemlist.clear();
+}
+
+void KanjiReadingIndex::find(const QString &str, bool prefix, bool on, bool kun, bool okurigana, KanjiBitSet &result)
+{
+    build();
+
+    result.fill(false);
+    if (on)
+        findIn(onlist, str, prefix, result);
+    if (kun)
+        findIn(okurigana ? kunlist : stemlist, str, prefix, result);
+}
+
+void KanjiReadingIndex::build()
+{
+    if (built)
+        return;
+    built = true;
+
+    for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
+    {
+        const KanjiEntry *k = ZKanji::kanjis[ix];
+        for (int iy = 0, siz = k->on.size(); iy != siz; ++iy)
+            onlist.push_back(std::make_pair(hiraganize(k->on[iy]), (ushort)ix));
+
+        for (int iy = 0, siz = k->kun.size(); iy != siz; ++iy)
+        {
+            QString kunstr = k->kun[iy].toQString();
+            int p = kunstr.indexOf('.');
+            if (p == -1)
+            {
+                kunstr = hiraganize(kunstr);
+                kunlist.push_back(std::make_pair(kunstr, (ushort)ix));
+                stemlist.push_back(std::make_pair(kunstr, (ushort)ix));
+            }
+            else
+            {
+                kunlist.push_back(std::make_pair(hiraganize(kunstr.left(p) + kunstr.mid(p + 1)), (ushort)ix));
+                stemlist.push_back(std::make_pair(hiraganize(kunstr.left(p)), (ushort)ix));
+            }
+        }
+    }
+
+    std::sort(onlist.begin(), onlist.end());
+    std::sort(kunlist.begin(), kunlist.end());
+    std::sort(stemlist.begin(), stemlist.end());
+}
+
+void KanjiReadingIndex::findIn(const ReadingList &list, const QString &str, bool prefix, KanjiBitSet &result) const
+{
+    // Readings starting with str are right after the position where str would be inserted.
+    auto it = std::lower_bound(list.begin(), list.end(), str, [](const std::pair<QString, ushort> &item, const QString &str) {
+        return item.first < str;
+    });
+
+    for (; it != list.end() && (prefix ? it->first.startsWith(str) : it->first == str); ++it)
+        result.set(it->second, true);
+}
+
+
+//-------------------------------------------------------------
+
+
+RadicalSelection::RadicalSelection() : mode(RadicalFilterModes::Parts), grouped(false), counts(ZKanji::kanjicount, 0)
+{
+
+}
+
+void RadicalSelection::setMode(RadicalFilterModes newmode, bool newgrouped)
+{
+    clear();
+    if (mode == newmode && grouped == newgrouped)
+        return;
+
+    mode = newmode;
+    grouped = newgrouped;
+    updateFound();
+}
+
+void RadicalSelection::setBase(const std::vector<ushort> &kanjilist)
+{
+    base.fill(false);
+    for (ushort kix : kanjilist)
+        base.set(kix, true);
+
+    res = base;
+    if (!selected.empty())
+    {
+        for (int kix = res.next(0); kix != -1; kix = res.next(kix + 1))
+            if (counts[kix] == 0)
+                res.set(kix, false);
+    }
+
+    updateFound();
+}
+
+void RadicalSelection::add(ushort rad)
+{
+    if (std::find(selected.begin(), selected.end(), rad) != selected.end())
+        return;
+
+    KanjiBitSet bits;
+    radicalKanji(rad, bits);
+
+    if (selected.empty())
+        res.fill(false);
+    selected.push_back(rad);
+
+    for (int kix = bits.next(0); kix != -1; kix = bits.next(kix + 1))
+        if (counts[kix]++ == 0 && base.toggled(kix))
+            res.set(kix, true);
+}
+
+void RadicalSelection::remove(ushort rad)
+{
+    auto it = std::find(selected.begin(), selected.end(), rad);
+    if (it == selected.end())
+        return;
+    selected.erase(it);
+
+    if (selected.empty())
+    {
+        clear();
+        return;
+    }
+
+    KanjiBitSet bits;
+    radicalKanji(rad, bits);
+
+    for (int kix = bits.next(0); kix != -1; kix = bits.next(kix + 1))
+        if (--counts[kix] == 0)
+            res.set(kix, false);
+}
+
+void RadicalSelection::clear()
+{
+    selected.clear();
+    std::fill(counts.begin(), counts.end(), 0);
+    res = base;
+}
+
+bool RadicalSelection::empty() const
+{
+    return selected.empty();
+}
+
+const KanjiBitSet& RadicalSelection::result() const
+{
+    return res;
+}
+
+bool RadicalSelection::found(ushort rad) const
+{
+    return rad < foundlist.size() && foundlist[rad];
+}
+
+void RadicalSelection::radicalKanji(ushort rad, KanjiBitSet &dest) const
+{
+    KanjiFilterIndex &kindex = ZKanji::kanjiFilterIndex();
+    if (mode == RadicalFilterModes::Radicals)
+        dest = kindex.radical(rad);
+    else if (mode == RadicalFilterModes::Parts)
+        dest = kindex.part(rad);
+    else
+    {
+        dest.fill(false);
+        kindex.namedRadical(rad, grouped, dest);
+    }
+}
+
+void RadicalSelection::updateFound()
+{
+    KanjiFilterIndex &kindex = ZKanji::kanjiFilterIndex();
+
+    // Each radical form is checked separately even in grouped mode. The radicals grid
+    // decides whether to show a group by its forms.
+    if (mode == RadicalFilterModes::Radicals)
+    {
+        foundlist.assign(215, false);
+        for (int ix = 1; ix != 215; ++ix)
+            foundlist[ix] = base.intersects(kindex.radical(ix));
+    }
+    else if (mode == RadicalFilterModes::Parts)
+    {
+        foundlist.assign(ZKanji::radklist.size(), false);
+        for (int ix = 0, siz = foundlist.size(); ix != siz; ++ix)
+            foundlist[ix] = base.intersects(kindex.part(ix));
+    }
+    else
+    {
+        foundlist.assign(ZKanji::radlist.size(), false);
+        for (int ix = 0, siz = foundlist.size(); ix != siz; ++ix)
+            foundlist[ix] = base.intersects(kindex.namedRadical(ix));
+    }
+}
+
+
+//-------------------------------------------------------------
+
+
+KanjiMeaningIndex::KanjiMeaningIndex(const Dictionary *dict) : dict(dict)
+{
+    texts.resize(ZKanji::kanjicount);
+    for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
+        add(ix);
+
+    std::sort(list.begin(), list.end(), [this](const Position &a, const Position &b) { return less(a, b); });
+}
+
+void KanjiMeaningIndex::update(int kindex)
+{
+    list.resize(std::remove_if(list.begin(), list.end(), [kindex](const Position &p) { return p.kindex == kindex; }) - list.begin());
+
+    int pos = list.size();
+    add(kindex);
+
+    // The new positions were added at the end of the list. Move each to its place.
+    std::vector<Position> added(list.begin() + pos, list.end());
+    list.resize(pos);
+    for (const Position &p : added)
+        list.insert(std::upper_bound(list.begin(), list.end(), p, [this](const Position &a, const Position &b) { return less(a, b); }), p);
+}
+
+void KanjiMeaningIndex::find(const QString &str, bool whole, KanjiBitSet &result) const
+{
+    result.fill(false);
+
+    const QChar *sdat = str.constData();
+    const int slen = str.size();
+
+    auto it = std::lower_bound(list.begin(), list.end(), 0, [this, sdat, slen](const Position &p, int) {
+        return compare(p, sdat, slen) < 0;
+    });
+
+    for (; it != list.end() && compare(*it, sdat, slen) == 0; ++it)
+    {
+        if (whole)
+        {
+            const QString &text = texts[it->kindex];
+            if (it->pos + slen != text.size() && qcharisdelim(text.at(it->pos + slen)) != QCharKind::Delimiter)
+                continue;
+        }
+        result.set(it->kindex, true);
+    }
+}
+
+void KanjiMeaningIndex::add(int kindex)
+{
+    QString &str = texts[kindex];
+    str = dict->kanjiMeaning(kindex).toLower();
+
+    // A word starts at every character that's not a delimiter and is either at the front
+    // of the text or comes after a delimiter.
+    const QChar *dat = str.constData();
+    bool delim = true;
+    for (int pos = 0, siz = str.size(); pos != siz; ++pos)
+    {
+        bool posdelim = qcharisdelim(dat[pos]) == QCharKind::Delimiter;
+        if (delim && !posdelim)
+            list.push_back({ (ushort)kindex, (ushort)pos });
+        delim = posdelim;
+    }
+}
+
+bool KanjiMeaningIndex::less(const Position &a, const Position &b) const
+{
+    const QString &text = texts[b.kindex];
+    return compare(a, text.constData() + b.pos, text.size() - b.pos) < 0;
+}
+
+int KanjiMeaningIndex::compare(const Position &p, const QChar *str, int len) const
+{
+    const QString &text = texts[p.kindex];
+    const QChar *dat = text.constData() + p.pos;
+    const int datlen = text.size() - p.pos;
+
+    for (int ix = 0; ix != len; ++ix)
+    {
+        if (ix == datlen)
+            return -1;
+        if (dat[ix] != str[ix])
+            return dat[ix].unicode() < str[ix].unicode() ? -1 : 1;
+    }
+    return 0;
+}
+
+
+//-------------------------------------------------------------
+
+
+namespace ZKanji
+{
+    KanjiFilterIndex& kanjiFilterIndex()
+    {
+        static KanjiFilterIndex index;
+        return index;
+    }
+
+    KanjiReadingIndex& kanjiReadingIndex()
+    {
+        static KanjiReadingIndex index;
+        return index;
+    }
+}
+
+
+//-------------------------------------------------------------
+
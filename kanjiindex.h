@@ -0,0 +1,262 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef KANJIINDEX_H
+#define KANJIINDEX_H
+
+#include <QtGlobal>
+#include <QString>
+#include <vector>
+
+// Set of kanji indexes in ZKanji::kanjis, stored as one bit per kanji in 64 bit words, so
+// two sets can be combined a word at a time.
+class KanjiBitSet
+{
+public:
+    // Creates a set with room for every kanji. When fill is true, every kanji is included.
+    KanjiBitSet(bool fill = false);
+    KanjiBitSet(const KanjiBitSet &src) = default;
+    KanjiBitSet(KanjiBitSet &&src) = default;
+    KanjiBitSet& operator=(const KanjiBitSet &src) = default;
+    KanjiBitSet& operator=(KanjiBitSet &&src) = default;
+
+    // Includes or excludes every kanji in the set.
+    void fill(bool toggle);
+
+    // Returns whether the kanji at kindex is included in the set.
+    bool toggled(int kindex) const;
+    // Includes or excludes the kanji at kindex.
+    void set(int kindex, bool toggle);
+
+    // Returns whether no kanji is included in the set.
+    bool empty() const;
+    // Returns whether at least one kanji is included in both this set and other.
+    bool intersects(const KanjiBitSet &other) const;
+    // Returns the number of kanji included in the set.
+    int count() const;
+
+    // Returns the first kanji index in the set that's not less than kindex, or -1 if there
+    // is none.
+    int next(int kindex) const;
+
+    // Keeps only kanji in the set that are also in other.
+    KanjiBitSet& operator&=(const KanjiBitSet &other);
+    // Adds the kanji in other to the set.
+    KanjiBitSet& operator|=(const KanjiBitSet &other);
+    // Removes the kanji from the set that are included in other.
+    KanjiBitSet& remove(const KanjiBitSet &other);
+
+    bool operator==(const KanjiBitSet &other) const;
+    bool operator!=(const KanjiBitSet &other) const;
+
+    // Replaces the contents of list with the kanji indexes in the set in increasing order.
+    void toList(std::vector<ushort> &list) const;
+private:
+    std::vector<quint64> bits;
+};
+
+enum class KanjiFromT;
+
+// Columns of kanji attributes used by the kanji search filters, stored as a precomputed
+// bit set for each possible value. The index is built on first use from the data in
+// ZKanji::kanjis, ZKanji::radlist and ZKanji::radklist.
+class KanjiFilterIndex
+{
+public:
+    KanjiFilterIndex();
+
+    // Discards the built index. It'll be rebuilt on next access.
+    void reset();
+
+    // Sets result to the kanji with stroke count between first and last inclusive.
+    void strokes(int first, int last, KanjiBitSet &result);
+    // Sets result to the kanji with JLPT level between first and last inclusive. Kanji
+    // without a JLPT level have a level of 0.
+    void jlpt(int first, int last, KanjiBitSet &result);
+    // Sets result to the kanji with jouyou grade between first and last inclusive.
+    void jouyou(int first, int last, KanjiBitSet &result);
+
+    // Kanji with the SKIP code value at position pos (0 to 2) matching val.
+    const KanjiBitSet& skip(int pos, int val);
+    // Kanji with the classical radical rad. The radicals are numbered from 1 to 214.
+    const KanjiBitSet& radical(int rad);
+    // Kanji listed under the radical part at index in ZKanji::radklist.
+    const KanjiBitSet& part(int index);
+    // Kanji listed under the named radical at index in ZKanji::radlist.
+    const KanjiBitSet& namedRadical(int index);
+    // Kanji listed under the named radical at index in ZKanji::radlist. When grouped is
+    // true, the kanji of the following named radicals of the same radical number are also
+    // included. The result is added to the kanji already in result.
+    void namedRadical(int index, bool grouped, KanjiBitSet &result);
+
+    // Kanji that are in the given kanji list or reference book. KanjiFromT::All and
+    // KanjiFromT::Clipbrd are not stored in the index and return every kanji.
+    const KanjiBitSet& from(KanjiFromT type);
+private:
+    void build();
+    // Sets result to the union of the sets in list between first and last inclusive.
+    void unite(const std::vector<KanjiBitSet> &list, int first, int last, KanjiBitSet &result) const;
+
+    bool built;
+
+    std::vector<KanjiBitSet> strokelist;
+    std::vector<KanjiBitSet> jlptlist;
+    std::vector<KanjiBitSet> jouyoulist;
+    std::vector<KanjiBitSet> skiplist[3];
+    std::vector<KanjiBitSet> radicallist;
+    std::vector<KanjiBitSet> partlist;
+    std::vector<KanjiBitSet> namedlist;
+    std::vector<KanjiBitSet> fromlist;
+
+    // Returned for values that no kanji has.
+    KanjiBitSet none;
+    // Returned for from types not stored in the index.
+    KanjiBitSet all;
+};
+
+// Sorted lists of the kanji readings converted to hiragana, to look up kanji by a reading
+// or the start of a reading with a binary search. Built on first use from ZKanji::kanjis.
+class KanjiReadingIndex
+{
+public:
+    KanjiReadingIndex();
+
+    // Discards the built index. It'll be rebuilt on next access.
+    void reset();
+
+    // Sets result to the kanji with a reading matching str, which must be in hiragana. When
+    // prefix is true, readings starting with str also match. Set on and kun to select
+    // which readings to check. When okurigana is false, only the part of KUN readings in
+    // front of the okurigana is checked.
+    void find(const QString &str, bool prefix, bool on, bool kun, bool okurigana, KanjiBitSet &result);
+private:
+    void build();
+
+    typedef std::vector<std::pair<QString, ushort>> ReadingList;
+
+    // Adds the kanji to result from list with a reading matching str.
+    void findIn(const ReadingList &list, const QString &str, bool prefix, KanjiBitSet &result) const;
+
+    bool built;
+
+    // ON readings.
+    ReadingList onlist;
+    // KUN readings with the okurigana.
+    ReadingList kunlist;
+    // KUN readings without the okurigana.
+    ReadingList stemlist;
+};
+
+enum class RadicalFilterModes : int;
+// Kanji matching the radicals selected in the radicals window. Any of the selected radicals
+// must be in a kanji for it to match. The result is updated when a single radical is added
+// to or removed from the selection, without going through every selected radical again.
+// The values of radicals depend on the mode. They are radical numbers in Radicals mode,
+// indexes in ZKanji::radklist in Parts mode and indexes in ZKanji::radlist in NamedRadicals
+// mode.
+class RadicalSelection
+{
+public:
+    RadicalSelection();
+
+    // Changes the kind of radicals that can be selected and clears the selection. When
+    // grouped is true in NamedRadicals mode, a selected radical stands for every form of it
+    // that follow it in ZKanji::radlist.
+    void setMode(RadicalFilterModes newmode, bool newgrouped);
+
+    // Sets the kanji the selection is applied to. Updates which radicals are found in them.
+    void setBase(const std::vector<ushort> &kanjilist);
+
+    // Adds a radical to the selection.
+    void add(ushort rad);
+    // Removes a radical from the selection.
+    void remove(ushort rad);
+    // Removes every radical from the selection.
+    void clear();
+    // Returns whether no radical is selected.
+    bool empty() const;
+
+    // Kanji of the base that contain any of the selected radicals. Every kanji of the base
+    // when the selection is empty.
+    const KanjiBitSet& result() const;
+
+    // Returns whether the radical is in at least one kanji of the base. Radicals not found
+    // there would only select kanji that are already filtered out.
+    bool found(ushort rad) const;
+private:
+    // Sets dest to the kanji containing the radical. In grouped NamedRadicals mode the
+    // other forms of the radical are included.
+    void radicalKanji(ushort rad, KanjiBitSet &dest) const;
+    // Recomputes which radicals are in the kanji of the base.
+    void updateFound();
+
+    RadicalFilterModes mode;
+    bool grouped;
+
+    KanjiBitSet base;
+    KanjiBitSet res;
+
+    // Selected radicals in the order they were selected.
+    std::vector<ushort> selected;
+    // Number of selected radicals in each kanji. A kanji is in the result if it's in the
+    // base and this count is not zero.
+    std::vector<ushort> counts;
+    // Whether each radical is in at least one kanji of the base.
+    std::vector<bool> foundlist;
+};
+
+class Dictionary;
+// Lookup of kanji by the words in their meanings in a dictionary. Every position in the
+// lowercase meaning text that starts a word is stored in a list ordered by the text
+// following it, so looking up a meaning is a binary search.
+class KanjiMeaningIndex
+{
+public:
+    KanjiMeaningIndex(const Dictionary *dict);
+
+    // Updates the index after the meaning of the kanji at kindex changed.
+    void update(int kindex);
+
+    // Sets result to the kanji having a word in their meaning that starts with str, which
+    // must be in lowercase. When whole is true, the match must end at a delimiter or the
+    // end of the meaning.
+    void find(const QString &str, bool whole, KanjiBitSet &result) const;
+private:
+    struct Position
+    {
+        ushort kindex;
+        // Position of the word start in the meaning text.
+        ushort pos;
+    };
+
+    // Fills texts[kindex] and adds the word starts in it to list, keeping its order.
+    void add(int kindex);
+
+    // Compares the meaning text of p from its position with the first len characters of
+    // str. The text matches if it starts with those characters.
+    int compare(const Position &p, const QChar *str, int len) const;
+    // Returns whether the meaning text of a from its position comes before that of b.
+    bool less(const Position &a, const Position &b) const;
+
+    const Dictionary *dict;
+
+    // Lowercase meaning text of each kanji.
+    std::vector<QString> texts;
+    std::vector<Position> list;
+};
+
+namespace ZKanji
+{
+    // Kanji filter index built from the global kanji data. Call reset() on it when the
+    // kanji data is replaced.
+    KanjiFilterIndex& kanjiFilterIndex();
+    // Kanji reading index built from the global kanji data. Call reset() on it when the
+    // kanji data is replaced.
+    KanjiReadingIndex& kanjiReadingIndex();
+}
+
+
+#endif // KANJIINDEX_H
@@ -17,6 +17,7 @@
 #include "zkanjimain.h"
 #include "words.h"
 #include "kanji.h"
+#include "kanjiindex.h"
 #include "zkanjigridmodel.h"
 #include "zui.h"
 #include "zevents.h"
@@ -1278,212 +1279,127 @@ void KanjiSearchWidget::listFilteredKanji(const RuntimeKanjiFilters &f, std::vec
 
     RadicalFilter rads = f.data.rads;
 
-    if (!filterActive(f.data.filters, KanjiFilters::Radicals) || rads.groups.empty())
-    {
-        for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
-            list.push_back(ix);
-    }
-    else if (rads.mode == RadicalFilterModes::Radicals)
+    KanjiFilterIndex &kindex = ZKanji::kanjiFilterIndex();
+
+    // Kanji passing every filter so far. The filters with precomputed columns in the index
+    // are combined with it a word at a time.
+    KanjiBitSet bits(true);
+    // Kanji matching a single filter, before it is combined with bits.
+    KanjiBitSet group;
+
+    if (filterActive(f.data.filters, KanjiFilters::Radicals) && !rads.groups.empty())
     {
-        std::vector<ushort> group;
-        for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
+        if (rads.mode == RadicalFilterModes::Radicals)
         {
-            auto it = std::find(rads.groups[0].begin(), rads.groups[0].end(), ZKanji::kanjis[ix]->rad);
-            if (it != rads.groups[0].end())
-                group.push_back(ix);
+            group.fill(false);
+            for (int ix = 0, siz = rads.groups[0].size(); ix != siz; ++ix)
+                group |= kindex.radical(rads.groups[0][ix]);
+            bits &= group;
         }
-        if (list.empty())
-            list = group;
         else
         {
-            std::vector<ushort> temp;
-            temp.swap(list);
-            list.resize(group.size());
-            list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
-        }
-        group.clear();
-    }
-    else if (rads.mode == RadicalFilterModes::Parts)
-    {
-        std::vector<ushort> group;
-        for (int ix = 0; ix != rads.groups.size(); ++ix)
-        {
-            const std::vector<ushort> &g = rads.groups[ix];
-            for (int iy = 0; iy != g.size(); ++iy)
-                group.insert(group.end(), ZKanji::radklist[g[iy]].second.begin(), ZKanji::radklist[g[iy]].second.end());
-            std::sort(group.begin(), group.end());
-            group.resize(std::unique(group.begin(), group.end()) - group.begin());
-
-            if (list.empty())
-                list = group;
-            else
-            {
-                std::vector<ushort> temp;
-                temp.swap(list);
-                list.resize(group.size());
-                list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
-            }
-            group.clear();
-        }
-    }
-    else // NamedRadicals
-    {
-        std::vector<ushort> group;
-        for (int ix = 0; ix != rads.groups.size(); ++ix)
-        {
-            const std::vector<ushort> &g = rads.groups[ix];
-            for (int iy = 0; iy != g.size(); ++iy)
+            for (int ix = 0; ix != rads.groups.size(); ++ix)
             {
-                if (!rads.grouped)
-                    group.insert(group.end(), ZKanji::radlist[g[iy]]->kanji.begin(), ZKanji::radlist[g[iy]]->kanji.end());
-                else
+                const std::vector<ushort> &g = rads.groups[ix];
+                group.fill(false);
+                for (int iy = 0; iy != g.size(); ++iy)
                 {
-                    for (int j = g[iy], siz = ZKanji::radlist.size(); j != siz; ++j)
-                        if (j != g[iy] && ZKanji::radlist[j]->radical != ZKanji::radlist[j - 1]->radical)
-                            break;
-                        else
-                            group.insert(group.end(), ZKanji::radlist[j]->kanji.begin(), ZKanji::radlist[j]->kanji.end());
+                    if (rads.mode == RadicalFilterModes::Parts)
+                        group |= kindex.part(g[iy]);
+                    else // NamedRadicals
+                        kindex.namedRadical(g[iy], rads.grouped, group);
                 }
+                bits &= group;
             }
-            std::sort(group.begin(), group.end());
-            group.resize(std::unique(group.begin(), group.end()) - group.begin());
-
-            if (list.empty())
-                list = group;
-            else
-            {
-                std::vector<ushort> temp;
-                temp.swap(list);
-                list.resize(group.size());
-                list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
-            }
-            group.clear();
         }
     }
 
-    if (list.empty())
-        return;
-
-    Dictionary *dict = ui->kanjiGrid->dictionary();
-
-    QSet<QChar> clpbrd;
     if (f.data.fromtype == KanjiFromT::Clipbrd)
     {
+        group.fill(false);
         QString tmp = qApp->clipboard()->text();
         for (int ix = 0; ix != tmp.size(); ++ix)
         {
-            if (KANJI(tmp.at(ix).unicode()))
-                clpbrd.insert(tmp.at(ix));
+            if (!KANJI(tmp.at(ix).unicode()))
+                continue;
+            int kix = ZKanji::kanjiIndex(tmp.at(ix));
+            if (kix != -1)
+                group.set(kix, true);
         }
+        bits &= group;
     }
+    else if (f.data.fromtype != KanjiFromT::All)
+        bits &= kindex.from(f.data.fromtype);
 
-    for (int ix = list.size() - 1; ix != -1; --ix)
+    if (filterActive(f.data, KanjiFilters::Strokes) && (f.data.strokemin != 0 || f.data.strokemax != 0))
     {
-        KanjiEntry *k = ZKanji::kanjis[list[ix]];
+        // A minimum without a maximum means an exact stroke count.
+        kindex.strokes(f.data.strokemin, f.data.strokemax == 0 ? f.data.strokemin : f.data.strokemax, group);
+        bits &= group;
+    }
 
-        bool match;
+    if (filterActive(f.data, KanjiFilters::JLPT) && (f.data.jlptmin != -1 || f.data.jlptmax != -1))
+    {
+        // A minimum without a maximum means an exact level.
+        kindex.jlpt(f.data.jlptmin == -1 ? 0 : f.data.jlptmin, f.data.jlptmax == -1 ? f.data.jlptmin : f.data.jlptmax, group);
+        bits &= group;
+    }
 
-        if (f.data.fromtype != KanjiFromT::All)
+    if (filterActive(f.data, KanjiFilters::SKIP))
+    {
+        if (f.data.skip1 != 0)
+            bits &= kindex.skip(0, f.data.skip1);
+        if (f.data.skip2 > 0)
+            bits &= kindex.skip(1, f.data.skip2);
+        if (f.data.skip3 > 0)
+            bits &= kindex.skip(2, f.data.skip3);
+    }
+
+    if (filterActive(f.data, KanjiFilters::Jouyou) && f.data.jouyou != 0)
+    {
+        // Grade 7 stands for every elementary school grade from 1 to 6.
+        if (f.data.jouyou == 7)
+            kindex.jouyou(1, 6, group);
+        else
+            kindex.jouyou(f.data.jouyou, f.data.jouyou, group);
+        bits &= group;
+    }
+
+    if (filterActive(f.data, KanjiFilters::Reading) && !f.data.reading.isEmpty())
+    {
+        // In strict mode katakana only matches ON and hiragana only KUN readings.
+        bool ron = true;
+        bool rkun = true;
+        if (f.data.readingstrict)
         {
-            match = false;
-            switch (f.data.fromtype)
+            for (int ix = 0, siz = f.data.reading.size(); (ron || rkun) && ix != siz; ++ix)
             {
-            case KanjiFromT::Clipbrd:
-                match = clpbrd.contains(k->ch);
-                break;
-            case KanjiFromT::Common:
-                match = k->frequency != 0;
-                break;
-            case KanjiFromT::Jouyou:
-                match = k->jouyou != 0;
-                break;
-            case KanjiFromT::JLPT:
-                match = k->jlpt != 0;
-                break;
-            case KanjiFromT::Oneil:
-                match = k->oneil != 0;
-                break;
-            case KanjiFromT::Gakken:
-                match = k->gakken != 0;
-                break;
-            case KanjiFromT::Halpern:
-                match = k->halpern != 0;
-                break;
-            case KanjiFromT::Heisig:
-                match = k->heisig != 0;
-                break;
-            case KanjiFromT::HeisigN:
-                match = k->heisign != 0;
-                break;
-            case KanjiFromT::HeisigF:
-                match = k->heisigf != 0;
-                break;
-            case KanjiFromT::Henshall:
-                match = k->henshall != 0;
-                break;
-            case KanjiFromT::Nelson:
-                match = k->nelson != 0;
-                break;
-            case KanjiFromT::NewNelson:
-                match = k->newnelson != 0;
-                break;
-            case KanjiFromT::SnH:
-                match = k->snh[0] != 0;
-                break;
-            case KanjiFromT::KnK:
-                match = k->knk != 0;
-                break;
-            case KanjiFromT::KnKOld:
-                match = k->knk != 0 && k->knk <= 1945;
-                break;
-            case KanjiFromT::Busy:
-                match = k->busy[0] != 0;
-                break;
-            case KanjiFromT::Crowley:
-                match = k->crowley != 0;
-                break;
-            case KanjiFromT::FlashC:
-                match = k->flashc != 0;
-                break;
-            case KanjiFromT::KGuide:
-                match = k->kguide != 0;
-                break;
-            case KanjiFromT::HalpernN:
-                match = k->halpernn != 0;
-                break;
-            case KanjiFromT::Deroo:
-                match = k->deroo != 0;
-                break;
-            case KanjiFromT::Sakade:
-                match = k->sakade != 0;
-                break;
-            case KanjiFromT::HenshallG:
-                match = k->henshallg != 0;
-                break;
-            case KanjiFromT::Context:
-                match = k->context != 0;
-                break;
-            case KanjiFromT::HalpernK:
-                match = k->halpernk != 0;
-                break;
-            case KanjiFromT::HalpernL:
-                match = k->halpernl != 0;
-                break;
-            case KanjiFromT::Tuttle:
-                match = k->tuttle != 0;
-                break;
-            }
-            if (!match)
-            {
-                list.erase(list.begin() + ix);
-                continue;
+                if (KATAKANA(f.data.reading.at(ix).unicode()))
+                    rkun = false;
+                if (HIRAGANA(f.data.reading.at(ix).unicode()))
+                    ron = false;
             }
         }
 
-        if (filterActive(f.data, KanjiFilters::Index) && !f.data.index.isEmpty())
+        ZKanji::kanjiReadingIndex().find(hiraganize(f.data.reading), f.data.readingafter, ron, rkun, f.data.readingoku, group);
+        bits &= group;
+    }
+
+    if (filterActive(f.data, KanjiFilters::Meaning) && !f.data.meaning.isEmpty())
+    {
+        ui->kanjiGrid->dictionary()->kanjiMeaningIndex().find(f.data.meaning.toLower(), !f.data.meaningafter, group);
+        bits &= group;
+    }
+
+    // The index filter is checked one by one on the remaining kanji.
+    if (filterActive(f.data, KanjiFilters::Index) && !f.data.index.isEmpty())
+    {
+        for (int kix = bits.next(0); kix != -1; kix = bits.next(kix + 1))
         {
+            KanjiEntry *k = ZKanji::kanjis[kix];
+
             QString str;
-            match = false;
+            bool match = false;
             switch (f.data.indextype)
             {
             case KanjiIndexT::Unicode:
@@ -1638,127 +1554,12 @@ void KanjiSearchWidget::listFilteredKanji(const RuntimeKanjiFilters &f, std::vec
             }
 
             if (!match)
-            {
-                list.erase(list.begin() + ix);
-                continue;
-            }
-        }
-
-        if (filterActive(f.data, KanjiFilters::Strokes) && ((f.data.strokemin != 0 && k->strokes < f.data.strokemin) || (f.data.strokemax != 0 && k->strokes > f.data.strokemax) || (f.data.strokemax == 0 && f.data.strokemin != 0 && k->strokes != f.data.strokemin)))
-        {
-            list.erase(list.begin() + ix);
-            continue;
-        }
-
-        if (filterActive(f.data, KanjiFilters::JLPT) && ((f.data.jlptmin != -1 && k->jlpt < f.data.jlptmin) || (f.data.jlptmax != -1 && k->jlpt > f.data.jlptmax) || (f.data.jlptmax == -1 && f.data.jlptmin != -1 && k->jlpt != f.data.jlptmin)))
-        {
-            list.erase(list.begin() + ix);
-            continue;
-        }
-
-        if (filterActive(f.data, KanjiFilters::SKIP) && ((f.data.skip1 != 0 && f.data.skip1 != k->skips[0]) || (f.data.skip2 > 0 && f.data.skip2 != k->skips[1]) || (f.data.skip3 > 0 && f.data.skip3 != k->skips[2])))
-        {
-            list.erase(list.begin() + ix);
-            continue;
-        }
-
-        if (filterActive(f.data, KanjiFilters::Jouyou) && (f.data.jouyou != 0 && (k->jouyou == 0 || (f.data.jouyou != 7 && f.data.jouyou != k->jouyou) || (f.data.jouyou == 7 && k->jouyou > 6))))
-        {
-            list.erase(list.begin() + ix);
-            continue;
-        }
-
-        if (filterActive(f.data, KanjiFilters::Reading) && !f.data.reading.isEmpty())
-        {
-            match = false;
-            bool ron = true;
-            bool rkun = true;
-            if (f.data.readingstrict)
-            {
-                for (int ix = 0, siz = f.data.reading.size(); (ron || rkun) && ix != siz; ++ix)
-                {
-                    if (KATAKANA(f.data.reading.at(ix).unicode()))
-                        rkun = false;
-                    if (HIRAGANA(f.data.reading.at(ix).unicode()))
-                        ron = false;
-                }
-            }
-
-            QString str = hiraganize(f.data.reading);
-            if (ron)
-            {
-                for (int iy = 0, siz = k->on.size(); !match && iy != siz; ++iy)
-                {
-                    QString str1 = hiraganize(k->on[iy].toQString());
-                    if (!f.data.readingafter && str1.size() != str.size())
-                        continue;
-                    match = qcharncmp(str1.constData(), str.constData(), str.size()) == 0;
-                }
-            }
-            if (!match && rkun)
-            {
-                for (int iy = 0, siz = k->kun.size(); !match && iy != siz; ++iy)
-                {
-                    QString kunstr = QString::fromRawData(k->kun[iy].data(), qcharlen(k->kun[iy].data()));
-                    int p = kunstr.indexOf('.');
-                    if (p != -1)
-                        kunstr = kunstr.left(p) + (!f.data.readingoku ? QString() : kunstr.right(kunstr.size() - p - 1));
-                    kunstr = hiraganize(kunstr);
-
-                    if (!f.data.readingafter && kunstr.size() != str.size())
-                        continue;
-
-                    match = qcharncmp(kunstr.constData(), str.constData(), str.size()) == 0;
-                }
-            }
-
-            if (!match)
-            {
-                list.erase(list.begin() + ix);
-                continue;
-            }
-        }
-
-        // Throw out anything not matching the meaning. There is no tree for kanji meanings,
-        // so the only way is to go through each of them and check for matches.
-        if (filterActive(f.data, KanjiFilters::Meaning) && !f.data.meaning.isEmpty())
-        {
-            const int mlen = f.data.meaning.size();
-            const QString mstr = f.data.meaning.toLower();
-            const QChar *mdat = mstr.constData();
-
-            match = false;
-            const QString datstr = dict->kanjiMeaning(list[ix]).toLower();
-            const QChar *dat = datstr.constData();
-            const int datlen = datstr.size();
-
-            // Go through each character one by one. The match is only valid if it's at the
-            // front of the meaning, or it comes after a delimiter. When meaningafter is
-            // false, the match must be directly followed by a delimiter or must tail the
-            // meaning.
-            for (int pos = 0; !match && pos <= datlen - mlen; ++pos)
-            {
-                if (qcharisdelim(dat[pos]) == QCharKind::Delimiter)
-                    continue;
-                if (qcharncmp(dat + pos, mdat, mlen) == 0)
-                {
-                    if (!f.data.meaningafter)
-                        match = pos + mlen == datlen || qcharisdelim(dat[pos + mlen]) == QCharKind::Delimiter;
-                    else
-                        match = true;
-                }
-
-                while (pos < datlen - mlen && qcharisdelim(dat[++pos]) != QCharKind::Delimiter)
-                    ;
-            }
-            if (!match)
-            {
-                list.erase(list.begin() + ix);
-                continue;
-            }
+                bits.set(kix, false);
         }
     }
 
+    bits.toList(list);
+
     if (filterActive(f.data, KanjiFilters::Radicals) && radform != nullptr)
     {
         // The radical selecting window needs the list before filtering by the temporary
@@ -1769,60 +1570,18 @@ void KanjiSearchWidget::listFilteredKanji(const RuntimeKanjiFilters &f, std::vec
         if (f.tmprads.empty() || list.empty())
             return;
 
-        if (rads.mode == RadicalFilterModes::Radicals)
-        {
-            std::vector<ushort> group;
-            for (int ix = 0; ix != ZKanji::kanjicount; ++ix)
-            {
-                auto it = std::find(f.tmprads.begin(), f.tmprads.end(), ZKanji::kanjis[ix]->rad);
-                if (it != f.tmprads.end())
-                    group.push_back(ix);
-            }
-            std::vector<ushort> temp;
-            temp.swap(list);
-            list.resize(group.size());
-            list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
-        }
-        else if (rads.mode == RadicalFilterModes::Parts)
+        group.fill(false);
+        for (int ix = 0; ix != f.tmprads.size(); ++ix)
         {
-            std::vector<ushort> group;
-            for (int ix = 0; ix != f.tmprads.size(); ++ix)
-                group.insert(group.end(), ZKanji::radklist[f.tmprads[ix]].second.begin(), ZKanji::radklist[f.tmprads[ix]].second.end());
-            std::sort(group.begin(), group.end());
-            group.resize(std::unique(group.begin(), group.end()) - group.begin());
-
-            std::vector<ushort> temp;
-            temp.swap(list);
-            list.resize(group.size());
-            list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
-        }
-        else // NamedRadicals
-        {
-            std::vector<ushort> group;
-
-            for (int ix = 0; ix != f.tmprads.size(); ++ix)
-            {
-                if (!rads.grouped)
-                    group.insert(group.end(), ZKanji::radlist[f.tmprads[ix]]->kanji.begin(), ZKanji::radlist[f.tmprads[ix]]->kanji.end());
-                else
-                {
-                    for (int j = f.tmprads[ix], siz = ZKanji::radlist.size(); j != siz; ++j)
-                    {
-                        if (j != f.tmprads[ix] && ZKanji::radlist[j]->radical != ZKanji::radlist[j - 1]->radical)
-                            break;
-                        else
-                            group.insert(group.end(), ZKanji::radlist[j]->kanji.begin(), ZKanji::radlist[j]->kanji.end());
-                    }
-                }
-            }
-            std::sort(group.begin(), group.end());
-            group.resize(std::unique(group.begin(), group.end()) - group.begin());
-
-            std::vector<ushort> temp;
-            temp.swap(list);
-            list.resize(group.size());
-            list.resize(std::set_intersection(group.begin(), group.end(), temp.begin(), temp.end(), list.begin()) - list.begin());
+            if (rads.mode == RadicalFilterModes::Radicals)
+                group |= kindex.radical(f.tmprads[ix]);
+            else if (rads.mode == RadicalFilterModes::Parts)
+                group |= kindex.part(f.tmprads[ix]);
+            else // NamedRadicals
+                kindex.namedRadical(f.tmprads[ix], rads.grouped, group);
         }
+        bits &= group;
+        bits.toList(list);
     }
 }
 
@@ -1837,7 +1596,19 @@ void KanjiSearchWidget::filterKanji(bool forced)
     {
         KanjiGridModel *tmp = ui->kanjiGrid->model();
 
-        if (filtersEmpty(f))
+        // Filters without the temporary radical selection of the last filtering.
+        RuntimeKanjiFilters ftmp = f;
+        ftmp.tmprads = filters.tmprads;
+
+        if (!forced && radform != nullptr && filterActive(f.data, KanjiFilters::Radicals) && !f.tmprads.empty() && filtersMatch(ftmp, filters))
+        {
+            // Only the radicals selected in the radicals window changed. The window keeps
+            // the kanji matching the other filters and updates its result on every click.
+            std::vector<ushort> list;
+            radform->selectionKanji(list);
+            ui->kanjiGrid->setModel(new KanjiGridSortModel(&mainKanjiListModel(), std::move(list), (KanjiGridSortOrder)ui->sortCBox->currentIndex(), ui->kanjiGrid->dictionary(), ui->kanjiGrid));
+        }
+        else if (filtersEmpty(f))
         {
             ui->kanjiGrid->setModel(new KanjiGridSortModel(&mainKanjiListModel(), (KanjiGridSortOrder)ui->sortCBox->currentIndex(), ui->kanjiGrid->dictionary(), ui->kanjiGrid));
             if (radform != nullptr)
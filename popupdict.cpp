@@ -22,6 +22,7 @@
 #include "zevents.h"
 #include "zdictionarylistview.h"
 #include "words.h"
+#include "wordformindex.h"
 #include "dialogs.h"
 #include "zui.h"
 
@@ -52,6 +53,8 @@ PopupDictionary::PopupDictionary(QWidget *parent) : base(parent), ui(new Ui::Pop
     ui->dictionary->view()->setSizeBase(ListSizeBase::Popup);
     ui->dictionary->view()->setGroupDisplay(true);
 
+    ui->wordsCombo->hide();
+
     connect(qApp, &QApplication::applicationStateChanged, this, &PopupDictionary::appStateChange);
     connect(gUI, &GlobalUI::settingsChanged, this, &PopupDictionary::settingsChanged);
 
@@ -112,12 +115,17 @@ void PopupDictionary::doPopup(int screen, bool fromjapanese)
     switch (Settings::popup.activation)
     {
     case PopupSettings::Clear:
+        ui->wordsCombo->hide();
         ui->dictionary->setSearchText(QString());
         break;
     case PopupSettings::Clipboard:
         str = qApp->clipboard()->text();
-        if (!str.isEmpty())
-            ui->dictionary->setSearchText(str);
+        if (!fromjapanese || !listTextWords(str))
+        {
+            ui->wordsCombo->hide();
+            if (!str.isEmpty())
+                ui->dictionary->setSearchText(str);
+        }
         break;
     case PopupSettings::Unchanged:
     default:
@@ -228,6 +236,47 @@ void PopupDictionary::on_dictionary_wordDoubleClicked(int windex, int dindex)
     gUI->wordToDestSelect(ZKanji::dictionary(dictindex), windex);
 }
 
+void PopupDictionary::on_wordsCombo_activated(int index)
+{
+    if (index < 0)
+        return;
+    ui->dictionary->setSearchText(ui->wordsCombo->itemData(index).toString());
+}
+
+bool PopupDictionary::listTextWords(const QString &str)
+{
+    Dictionary *dict = ZKanji::dictionary(dictindex);
+
+    std::vector<TextSegment> segments;
+    dict->wordFormIndex().segment(str, segments);
+
+    ui->wordsCombo->clear();
+    for (int ix = 0, siz = segments.size(); ix != siz; ++ix)
+    {
+        const TextSegment &s = segments[ix];
+        // Only the first word found for each part of the text is listed. The rest are found
+        // by the dictionary search.
+        if (ix != 0 && segments[ix - 1].pos == s.pos)
+            continue;
+
+        QString text = str.mid(s.pos, s.len);
+        QString form = dict->wordEntry(s.windex)->kanji.toQString();
+        ui->wordsCombo->addItem(text == form ? text : QString("%1 (%2)").arg(text).arg(form), form);
+    }
+
+    // A single word is looked up in the search as before, so it can be changed by hand.
+    if (ui->wordsCombo->count() < 2)
+    {
+        ui->wordsCombo->clear();
+        return false;
+    }
+
+    ui->wordsCombo->show();
+    ui->wordsCombo->setCurrentIndex(0);
+    on_wordsCombo_activated(0);
+    return true;
+}
+
 void PopupDictionary::appStateChange(Qt::ApplicationState state)
 {
     if (!isVisible() || !Settings::popup.autohide || ui->pinButton->isChecked() || ignoreresize)
@@ -65,6 +65,8 @@ private slots:
     void on_pinButton_clicked(bool checked);
     void on_floatButton_clicked(bool checked);
     void on_dictionary_wordDoubleClicked(int windex, int dindex);
+    // Looks up the word selected from the words found in the pasted text.
+    void on_wordsCombo_activated(int index);
 
     void settingsChanged();
     void dictionaryRemoved(int index);
@@ -79,6 +81,9 @@ private:
     void resizeToFullWidth();
     // Changes the currently displayed dictionary.
     void setDictionary(int index);
+    // Fills the words combo box with the words found in str and looks up the first one.
+    // Returns false without showing the combo box if str holds less than two words.
+    bool listTextWords(const QString &str);
 
     static PopupDictionary *instance;
 
@@ -21,6 +21,7 @@
 #include "zkanjimain.h"
 #include "zstrings.h"
 #include "furigana.h"
+#include "kanji.h"
 
 #include "settingsform.h"
 #include "globalui.h"
@@ -81,7 +82,7 @@ void PrintTextBlock::setMaxWidth(int width)
         setlist.clear();
         w = 0;
         h = 0;
-        setFuriWord(word, f, fm, furif, furifm, lh, desc, furih, furidesc);
+        setFuriWord(word, fdat, f, fm, furif, furifm, lh, desc, furih, furidesc);
         //furitext = false;
     }
 }
@@ -92,7 +93,7 @@ void PrintTextBlock::setLineAttr(int lineheight, int descent)
     desc = descent;
 }
 
-void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent)
+void PrintTextBlock::setFuriWord(WordEntry *e, const std::vector<FuriganaData> &furidat, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent)
 {
 #ifdef _DEBUG
     if (!furitext || !lines.empty())
@@ -100,6 +101,7 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
 #endif
 
     word = e;
+    fdat = furidat;
     lh = lineheight;
     desc = descent;
     furih = furiheight;
@@ -125,8 +127,6 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
     {
         // Try to break up the word on furigana boundaries. Only the kanji of the data counts
         // as this is only for measuring.
-        std::vector<FuriganaData> fdat;
-        findFurigana(word->kanji, word->kana, fdat);
 
         int kanjisiz = word->kanji.size();
         int kanasiz = word->kana.size();
@@ -185,7 +185,7 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
     }
 }
 
-void PrintTextBlock::addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent)
+void PrintTextBlock::addFuriWord(WordEntry *e, const std::vector<FuriganaData> &furidat, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent)
 {
 #ifdef _DEBUG
     if (furitext)
@@ -193,6 +193,7 @@ void PrintTextBlock::addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
 #endif
 
     word = e;
+    fdat = furidat;
     frontword = tokens.empty();
     furih = furiheight;
     furidesc = furidescent;
@@ -399,9 +400,6 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
     bool addfurispace = word != nullptr && (!frontword || (list.size() > 1 && list[1].tokenpos == 0));
     int furiextra = (!addfurispace && word == nullptr) ? 0 : furih;
 
-    std::vector<FuriganaData> fdat;
-    
-
     if (!furitext)
     {
         p.setFont(setlist[0].f);
@@ -433,9 +431,6 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
             {
                 // Draw furigana above kanji.
 
-                if (fdat.empty())
-                    findFurigana(word->kanji, word->kana, fdat);
-
                 int left = 0;
                 int strpos = list[ix].pos == -1 ? 0 : list[ix].pos;
 
@@ -495,9 +490,6 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
 
 void PrintTextBlock::paintKanjiFuri(QPainter &p, int x, int y, bool rightalign)
 {
-    std::vector<FuriganaData> fdat;
-    findFurigana(word->kanji, word->kana, fdat);
-
     uint kanjisiz = word->kanji.size();
     uint kanasiz = word->kana.size();
 
@@ -654,7 +646,7 @@ void PrintTextBlock::paintFurigana(QPainter &p, int x, int y, int width, int pos
 //-------------------------------------------------------------
 
 
-PrintPreviewForm::PrintPreviewForm(QWidget *parent) : base(parent), ui(new Ui::PrintPreviewForm), printer(QPrinter::HighResolution), printing(false), pagecnt(0)
+PrintPreviewForm::PrintPreviewForm(QWidget *parent) : base(parent), ui(new Ui::PrintPreviewForm), printer(QPrinter::HighResolution), printing(false), pagecnt(0), layoutres(0)
 {
     ui->setupUi(this);
 
@@ -717,7 +709,7 @@ PrintPreviewForm::PrintPreviewForm(QWidget *parent) : base(parent), ui(new Ui::P
 
     connect(preview, &QPrintPreviewWidget::paintRequested, this, &PrintPreviewForm::paintPages);
     connect(preview->findChild<QAbstractScrollArea*>()->verticalScrollBar(), &QScrollBar::valueChanged, this, &PrintPreviewForm::pageScrolled);
-    connect(gUI, &GlobalUI::settingsChanged, preview, &QPrintPreviewWidget::updatePreview);
+    connect(gUI, &GlobalUI::settingsChanged, this, &PrintPreviewForm::settingsChanged);
     connect(gUI, &GlobalUI::dictionaryToBeRemoved, this, &PrintPreviewForm::dictionaryToBeRemoved);
 
     FormStates::restoreDialogMaximizedAndSize("PrintPreview", this, true);
@@ -917,13 +909,38 @@ void PrintPreviewForm::entryRemoved(int windex, int abcdeindex, int aiueoindex)
     if (wpos != -1)
     {
         list.erase(list.begin() + wpos);
+        if (!furigana.empty())
+            furigana.erase(furigana.begin() + wpos);
+        if (!layout.empty())
+            layout.erase(layout.begin() + wpos);
         preview->updatePreview();
     }
 }
 
 void PrintPreviewForm::entryChanged(int windex, bool studydef)
 {
-    if (std::find(list.begin(), list.end(), windex) != list.end())
+    bool found = false;
+    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
+    {
+        if (list[ix] != windex)
+            continue;
+        found = true;
+
+        // Only the changed word is measured again in the next layout.
+        if (!furigana.empty())
+        {
+            WordEntry *e = dict->wordEntry(windex);
+            furigana[ix].clear();
+            findFurigana(e->kanji, e->kana, furigana[ix]);
+        }
+        if (!layout.empty())
+        {
+            layout[ix].block.reset();
+            layout[ix].kblock.reset();
+        }
+    }
+
+    if (found)
         preview->updatePreview();
 }
 
@@ -941,13 +958,17 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
     // Printing the second page of a double page layout.
     bool secondpage = false;
 
-    // Saved line sizes for double page printing.
-    smartvector<PrintTextBlock> blocks;
+    // Blocks printed on the second page of a double page layout and their height.
+    std::vector<std::pair<PrintTextBlock*, int>> blocks;
 
     QRect pagerect = pr->pageRect();
 
     int pres = pr->resolution();
 
+    // Blocks measured for a different page or printer resolution can't be reused.
+    if (pres != layoutres || pagerect != layoutrect)
+        layout.clear();
+
     double sizes[] = { 0.16, 0.2, 0.24, 0.28, 0.32, 0.36, 0.4 };
     double linesize = sizes[(int)Settings::print.linesize] * pres;
     int h = std::ceil(linesize);
@@ -970,36 +991,53 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
     // Column currently printed in.
     int column = 0;
 
-    // Kana font.
-    QFont kf = QFont(Settings::printKanaFont(), pr);
-    // Font used for furigana.
-    QFont ff = QFont(Settings::printKanaFont(), pr);
-    // Definition font.
-    QFont df = QFont(Settings::printDefFont(), pr);
-    // Type font.
-    QFont tf = QFont(Settings::printInfoFont(), pr);
-
     // Page number font
     QFont pf = QFont(Settings::printDefFont(), pr);
 
     QPainter p;
     p.begin(pr);
 
-    // Determine the size of the fonts from the line size.
-    adjustFontSize(kf, linesize * 0.9, &p/*, QString(QChar(0x4e80))*/);
-    adjustFontSize(ff, linesize * 0.6, &p);
-    adjustFontSize(df, linesize, &p/*, QStringLiteral("mgMG")*/);
-    adjustFontSize(tf, linesize, &p);
     adjustFontSize(pf, m * 0.6, &p);
 
-    p.setFont(kf);
-    QFontMetrics kfm = p.fontMetrics();
-    p.setFont(ff);
-    QFontMetrics ffm = p.fontMetrics();
-    p.setFont(df);
-    QFontMetrics dfm = p.fontMetrics();
-    p.setFont(tf);
-    QFontMetrics tfm = p.fontMetrics();
+    if (layout.empty())
+    {
+        // Kana font.
+        kanjifont = QFont(Settings::printKanaFont(), pr);
+        // Font used for furigana.
+        furifont = QFont(Settings::printKanaFont(), pr);
+        // Definition font.
+        deffont = QFont(Settings::printDefFont(), pr);
+        // Type font.
+        typefont = QFont(Settings::printInfoFont(), pr);
+
+        // Determine the size of the fonts from the line size.
+        adjustFontSize(kanjifont, linesize * 0.9, &p/*, QString(QChar(0x4e80))*/);
+        adjustFontSize(furifont, linesize * 0.6, &p);
+        adjustFontSize(deffont, linesize, &p/*, QStringLiteral("mgMG")*/);
+        adjustFontSize(typefont, linesize, &p);
+
+        p.setFont(kanjifont);
+        kanjimetrics.reset(new QFontMetrics(p.fontMetrics()));
+        p.setFont(furifont);
+        furimetrics.reset(new QFontMetrics(p.fontMetrics()));
+        p.setFont(deffont);
+        defmetrics.reset(new QFontMetrics(p.fontMetrics()));
+        p.setFont(typefont);
+        typemetrics.reset(new QFontMetrics(p.fontMetrics()));
+
+        layout.resize(list.size());
+        layoutres = pres;
+        layoutrect = pr->pageRect();
+    }
+
+    QFont &kf = kanjifont;
+    QFont &ff = furifont;
+    QFont &df = deffont;
+    QFont &tf = typefont;
+    QFontMetrics &kfm = *kanjimetrics;
+    QFontMetrics &ffm = *furimetrics;
+    QFontMetrics &dfm = *defmetrics;
+    QFontMetrics &tfm = *typemetrics;
 
     WordEntry *e;
 
@@ -1033,7 +1071,7 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
         pr->newPage();
     }
 
-    std::unique_ptr<PrintTextBlock> block;
+    PrintTextBlock *block;
 
     // Whether to show furigana when the kanji is separately printed from the definition.
     bool blockfuri = (Settings::print.doublepage || Settings::print.separated) && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
@@ -1042,7 +1080,7 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
     bool inlinefuri = !blockfuri && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
 
     // Text block for the separate kanji/kana side. Only used for separate printing.
-    std::unique_ptr<PrintTextBlock> kblock;
+    PrintTextBlock *kblock;
 
     // Maximum width available for the kanji/kana text is around one third of the whole width
     // of the column. If it takes up less space, the rest will go to the definition. This
@@ -1050,6 +1088,9 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
     // of the width.
     int kmaxwidth = Settings::print.doublepage ? (colwidth - colspacing / 2) : std::ceil((colwidth - colspacing / 2) * 0.35);
 
+    if ((blockfuri || inlinefuri) && furigana.size() != list.size())
+        findListFurigana();
+
     while (wordpos != list.size())
     {
         e = dict->wordEntry(list[wordpos]);
@@ -1059,157 +1100,169 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
 
         if (!secondpage)
         {
-            block.reset(new PrintTextBlock(spacewidth, false));
-            kblock.reset(new PrintTextBlock(0, blockfuri));
-
-            // Measuring the space needed for the current word.
+            // Words are only measured when they have no blocks from a previous layout.
+            WordBlocks &wb = layout[wordpos];
+            bool measure = wb.block == nullptr;
+            if (measure)
+            {
+                wb.block.reset(new PrintTextBlock(spacewidth, false));
+                wb.kblock.reset(new PrintTextBlock(0, blockfuri));
+            }
+            block = wb.block.get();
+            kblock = wb.kblock.get();
 
-            if (Settings::print.doublepage || Settings::print.separated)
+            if (measure)
             {
-                // Separate printing of kanji and definition if it's in its own column or on a
-                // separate page.
 
-                kblock->setMaxWidth(kmaxwidth);
+                // Measuring the space needed for the current word.
 
-                // In case furigana is shown after the kanji, it must be included in the
-                // printed string. Otherwise use the kanji, and leave space for optional
-                // furigana above it.
-                if (blockfuri)
-                    kblock->setFuriWord(e, kf, kfm, ff, ffm, h, fdesc, furilinesize, furidesc);
-                else
+                if (Settings::print.doublepage || Settings::print.separated)
                 {
-                    kblock->setLineAttr(h, fdesc);
+                    // Separate printing of kanji and definition if it's in its own column or on a
+                    // separate page.
 
-                    if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
-                    {
-                        str = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
-                        QCharTokenizer ktok(str.constData(), str.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                        kblock->addText(ktok, kf, kfm);
-                    }
+                    kblock->setMaxWidth(kmaxwidth);
+
+                    // In case furigana is shown after the kanji, it must be included in the
+                    // printed string. Otherwise use the kanji, and leave space for optional
+                    // furigana above it.
+                    if (blockfuri)
+                        kblock->setFuriWord(e, furigana[wordpos], kf, kfm, ff, ffm, h, fdesc, furilinesize, furidesc);
                     else
                     {
-                        str = Settings::print.usekanji ? e->kanji.toQString() : e->kana.toQString();
-                        kblock->addText(str, kf, kfm);
+                        kblock->setLineAttr(h, fdesc);
+
+                        if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
+                        {
+                            str = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
+                            QCharTokenizer ktok(str.constData(), str.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+                            kblock->addText(ktok, kf, kfm);
+                        }
+                        else
+                        {
+                            str = Settings::print.usekanji ? e->kanji.toQString() : e->kana.toQString();
+                            kblock->addText(str, kf, kfm);
+                        }
                     }
                 }
-            }
 
-            // Definition and the rest of the word if it's printed on the same side.
+                // Definition and the rest of the word if it's printed on the same side.
 
-            // Width available for the definition side.
-            int maxwidth = colwidth - colspacing / 2;
-            if (!kblock->empty())
-                maxwidth -= colspacing + kblock->width();
+                // Width available for the definition side.
+                int maxwidth = colwidth - colspacing / 2;
+                if (!kblock->empty())
+                    maxwidth -= colspacing + kblock->width();
 
-            block->setMaxWidth(maxwidth);
-            block->setLineAttr(h, fdesc);
+                block->setMaxWidth(maxwidth);
+                block->setLineAttr(h, fdesc);
 
-            // Measure the kanji/kana + word types + definition in some order.
+                // Measure the kanji/kana + word types + definition in some order.
 
-            QString kanjistr;
+                QString kanjistr;
 
-            // Build the string for the kanji/kana part.
+                // Build the string for the kanji/kana part.
 
-            if (!Settings::print.separated && !Settings::print.doublepage)
-            {
-                if (inlinefuri)
-                {
-                    if (!Settings::print.reversed)
-                        block->addFuriWord(e, kf, kfm, ff, ffm, furilinesize, furidesc);
-                }
-                else if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
+                if (!Settings::print.separated && !Settings::print.doublepage)
                 {
-                    kanjistr = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
-
-                    if (!Settings::print.reversed)
+                    if (inlinefuri)
                     {
-                        // Kanji/kana when it comes before the definition.
-                        QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                        block->addText(ktok, kf, kfm);
+                        if (!Settings::print.reversed)
+                            block->addFuriWord(e, furigana[wordpos], kf, kfm, ff, ffm, furilinesize, furidesc);
                     }
-                }
-                else
-                {
-                    kanjistr = !Settings::print.usekanji ? e->kana.toQString() : e->kanji.toQString();
-                    if (!Settings::print.reversed)
-                        block->addText(kanjistr, kf, kfm);
-                }
-
-                if (!Settings::print.reversed)
-                    block->addText("-", kf, kfm);
-            }
-
-            // Definition has several parts:
-            // definition number, word type, definition text. If the word has a user defined
-            // definition, it's used together with all the word types specified for each
-            // definition.
-
-            const QCharString *sdef = Settings::print.userdefs ? dict->studyDefinition(list[wordpos]) : nullptr;
-            if (sdef != nullptr)
-            {
-                // There was a user given definition for the word.
-
-                if (Settings::print.showtype)
-                {
-                    QString str;
-                    for (int ix = 0; ix != e->defs.size(); ++ix)
+                    else if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
                     {
-                        str = Strings::wordTypesText(e->defs[ix].attrib.types);
-                        if (ix != e->defs.size() - 1)
-                            str += "; ";
+                        kanjistr = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
+
+                        if (!Settings::print.reversed)
+                        {
+                            // Kanji/kana when it comes before the definition.
+                            QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+                            block->addText(ktok, kf, kfm);
+                        }
                     }
-                    QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
-                    block->addText(pttok, tf, tfm);
+                    else
+                    {
+                        kanjistr = !Settings::print.usekanji ? e->kana.toQString() : e->kanji.toQString();
+                        if (!Settings::print.reversed)
+                            block->addText(kanjistr, kf, kfm);
+                    }
+
+                    if (!Settings::print.reversed)
+                        block->addText("-", kf, kfm);
                 }
 
-                str = sdef->toQStringRaw();
-                QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
+                // Definition has several parts:
+                // definition number, word type, definition text. If the word has a user defined
+                // definition, it's used together with all the word types specified for each
+                // definition.
 
-                block->addText(stok, df, dfm);
-            }
-            else
-            {
-                // No user definition. Use the word from the dictionary.
-                // Print each definition separately.
-                for (int ix = 0; ix != e->defs.size(); ++ix)
+                const QCharString *sdef = Settings::print.userdefs ? dict->studyDefinition(list[wordpos]) : nullptr;
+                if (sdef != nullptr)
                 {
-                    if (e->defs.size() != 1)
-                        block->addText(QStringLiteral("%1.").arg(ix + 1), df, dfm);
+                    // There was a user given definition for the word.
 
                     if (Settings::print.showtype)
                     {
-                        QString str = Strings::wordTypesText(e->defs[ix].attrib.types);
-
+                        QString str;
+                        for (int ix = 0; ix != e->defs.size(); ++ix)
+                        {
+                            str = Strings::wordTypesText(e->defs[ix].attrib.types);
+                            if (ix != e->defs.size() - 1)
+                                str += "; ";
+                        }
                         QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
                         block->addText(pttok, tf, tfm);
                     }
 
-                    str = e->defs[ix].def.toQStringRaw();
-
+                    str = sdef->toQStringRaw();
                     QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
+
                     block->addText(stok, df, dfm);
                 }
-            }
+                else
+                {
+                    // No user definition. Use the word from the dictionary.
+                    // Print each definition separately.
+                    for (int ix = 0; ix != e->defs.size(); ++ix)
+                    {
+                        if (e->defs.size() != 1)
+                            block->addText(QStringLiteral("%1.").arg(ix + 1), df, dfm);
 
-            if (!Settings::print.doublepage && Settings::print.reversed && !Settings::print.separated)
-            {
-                // Kanji/kana when printed after the definition.
+                        if (Settings::print.showtype)
+                        {
+                            QString str = Strings::wordTypesText(e->defs[ix].attrib.types);
 
-                block->addText("-", kf, kfm);
+                            QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
+                            block->addText(pttok, tf, tfm);
+                        }
 
-                if (inlinefuri)
-                    block->addFuriWord(e, kf, kfm, ff, ffm, furilinesize, furidesc);
-                else
+                        str = e->defs[ix].def.toQStringRaw();
+
+                        QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
+                        block->addText(stok, df, dfm);
+                    }
+                }
+
+                if (!Settings::print.doublepage && Settings::print.reversed && !Settings::print.separated)
                 {
-                    QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                    block->addText(ktok, kf, kfm);
+                    // Kanji/kana when printed after the definition.
+
+                    block->addText("-", kf, kfm);
+
+                    if (inlinefuri)
+                        block->addFuriWord(e, furigana[wordpos], kf, kfm, ff, ffm, furilinesize, furidesc);
+                    else
+                    {
+                        QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+                        block->addText(ktok, kf, kfm);
+                    }
                 }
-            }
 
-            // Update the available width of the separate kanji text after the
-            // definition has been completed.
-            if (!Settings::print.doublepage && Settings::print.separated)
-                kblock->setMaxWidth(colwidth - colspacing / 2 - colspacing - block->width());
+                // Update the available width of the separate kanji text after the
+                // definition has been completed.
+                if (!Settings::print.doublepage && Settings::print.separated)
+                    kblock->setMaxWidth(colwidth - colspacing / 2 - colspacing - block->width());
+            }
 
             // Print after measurments are done.
 
@@ -1270,10 +1323,7 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
                 if (!Settings::print.doublepage)
                     block->paint(p, left + colwidth - block->width() - colspacing / 2, top + blockskip, true);
                 else
-                {
-                    block->setHeight(blockh);
-                    blocks.push_back(block.release());
-                }
+                    blocks.push_back(std::make_pair(block, blockh));
             }
             else
             {
@@ -1283,10 +1333,7 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
                 if (!Settings::print.doublepage)
                     kblock->paint(p, left + colwidth - kblock->width() - colspacing / 2, top, true);
                 else
-                {
-                    kblock->setHeight(blockh);
-                    blocks.push_back(kblock.release());
-                }
+                    blocks.push_back(std::make_pair(kblock, blockh));
             }
 
             top += linespacing + blockh;
@@ -1316,10 +1363,10 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
             // Second page.
             for (int ix = 0; ix != blocks.size(); ++ix, ++wordpos)
             {
-                PrintTextBlock *bl = blocks[ix];
-                int blockh = bl->height();
+                PrintTextBlock *bl = blocks[ix].first;
+                int blockh = blocks[ix].second;
 
-                if (top != basetop && top + bl->height() /*+ linespacing*/ > pagebottom)
+                if (top != basetop && top + blockh /*+ linespacing*/ > pagebottom)
                 {
                     top = basetop;
                     left += colwidth + colspacing;
@@ -1333,7 +1380,7 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
                 }
 
                 bl->paint(p, left, top);
-                top += linespacing + bl->height();
+                top += linespacing + blockh;
             }
 
             column = 0;
@@ -1370,6 +1417,12 @@ void PrintPreviewForm::paintPages(QPrinter *pr)
     ui->pageLabel->setText(QStringLiteral("/ %1").arg(pagecnt));
 }
 
+void PrintPreviewForm::settingsChanged()
+{
+    layout.clear();
+    preview->updatePreview();
+}
+
 void PrintPreviewForm::dictionaryToBeRemoved(int index, int orderindex, Dictionary *d)
 {
     if (d == dict)
@@ -1417,4 +1470,24 @@ bool PrintPreviewForm::savePrinterSettings()
     return changed;
 }
 
+void PrintPreviewForm::findListFurigana()
+{
+    int siz = list.size();
+    furigana.clear();
+    furigana.resize(siz);
+
+    // Finding the furigana only reads the kanji data, so the words are split into ranges
+    // handled on the thread pool. The kanji are looked up by character in a mapping that
+    // must be complete before it's read from the threads.
+    ZKanji::mapKanjiIndexes();
+
+    ParallelRanges::run(siz, 500, [this](int, int first, int last) {
+        for (int pos = first; pos != last; ++pos)
+        {
+            WordEntry *e = dict->wordEntry(list[pos]);
+            findFurigana(e->kanji, e->kana, furigana[pos]);
+        }
+    });
+}
+
 //-------------------------------------------------------------
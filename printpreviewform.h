@@ -12,7 +12,9 @@
 #include <QPrinter>
 #include <QFont>
 #include <QPrintPreviewWidget>
+#include <memory>
 #include "dialogwindow.h"
+#include "furigana.h"
 
 namespace Ui {
     class PrintPreviewForm;
@@ -39,9 +41,11 @@ public:
     // Should be called once before adding anything to the block.
     void setLineAttr(int lineheight, int descent);
 
-    void setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent);
+    // Sets the word printed with furigana above its kanji. The furigana data of the word, as
+    // found by findFurigana(), is passed in fdat.
+    void setFuriWord(WordEntry *e, const std::vector<FuriganaData> &fdat, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent);
 
-    void addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent);
+    void addFuriWord(WordEntry *e, const std::vector<FuriganaData> &fdat, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent);
 
     void addText(QCharTokenizer &tok, QFont &f, QFontMetrics &fm);
     void addText(const QString &str, QFont &f, QFontMetrics &fm);
@@ -127,6 +131,9 @@ private:
     // Word used for furigana printing.
     WordEntry *word;
 
+    // Furigana data of word.
+    std::vector<FuriganaData> fdat;
+
     // The word entry is printed at the front (or back) of the block in a flowing text.
     bool frontword;
 
@@ -187,12 +194,25 @@ protected slots:
 
     void paintPages(QPrinter *p);
 
+    void settingsChanged();
+
     void dictionaryToBeRemoved(int index, int orderindex, Dictionary *dict);
 private:
     // Saves the current printer settings in Settings::print. Returns true if anything was
     // changed.
     bool savePrinterSettings();
 
+    // Fills the furigana data of every word in list, splitting the work between threads.
+    void findListFurigana();
+
+    // Measured text blocks of a word, kept between calls to paintPages(). When the
+    // definition and kanji are printed separately, the kanji is in kblock.
+    struct WordBlocks
+    {
+        std::unique_ptr<PrintTextBlock> block;
+        std::unique_ptr<PrintTextBlock> kblock;
+    };
+
     Ui::PrintPreviewForm *ui;
 
     QPrinter printer;
@@ -210,6 +230,26 @@ private:
     // Number of pages.
     int pagecnt;
 
+    // Furigana data of each word in list. Empty until first needed for printing.
+    std::vector<std::vector<FuriganaData>> furigana;
+
+    // Text blocks of each word in list, measured at layoutres resolution in a page of
+    // layoutrect. Words without measured blocks have null blocks. Empty when every word must
+    // be measured again.
+    std::vector<WordBlocks> layout;
+    int layoutres;
+    QRect layoutrect;
+
+    // Fonts and their metrics referenced by the blocks in layout.
+    QFont kanjifont;
+    QFont furifont;
+    QFont deffont;
+    QFont typefont;
+    std::unique_ptr<QFontMetrics> kanjimetrics;
+    std::unique_ptr<QFontMetrics> furimetrics;
+    std::unique_ptr<QFontMetrics> defmetrics;
+    std::unique_ptr<QFontMetrics> typemetrics;
+
     typedef DialogWindow    base;
 };
 
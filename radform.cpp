@@ -164,6 +164,11 @@ std::vector<ushort> RadicalForm::selectionToFilter()
     return ui->radicalGrid->selectionToFilter();
 }
 
+void RadicalForm::selectionKanji(std::vector<ushort> &result) const
+{
+    ui->radicalGrid->selectionKanji(result);
+}
+
 RadicalForm::Results RadicalForm::result()
 {
     return btnresult;
@@ -49,6 +49,9 @@ public:
     // Calls the function with the same name in the radicals grid.
     // Not valid when handling the destroyed event.
     std::vector<ushort> selectionToFilter();
+    // Calls the function with the same name in the radicals grid.
+    // Not valid when handling the destroyed event.
+    void selectionKanji(std::vector<ushort> &result) const;
 
     // Which button was used to close the dialog. Only returns Ok when
     // the Ok button was pressed.
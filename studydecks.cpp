@@ -8,6 +8,8 @@
 #include <QMessageBox>
 #include <QTimeZone>
 #include <QSet>
+#include <limits>
+#include <functional>
 #include "studydecks.h"
 #include "zkanjimain.h"
 #include "zui.h"
@@ -23,6 +25,10 @@ namespace
 
     const quint32 s_1_day = 24 * 60 * 60;
     const quint32 s_1_month = s_1_day * 30.5;
+
+    // Placed in StudyDeck's order in place of the slot of deleted cards until the list is
+    // compacted.
+    const quint32 deletedSlot = std::numeric_limits<quint32>::max();
 }
 
 //-------------------------------------------------------------
@@ -76,7 +82,7 @@ QDataStream& operator>>(QDataStream &stream, StudyCardStat &stat)
 //    return data != -1;
 //}
 
-CardId::CardId(int data) : data(data)
+CardId::CardId(quint32 data) : data(data)
 {
     ;
 }
@@ -116,65 +122,6 @@ CardId::CardId(int data) : data(data)
 //-------------------------------------------------------------
 
 
-QDataStream& operator<<(QDataStream& stream, const StudyCard &c)
-{
-    stream << make_zvec<qint32, StudyCardStat>(c.stats);
-    stream << make_zdate(c.testdate);
-    stream << make_zdate(c.itemdate);
-    stream.writeRawData((const char*)c.answers, 4);
-    stream << (quint8)c.level;
-    stream << c.multiplier;
-    //stream << (quint16)c.inclusion;
-    stream << (quint32)c.spacing;
-    //stream << (quint16)c.answercnt;
-    //stream << (quint16)c.wrongcnt;
-    //stream << (qint8)c.problematic;
-    stream << (quint8)c.repeats;
-    stream << (quint8)c.testlevel;
-    stream << (quint32)c.timespent;
-
-    //stream << *c.id.get();
-
-    return stream;
-}
-
-QDataStream& operator>>(QDataStream& stream, StudyCard &c)
-{
-    quint8 b;
-    qint8 ch;
-    quint16 s;
-    quint32 ui;
-
-    stream >> make_zvec<qint32, StudyCardStat>(c.stats);
-    stream >> make_zdate(c.testdate);
-    stream >> make_zdate(c.itemdate);
-    stream.readRawData((char*)c.answers, 4);
-
-    stream >> b;
-    c.level = b;
-    stream >> c.multiplier;
-    //c.level = b;
-    //stream >> s;
-    //c.inclusion = s;
-    stream >> ui;
-    c.spacing = ui;
-    c.nexttestdate = QDateTime();
-    //stream >> s;
-    //c.answercnt = s;
-    //stream >> s;
-    //c.wrongcnt = s;
-    //stream >> ch;
-    //c.problematic = ch;
-    stream >> b;
-    c.repeats = b;
-    stream >> b;
-    c.testlevel = b;
-    stream >> ui;
-    c.timespent = ui;
-
-    return stream;
-}
-
 QDataStream& operator<<(QDataStream &stream, const DeckTimeStatItem &i)
 {
     stream << (quint8)i.used;
@@ -246,20 +193,44 @@ void DeckTimeStatList::save(QDataStream &stream) const
 
 void DeckTimeStatList::createUndo(uchar level)
 {
-    undocount = items.size();
-    if (items.size() > level)
-        undostat = items[level];
+    undo.level = level;
+    undo.itemcount = items.size();
+    undo.timeadded = false;
+    undo.repeatadded = false;
 }
 
-void DeckTimeStatList::revertUndo(uchar level)
+void DeckTimeStatList::revertUndo()
 {
-    if (level >= undocount)
-        items.resize(undocount);
-    else
-        items[level] = undostat;
-    //DeckTimeStat &stat = items[level];
-    //memmove(stat.repeat, stat.repeat + 1, sizeof(uchar) * 100);
-    //--stat.used;
+    // The changes are reverted in the opposite order they were made.
+
+    if (undo.level >= undo.itemcount)
+    {
+        items.resize(undo.itemcount);
+        return;
+    }
+
+    DeckTimeStat &stat = items[undo.level];
+
+    if (undo.repeatadded)
+    {
+        memmove(stat.repeat, stat.repeat + 1, sizeof(uchar) * 99);
+        stat.repeat[99] = undo.lastrepeat;
+        stat.used = undo.repeatused;
+    }
+
+    if (!undo.timeadded)
+        return;
+
+    if (undo.repeats >= undo.timecount)
+    {
+        stat.timestats.resize(undo.timecount);
+        return;
+    }
+
+    DeckTimeStatItem &tstat = stat.timestats[undo.repeats];
+    memmove(tstat.time, tstat.time + 1, sizeof(quint32) * 254);
+    tstat.time[254] = undo.lasttime;
+    tstat.used = undo.timeused;
 }
 
 void DeckTimeStatList::addTime(uchar level, uchar repeats, quint32 time)
@@ -274,6 +245,11 @@ void DeckTimeStatList::addTime(uchar level, uchar repeats, quint32 time)
     DeckTimeStat &stat = items[level];
 
     repeats = std::min<uchar>(254, repeats);
+
+    undo.timeadded = true;
+    undo.repeats = repeats;
+    undo.timecount = stat.timestats.size();
+
     if (stat.timestats.size() <= repeats)
     {
         int s = stat.timestats.size();
@@ -283,6 +259,8 @@ void DeckTimeStatList::addTime(uchar level, uchar repeats, quint32 time)
     }
 
     DeckTimeStatItem &tstat = stat.timestats[repeats];
+    undo.lasttime = tstat.time[254];
+    undo.timeused = tstat.used;
     memmove(tstat.time + 1, tstat.time, sizeof(quint32) * 254);
     tstat.time[0] = time;
     tstat.used = std::min(tstat.used + 1, 255);
@@ -296,11 +274,69 @@ void DeckTimeStatList::addRepeat(uchar level, uchar repeats)
 #endif
 
     DeckTimeStat &stat = items[level];
+    undo.repeatadded = true;
+    undo.lastrepeat = stat.repeat[99];
+    undo.repeatused = stat.used;
     memmove(stat.repeat + 1, stat.repeat, sizeof(uchar) * 99);
     stat.repeat[0] = std::min<uchar>(254, repeats);
     stat.used = std::min(stat.used + 1, 100);
 }
 
+void DeckTimeStatList::saveChange(QDataStream &stream) const
+{
+#ifdef _DEBUG
+    if (!undo.timeadded || items.size() <= undo.level)
+        throw "No time was added since createUndo().";
+#endif
+
+    const DeckTimeStat &stat = items[undo.level];
+    stream << (quint8)undo.level;
+
+    // The repeat values are always written, as changing the last answer can revert an added
+    // repeat without adding a new one.
+    stream << (quint8)stat.used;
+    for (int ix = 0; ix != stat.used; ++ix)
+        stream << (quint8)stat.repeat[ix];
+
+    stream << (quint8)undo.repeats;
+    stream << stat.timestats[undo.repeats];
+}
+
+void DeckTimeStatList::loadChange(QDataStream &stream)
+{
+    quint8 level;
+    stream >> level;
+
+    if (items.size() <= level)
+    {
+        int s = items.size();
+        items.resize(level + 1);
+        for (int ix = s; ix != level + 1; ++ix)
+            items[ix].used = 0;
+    }
+    DeckTimeStat &stat = items[level];
+
+    quint8 b;
+    stream >> b;
+    stat.used = std::min<int>(b, 100);
+    for (int ix = 0; ix != stat.used; ++ix)
+    {
+        stream >> b;
+        stat.repeat[ix] = b;
+    }
+
+    quint8 repeats;
+    stream >> repeats;
+    if (stat.timestats.size() <= repeats)
+    {
+        int s = stat.timestats.size();
+        stat.timestats.resize(repeats + 1);
+        for (int ix = s; ix != repeats + 1; ++ix)
+            stat.timestats[ix].used = 0;
+    }
+    stream >> stat.timestats[repeats];
+}
+
 quint32 DeckTimeStatList::estimate(uchar level, uchar repeats) const
 {
     if (items.size() <= level || items[level].used < 10)
@@ -393,6 +429,55 @@ quint32 DeckTimeStatList::estimate(uchar level, uchar repeats) const
 
 }
 
+quint32 DeckTimeStatList::tryEstimate(uchar level, uchar repeats) const
+{
+    if (items.size() <= level || items[level].used < 10)
+    {
+        if (level > 0)
+            return tryEstimate(level - 1, repeats) * 0.9;
+
+        // Guess 1 minute for the 0th repeat and 30 seconds for the rest when there's not
+        // enough data, like in estimate().
+        quint32 guess = repeats == 0 ? 60 * 10 : 30 * 10;
+        if (items.empty() || items[0].timestats.size() <= repeats)
+            return guess;
+
+        qint64 avg = _estimate(0, repeats);
+        for (int ix = items[0].timestats[repeats].used; ix < 10; ++ix)
+            avg -= (avg - guess) / (ix + 1);
+        return std::max<qint64>(0, avg);
+    }
+
+    const DeckTimeStat &stat = items[level];
+    if (stat.timestats.empty())
+        return repeats == 0 ? 60 * 10 : 30 * 10;
+    if (stat.timestats.size() <= repeats)
+        return _estimate(level, stat.timestats.size() - 1) * 0.8;
+
+    qint64 avg = _estimate(level, repeats);
+    const DeckTimeStatItem &tstat = stat.timestats[repeats];
+    if (tstat.used < 10 && repeats != 0)
+    {
+        quint32 prevestimate = tryEstimate(level, repeats - 1);
+        for (int ix = tstat.used; ix != 10; ++ix)
+            avg -= (avg - prevestimate) / (ix + 1);
+    }
+
+    return std::max<qint64>(0, avg);
+}
+
+int DeckTimeStatList::repeatCount(uchar level) const
+{
+    if (items.size() <= level)
+        return 0;
+    return items[level].used;
+}
+
+uchar DeckTimeStatList::repeatValue(uchar level, int index) const
+{
+    return items[level].repeat[index];
+}
+
 quint32 DeckTimeStatList::_estimate(uchar level, uchar repeats) const
 {
     const DeckTimeStat &stat = items[level];
@@ -459,7 +544,7 @@ QDataStream& operator>>(QDataStream &stream, DeckDayStat &s)
 //-------------------------------------------------------------
 
 
-DeckDayStatList::DeckDayStatList()
+DeckDayStatList::DeckDayStatList() : sumsvalid(0)
 {
     ;
 }
@@ -467,6 +552,7 @@ DeckDayStatList::DeckDayStatList()
 void DeckDayStatList::load(QDataStream &stream)
 {
     stream >> make_zvec<qint32, DeckDayStat>(list);
+    invalidateSums(0);
 }
 
 void DeckDayStatList::save(QDataStream &stream) const
@@ -481,6 +567,7 @@ void DeckDayStatList::fixStats(const std::vector<std::tuple<StudyCard*, int, boo
 
     std::vector<DeckDayStat> tmp;
     std::swap(tmp, list);
+    invalidateSums(0);
 
     QSet<StudyCard*> added;
     int statpos = 0;
@@ -556,6 +643,7 @@ bool DeckDayStatList::empty() const
 
 DeckDayStat& DeckDayStatList::back()
 {
+    invalidateSums(list.size() - 1);
     return list.back();
 }
 
@@ -576,12 +664,14 @@ const DeckDayStat& DeckDayStatList::items(int index) const
 
 DeckDayStat& DeckDayStatList::items(int index)
 {
+    invalidateSums(index);
     return list[index];
 }
 
 void DeckDayStatList::clear()
 {
     list.clear();
+    invalidateSums(0);
 }
 
 void DeckDayStatList::createUndo(QDate testdate)
@@ -597,12 +687,31 @@ void DeckDayStatList::revertUndo()
         throw "Undo data not saved.";
 #endif
     list.back() = undo;
+    invalidateSums(list.size() - 1);
+}
+
+void DeckDayStatList::saveChange(QDataStream &stream) const
+{
+    stream << list.back();
+}
+
+void DeckDayStatList::loadChange(QDataStream &stream)
+{
+    DeckDayStat stat;
+    stream >> stat;
+
+    if (!list.empty() && list.back().day == stat.day)
+        list.back() = stat;
+    else
+        list.push_back(stat);
+    invalidateSums(list.size() - 1);
 }
 
 void DeckDayStatList::newCard(QDate testdate, bool newgroup)
 {
     addDay(testdate);
     DeckDayStat &stat = list.back();
+    invalidateSums(list.size() - 1);
     ++stat.itemcount;
     if (newgroup)
         ++stat.groupcount;
@@ -613,6 +722,7 @@ void DeckDayStatList::cardDeleted(QDate testdate, bool grouplast, bool learned)
     //if (list.empty() || list.back().day < testdate)
     addDay(testdate);
     DeckDayStat &stat = list.back();
+    invalidateSums(list.size() - 1);
     --stat.itemcount;
     if (grouplast)
         --stat.groupcount;
@@ -625,6 +735,7 @@ void DeckDayStatList::cardTested(QDate testdate, int timespent, bool wrong, bool
     addDay(testdate);
 
     DeckDayStat &stat = list.back();
+    invalidateSums(list.size() - 1);
     stat.timespent += timespent;
     ++stat.testcount;
     if (newcard)
@@ -645,6 +756,65 @@ void DeckDayStatList::groupsMerged()
     if (list.empty())
         return;
     --list.back().groupcount;
+    invalidateSums(list.size() - 1);
+}
+
+DeckDayStatSum DeckDayStatList::sum(int first, int last) const
+{
+    updateSums();
+
+    const DeckDayStatSum &a = sums[first];
+    const DeckDayStatSum &b = sums[last];
+
+    DeckDayStatSum r;
+    r.days = b.days - a.days;
+    r.testdays = b.testdays - a.testdays;
+    r.timeddays = b.timeddays - a.timeddays;
+    r.timespent = b.timespent - a.timespent;
+    r.testcount = b.testcount - a.testcount;
+    r.testednew = b.testednew - a.testednew;
+    r.testwrong = b.testwrong - a.testwrong;
+    r.testlearned = b.testlearned - a.testlearned;
+    r.timedtestcount = b.timedtestcount - a.timedtestcount;
+    return r;
+}
+
+DeckDayStatSum DeckDayStatList::total() const
+{
+    return sum(0, list.size());
+}
+
+void DeckDayStatList::invalidateSums(int index)
+{
+    sumsvalid = std::min(sumsvalid, index + 1);
+}
+
+void DeckDayStatList::updateSums() const
+{
+    sums.resize(list.size() + 1);
+    if (sumsvalid == 0)
+    {
+        sums[0] = DeckDayStatSum();
+        sumsvalid = 1;
+    }
+
+    for (int ix = sumsvalid, siz = sums.size(); ix != siz; ++ix)
+    {
+        const DeckDayStatSum &prev = sums[ix - 1];
+        const DeckDayStat &stat = list[ix - 1];
+        DeckDayStatSum &s = sums[ix];
+
+        s.days = prev.days + 1;
+        s.testdays = prev.testdays + (stat.testcount != 0 ? 1 : 0);
+        s.timeddays = prev.timeddays + (stat.timespent != 0 ? 1 : 0);
+        s.timespent = prev.timespent + stat.timespent;
+        s.testcount = prev.testcount + stat.testcount;
+        s.testednew = prev.testednew + stat.testednew;
+        s.testwrong = prev.testwrong + stat.testwrong;
+        s.testlearned = prev.testlearned + stat.testlearned;
+        s.timedtestcount = prev.timedtestcount + (stat.timespent != 0 ? stat.testcount : 0);
+    }
+    sumsvalid = sums.size();
 }
 
 void DeckDayStatList::addDay(QDate testdate)
@@ -657,6 +827,8 @@ void DeckDayStatList::addDay(QDate testdate)
     if (!list.empty() && list.back().day == testdate)
         return;
 
+    invalidateSums(list.size());
+
     DeckDayStat stat;
     stat.day = testdate;
     stat.timespent = 0;
@@ -761,54 +933,71 @@ size_t StudyDeckIdHash::operator()(const StudyDeckId &id) const
 //-------------------------------------------------------------
 
 
-StudyDeck::StudyDeck(StudyDeckList *owner, StudyDeckId id) : owner(owner), id(id)
+StudyDeck::StudyDeck(StudyDeckList *owner, StudyDeckId id) : owner(owner), id(id), ordergaps(0)
 {
-
+    undodata.slot = -1;
 }
 
 StudyDeck::~StudyDeck()
 {
-    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
+    compactOrder();
+    for (quint32 slot : order)
     {
-        StudyCard *card = list[ix];
-        if (card->level >= 3)
-            ZKanji::profile().removeMultiplier(card->multiplier);
-        
+        if (levels[slot] >= 3)
+            ZKanji::profile().removeMultiplier(cards[slot].multiplier);
     }
 }
 
-void StudyDeck::load(QDataStream &stream)
+void StudyDeck::load(QDataStream &stream, int version)
 {
     //stream >> id;
     stream >> make_zdate(testdate);
 
+    history.clear();
+
     qint32 i;
     stream >> i;
-    list.reserve(i);
+    cards.resize(i);
+    resizeColumns();
+    order.reserve(i);
     ids.reserve(i);
     for (int ix = 0; ix != i; ++ix)
     {
-        list.push_back(new StudyCard);
-        list.back()->index = ix;// .reset(new CardId(ix));
-        stream >> *list.back();
+        StudyCard &c = cards[ix];
+        c.index = ix;
+        if (version < 3)
+        {
+            stream >> make_zvec<qint32, StudyCardStat>(c.stats);
+            inclusions[ix] = c.stats.size();
+        }
+        loadCard(stream, ix);
+        order.push_back(ix);
         ids.push_back(new CardId(ix));
     }
 
     timestats.load(stream);
-    daystats.load(stream);
+    if (version < 3)
+        daystats.load(stream);
 
-    for (StudyCard *c : list)
+    for (StudyCard &c : cards)
     {
         qint32 idindex;
         stream >> idindex;
 
-        if (c->index /*->data*/ == idindex)
-            c->next = c;
-        else
-            c->next = list[idindex];
+        c.next = &cards[idindex];
     }
 
     stream >> make_zvec<qint32, qint32>(testcards);
+
+    if (version < 3)
+        return;
+
+    // The card stats and day statistics are only read into memory when they are first
+    // needed. See loadHistory().
+    stream >> i;
+    history.resize(i);
+    if (stream.readRawData(history.data(), i) != i)
+        throw ZException("Unexpected end of user data.");
 }
 
 void StudyDeck::save(QDataStream &stream) const
@@ -816,70 +1005,132 @@ void StudyDeck::save(QDataStream &stream) const
     //stream << id;
     stream << make_zdate(testdate);
 
-    stream << (qint32)list.size();
-    for (auto *sc : list)
-        stream << *sc;
+    compactOrder();
+    stream << (qint32)order.size();
+    for (quint32 slot : order)
+        saveCard(stream, slot);
 
     timestats.save(stream);
-    daystats.save(stream);
 
-    for (const StudyCard *c : list)
-        stream << (qint32)c->next->index /*->data*/;
+    for (quint32 slot : order)
+        stream << (qint32)cards[slot].next->index;
+
+    // The tested cards are saved by their index instead of their slot.
+    std::vector<int> tested;
+    tested.reserve(testcards.size());
+    for (int slot : testcards)
+        tested.push_back(cards[slot].index);
+    stream << make_zvec<qint32, qint32>(tested);
+
+    // The history not loaded since the deck was read is written back unchanged.
+    if (!history.isEmpty())
+    {
+        stream << (qint32)history.size();
+        stream.writeRawData(history.constData(), history.size());
+        return;
+    }
 
-    stream << make_zvec<qint32, qint32>(testcards);
+    QByteArray data;
+    QDataStream hstream(&data, QIODevice::WriteOnly);
+    hstream.setVersion(stream.version());
+    hstream.setByteOrder(stream.byteOrder());
+
+    for (quint32 slot : order)
+        hstream << make_zvec<qint32, StudyCardStat>(cards[slot].stats);
+    daystats.save(hstream);
+
+    stream << (qint32)data.size();
+    stream.writeRawData(data.constData(), data.size());
+}
+
+void StudyDeck::loadHistory() const
+{
+    if (history.isEmpty())
+        return;
+
+    StudyDeck *self = const_cast<StudyDeck*>(this);
+    compactOrder();
+
+    QDataStream stream(history);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    for (quint32 slot : self->order)
+    {
+        stream >> make_zvec<qint32, StudyCardStat>(self->cards[slot].stats);
+        self->inclusions[slot] = self->cards[slot].stats.size();
+    }
+    self->daystats.load(stream);
+
+    history.clear();
 }
 
 void StudyDeck::copy(StudyDeck *src, std::map<CardId*, CardId*> &map)
 {
     testdate = src->testdate;
-    testcards = src->testcards;
     timestats = src->timestats;
     daystats = src->daystats;
+    // The card stats are copied with the cards when the history is loaded, otherwise they
+    // are part of it.
+    history = src->history;
 
-    list.clear();
-    ids.clear();
-
-    list.reserve(src->list.size());
-    ids.reserve(src->ids.size());
+    src->compactOrder();
 
-    for (int ix = 0, siz = src->ids.size(); ix != siz; ++ix)
+    cards.clear();
+    freeslots.clear();
+    order.clear();
+    ordergaps = 0;
+    ids.clear();
+    levels.clear();
+    spacings.clear();
+    nexttests.clear();
+    tries.clear();
+    inclusions.clear();
+
+    // The cards are copied without free slots, placing each card in the slot matching its
+    // index.
+    int siz = src->order.size();
+    cards.resize(siz);
+    resizeColumns();
+    order.reserve(siz);
+    ids.reserve(siz);
+
+    for (int ix = 0; ix != siz; ++ix)
     {
         CardId *id = new CardId(ix);
         ids.push_back(id);
-        map.insert(std::make_pair(src->ids[ix], id));
+        order.push_back(ix);
+        map.insert(std::make_pair(src->ids[src->order[ix]], id));
+
+        quint32 srcslot = src->order[ix];
+        StudyCard &c = cards[ix];
+        c = src->cards[srcslot];
+        c.data = 0;
+        levels[ix] = src->levels[srcslot];
+        spacings[ix] = src->spacings[srcslot];
+        nexttests[ix] = src->nexttests[srcslot];
+        tries[ix] = src->tries[srcslot];
+        inclusions[ix] = src->inclusions[srcslot];
+        c.next = c.next == nullptr ? nullptr : &cards[c.next->index];
     }
 
-    for (int ix = 0, siz = src->list.size(); ix != siz; ++ix)
-    {
-        StudyCard *c = new StudyCard;
-        StudyCard *csrc = src->list[ix];
-        *c = *csrc;
-        c->data = 0;
-        c->next = nullptr;
-
-        list.push_back(c);
-    }
-
-    for (int ix = 0, siz = src->list.size(); ix != siz; ++ix)
-    {
-        StudyCard *c = list[ix];
-        StudyCard *csrc = src->list[ix];
-
-        if (csrc->next != nullptr)
-        {
-            if (csrc->next == csrc)
-                c->next = c;
-            else
-                c->next = list[csrc->next->index];
-        }
-    }
+    testcards.clear();
+    testcards.reserve(src->testcards.size());
+    for (int slot : src->testcards)
+        testcards.push_back(src->cards[slot].index);
 }
 
 const DeckDayStatList& StudyDeck::dayStats() const
 {
+    loadHistory();
     return daystats;
 }
 
+const DeckTimeStatList& StudyDeck::timeStats() const
+{
+    return timestats;
+}
+
 //void StudyDeck::fixDayStats()
 //{
 //    if (daystats.empty() || daystats.back().itemcount == list.size())
@@ -898,7 +1149,9 @@ const DeckDayStatList& StudyDeck::dayStats() const
 
 void StudyDeck::fixDayStats()
 {
-    if (list.empty())
+    loadHistory();
+    compactOrder();
+    if (order.empty())
     {
         daystats.clear();
         return;
@@ -911,9 +1164,9 @@ void StudyDeck::fixDayStats()
     // [ card, card stat index, answer was correct]
     std::vector<std::tuple<StudyCard*, int, bool>> tmp;
     //std::map<StudyCard*, int> incl;
-    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
+    for (int ix = 0, siz = order.size(); ix != siz; ++ix)
     {
-        StudyCard *c = list[ix];
+        StudyCard *c = &cards[order[ix]];
 
         //c->answercnt = 0;
         //c->wrongcnt = 0;
@@ -943,12 +1196,12 @@ void StudyDeck::fixDayStats()
         {
             auto pit = std::prev(it);
             if (std::get<0>(*pit)->stats[std::get<1>(*pit)].day == cdate)
-                testcards.push_back(std::get<0>(*pit)->index);
+                testcards.push_back(slotOf(std::get<0>(*pit)));
             it = pit;
         }
     }
 
-    std::sort(testcards.begin(), testcards.end(), [this](int a, int b) { return list[a]->itemdate < list[b]->itemdate; });
+    std::sort(testcards.begin(), testcards.end(), [this](int a, int b) { return cards[a].itemdate < cards[b].itemdate; });
 
     daystats.fixStats(tmp);
 
@@ -957,20 +1210,23 @@ void StudyDeck::fixDayStats()
 #ifdef _DEBUG
 void StudyDeck::checkDayStats() const
 {
+    loadHistory();
     if (daystats.empty())
         return;
 
     const DeckDayStat &stat = daystats.back();
 
+    compactOrder();
     bool error = false;
-    if (stat.itemcount != list.size())
+    if (stat.itemcount != order.size())
         error = true;
 
     int lcnt = 0;
     int gcnt = 0;
     QSet<const StudyCard*> added;
-    for (const StudyCard *c : list)
+    for (quint32 slot : order)
     {
+        const StudyCard *c = &cards[slot];
         if (c->learned)
             ++lcnt;
 
@@ -1005,23 +1261,32 @@ StudyDeckId StudyDeck::deckId() const
 
 CardId* StudyDeck::cardId(int index) const
 {
-    return const_cast<CardId*>(ids[index]); //list[index]->id.get();
+    compactOrder();
+    return const_cast<CardId*>(ids[order[index]]);
 }
 
 int StudyDeck::cardIndex(CardId *cardid) const
 {
-    return posFromId(cardid);
+    const StudyCard *card = fromId(cardid);
+    if (card == nullptr)
+        return -1;
+    compactOrder();
+    return card->index;
 }
 
 void StudyDeck::fixResizeCardId(int size)
 {
-    if (ids.size() == size)
+    compactOrder();
+    if (order.size() == size)
         return;
     QString errormsg = qApp->translate("", "The study data is corrupted. The program will work, but there's a high chance that the cards in the long-term study list will have invalid intervals and score.");
     QMessageBox::warning(nullptr, "zkanji", errormsg);
-    while (ids.size() > size)
-        deleteCard(ids.back());
-    while (ids.size() < size)
+    while (order.size() > size)
+    {
+        deleteCard(ids[order.back()]);
+        compactOrder();
+    }
+    while (order.size() < size)
         createCard(nullptr, 0);
 }
 
@@ -1031,7 +1296,8 @@ CardId* StudyDeck::loadCardId(QDataStream &stream)
     stream >> val;
     if (val == -1)
         return nullptr;
-    return ids[val];
+    compactOrder();
+    return ids[order[val]];
 }
 
 void StudyDeck::saveCardId(QDataStream &stream, CardId *id) const
@@ -1039,7 +1305,10 @@ void StudyDeck::saveCardId(QDataStream &stream, CardId *id) const
     if (id == nullptr)
         stream << (qint32)-1;
     else
-        stream << (qint32)id->data;
+    {
+        compactOrder();
+        stream << (qint32)cards[id->data].index;
+    }
 }
 
 void StudyDeck::setCardData(CardId *cardid, intptr_t data)
@@ -1057,7 +1326,7 @@ intptr_t StudyDeck::cardData(const CardId *cardid) const
 CardId* StudyDeck::nextCard(CardId *cardid)
 {
     StudyCard *card = fromId(cardid);
-    return ids[card->next->index];
+    return ids[slotOf(card->next)];
 }
 
 void StudyDeck::groupData(CardId *cardid, std::vector<intptr_t> &result)
@@ -1073,10 +1342,26 @@ void StudyDeck::groupData(CardId *cardid, std::vector<intptr_t> &result)
 
 CardId* StudyDeck::createCard(CardId *cardid_group, intptr_t data)
 {
+    loadHistory();
     StudyCard *group = fromId(cardid_group);
-    StudyCard *card = new StudyCard;
+
+    quint32 slot;
+    if (!freeslots.empty())
+    {
+        slot = freeslots.back();
+        freeslots.pop_back();
+    }
+    else
+    {
+        slot = cards.size();
+        cards.emplace_back();
+        resizeColumns();
+        ids.push_back(new CardId(slot));
+    }
+
+    StudyCard *card = &cards[slot];
     card->data = data;
-    memset(card->answers, 0, sizeof(uchar) * 4);
+    clearColumns(slot);
 
     //card->problematic = false;
     //card->wrongcnt = 0;
@@ -1084,19 +1369,13 @@ CardId* StudyDeck::createCard(CardId *cardid_group, intptr_t data)
 
     //card->level = 0;
     //card->inclusion = 0;
-    card->spacing = 0;
     card->repeats = 0;
-    card->level = 0;
     card->multiplier = ZKanji::profile().baseMultiplier();
     card->testlevel = 0;
     card->timespent = 0;
     card->next = card;
     card->learned = false;
-    //if (list.empty())
-    //    card->id = CardId(0);
-    //else
-    //    card->id = CardId(list.back()->id.data + 1);
-    card->index = list.size(); // id.reset(new CardId(list.size()));
+    card->index = order.size();
 
     if (group != nullptr)
     {
@@ -1106,35 +1385,36 @@ CardId* StudyDeck::createCard(CardId *cardid_group, intptr_t data)
     }
     daystats.newCard(ltDay(testdate), group == nullptr);
 
-    list.push_back(card);
-    ids.push_back(new CardId(ids.size()));
+    order.push_back(slot);
 
-    return ids.back(); //card->id.get();
+    return ids[slot];
 }
 
 CardId* StudyDeck::deleteCard(CardId *cardid)
 {
+    loadHistory();
     // IMPORTANT: when changing, update deleteCardGroup() too (below.) which does the same
     // thing but does the bookkeeping only once.
 
-    int cardix = cardid == nullptr ? -1 : cardid->data; // posFromId(cardid);
-    if (cardix == -1)
+    int slot = posFromId(cardid);
+    if (slot == -1)
 #ifdef _DEBUG
         throw "No such card.";
 #else
         return nullptr;
 #endif
 
-    StudyCard *card = list[cardix];
+    StudyCard *card = &cards[slot];
+    int cardix = card->index;
 
     // Result to be returned. The next card in the same group.
-    int rindex;
+    CardId *r;
 
     if (card->next == card)
-        rindex = -1;
+        r = nullptr;
     else
     {
-        rindex = card->next->index;
+        r = ids[slotOf(card->next)];
 
         // Remove card from its group.
         StudyCard *pos = card->next;
@@ -1143,110 +1423,54 @@ CardId* StudyDeck::deleteCard(CardId *cardid)
         pos->next = card->next;
     }
 
-    if (card->level >= 3)
+    if (levels[slot] >= 3)
         ZKanji::profile().removeMultiplier(card->multiplier);
 
-    if (rindex > cardix)
-        --rindex;
+    daystats.cardDeleted(ltDay(QDateTime::currentDateTimeUtc()), r == nullptr, card->learned);
 
-    daystats.cardDeleted(ltDay(QDateTime::currentDateTimeUtc()), rindex == -1, card->learned);
+    auto it = std::find(testcards.begin(), testcards.end(), slot);
+    if (it != testcards.end())
+        testcards.erase(it);
 
-    auto it = testcards.begin();
-    while (it != testcards.end())
-    {
-        if (*it == cardix)
-        {
-            it = testcards.erase(it);
-            continue;
-        }
-        else if (*it > cardix)
-            --*it;
-        ++it;
-    }
+    freeSlot(slot);
 
-    list.erase(list.begin() + cardix);
-    ids.erase(ids.begin() + cardix);
-    for (; cardix != list.size(); ++cardix)
-    {
-        --list[cardix]->index; //id->data;
-        --ids[cardix]->data;
-    }
+    // The index of the cards after the deleted one are only updated when needed.
+    order[cardix] = deletedSlot;
+    ++ordergaps;
 
-    return rindex == -1 ? nullptr : ids[rindex]; //r;
+    return r;
 }
 
 void StudyDeck::deleteCardGroup(CardId *cardid)
 {
+    loadHistory();
 #ifdef _DEBUG
-    if (cardid == nullptr || cardid->data < 0 || cardid->data >= list.size())
+    if (cardid == nullptr || cardid->data >= cards.size() || cards[cardid->data].index == -1)
         throw "Invalid card id.";
 #endif
 
-    StudyCard *card = list[cardid->data];
+    StudyCard *card = &cards[cardid->data];
     StudyCard *first = card;
-    auto listdata = list.data();
-    auto iddata = ids.data();
-
-    std::vector<int> dellist;
 
-    int removed = 0;
     do
     {
-        int cardix = card->index /*->data*/;
-        dellist.push_back(cardix);
+        int slot = slotOf(card);
         //owner->changeAnswerRatio(-card->answercnt, -card->wrongcnt);
-        if (card->level >= 3)
+        if (levels[slot] >= 3)
             ZKanji::profile().removeMultiplier(card->multiplier);
 
         daystats.cardDeleted(ltDay(QDateTime::currentDateTimeUtc()), card->next == first, card->learned);
 
-        card = card->next;
-        delete listdata[cardix];
-        listdata[cardix] = nullptr;
-        delete iddata[cardix];
-        iddata[cardix] = nullptr;
+        auto it = std::find(testcards.begin(), testcards.end(), slot);
+        if (it != testcards.end())
+            testcards.erase(it);
 
-        auto it = testcards.begin();
-        while (it != testcards.end())
-        {
-            if (*it == cardix)
-            {
-                it = testcards.erase(it);
-                continue;
-            }
-            else if (*it > cardix)
-                --*it;
-            ++it;
-        }
+        order[card->index] = deletedSlot;
+        ++ordergaps;
 
-        ++removed;
+        card = card->next;
+        freeSlot(slot);
     } while (first != card);
-
-
-    std::sort(dellist.begin(), dellist.end());
-
-    // Removing the cards from list and updating the id of the rest.
-    int ix = 0;
-    for (int pos = 0, siz = list.size(); pos != siz; ++pos)
-    {
-        if (listdata[pos] == nullptr)
-            continue;
-
-        if (listdata[ix] == nullptr)
-        {
-            listdata[ix] = listdata[pos];
-            listdata[pos] = nullptr;
-            iddata[ix] = iddata[pos];
-            iddata[pos] = nullptr;
-        }
-
-        listdata[ix]->index /*->data*/ = ix;
-        iddata[ix]->data = ix;
-
-        ++ix;
-    }
-    list.resizeAddNull(ix);
-
 }
 
 bool StudyDeck::sameGroup(CardId *g1, CardId *g2) const
@@ -1268,6 +1492,7 @@ bool StudyDeck::sameGroup(CardId *g1, CardId *g2) const
 
 void StudyDeck::mergeGroups(CardId *g1, CardId *g2)
 {
+    loadHistory();
     if (sameGroup(g1, g2))
         return;
 
@@ -1285,11 +1510,13 @@ void StudyDeck::mergeGroups(CardId *g1, CardId *g2)
 
 ushort StudyDeck::dayStatSize() const
 {
+    loadHistory();
     return daystats.size();
 }
 
 const DeckDayStat& StudyDeck::dayStat(int index) const
 {
+    loadHistory();
     return daystats.items(index);
 }
 
@@ -1306,27 +1533,41 @@ const DeckDayStat& StudyDeck::dayStat(int index) const
 
 uchar StudyDeck::cardLevelOld(CardId *cardid) const
 {
+    loadHistory();
     const StudyCard *card = fromId(cardid);
     if (card == nullptr || card->stats.empty())
         return 0;
 
-    return card->stats.size() > 1 ? std::prev(card->stats.end(), 2)->level : card->level;
+    return card->stats.size() > 1 ? std::prev(card->stats.end(), 2)->level : levels[cardid->data];
 }
 
 uchar StudyDeck::cardLevel(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    if (cardid == nullptr)
         return 0;
-    return card->level;
+    return levels[cardid->data];
+}
+
+void StudyDeck::levelCounts(std::vector<int> &result, int size) const
+{
+    result.assign(size, 0);
+    // The levels of free slots are not counted. They are removed from the counts at the end
+    // instead of checking every slot.
+    for (uchar lv : levels)
+    {
+        if (result.size() <= lv)
+            result.resize(lv + 1, 0);
+        ++result[lv];
+    }
+    for (quint32 slot : freeslots)
+        --result[levels[slot]];
 }
 
 const uchar* StudyDeck::cardTries(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    if (cardid == nullptr)
         return nullptr;
-    return card->answers;
+    return tries[cardid->data].data();
 }
 
 uchar StudyDeck::cardTestLevel(CardId *cardid) const
@@ -1347,11 +1588,11 @@ bool StudyDeck::cardFirstShow(CardId *cardid) const
 
 ushort StudyDeck::cardInclusion(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    loadHistory();
+    if (cardid == nullptr)
         return 0;
 
-    return card->stats.size();// inclusion;
+    return inclusions[cardid->data];
 }
 
 QDateTime StudyDeck::cardTestDate(CardId *cardid) const
@@ -1365,6 +1606,7 @@ QDateTime StudyDeck::cardTestDate(CardId *cardid) const
 
 QDate StudyDeck::cardFirstStatDate(CardId *cardid) const
 {
+    loadHistory();
     const StudyCard *card = fromId(cardid);
     if (card == nullptr || card->stats.empty())
         return QDate();
@@ -1387,119 +1629,138 @@ QDateTime StudyDeck::cardNextTestDate(CardId *cardid) const
     if (card == nullptr || !card->testdate.isValid())
         return QDateTime();
 
-    if (!card->nexttestdate.isValid())
-        card->nexttestdate = card->testdate.addSecs(card->spacing);
-    return card->nexttestdate;
+    return QDateTime::fromMSecsSinceEpoch(cardNextTestTime(cardid), Qt::UTC);
+}
+
+qint64 StudyDeck::cardNextTestTime(CardId *cardid) const
+{
+    if (cardid == nullptr)
+        return std::numeric_limits<qint64>::min();
+
+    // The card's testdate is only read the first time after the value is invalidated.
+    qint64 &next = nexttests[cardid->data];
+    if (next == -1)
+    {
+        const StudyCard &card = cards[cardid->data];
+        next = !card.testdate.isValid() ? std::numeric_limits<qint64>::min() : card.testdate.toMSecsSinceEpoch() + (qint64)spacings[cardid->data] * 1000;
+    }
+    return next;
 }
 
 quint32 StudyDeck::cardSpacing(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    if (cardid == nullptr)
         return 0;
 
-    return card->spacing;
+    return spacings[cardid->data];
 }
 
 quint32 StudyDeck::increasedSpacing(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    loadHistory();
+    int slot = posFromId(cardid);
+    if (slot == -1)
         return 0;
 
+    const StudyCard *card = &cards[slot];
     if (card->stats.empty())
-        return card->spacing;
+        return spacings[slot];
 
-    quint32 spacing = card->spacing * card->multiplier;
-    fixCardSpacing(card, card->testdate, card->level + 1, spacing);
+    quint32 spacing = spacings[slot] * card->multiplier;
+    fixCardSpacing(slot, card->testdate, levels[slot] + 1, spacing);
     return spacing;
 }
 
 quint32 StudyDeck::decreasedSpacing(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    loadHistory();
+    int slot = posFromId(cardid);
+    if (slot == -1)
         return 0;
 
+    const StudyCard *card = &cards[slot];
     if (card->stats.empty())
-        return card->spacing;
+        return spacings[slot];
 
-    if (card->level < 2)
-        return card->spacing;
-    quint32 spacing = std::max<quint32>(card->spacing / card->multiplier, 24 * 60 * 60);
-    fixCardSpacing(card, card->testdate, card->level - 1, spacing);
+    if (levels[slot] < 2)
+        return spacings[slot];
+    quint32 spacing = std::max<quint32>(spacings[slot] / card->multiplier, 24 * 60 * 60);
+    fixCardSpacing(slot, card->testdate, levels[slot] - 1, spacing);
     return spacing;
 }
 
 void StudyDeck::increaseSpacingLevel(CardId *cardid)
 {
-    StudyCard *card = fromId(cardid);
-    if (card == nullptr || card->stats.empty())
+    loadHistory();
+    int slot = posFromId(cardid);
+    if (slot == -1 || cards[slot].stats.empty())
         return;
 
-    if (card->level >= 3)
+    StudyCard *card = &cards[slot];
+    if (levels[slot] >= 3)
         ZKanji::profile().removeMultiplier(card->multiplier);
 
-    quint32 spacing = card->spacing * card->multiplier;
-    fixCardSpacing(card, card->testdate, card->level + 1, spacing);
-    card->spacing = spacing;
-    ++card->level;
-    card->nexttestdate = QDateTime();
+    quint32 spacing = spacings[slot] * card->multiplier;
+    fixCardSpacing(slot, card->testdate, levels[slot] + 1, spacing);
+    spacings[slot] = spacing;
+    ++levels[slot];
+    nexttests[slot] = -1;
 
-    if (card->level >= 3)
+    if (levels[slot] >= 3)
         ZKanji::profile().addMultiplier(card->multiplier);
 
     if (!card->stats.empty())
-        updateCardStat(card, 0);
+        updateCardStat(slot, 0);
 }
 
 void StudyDeck::decreaseSpacingLevel(CardId *cardid)
 {
-    StudyCard *card = fromId(cardid);
-    if (card == nullptr || card->level < 2 || card->stats.empty())
+    loadHistory();
+    int slot = posFromId(cardid);
+    if (slot == -1 || levels[slot] < 2 || cards[slot].stats.empty())
         return;
 
-    if (card->level >= 3)
+    StudyCard *card = &cards[slot];
+    if (levels[slot] >= 3)
         ZKanji::profile().removeMultiplier(card->multiplier);
 
-    quint32 spacing = std::max<quint32>(card->spacing / card->multiplier, 24 * 60 * 60);
-    fixCardSpacing(card, card->testdate, card->level - 1, spacing);
-    card->spacing = spacing;
-    --card->level;
-    card->nexttestdate = QDateTime();
+    quint32 spacing = std::max<quint32>(spacings[slot] / card->multiplier, 24 * 60 * 60);
+    fixCardSpacing(slot, card->testdate, levels[slot] - 1, spacing);
+    spacings[slot] = spacing;
+    --levels[slot];
+    nexttests[slot] = -1;
 
-    if (card->level >= 3)
+    if (levels[slot] >= 3)
         ZKanji::profile().addMultiplier(card->multiplier);
 
     if (!card->stats.empty())
-        updateCardStat(card, 0);
+        updateCardStat(slot, 0);
 }
 
 void StudyDeck::resetCardStudyData(CardId *cardid)
 {
-    StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    loadHistory();
+    int slot = posFromId(cardid);
+    if (slot == -1)
         return;
 
-    if (card->level >= 3)
+    StudyCard *card = &cards[slot];
+    if (levels[slot] >= 3)
         ZKanji::profile().removeMultiplier(card->multiplier);
     if (card->learned)
         --daystats.back().itemlearned;
 
     card->stats.clear();
-    memset(card->answers, 0, sizeof(uchar) * 4);
-    card->spacing = 0;
+    clearColumns(slot);
     card->repeats = 0;
-    card->level = 0;
     card->multiplier = ZKanji::profile().baseMultiplier();
     card->testlevel = 0;
     card->timespent = 0;
     card->learned = false;
-    card->nexttestdate = QDateTime();
     card->itemdate = QDateTime();
     card->testdate = QDateTime();
 
-    auto it = std::find(testcards.begin(), testcards.end(), card->index);
+    auto it = std::find(testcards.begin(), testcards.end(), (int)cardid->data);
     if (it != testcards.end())
     {
         testcards.erase(it);
@@ -1508,6 +1769,7 @@ void StudyDeck::resetCardStudyData(CardId *cardid)
 
 float StudyDeck::cardMultiplierOld(CardId *cardid) const
 {
+    loadHistory();
     const StudyCard *card = fromId(cardid);
     if (card == nullptr || card->stats.empty())
         return 0;
@@ -1524,11 +1786,12 @@ float StudyDeck::cardMultiplier(CardId *cardid) const
 
 quint32 StudyDeck::cardEta(CardId *cardid) const
 {
-    const StudyCard *card = fromId(cardid);
-    if (card == nullptr)
+    int slot = posFromId(cardid);
+    if (slot == -1)
         return newCardEta();
 
-    return timestats.estimate(card->repeats == 0 ? card->level : card->testlevel, card->repeats);
+    const StudyCard *card = &cards[slot];
+    return timestats.estimate(card->repeats == 0 ? levels[slot] : card->testlevel, card->repeats);
 }
 
 quint32 StudyDeck::newCardEta() const
@@ -1545,20 +1808,14 @@ bool StudyDeck::startTestDay()
     if (testdate.isValid() && ltDay(testdate).daysTo(testday) <= 0)
         return false;
 
-    undodata.card = nullptr;
-
-    testdate = now;
-
-    for (StudyCard *c : list)
-        c->repeats = 0;
-
-    testcards.clear();
+    beginTestDay(now);
 
     return true;
 }
 
 int StudyDeck::daysSinceLastInclude() const
 {
+    loadHistory();
     if (daystats.empty())
         return -1;
 
@@ -1602,11 +1859,13 @@ CardId* StudyDeck::testCard(int index) const
 
 quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answertime, /*bool &postponed,*/ bool simulate)
 {
+    loadHistory();
     if (simulate && (a == StudyCard::Wrong || a == StudyCard::Retry))
         throw "Don't simulate in case of negative answer.";
 
     //postponed = false;
-    StudyCard *card = fromId(cardid);
+    int slot = posFromId(cardid);
+    StudyCard *card = &cards[slot];
 
     QDate testday = ltDay(testdate);
     QDateTime oldtestdate = card->stats.size() >= 2 && testdate == card->testdate ? QDateTime(card->stats[card->stats.size() - 2].day, QTime(12, 01, 01), QTimeZone::utc()) : card->testdate;
@@ -1615,7 +1874,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
 
     if (!simulate)
     {
-        if (card->level >= 3)
+        if (levels[slot] >= 3)
             ZKanji::profile().removeMultiplier(card->multiplier);
 
         // First time a card is shown for the day.
@@ -1623,15 +1882,15 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         {
             // Only reset card stats for the day here and not in startTestDay() because the
             // card might show up in the previous test day list.
-            card->testlevel = card->level;
-            memset(card->answers, 0, sizeof(uchar) * 4);
+            card->testlevel = levels[slot];
+            tries[slot].fill(0);
         }
 
         // The card's testlevel is set above, which is the only data that must be changed
         // before saving the card as undo data.
-        createUndo(card, a, answertime);
+        createUndo(slot, a, answertime);
 
-        card->answers[(int)a] = std::min(255, card->answers[(int)a] + 1);
+        tries[slot][(int)a] = std::min(255, tries[slot][(int)a] + 1);
 
         card->itemdate = QDateTime::currentDateTimeUtc();
 
@@ -1646,9 +1905,10 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         {
             // Add new empty stats that will be updated.
             card->stats.resize(card->stats.size() + 1);
+            inclusions[slot] = card->stats.size();
             StudyCardStat &cardstat = card->stats[card->stats.size() - 1];
             cardstat.day = testday;
-            cardstat.level = card->level;
+            cardstat.level = levels[slot];
             cardstat.multiplier = card->multiplier;
             cardstat.timespent = 0;
             //cardstat.status = /*card->problematic ? (int)StudyCardStatus::Problematic :*/ 0;
@@ -1656,9 +1916,8 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
             daystats.cardTested(testday, answertime / 100, a == StudyCard::Wrong || a == StudyCard::Retry, card->testlevel == 0, card->learned, oldtestdate.secsTo(QDateTime(testday, QTime(12, 01, 01), QTimeZone::utc())) >= s_1_month * 2);
         }
 
-        int idpos = posFromId(cardid);
-        testcards.resize(std::remove(testcards.begin(), testcards.end(), idpos) - testcards.begin());
-        testcards.push_back(idpos);
+        testcards.resize(std::remove(testcards.begin(), testcards.end(), slot) - testcards.begin());
+        testcards.push_back(slot);
     }
 
     uchar repeats = card->repeats + (simulate && card->repeats != 254 ? 1 : 0);
@@ -1682,18 +1941,18 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         //if (a == StudyCard::Wrong || a == StudyCard::Retry)
         //    cardinterval = Settings::study.delaywrong * ms_1_minute;
         //else
-        fixCardSpacing(card, testdate, cardlevel, cardspacing);
+        fixCardSpacing(slot, testdate, cardlevel, cardspacing);
 
         if (!simulate)
         {
             card->testdate = testdate;
             //card->inclusion = 1;
-            card->level = 1;
-            card->spacing = cardspacing;
+            levels[slot] = 1;
+            spacings[slot] = cardspacing;
             card->multiplier = cardmulti;
-            card->nexttestdate = QDateTime();
+            nexttests[slot] = -1;
 
-            updateCardStat(card, /*a,*/ answertime / 100);
+            updateCardStat(slot, /*a,*/ answertime / 100);
 
             //card->answercnt = 0;
             //owner->changeAnswerRatio(1, 0);
@@ -1712,8 +1971,8 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
 
     if (a == StudyCard::Easy || a == StudyCard::Correct)
     {
-        quint32 cardspacing = card->spacing;
-        uchar cardlevel = card->level;
+        quint32 cardspacing = spacings[slot];
+        uchar cardlevel = levels[slot];
         float cardmulti = card->multiplier;
 
         // Card was previously been marked as incorrect or retried. All the values were set
@@ -1729,7 +1988,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
             {
                 //card->testdate = testdate;
                 //card->spacing = cardspacing;
-                card->nexttestdate = QDateTime();
+                nexttests[slot] = -1;
                 //card->level = cardlevel;
             }
             return cardspacing;
@@ -1768,23 +2027,23 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
 
         //cardlevel = ZKanji::profile().levelFromInterval(ltDay(testdate), cardinterval);
 
-        fixCardSpacing(card, testdate, cardlevel, cardspacing);
+        fixCardSpacing(slot, testdate, cardlevel, cardspacing);
 
         if (!simulate)
         {
             card->testdate = testdate;
-            card->spacing = cardspacing;
+            spacings[slot] = cardspacing;
             card->multiplier = cardmulti;
-            card->nexttestdate = QDateTime();
-            card->level = cardlevel;
+            nexttests[slot] = -1;
+            levels[slot] = cardlevel;
 
-            if (card->level >= 3)
+            if (levels[slot] >= 3)
                 ZKanji::profile().addMultiplier(cardmulti);
 
             if (oldtestdate.secsTo(QDateTime(testday, QTime(12, 01, 01), QTimeZone::utc())) >= s_1_month * 2)
                 card->learned = true;
 
-            updateCardStat(card, /*a,*/ answertime / 100);
+            updateCardStat(slot, /*a,*/ answertime / 100);
 
             //if (card->inclusion > 3)
             //    owner->changeAnswerRatio(1, 0);
@@ -1815,7 +2074,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
     //            card->problematic = true;
     //            card->level = 1;
     //            card->interval = ms_1_day * Settings::study.postponedays;
-    //            card->nexttestdate = QDateTime();
+    //            card->nexttest = -1;
 
     //            // If the card becomes problematic, its data must be removed from
     //            // the student's answer-wrong-answer count, as well as it must be
@@ -1827,7 +2086,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
     //            if (a != StudyCard::Retry)
     //            {
     //                fixCardInterval(card, testdate, card->interval, 1);
-    //                card->nexttestdate = QDateTime();
+    //                card->nexttest = -1;
     //            }
     //        }
 
@@ -1853,10 +2112,10 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
     card->testdate = testdate;
     if (a == StudyCard::Retry)
     {
-        card->spacing /= card->multiplier;
-        card->level = std::max(1, card->level - 1);
+        spacings[slot] /= card->multiplier;
+        levels[slot] = std::max(1, levels[slot] - 1);
 
-        if (card->spacing >= s_1_day * 2)
+        if (spacings[slot] >= s_1_day * 2)
             card->multiplier = ZKanji::profile().retryMultiplier(card->multiplier);
     }
     if (a == StudyCard::Wrong)
@@ -1865,36 +2124,36 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         // both of them.
         if (card->repeats == 1 /*&& (card->stats.size() == 1 || (card->stats[card->stats.size() - 2].status & (int)StudyCardStatus::Finished) != 0)*/)
         {
-            card->spacing /= card->multiplier * card->multiplier;
-            card->level = std::max(1, card->level - 2);
-            while (card->level > 5)
+            spacings[slot] /= card->multiplier * card->multiplier;
+            levels[slot] = std::max(1, levels[slot] - 2);
+            while (levels[slot] > 5)
             {
-                card->spacing /= card->multiplier;
-                --card->level;
+                spacings[slot] /= card->multiplier;
+                --levels[slot];
             }
         }
         else
         {
-            card->spacing = s_1_day;
-            card->level = 1;
+            spacings[slot] = s_1_day;
+            levels[slot] = 1;
         }
-        if (card->spacing >= s_1_day * 2)
+        if (spacings[slot] >= s_1_day * 2)
             card->multiplier = ZKanji::profile().wrongMultiplier(card->multiplier);
     }
 
-    if (card->level == 1 || card->spacing < s_1_day * 2)
+    if (levels[slot] == 1 || spacings[slot] < s_1_day * 2)
     {
-        card->level = 1;
-        card->spacing = s_1_day;
+        levels[slot] = 1;
+        spacings[slot] = s_1_day;
     }
 
-    fixCardSpacing(card, testdate, card->level, card->spacing);
+    fixCardSpacing(slot, testdate, levels[slot], spacings[slot]);
 
-    card->nexttestdate = QDateTime();
+    nexttests[slot] = -1;
 
-    updateCardStat(card, /*a,*/ answertime / 100);
+    updateCardStat(slot, /*a,*/ answertime / 100);
 
-    if (card->level >= 3)
+    if (levels[slot] >= 3)
         ZKanji::profile().addMultiplier(card->multiplier);
 
     //if (repeats != 1 && (a != StudyCard::Retry || repeats != 2))
@@ -1911,7 +2170,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
     //if (repeats == 1 && !card->problematic)
     //    ZKanji::profile().updateMultiplier(oldlevel, oldinterval, oldtestdate, ltDay(testdate), false);
 
-    return card->spacing;
+    return spacings[slot];
 }
 
 StudyCard::AnswerType StudyDeck::lastAnswer() const
@@ -1922,12 +2181,86 @@ StudyCard::AnswerType StudyDeck::lastAnswer() const
 void StudyDeck::changeLastAnswer(StudyCard::AnswerType a)
 {
     revertUndo();
-    answer(ids[undodata.card->index] /*d.get()*/, a, undodata.answertime);
+    answer(ids[undodata.slot], a, undodata.answertime);
 }
 
 const CardId* StudyDeck::lastCard() const
 {
-    return ids[undodata.card->index]; /*d.get()*/;
+    return ids[undodata.slot];
+}
+
+void StudyDeck::saveAnswer(QDataStream &stream) const
+{
+    loadHistory();
+
+    int slot = undodata.slot;
+    const StudyCard &c = cards[slot];
+
+    saveCardId(stream, const_cast<CardId*>(ids[slot]));
+    saveCard(stream, slot);
+    stream << (quint8)c.learned;
+
+    // Only the last stat of the card is changed by an answer.
+    stream << (qint32)c.stats.size();
+    stream << c.stats[c.stats.size() - 1];
+
+    timestats.saveChange(stream);
+    daystats.saveChange(stream);
+}
+
+void StudyDeck::loadAnswer(QDataStream &stream)
+{
+    loadHistory();
+
+    int slot = posFromId(loadCardId(stream));
+    if (slot == -1)
+        throw ZException("Invalid card in user data journal.");
+
+    StudyCard &c = cards[slot];
+    loadCard(stream, slot);
+
+    quint8 b;
+    stream >> b;
+    c.learned = b != 0;
+
+    qint32 i;
+    stream >> i;
+    if (i < 1)
+        throw ZException("Invalid card in user data journal.");
+    c.stats.resize(i);
+    stream >> c.stats[i - 1];
+    inclusions[slot] = i;
+
+    testcards.resize(std::remove(testcards.begin(), testcards.end(), slot) - testcards.begin());
+    testcards.push_back(slot);
+
+    timestats.loadChange(stream);
+    daystats.loadChange(stream);
+}
+
+void StudyDeck::saveTestDay(QDataStream &stream) const
+{
+    stream << make_zdate(testdate);
+}
+
+void StudyDeck::loadTestDay(QDataStream &stream)
+{
+    QDateTime date;
+    stream >> make_zdate(date);
+    beginTestDay(date);
+}
+
+void StudyDeck::beginTestDay(QDateTime date)
+{
+    undodata.slot = -1;
+
+    testdate = date;
+
+    compactOrder();
+    for (quint32 slot : order)
+        cards[slot].repeats = 0;
+
+    testcards.clear();
 }
 
 const StudyCard* StudyDeck::fromId(const CardId *cardid) const
@@ -1935,7 +2268,7 @@ const StudyCard* StudyDeck::fromId(const CardId *cardid) const
     int ix = posFromId(cardid);
     if (ix == -1)
         return nullptr;
-    return list[ix];
+    return &cards[ix];
 }
 
 StudyCard* StudyDeck::fromId(const CardId *cardid)
@@ -1943,68 +2276,186 @@ StudyCard* StudyDeck::fromId(const CardId *cardid)
     int ix = posFromId(cardid);
     if (ix == -1)
         return nullptr;
-    return list[ix];
+    return &cards[ix];
 }
 
 int StudyDeck::posFromId(const CardId *cardid) const
 {
-    if (cardid == nullptr)
+    if (cardid == nullptr || cards[cardid->data].index == -1)
         return -1;
 
     return cardid->data;
+}
+
+quint32 StudyDeck::slotOf(const StudyCard *card) const
+{
+    return order[card->index];
+}
+
+void StudyDeck::compactOrder() const
+{
+    if (ordergaps == 0)
+        return;
+
+    StudyDeck *self = const_cast<StudyDeck*>(this);
+
+    int ix = 0;
+    for (int pos = 0, siz = order.size(); pos != siz; ++pos)
+    {
+        quint32 slot = order[pos];
+        if (slot == deletedSlot)
+            continue;
 
-    //auto listdata = list.data();
-    //int ix = std::lower_bound(listdata, listdata + list.size(), cardid, [](const StudyCard *card, const CardId &id){
-    //    return card->id < id;
-    //}) - listdata;
+        self->order[ix] = slot;
+        self->cards[slot].index = ix;
+        ++ix;
+    }
+    self->order.resize(ix);
+    self->ordergaps = 0;
+}
+
+void StudyDeck::saveCard(QDataStream &stream, quint32 slot) const
+{
+    const StudyCard &c = cards[slot];
+    stream << make_zdate(c.testdate);
+    stream << make_zdate(c.itemdate);
+    stream.writeRawData((const char*)tries[slot].data(), 4);
+    stream << (quint8)levels[slot];
+    stream << c.multiplier;
+    //stream << (quint16)c.inclusion;
+    stream << (quint32)spacings[slot];
+    //stream << (quint16)c.answercnt;
+    //stream << (quint16)c.wrongcnt;
+    //stream << (qint8)c.problematic;
+    stream << (quint8)c.repeats;
+    stream << (quint8)c.testlevel;
+    stream << (quint32)c.timespent;
+}
+
+void StudyDeck::loadCard(QDataStream &stream, quint32 slot)
+{
+    StudyCard &c = cards[slot];
 
-    //if (ix == list.size())
-    //    return -1;
+    quint8 b;
+    quint32 ui;
 
-    //const StudyCard *c = list[ix];
-    //if (c->id != cardid)
-    //    return -1;
+    stream >> make_zdate(c.testdate);
+    stream >> make_zdate(c.itemdate);
+    stream.readRawData((char*)tries[slot].data(), 4);
 
-    //return ix;
+    stream >> b;
+    levels[slot] = b;
+    stream >> c.multiplier;
+    stream >> ui;
+    spacings[slot] = ui;
+    nexttests[slot] = -1;
+    stream >> b;
+    c.repeats = b;
+    stream >> b;
+    c.testlevel = b;
+    stream >> ui;
+    c.timespent = ui;
+}
+
+void StudyDeck::resizeColumns()
+{
+    size_t siz = cards.size();
+    levels.resize(siz, 0);
+    spacings.resize(siz, 0);
+    nexttests.resize(siz, -1);
+    tries.resize(siz, std::array<uchar, 4>{ { 0, 0, 0, 0 } });
+    inclusions.resize(siz, 0);
 }
 
-void StudyDeck::createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime)
+void StudyDeck::clearColumns(quint32 slot)
 {
+    levels[slot] = 0;
+    spacings[slot] = 0;
+    nexttests[slot] = -1;
+    tries[slot].fill(0);
+    inclusions[slot] = 0;
+}
+
+void StudyDeck::freeSlot(quint32 slot)
+{
+    cards[slot] = StudyCard();
+    cards[slot].index = -1;
+    cards[slot].next = nullptr;
+    clearColumns(slot);
+    freeslots.insert(std::upper_bound(freeslots.begin(), freeslots.end(), slot, std::greater<quint32>()), slot);
+}
+
+void StudyDeck::createUndo(int slot, StudyCard::AnswerType a, qint64 answertime)
+{
+    loadHistory();
     ZKanji::profile().createUndo();
 
+    const StudyCard *card = &cards[slot];
     timestats.createUndo(card->testlevel);
     daystats.createUndo(ltDay(testdate));
 
-    undodata.card = card;
-    undodata.cardundo = *card;
+    undodata.slot = slot;
+    undodata.tries = tries[slot];
+    undodata.testdate = card->testdate;
+    undodata.itemdate = card->itemdate;
+    undodata.nexttest = nexttests[slot];
+    undodata.level = levels[slot];
+    undodata.multiplier = card->multiplier;
+    undodata.spacing = spacings[slot];
+    undodata.learned = card->learned;
+    undodata.repeats = card->repeats;
+    undodata.statcount = card->stats.size();
+    if (!card->stats.empty())
+        undodata.laststat = card->stats[card->stats.size() - 1];
     undodata.answertime = answertime;
     undodata.lastanswer = a;
 }
 
 void StudyDeck::revertUndo()
 {
+    loadHistory();
     ZKanji::profile().revertUndo();
 
-    timestats.revertUndo(undodata.card->testlevel);
+    timestats.revertUndo();
     daystats.revertUndo();
 
-    *undodata.card = undodata.cardundo;
+    int slot = undodata.slot;
+    StudyCard *card = &cards[slot];
+    tries[slot] = undodata.tries;
+    card->testdate = undodata.testdate;
+    card->itemdate = undodata.itemdate;
+    nexttests[slot] = undodata.nexttest;
+    levels[slot] = undodata.level;
+    card->multiplier = undodata.multiplier;
+    spacings[slot] = undodata.spacing;
+    card->learned = undodata.learned;
+    card->repeats = undodata.repeats;
+    if (card->stats.size() != undodata.statcount)
+    {
+        card->stats.resize(undodata.statcount);
+        inclusions[slot] = undodata.statcount;
+    }
+    else if (!card->stats.empty())
+        card->stats[card->stats.size() - 1] = undodata.laststat;
 }
 
-void StudyDeck::updateCardStat(StudyCard *card, /*StudyCard::AnswerType a,*/ int time)
+void StudyDeck::updateCardStat(int slot, /*StudyCard::AnswerType a,*/ int time)
 {
+    loadHistory();
+    StudyCard *card = &cards[slot];
     StudyCardStat &cardstat = card->stats[card->stats.size() - 1];
     //if (a == StudyCard::Correct || a == StudyCard::Easy)
     //    cardstat.status |= (int)StudyCardStatus::Finished;
     //if (card->problematic)
     //    cardstat.status |= (int)StudyCardStatus::Problematic;
-    cardstat.level = card->level;
+    cardstat.level = levels[slot];
     cardstat.multiplier = card->multiplier;
     cardstat.timespent = std::min<ushort>(65535, cardstat.timespent + time);
 }
 
-void StudyDeck::fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const
+void StudyDeck::fixCardSpacing(int slot, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const
 {
+    const StudyCard *card = &cards[slot];
     if (card->next == card || card->next == nullptr)
         return;
 
@@ -2035,14 +2486,15 @@ void StudyDeck::fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uc
     // the period limits are excluded.
     std::vector<std::pair<QDate, QDate>> badint;
 
-    StudyCard *pos = card->next;
+    const StudyCard *pos = card->next;
 
     // Fill the gooddates list with all the acceptable dates around other
     // items in the period of [firstdate, lastdate].
     while (pos && pos != card)
     {
-        QDateTime posdue = pos->testdate.addSecs(pos->spacing);
-        qint64 posdiff = pos->spacing * (1 - ZKanji::profile().acceptRate(pos->level) / 1.035) / 1.8;
+        quint32 posslot = slotOf(pos);
+        QDateTime posdue = pos->testdate.addSecs(spacings[posslot]);
+        qint64 posdiff = spacings[posslot] * (1 - ZKanji::profile().acceptRate(levels[posslot]) / 1.035) / 1.8;
 
         QDateTime posfirst = posdue.addMSecs(-posdiff);
         QDateTime poslast = posdue.addMSecs(+posdiff);
@@ -2106,7 +2558,7 @@ void StudyDeck::fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uc
     bool daygood = true;
     while (pos && pos != card && (pregood || nextgood))
     {
-        QDate posdate = ltDay(pos->testdate.addSecs(pos->spacing));
+        QDate posdate = ltDay(pos->testdate.addSecs(spacings[slotOf(pos)]));
         if (posdate == dueday.addDays(1))
             nextgood = false;
         if (posdate == dueday.addDays(-1))
@@ -2138,7 +2590,7 @@ StudyDeckList::~StudyDeckList()
     clear();
 }
 
-void StudyDeckList::load(QDataStream &stream)
+void StudyDeckList::load(QDataStream &stream, int version)
 {
     //bool mod = ZKanji::profile().isModified();
     //ZKanji::profile().changeAnswerRatio(-cardanswercnt, -cardwrongcnt);
@@ -2160,7 +2612,7 @@ void StudyDeckList::load(QDataStream &stream)
         StudyDeckId id;
         stream >> id;
         list.push_back(new StudyDeck(this, id));
-        list.back()->load(stream);
+        list.back()->load(stream, version);
         mapping.insert({ id, list.back() });
         nextid = StudyDeckId::next(id, nextid);
     }
@@ -2182,6 +2634,18 @@ void StudyDeckList::save(QDataStream &stream) const
     }
 }
 
+void StudyDeckList::loadDeck(QDataStream &stream, int version)
+{
+    StudyDeckId id;
+    stream >> id;
+    removeDeck(id);
+
+    list.push_back(new StudyDeck(this, id));
+    list.back()->load(stream, version);
+    mapping.insert({ id, list.back() });
+    nextid = StudyDeckId::next(id, nextid);
+}
+
 void StudyDeckList::clear()
 {
     list.clear();
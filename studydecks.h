@@ -8,8 +8,11 @@
 #define STUDYDECKS_H
 
 #include <QDataStream>
+#include <QByteArray>
 #include <QDateTime>
 #include <memory>
+#include <deque>
+#include <array>
 #include <unordered_map>
 #include "smartvector.h"
 #include "fastarray.h"
@@ -164,8 +167,9 @@ struct CardId
     //CardId();
     //bool isValid();
 private:
-    CardId(int data);
-    int data;
+    CardId(quint32 data);
+    // Slot of the card in its study deck. It doesn't change while the card exists.
+    quint32 data;
 
     friend class StudyDeck;
     //friend bool operator==(const CardId &a, const CardId &b);
@@ -176,9 +180,11 @@ private:
 
 };
 
+// The level, spacing, due time, tries and inclusion count of a card are not stored in the
+// card, but in columns of its StudyDeck, indexed by the card's slot.
 struct StudyCard // - ex TRepetitionItem
 {
-    // Indexes in answers.
+    // Indexes in the tries of a card.
     enum AnswerType { Retry = 0, Correct = 1, Wrong = 2, Easy = 3 };
 
     // Statistics for each day the card was tested.
@@ -192,34 +198,20 @@ struct StudyCard // - ex TRepetitionItem
     // date to compute the date of the next test.
     QDateTime testdate;
 
-    // Date and time when the card should be tested next. Computed by adding interval to
-    // testdate. This value is not saved and is invalid until needed. When the testdate or
-    // interval changes, this date should be invalidated.
-    mutable QDateTime nexttestdate;
-
     // Exact date and time when the item was tested the last time. This is NOT used for
     // determining when it's tested again. Only used, when searching for the next item to
     // test, to find the one tested the longest time ago. Testdate is not suitable as it is
     // the same for every item previously answered in the current test.
     QDateTime itemdate;
 
-    // Number of times a type of answer was given in today's test. See indexes from
-    // AnswerType. At most 255 is valid. Only used in last test day's statistics.
-    uchar answers[4];
-
     // Current item difficulty. Starts at 1.0.
     //double difficulty;
 
-    // Current repetition of item that determines interval.
-    uchar level;
     // Last study interval is multiplied by this value.
     float multiplier;
     // Number of times this item was included in tests and not repeated.
     //ushort inclusion;
 
-    // Time between the last and the next tests in seconds.
-    quint32 spacing;
-
 
     // TO-NOT-DO: is wrongcnt and answercnt imported from old data? is the student also updated with it?
 
@@ -250,7 +242,8 @@ struct StudyCard // - ex TRepetitionItem
     // Sum of all time spent on this item in tenth seconds.
     quint32 timespent;
 
-    // Index of card in a deck.
+    // Index of card in a deck, in the order the cards were created. Cards store their
+    // index in place of their id when saving. Set to -1 for deleted cards.
     int index;
 
     // The cards of related items are connected via the 'next' pointer.
@@ -259,9 +252,6 @@ struct StudyCard // - ex TRepetitionItem
     StudyCard *next;
 };
 
-QDataStream& operator<<(QDataStream& stream, const StudyCard &card);
-QDataStream& operator>>(QDataStream& stream, StudyCard &card);
-
 
 // The DeckTimeStatItem, DeckTimeStat and DeckTimeStatList are all used for
 // estimating the time a test will take.
@@ -319,33 +309,73 @@ public:
     void load(QDataStream &stream);
     void save(QDataStream &stream) const;
 
-    // Saves the current state of the object for the passed level, so it can be reverted when
-    // the student changes the last answer.
+    // Starts recording the changes made by addTime() and addRepeat() on the passed level, so
+    // they can be reverted when the student changes the last answer.
     void createUndo(uchar level);
-    // Removes the last added (first) value from repeats. Only call if addRepeat will be used
-    // afterwards to add a new value.
-    void revertUndo(uchar level);
+    // Reverts the changes recorded since the last call to createUndo(). Only call it once
+    // before calling createUndo() again.
+    void revertUndo();
     // Adds a new time in tenth seconds for a given level and repeat count.
     void addTime(uchar level, uchar repeats, quint32 time);
     // Adds a new repeat value on level. Both level and repeats must be 0 based.
     void addRepeat(uchar level, uchar repeats);
 
+    // Writes the statistics changed by addTime() and addRepeat() since the last call to
+    // createUndo(), to be restored by loadChange().
+    void saveChange(QDataStream &stream) const;
+    // Replaces the statistics of a level written by saveChange().
+    void loadChange(QDataStream &stream);
+
     // Returns the number of tenth seconds an item might take in a test if it was first
     // included at level and currently is past repeats number or tries. If there is not enough
     // data, returns a simple guess that might be wrong, but can be displayed.
     quint32 estimate(uchar level, uchar repeats) const;
+    // Returns the number of tenth seconds a single try of an item might take in a test, if it
+    // was first included at level and was already tried repeats number of times. The result
+    // is only a guess if there is not enough data.
+    quint32 tryEstimate(uchar level, uchar repeats) const;
+
+    // Number of repeat counts recorded for cards first tested on level on a test day. At most
+    // the last 100 are recorded.
+    int repeatCount(uchar level) const;
+    // Returns the index-th recorded repeat count on level, starting at the latest. This is the
+    // number of times a card was answered incorrectly before the correct answer.
+    uchar repeatValue(uchar level, int index) const;
 private:
     // Returns the number of milliseconds an item's single repeat might take in a test. If
     // there's no data, returns a guess.
     quint32 _estimate(uchar level, uchar repeats) const;
 
-    // Temporary undo data. Only use during tests.
+    // Temporary undo data. Only use during tests. Instead of copying the statistics of a
+    // level, only the values shifted out of the arrays by addTime() and addRepeat() are saved.
+    struct Undo
+    {
+        // Level passed to createUndo().
+        uchar level;
+        // Number of levels in items. If this is not greater than level, the level was added
+        // after createUndo() and the rest of the values are invalid.
+        int itemcount;
+
+        // A time was added to the timestats of level at repeats.
+        bool timeadded;
+        uchar repeats;
+        // Number of items in the timestats of level. If this is not greater than repeats,
+        // the time stat item was added by addTime().
+        int timecount;
+        // Last value of the time array shifted out when the time was added, and the number
+        // of used values before that.
+        quint32 lasttime;
+        uchar timeused;
+
+        // A value was added to the repeat array of level.
+        bool repeatadded;
+        // Last value of the repeat array shifted out, and the number of used values before
+        // the repeat was added.
+        uchar lastrepeat;
+        uchar repeatused;
+    };
 
-    // Number of levels in items. If this is less than the level to undo or create undo for
-    // undostat is invalid.
-    uchar undocount;
-    // The saved statistics item on level.
-    DeckTimeStat undostat;
+    Undo undo;
 
     // End of temporary data.
 
@@ -380,6 +410,26 @@ struct DeckDayStat // - ex TDayStat
 QDataStream& operator<<(QDataStream &stream, const DeckDayStat &s);
 QDataStream& operator>>(QDataStream &stream, DeckDayStat &s);
 
+// Sums of the values in day statistics over a range of days.
+struct DeckDayStatSum
+{
+    // Number of days with statistics.
+    int days;
+    // Number of days when at least one item was tested.
+    int testdays;
+    // Number of days with time spent testing.
+    int timeddays;
+
+    qint64 timespent;
+    qint64 testcount;
+    qint64 testednew;
+    qint64 testwrong;
+    qint64 testlearned;
+
+    // Count of items tested on the days with time spent testing.
+    qint64 timedtestcount;
+};
+
 class DeckDayStatList  // -ex TDayStatList
 {
 public:
@@ -408,6 +458,13 @@ public:
     void createUndo(QDate testdate);
     void revertUndo();
 
+    // Writes the statistics of the last day, which is the only one changed by a test, to be
+    // restored by loadChange().
+    void saveChange(QDataStream &stream) const;
+    // Replaces the statistics of the day written by saveChange(), or adds them after the
+    // last day if the list has no statistics for that day yet.
+    void loadChange(QDataStream &stream);
+
     // Includes a new card in the day stats for the given test date. The date must match or
     // come after the last date.
     void newCard(QDate testdate, bool newgroup);
@@ -421,7 +478,16 @@ public:
     // Decrements the group count of the last test day. Does not create an extra empty day
     // stat for today if it doesn't exist.
     void groupsMerged();
+
+    // Returns the sums of the day stats from index first up to but not including last.
+    DeckDayStatSum sum(int first, int last) const;
+    // Returns the sums of every day stat.
+    DeckDayStatSum total() const;
 private:
+    // Marks the prefix sums invalid that include the day stat at index.
+    void invalidateSums(int index);
+    // Recomputes the prefix sums marked invalid.
+    void updateSums() const;
     // Creates statistics for the day of testdate. The date must match or come later than the
     // last existing date. If the dates match the function returns leaving the list unchanged,
     // otherwise every item that doesn't refer to today's test is copied.
@@ -431,6 +497,13 @@ private:
     DeckDayStat undo;
 
     std::vector<DeckDayStat> list;
+
+    // Prefix sums of the day stats. The item at index holds the sums of the stats in list in
+    // front of index, so it has one more item than list when up to date. Only the last item
+    // changes during a test, so updating it is cheap.
+    mutable std::vector<DeckDayStatSum> sums;
+    // Number of items at the front of sums that are up to date.
+    mutable int sumsvalid;
 };
 
 class StudyDeck;
@@ -476,7 +549,9 @@ public:
 
     void loadLegacy(QDataStream &stream, int version);
 
-    void load(QDataStream &stream);
+    // Loads the deck from stream. From user data version 3, the card stats and day
+    // statistics are only read when first needed.
+    void load(QDataStream &stream, int version);
     void save(QDataStream &stream) const;
 
     // Creates a copy of source, returning a mapping from source card id to those in this
@@ -484,6 +559,7 @@ public:
     void copy(StudyDeck *src, std::map<CardId*, CardId*> &map);
 
     const DeckDayStatList& dayStats() const;
+    const DeckTimeStatList& timeStats() const;
 
     // Fixes errors after loading from previous versions. Simulates answering the cards one
     // by one on each study date.
@@ -560,6 +636,9 @@ public:
 
     uchar cardLevelOld(CardId *cardid) const;
     uchar cardLevel(CardId *cardid) const;
+    // Fills result with the number of cards on each level, indexed by the level. The size
+    // of result is at least size, or one more than the highest level of a card.
+    void levelCounts(std::vector<int> &result, int size = 0) const;
 
     // Returns the number of times a card was answered with a given answer. See
     // StudyCard::AnswerType for the indexes. Returned is an array of size 4.
@@ -586,6 +665,10 @@ public:
     // Returns the date of the card when it's due next, by adding its interval
     // to its testdate.
     QDateTime cardNextTestDate(CardId *cardid) const;
+    // Returns the UTC time in milliseconds since the epoch of the card when it's due next.
+    // Cheaper than cardNextTestDate() for comparing the due times of cards. Cards that were
+    // never tested come before every other card.
+    qint64 cardNextTestTime(CardId *cardid) const;
 
     // Returns the spacing of the card in seconds.
     quint32 cardSpacing(CardId *cardid) const;
@@ -661,18 +744,48 @@ public:
 
     // Returns the id of the card last answered.
     const CardId* lastCard() const;
+
+    // Writes the values of the card changed by the last call to answer() or
+    // changeLastAnswer(), with the statistics changed by it, to be restored by loadAnswer().
+    void saveAnswer(QDataStream &stream) const;
+    // Restores the values of a card and the statistics written by saveAnswer().
+    void loadAnswer(QDataStream &stream);
+    // Writes the start of the current test day, to be restored by loadTestDay().
+    void saveTestDay(QDataStream &stream) const;
+    // Starts the test day written by saveTestDay() like startTestDay() did.
+    void loadTestDay(QDataStream &stream);
 private:
+    // Sets date as the start of the test day, and resets the card data only valid on a
+    // single test day.
+    void beginTestDay(QDateTime date);
+
     // Returns the card by its id. Passing an invalid id results in undefined behavior.
     const StudyCard* fromId(const CardId *cardid) const;
     // Returns the card by its id. Passing an invalid id results in undefined behavior.
     StudyCard* fromId(const CardId *cardid);
-    // Returns the card's index in list by its id. Passing an invalid id
+    // Returns the card's slot in cards by its id. Passing an invalid id
     // results in undefined behavior.
     int posFromId(const CardId *cardid) const;
+    // Returns the slot of a card in cards from a pointer to it.
+    quint32 slotOf(const StudyCard *card) const;
+    // Writes the card in slot to stream, with its values from the columns.
+    void saveCard(QDataStream &stream, quint32 slot) const;
+    // Reads the card in slot from stream, setting its values in the columns too.
+    void loadCard(QDataStream &stream, quint32 slot);
+    // Resizes the columns of the card values to match the number of slots in cards.
+    void resizeColumns();
+    // Sets the values of the card in slot in the columns to those of a new card.
+    void clearColumns(quint32 slot);
+    // Removes the slots of deleted cards from order and updates the index of the cards after
+    // them. Call before using order or the index of cards.
+    void compactOrder() const;
+    // Clears the card in slot and adds the slot to freeslots. The card must be removed from
+    // its group and from testcards first. Doesn't update order.
+    void freeSlot(quint32 slot);
 
     // Saves everything about the last item so its data can be changed. The data saved is only
     // usable in the same study session. It becomes invalid on suspend or when the test ends.
-    void createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime);
+    void createUndo(int slot, StudyCard::AnswerType a, qint64 answertime);
 
     // Reverts the data saved with createUndo(). Only valid during a study session
     // and not for the first item in the session.
@@ -680,23 +793,41 @@ private:
 
     // Changes the last study statistics of a card to match the card's level and multiplier,
     // and adds time to the time spent on the card.
-    void updateCardStat(StudyCard *card, /*StudyCard::AnswerType a,*/ int time);
+    void updateCardStat(int slot, /*StudyCard::AnswerType a,*/ int time);
 
     // Checks whether the card's current interval conflicts with another item in the same
-    // group, and changes the interval if it does. The values of the passed card are not used
+    // group, and changes the interval if it does. The values of the card in slot are not used
     // directly. It's only needed to identify the group it's in.
     // cardtestdate is the date of the current test, cardinterval is the current set interval
     // for the next repetition. This value is updated if another item of the same group was to
     // be tested on the day.
-    void fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const;
+    void fixCardSpacing(int slot, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const;
 
     // Temporary container of undo data.
     struct Undo
     {
-        StudyCard *card;
-
-        // Copy of the original card. The easiest way to undo is to copy the data back.
-        StudyCard cardundo;
+        // Slot of the card last answered. Set to -1 when no card was answered in the current
+        // session.
+        int slot;
+
+        // Values of the card that can be changed by answer(). The card's testlevel is set
+        // before the undo data is created, and only the last item of its stats can change.
+
+        std::array<uchar, 4> tries;
+        QDateTime testdate;
+        QDateTime itemdate;
+        qint64 nexttest;
+        uchar level;
+        float multiplier;
+        quint32 spacing;
+        bool learned;
+        uchar repeats;
+
+        // Number of items in the card's stats. A new item is added at the first answer on a
+        // test day, which is removed when reverting.
+        int statcount;
+        // Copy of the last item in the card's stats if there was any.
+        StudyCardStat laststat;
 
         qint64 answertime;
 
@@ -717,18 +848,55 @@ private:
     // Date and time when the last test was started.
     QDateTime testdate;
 
-    // List of all cards in the deck.
-    smartvector<StudyCard> list;
-    // List of stored card ids corresponding to same index in list.
+    // Cards of the deck in slots. A card keeps its slot until it's deleted, and the slots
+    // of deleted cards are reused for new ones. Cards are never moved in memory.
+    std::deque<StudyCard> cards;
+    // Slots in cards not used by any card, ordered from the highest to the lowest slot.
+    std::vector<quint32> freeslots;
+    // Slots of the cards in cards in the order of their index. Deleted cards are only removed
+    // from the list in compactOrder(), until then their slot is replaced by an invalid value.
+    std::vector<quint32> order;
+    // Number of deleted cards in order.
+    int ordergaps;
+    // Card ids corresponding to the same slot in cards. The ids of free slots are reused.
     smartvector<CardId> ids;
 
-    // Card indexes in list that were tested during the last test. The list is ordered by the
+    // Columns of the card values read when listing, sorting and scheduling the cards. Each
+    // holds a value for every slot in cards, so scans over many cards don't have to touch
+    // the card records and their history. Free slots hold the values of a new card.
+
+    // Current repetition level of the card that determines its spacing.
+    std::vector<uchar> levels;
+    // Time between the last and the next tests of the card in seconds.
+    std::vector<quint32> spacings;
+    // UTC time in milliseconds since the epoch when the card should be tested next, computed
+    // by adding the spacing to the card's testdate. Not saved and is -1 until needed. It must
+    // be set to -1 when the testdate or spacing changes. Cards never tested hold the lowest
+    // possible value once computed.
+    mutable std::vector<qint64> nexttests;
+    // Number of times a type of answer was given for the card in today's test. See indexes
+    // from StudyCard::AnswerType. At most 255 is valid. Only used in last test day's
+    // statistics.
+    std::vector<std::array<uchar, 4>> tries;
+    // Number of days the card was tested on, which is the size of its stats. Only valid after
+    // loadHistory().
+    std::vector<ushort> inclusions;
+
+    // Slots of the cards that were tested during the last test. The list is ordered by the
     // card's last test time.
     std::vector<int> testcards;
 
     DeckTimeStatList timestats; 
     DeckDayStatList daystats;
 
+    // Reads the card stats and day statistics from history if they haven't been loaded yet.
+    // Called by every function using them.
+    void loadHistory() const;
+
+    // Card stats of every card followed by the day statistics as saved in the user data.
+    // Holds the data until loadHistory() reads it, and is empty afterwards. The history of
+    // decks that are not studied is never read, and is saved unchanged.
+    mutable QByteArray history;
 };
 
 // Only a single student object should exist while the program is running.
@@ -745,9 +913,13 @@ public:
     StudyDeckId skipIdLegacy(QDataStream &stream);
     // End legacy.
 
-    void load(QDataStream &stream);
+    void load(QDataStream &stream, int version);
     void save(QDataStream &stream) const;
 
+    // Reads a single deck with its id written in the user data journal, replacing a deck
+    // with the same id.
+    void loadDeck(QDataStream &stream, int version);
+
     void clear();
 
     // Forces the decks to recompute the answer count and wrong count for every
@@ -99,6 +99,8 @@ void DeckDayStatList::loadLegacy(QDataStream &stream, int version)
 
         list.push_back(item);
     }
+
+    invalidateSums(0);
 }
 
 void StudyDeck::loadLegacy(QDataStream &stream, int version)
@@ -111,7 +113,9 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
 
     qint32 val;
     stream >> val;
-    list.reserve(val);
+    cards.resize(val);
+    resizeColumns();
+    order.reserve(val);
     ids.reserve(val);
 
     std::vector<int> nextvec(val);
@@ -122,8 +126,8 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
 
     for (int ix = 0, siz = nextvec.size(); ix != siz; ++ix)
     {
-        StudyCard *item = new StudyCard;
-        list.push_back(item);
+        StudyCard *item = &cards[ix];
+        order.push_back(ix);
         ids.push_back(new CardId(ix));
 
         item->index = ix; // id.reset(new CardId(ix));
@@ -145,7 +149,7 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
 
         quint8 b;
         stream >> b;
-        item->level = b;
+        levels[ix] = b;
 
         quint16 w;
         stream >> w;
@@ -153,11 +157,11 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
         // SKIP: item->inclusion = w;
 
         stream >> d;
-        item->spacing = d * quint32(24) * quint32(60) * quint32(60) /** qint64(1000)*/;
-        if (item->spacing < s_1_day * 2)
+        spacings[ix] = d * quint32(24) * quint32(60) * quint32(60) /** qint64(1000)*/;
+        if (spacings[ix] < s_1_day * 2)
         {
-            item->spacing = s_1_day;
-            item->level = 1;
+            spacings[ix] = s_1_day;
+            levels[ix] = 1;
         }
 
         stream >> d;
@@ -172,7 +176,7 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
         stream >> val;
         nextvec[ix] = val;
 
-        stream.readRawData((char*)item->answers, 4);
+        stream.readRawData((char*)tries[ix].data(), 4);
 
         //fread(&item->answers.uncertain, sizeof(byte), 1, f);
         //fread(&item->answers.good, sizeof(byte), 1, f);
@@ -185,6 +189,7 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
         qint32 cnt;
         stream >> cnt;
         item->stats.resize(cnt);
+        inclusions[ix] = cnt;
 
         // The time spent on each test day on a card is not saved originally, so it'll just be
         // the same value for each day in the imported stats.
@@ -229,17 +234,17 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
             //stat.status = 0;
         }
         item->multiplier = multipl;
-        if (item->level >= 3)
+        if (levels[ix] >= 3)
             ZKanji::profile().addMultiplier(item->multiplier);
     }
 
     for (int ix = 0; ix != nextvec.size(); ++ix)
     {
         if (nextvec[ix] >= 0)
-            list[ix]->next = list[nextvec[ix]];
+            cards[ix].next = &cards[nextvec[ix]];
         else
         {
-            list[ix]->next = list[ix];
+            cards[ix].next = &cards[ix];
         }
     }
 
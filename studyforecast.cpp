@@ -0,0 +1,173 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <algorithm>
+#include <cmath>
+
+#include "studyforecast.h"
+#include "studydecks.h"
+#include "zkanjimain.h"
+#include "zui.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    const quint32 s_1_day = 24 * 60 * 60;
+
+    // Number of card levels with separate answer statistics. Cards on higher levels use the
+    // statistics of the last level.
+    const int levelCount = 32;
+
+    // Minimum number of recorded answers on a level to use them. Levels with fewer answers
+    // use the statistics of the level below them.
+    const int minRepeatCount = 10;
+}
+
+StudyForecast::StudyForecast(const StudyDeck *study, const std::vector<CardId*> &cardids, QDateTime now)
+{
+    QDate nowday = ltDay(now);
+
+    cards.reserve(cardids.size());
+    for (CardId *id : cardids)
+    {
+        Card c;
+        c.spacing = study->cardSpacing(id);
+        c.multiplier = study->cardMultiplier(id);
+        c.level = study->cardLevel(id);
+        c.due = std::max<qint64>(0, nowday.daysTo(ltDay(study->cardItemDate(id).addSecs(c.spacing))));
+        cards.push_back(c);
+    }
+
+    const DeckTimeStatList &stats = study->timeStats();
+    levels.resize(levelCount);
+    for (int ix = 0; ix != levelCount; ++ix)
+    {
+        Level &l = levels[ix];
+        int cnt = stats.repeatCount(ix);
+        if (cnt >= minRepeatCount)
+        {
+            l.repeats.reserve(cnt);
+            for (int iy = 0; iy != cnt; ++iy)
+                l.repeats.push_back(stats.repeatValue(ix, iy));
+        }
+        else if (ix != 0)
+            l.repeats = levels[ix - 1].repeats;
+
+        int maxrepeat = l.repeats.empty() ? 0 : *std::max_element(l.repeats.begin(), l.repeats.end());
+        l.times.resize(maxrepeat + 1);
+        quint32 sum = 0;
+        for (int iy = 0; iy != maxrepeat + 1; ++iy)
+        {
+            sum += stats.tryEstimate(ix, iy);
+            l.times[iy] = sum;
+        }
+    }
+}
+
+void StudyForecast::simulate(int days, int runs)
+{
+    duecounts.assign(days, 0);
+    testtimes.assign(days, 0);
+    if (days == 0 || runs == 0)
+        return;
+
+    // Every range of runs is simulated on the thread pool with its own random generator and
+    // sums.
+    int cnt = ParallelRanges::rangeCount(runs, 1);
+    std::vector<std::vector<qint64>> due(cnt, std::vector<qint64>(days, 0));
+    std::vector<std::vector<qint64>> time(cnt, std::vector<qint64>(days, 0));
+    std::vector<std::mt19937> rnds;
+    rnds.reserve(cnt);
+    for (int ix = 0; ix != cnt; ++ix)
+        rnds.emplace_back(random_engine()());
+
+    ParallelRanges::run(runs, 1, [&](int ix, int first, int last) {
+        for (int iy = first; iy != last; ++iy)
+            run(rnds[ix], due[ix], time[ix]);
+    });
+
+    for (int ix = 0; ix != cnt; ++ix)
+    {
+        for (int iy = 0; iy != days; ++iy)
+        {
+            duecounts[iy] += due[ix][iy];
+            testtimes[iy] += time[ix][iy];
+        }
+    }
+    for (int iy = 0; iy != days; ++iy)
+    {
+        duecounts[iy] /= runs;
+        testtimes[iy] /= runs;
+    }
+}
+
+int StudyForecast::size() const
+{
+    return duecounts.size();
+}
+
+double StudyForecast::dueCount(int index) const
+{
+    return duecounts[index];
+}
+
+double StudyForecast::testTime(int index) const
+{
+    return testtimes[index];
+}
+
+void StudyForecast::run(std::mt19937 &rnd, std::vector<qint64> &due, std::vector<qint64> &time) const
+{
+    int days = due.size();
+    for (const Card &c : cards)
+    {
+        int day = c.due;
+        double spacing = c.spacing;
+        double multi = c.multiplier;
+        int level = c.level;
+
+        while (day < days)
+        {
+            const Level &l = levels[std::min(level, levelCount - 1)];
+            int r = l.repeats.empty() ? 0 : l.repeats[std::uniform_int_distribution<int>(0, l.repeats.size() - 1)(rnd)];
+
+            ++due[day];
+            time[day] += l.times[std::min<int>(r, l.times.size() - 1)];
+
+            // The spacing changes like in StudyDeck::answer() for cards answered correctly or
+            // wrong the first time on a test day, without changing the multiplier.
+            if (r == 0)
+            {
+                spacing *= multi;
+                level = std::min(level + 1, 255);
+            }
+            else
+            {
+                spacing /= multi * multi;
+                level = std::max(1, level - 2);
+                while (level > 5)
+                {
+                    spacing /= multi;
+                    --level;
+                }
+                if (level == 1 || spacing < s_1_day * 2)
+                {
+                    level = 1;
+                    spacing = s_1_day;
+                }
+            }
+
+            day += std::max(1, (int)std::min<double>(days, std::round(spacing / s_1_day)));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------
+
@@ -0,0 +1,72 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef STUDYFORECAST_H
+#define STUDYFORECAST_H
+
+#include <QDateTime>
+#include <vector>
+#include <random>
+
+class StudyDeck;
+struct CardId;
+// Forecasts the number of cards due and the time spent testing them on the coming days. The
+// tests of the cards are simulated several times, picking the number of wrong answers given
+// to a card before the correct one from the answers recorded on the card's level. The
+// results are the averages of every simulation.
+class StudyForecast
+{
+public:
+    // Copies the state of the cards in study needed for the simulations. The forecast starts
+    // on the day of now.
+    StudyForecast(const StudyDeck *study, const std::vector<CardId*> &cardids, QDateTime now = QDateTime::currentDateTimeUtc());
+
+    // Simulates the tests of the next number of days runs times, splitting the simulations
+    // between threads.
+    void simulate(int days, int runs);
+
+    // Number of days simulated.
+    int size() const;
+    // Average number of cards due on the day at index. The first day is today.
+    double dueCount(int index) const;
+    // Average tenth seconds spent testing cards on the day at index.
+    double testTime(int index) const;
+private:
+    // State of a card in the simulations.
+    struct Card
+    {
+        // Day the card is due next. The first day is today.
+        int due;
+        // Seconds between the last and the next test.
+        quint32 spacing;
+        float multiplier;
+        uchar level;
+    };
+
+    // Recorded answers on a card level.
+    struct Level
+    {
+        // Number of wrong answers before the correct one. When empty, cards on the level are
+        // always answered correctly at first.
+        std::vector<uchar> repeats;
+        // Estimated tenth seconds spent on all the tries of a card, indexed by its number of
+        // wrong answers.
+        std::vector<quint32> times;
+    };
+
+    // Simulates the tests of every card once, adding the number of cards due and the test
+    // time on each day to due and time.
+    void run(std::mt19937 &rnd, std::vector<qint64> &due, std::vector<qint64> &time) const;
+
+    std::vector<Card> cards;
+    std::vector<Level> levels;
+
+    std::vector<double> duecounts;
+    std::vector<double> testtimes;
+};
+
+
+#endif // STUDYFORECAST_H
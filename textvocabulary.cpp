@@ -0,0 +1,218 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
+#include "textvocabulary.h"
+#include "wordformindex.h"
+#include "words.h"
+#include "worddeck.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Number of characters read from a file at a time.
+    const int blockSize = 64 * 1024;
+
+    // Returns whether ch ends a line or a sentence. Words don't continue over these, so the
+    // text can be split at them.
+    bool isTextBreak(QChar ch)
+    {
+        ushort c = ch.unicode();
+        return c == '\n' || c == '\r' || c == 0x3002 /* 。 */ || c == 0xFF01 /* ！ */ || c == 0xFF1F /* ？ */;
+    }
+}
+
+class TextVocabulary::BlockRunnable : public QRunnable
+{
+public:
+    BlockRunnable(TextVocabulary *owner, QString &&block) : owner(owner), block(std::move(block)) {}
+    virtual void run() override
+    {
+        owner->countWords(block);
+    }
+private:
+    TextVocabulary *owner;
+    QString block;
+};
+
+TextVocabulary::TextVocabulary(Dictionary *dict) : dict(dict), counts(dict->entryCount(), 0), totalcount(0), pending(0)
+{
+
+}
+
+bool TextVocabulary::add(const QString &path, const std::function<bool()> &callback)
+{
+    // The index is built on first use, which must happen before it's accessed from multiple
+    // threads.
+    dict->wordFormIndex();
+
+    bool result = true;
+    if (QFileInfo(path).isDir())
+    {
+        QDirIterator it(path, QStringList() << "*.txt", QDir::Files, QDirIterator::Subdirectories);
+        while (result && it.hasNext())
+            result = addFile(it.next(), callback);
+    }
+    else
+        result = addFile(path, callback);
+
+    finish();
+    return result;
+}
+
+int TextVocabulary::count(int windex) const
+{
+    return counts[windex];
+}
+
+qint64 TextVocabulary::total() const
+{
+    return totalcount;
+}
+
+void TextVocabulary::words(const TextVocabularyFilter &filter, std::vector<int> &result) const
+{
+    result.clear();
+
+    WordDeckList *decks = dict->wordDecks();
+    for (int ix = 0, siz = counts.size(); ix != siz; ++ix)
+    {
+        if (counts[ix] == 0 || counts[ix] < filter.mincount)
+            continue;
+        if (filter.skipgroups && (dict->wordEntry(ix)->dat & (1 << (int)WordRuntimeData::InGroup)) != 0)
+            continue;
+        if (filter.skipjlpt != 0 && (dict->wordAttributes(ix).jlpt & filter.skipjlpt) != 0)
+            continue;
+        if (filter.skipdecks)
+        {
+            bool found = false;
+            for (int iy = 0; !found && iy != decks->size(); ++iy)
+                found = decks->items(iy)->wordFromIndex(ix) != nullptr;
+            if (found)
+                continue;
+        }
+
+        result.push_back(ix);
+    }
+
+    std::stable_sort(result.begin(), result.end(), [this](int a, int b) {
+        return counts[a] > counts[b];
+    });
+}
+
+bool TextVocabulary::addFile(const QString &filename, const std::function<bool()> &callback)
+{
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QTextStream stream(&f);
+    stream.setCodec("UTF-8");
+
+    // Text after the last break in the previous block, which is added to the next block.
+    QString rest;
+    while (!stream.atEnd())
+    {
+        QString block = rest + stream.read(blockSize);
+        rest.clear();
+
+        if (!stream.atEnd())
+        {
+            int pos = block.size() - 1;
+            while (pos != -1 && !isTextBreak(block.at(pos)))
+                --pos;
+            // Without any break in the block, the text is split at the block end.
+            if (pos != -1)
+            {
+                rest = block.mid(pos + 1);
+                block.truncate(pos + 1);
+            }
+        }
+
+        push(std::move(block));
+
+        if (callback && !callback())
+            return false;
+    }
+
+    return true;
+}
+
+void TextVocabulary::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    processed.wait(lock, [this]() { return pending == 0; });
+}
+
+void TextVocabulary::push(QString &&block)
+{
+    QThreadPool *pool = QThreadPool::globalInstance();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        processed.wait(lock, [this, pool]() { return pending < std::max(1, pool->maxThreadCount()) * 2; });
+        ++pending;
+    }
+    pool->start(new BlockRunnable(this, std::move(block)));
+}
+
+void TextVocabulary::countWords(const QString &block)
+{
+    const WordFormIndex &index = dict->wordFormIndex();
+
+    // Words of the block, added to the shared counts when the block is done.
+    std::vector<int> found;
+    std::vector<TextSegment> segments;
+
+    for (int pos = 0, siz = block.size(); pos != siz; )
+    {
+        int end = pos;
+        while (end != siz && !isTextBreak(block.at(end)))
+            ++end;
+
+        if (end != pos)
+        {
+            index.segment(block.mid(pos, end - pos), segments);
+
+            // Words matching the same part of the text follow each other. Only the most
+            // frequent of them is counted.
+            for (int ix = 0, ssiz = segments.size(); ix != ssiz; )
+            {
+                int best = ix;
+                int iy = ix + 1;
+                for (; iy != ssiz && segments[iy].pos == segments[ix].pos; ++iy)
+                    if (dict->wordEntry(segments[iy].windex)->freq > dict->wordEntry(segments[best].windex)->freq)
+                        best = iy;
+
+                found.push_back(segments[best].windex);
+                ix = iy;
+            }
+        }
+
+        pos = end == siz ? end : end + 1;
+    }
+
+    // Notifying under the lock, because finish() can return and the owner be destroyed as
+    // soon as the lock is released.
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int windex : found)
+        ++counts[windex];
+    totalcount += found.size();
+    --pending;
+    processed.notify_all();
+}
+
+//-------------------------------------------------------------
+
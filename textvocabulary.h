@@ -0,0 +1,82 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef TEXTVOCABULARY_H
+#define TEXTVOCABULARY_H
+
+#include <QString>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Conditions for listing the words found by TextVocabulary.
+struct TextVocabularyFilter
+{
+    // Words found fewer times in the texts are not listed.
+    int mincount = 1;
+    // Skip words placed in any word group of the dictionary.
+    bool skipgroups = true;
+    // Skip words added to any deck of the dictionary.
+    bool skipdecks = true;
+    // Skip words with a JLPT level included in this value, in the format of
+    // WordAttributeFilter::jlpt.
+    uchar skipjlpt = 0;
+};
+
+class Dictionary;
+// Counts the dictionary words found in texts. Files are read in blocks on the calling thread
+// while the blocks are split into words on the global thread pool. At most a few blocks are
+// kept in memory at any time, independent of the size of the files.
+class TextVocabulary
+{
+public:
+    TextVocabulary(Dictionary *dict);
+
+    // Adds the words in the UTF-8 text file at path to the counts. If path is a directory,
+    // the words of every txt file in it and in its sub-directories are added. If a callback
+    // is passed, it's called after each block read, and should return false to interrupt the
+    // processing. Returns false if a file couldn't be opened or the processing was
+    // interrupted. Words found up to that point are kept.
+    bool add(const QString &path, const std::function<bool()> &callback = std::function<bool()>());
+
+    // Number of times the word at windex was found in the texts.
+    int count(int windex) const;
+    // Number of words found in the texts, including repeated words.
+    qint64 total() const;
+
+    // Fills result with the index of words found in the texts that match filter. The words
+    // are ordered by the number of times they were found, starting with the most frequent.
+    void words(const TextVocabularyFilter &filter, std::vector<int> &result) const;
+private:
+    // Reads a single file. Returns false on error or when interrupted.
+    bool addFile(const QString &filename, const std::function<bool()> &callback);
+
+    // Waits for the blocks started on the thread pool to be processed.
+    void finish();
+    // Starts processing a block of text on the thread pool. Waits while too many blocks are
+    // waiting to be processed.
+    void push(QString &&block);
+    // Splits block into words and adds them to the counts. Called on the thread pool.
+    void countWords(const QString &block);
+
+    class BlockRunnable;
+
+    Dictionary *dict;
+
+    // Number of times each word was found. Guarded by mutex while blocks are processed.
+    std::vector<int> counts;
+    qint64 totalcount;
+
+    std::mutex mutex;
+    // Signaled when a block was processed.
+    std::condition_variable processed;
+    // Number of blocks started on the thread pool and not yet processed.
+    int pending;
+};
+
+
+#endif // TEXTVOCABULARY_H
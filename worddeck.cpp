@@ -6,8 +6,6 @@
 
 #include <QThreadPool>
 #include <QSet>
-#include <chrono>
-#include <thread>
 #include "words.h"
 #include "kanji.h"
 #include "worddeck.h"
@@ -87,7 +85,7 @@ bool WordDeckItems<T>::empty() const
 }
 
 template<typename T>
-void WordDeckItems<T>::applyChanges(const std::map<int, int> &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<WordDeckWord*, int> &kept)
+void WordDeckItems<T>::applyChanges(const WordIndexMap &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<WordDeckWord*, int> &kept)
 {
     auto it = list.begin();
     while (it != list.end())
@@ -99,7 +97,7 @@ void WordDeckItems<T>::applyChanges(const std::map<int, int> &changes, const std
             it = list.erase(it);
         else
         {
-            int newindex = changes.at(keptit->first->index);
+            int newindex = changes[keptit->first->index];
             (*it)->data = mainword.at(newindex);
             ++it;
         }
@@ -332,7 +330,7 @@ int ReadingTestList::size() const
     return list.size();
 }
 
-void ReadingTestList::applyChanges(const std::map<int, int> &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<int, bool> &match)
+void ReadingTestList::applyChanges(const WordIndexMap &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<int, bool> &match)
 {
     undoindex = -1;
     words.clear();
@@ -343,7 +341,7 @@ void ReadingTestList::applyChanges(const std::map<int, int> &changes, const std:
         auto it2 = itwords.begin();
         while (it2 != itwords.end())
         {
-            int newindex = changes.at((*it2)->windex);
+            int newindex = changes[(*it2)->windex];
             if (newindex == -1 || !match.at(newindex) || mainword.at(newindex)->index != (*it2)->windex)
                 it2 = itwords.erase(it2);
             else
@@ -539,8 +537,6 @@ void ReadingTestList::add(int windex, bool newitem, bool failed, bool undo)
     // hold it any more, but the words list will. This set of words is reset on each test day.
     if (!wordadded)
         words.insert(windex);
-
-    owner->dictionary()->setToUserModified();
 }
 
 void ReadingTestList::removeWord(int windex)
@@ -573,7 +569,7 @@ void ReadingTestList::removeWord(int windex)
     }
 
     if (changed)
-        owner->dictionary()->setToUserModified();
+        owner->dictionary()->setToUserModified(owner);
 }
 
 int ReadingTestList::nextKanji()
@@ -667,7 +663,6 @@ QString ReadingTestList::correctReading()
 void ReadingTestList::readingAnswered()
 {
     list.erase(list.begin());
-    owner->dictionary()->setToUserModified();
 }
 
 void ReadingTestList::nextWords(std::vector<int> &wlist)
@@ -714,12 +709,34 @@ void WordDeckList::save(QDataStream &stream) const
         list[ix]->save(stream);
 }
 
+void WordDeckList::loadDeck(int index, QDataStream &stream, int version)
+{
+    // The old deck must be destroyed first, as it removes its study deck with the same id.
+    WordDeck *deck = list[index];
+    list[index] = new WordDeck(this);
+    if (lastdeck == deck)
+        lastdeck = list[index];
+    delete deck;
+
+    dict->studyDecks()->loadDeck(stream, version);
+    list[index]->load(stream);
+}
+
+void WordDeckList::saveDeck(int index, QDataStream &stream) const
+{
+    const WordDeck *deck = list[index];
+    const StudyDeck *study = deck->studyDeck();
+    stream << study->deckId();
+    study->save(stream);
+    deck->save(stream);
+}
+
 void WordDeckList::clear()
 {
     list.clear();
 }
 
-void WordDeckList::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
+void WordDeckList::applyChanges(Dictionary *olddict, const WordIndexMap &changes)
 {
     //dict = newdict;
 
@@ -815,7 +832,7 @@ bool WordDeckList::rename(int index, const QString &name)
 
     list[index]->setName(val);
 
-    dict->setToUserModified();
+    dict->setToUserModified(list[index]);
     emit deckRenamed(list[index], val);
     return true;
 }
@@ -829,7 +846,7 @@ bool WordDeckList::add(const QString &name)
 
     list.push_back(new WordDeck(this));
     list.back()->setName(val);
-    dict->setToUserModified();
+    dict->setToUserModified(UserDataSection::Decks);
     return true;
 }
 
@@ -854,7 +871,7 @@ void WordDeckList::remove(int index)
 
     list.erase(list.begin() + index);
 
-    dict->setToUserModified();
+    dict->setToUserModified(UserDataSection::Decks);
     emit deckRemoved(index, addr);
 }
 
@@ -868,7 +885,7 @@ void WordDeckList::move(const smartvector<Range> &ranges, int pos)
 
     _moveRanges(ranges, pos, list /*[this](const Range &r, int pos) { _moveRange(worddecks, r, pos); }*/);
 
-    dict->setToUserModified();
+    dict->setToUserModified(UserDataSection::Decks);
     emit decksMoved(ranges, pos);
 }
 
@@ -879,7 +896,9 @@ void WordDeckList::move(const smartvector<Range> &ranges, int pos)
 WordDeck::WordDeck(WordDeckList *owner) : base(owner), lastcnt(0), freeitems(this), lockitems(this), testreadings(this), newcnt(0) 
 {
     generatingnext = false;
+    shownewest = false;
     abortgenerating = false;
+    candidatesdirty = true;
 
     deckid = owner->dictionary()->studyDecks()->createDeck();
 }
@@ -895,6 +914,7 @@ void WordDeck::load(QDataStream &stream)
     qint32 i;
 
     owner()->dictionary()->studyDecks()->removeDeck(deckid);
+    candidatesdirty = true;
 
     stream >> make_zstr(name, ZStrFormat::Byte);
     stream >> deckid;
@@ -1039,7 +1059,7 @@ bool WordDeck::empty() const
     return freeitems.empty() && lockitems.empty();
 }
 
-void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
+void WordDeck::applyChanges(Dictionary *olddict, const WordIndexMap &changes)
 {
     // Changes are applied in multiple steps. The words are referenced by WordDeckWord objects
     // for the items in the deck. Multiple items can share data for a single word. The change
@@ -1069,6 +1089,8 @@ void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
     if (study == nullptr)
         return;
 
+    candidatesdirty = true;
+
     // [new index, word data]. Used for joining multiple data when they have the same new
     // index. The data stored either refers to a word in the old dictionary with the exact
     // kanji/kana of a new dictionary word, or the old word with the lowest word index to be
@@ -1082,7 +1104,7 @@ void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
 
     for (int ix = list.size() - 1; ix != -1; --ix)
     {
-        int newindex = changes.at(list[ix]->index);
+        int newindex = changes[list[ix]->index];
         if (newindex == -1)
             continue;
         auto it = mainword.find(newindex);
@@ -1151,7 +1173,7 @@ void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
     // type of item, items of other word data are used.
     for (int ix = 0; ix != list.size(); ++ix)
     {
-        int newindex = changes.at(list[ix]->index);
+        int newindex = changes[list[ix]->index];
 
         // Word is not used in the new dictionary so it can be skipped.
         if (newindex == -1)
@@ -1199,7 +1221,7 @@ void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
     // Do the same for the other word data not used after the update.
     for (int ix = 0; ix != list.size(); ++ix)
     {
-        int newindex = changes.at(list[ix]->index);
+        int newindex = changes[list[ix]->index];
 
         // New index is not set, so the word won't be used later.
         if (newindex == -1)
@@ -1343,6 +1365,8 @@ void WordDeck::applyChanges(Dictionary *olddict, std::map<int, int> &changes)
 
 void WordDeck::copy(WordDeck *src)
 {
+    candidatesdirty = true;
+
     std::map<CardId*, CardId*> cardmap;
     getStudyDeck()->copy(src->getStudyDeck(), cardmap);
 
@@ -1374,6 +1398,8 @@ void WordDeck::copy(WordDeck *src)
 
 void WordDeck::processRemovedWord(int windex)
 {
+    candidatesdirty = true;
+
     // Removing word from the readings test. The readings test is not strongly connected to
     // the other data and can be updated.
     testreadings.processRemovedWord(windex);
@@ -1499,7 +1525,7 @@ void WordDeck::initNewStudy(int num)
         return;
 
     newcnt += std::min(freeitems.size(), num);
-    dictionary()->setToUserModified();
+    journalChange(WordDeckChange::NewStudy);
 }
 
 WordDeckWord* WordDeck::wordFromIndex(int windex)
@@ -1546,6 +1572,12 @@ void WordDeck::startTest()
     if (!study->startTestDay())
         return;
 
+    beginTestDay();
+    journalChange(WordDeckChange::TestDay);
+}
+
+void WordDeck::beginTestDay()
+{
 #ifdef _DEBUG
     //sortDueList();
     checkDueList();
@@ -1571,9 +1603,9 @@ void WordDeck::startTest()
     // Clear kanji readings test data.
     testreadings.clear();
 
-    lastday = study->testDay();
+    lastday = studyDeck()->testDay();
 
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
 }
 
 int WordDeck::daysSinceLastInclude() const
@@ -1630,13 +1662,7 @@ int WordDeck::totalTime() const
     if (!deckid.valid())
         return 0;
     const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-    int sum = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-        sum += study->dayStat(ix).timespent;
-
-    return sum;
+    return study->dayStats().total().timespent;
 }
 
 int WordDeck::studyAverage() const
@@ -1644,39 +1670,21 @@ int WordDeck::studyAverage() const
     if (!deckid.valid())
         return 0;
     const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-
-    int sum = 0;
-    int cnt = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        int spent = study->dayStat(ix).timespent;
-        if (spent != 0)
-        {
-            sum += study->dayStat(ix).timespent;
-            ++cnt;
-        }
-    }
+    DeckDayStatSum sum = study->dayStats().total();
 
-    return cnt == 0 ? 0 : sum / cnt;
+    return sum.timeddays == 0 ? 0 : sum.timespent / sum.timeddays;
 }
 
 int WordDeck::answerAverage() const
 {
-    int sum = totalTime();
-    if (totalTime() == 0)
+    if (!deckid.valid())
         return 0;
-
-    int itemcnt = 0;
-
     const StudyDeck *study = studyDeck();
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        if (study->dayStat(ix).timespent != 0)
-            itemcnt += study->dayStat(ix).testcount;
-    }
-    return sum / itemcnt;
+    DeckDayStatSum sum = study->dayStats().total();
+    if (sum.timespent == 0 || sum.timedtestcount == 0)
+        return 0;
+
+    return sum.timespent / sum.timedtestcount;
 }
 
 int WordDeck::queueSize() const
@@ -1686,15 +1694,7 @@ int WordDeck::queueSize() const
 
 int WordDeck::dueSize() const
 {
-    const StudyDeck *study = studyDeck();
-    QDate now = ltDay(QDateTime::currentDateTimeUtc());
-
-    auto endit = std::upper_bound(duelist.begin(), duelist.end(), now, [this, study](QDate now, int ix) {
-        QDateTime d = study->cardNextTestDate(lockitems.items(ix)->cardid);
-        return now < ltDay(d);
-    });
-
-    return failedlist.size() + (endit - duelist.begin());
+    return failedlist.size() + dueCount(ltDay(QDateTime::currentDateTimeUtc()));
 
     //int duecnt = 0;
     //for (int ix : duelist)
@@ -1757,7 +1757,8 @@ void WordDeck::removeQueuedItems(const std::vector<int> &items)
             removeWordData(dat);
     }
 
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
+    dictionary()->setToUserModified(this);
     emit itemsRemoved(ordered, true);
 }
 
@@ -1804,7 +1805,8 @@ void WordDeck::removeStudiedItems(const std::vector<int> &items)
             removeWordData(dat);
     }
     
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
+    dictionary()->setToUserModified(this);
     emit itemsRemoved(ordered, false);
 }
 
@@ -1825,7 +1827,7 @@ void WordDeck::requeueStudiedItems(const std::vector<int> &items)
     removeStudiedItems(items);
     queueWordItems(parts);
 
-    dictionary()->setToUserModified();
+    dictionary()->setToUserModified(this);
 }
 
 void WordDeck::queuedPriorities(const std::vector<int> &items, QSet<uchar> &priorities) const
@@ -1857,7 +1859,8 @@ void WordDeck::setQueuedPriority(const std::vector<int> &items, uchar priority)
     std::sort(changed.begin(), changed.end());
     if (!changed.empty())
     {
-        dictionary()->setToUserModified();
+        candidatesdirty = true;
+        dictionary()->setToUserModified(this);
         emit itemDataChanged(changed, true);
     }
 }
@@ -1894,7 +1897,7 @@ void WordDeck::setItemHints(const std::vector<int> &items, bool queue, WordParts
     std::sort(changed.begin(), changed.end());
     if (!changed.empty())
     {
-        dictionary()->setToUserModified();
+        dictionary()->setToUserModified(this);
         emit itemDataChanged(changed, queue);
     }
 }
@@ -1904,7 +1907,8 @@ void WordDeck::increaseSpacingLevel(int ix)
     StudyDeck *study = studyDeck();
     study->increaseSpacingLevel(lockitems.items(ix)->cardid);
 
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
+    dictionary()->setToUserModified(this);
     emit itemDataChanged({ ix }, false);
 }
 
@@ -1913,7 +1917,8 @@ void WordDeck::decreaseSpacingLevel(int ix)
     StudyDeck *study = studyDeck();
     study->decreaseSpacingLevel(lockitems.items(ix)->cardid);
 
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
+    dictionary()->setToUserModified(this);
     emit itemDataChanged({ ix }, false);
 }
 
@@ -1926,7 +1931,8 @@ void WordDeck::resetCardStudyData(const std::vector<int> &items)
     for (int ix : items)
         study->resetCardStudyData(lockitems.items(ix)->cardid);
 
-    dictionary()->setToUserModified();
+    candidatesdirty = true;
+    dictionary()->setToUserModified(this);
     emit itemDataChanged(items, false);
 }
 
@@ -1980,12 +1986,48 @@ int WordDeck::queueWordItems(const std::vector<std::pair<int, int>> &parts)
 
     if (added != 0)
     {
-        dictionary()->setToUserModified();
+        candidatesdirty = true;
+        dictionary()->setToUserModified(this);
         emit itemsQueued(added);
     }
     return added;
 }
 
+int WordDeck::removeWordItems(const std::vector<std::pair<int, int>> &parts)
+{
+    // [dictionary word index, word parts to remove]
+    std::map<int, int> types;
+    for (const std::pair<int, int> &p : parts)
+    {
+        if ((p.second & (int)WordPartBits::AllParts) != 0)
+            types[p.first] |= p.second & (int)WordPartBits::AllParts;
+    }
+
+    if (types.empty())
+        return 0;
+
+    auto matches = [&types](const WordDeckItem *item) {
+        auto it = types.find(item->data->index);
+        return it != types.end() && (it->second & (int)item->questiontype) != 0;
+    };
+
+    std::vector<int> queued;
+    for (int ix = 0, siz = freeitems.size(); ix != siz; ++ix)
+        if (matches(freeitems.items(ix)))
+            queued.push_back(ix);
+
+    std::vector<int> studied;
+    for (int ix = 0, siz = lockitems.size(); ix != siz; ++ix)
+        if (matches(lockitems.items(ix)))
+            studied.push_back(ix);
+
+    // The word data is only removed by either call when no items of the word remain.
+    removeQueuedItems(queued);
+    removeStudiedItems(studied);
+
+    return queued.size() + studied.size();
+}
+
 int WordDeck::queueUniqueSize() const
 {
     QSet<int> uniques;
@@ -2067,17 +2109,7 @@ int WordDeck::testDayCount() const
     if (!deckid.valid())
         return 0;
     const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-
-    int r = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        const DeckDayStat &stat = study->dayStat(ix);
-        if (stat.testcount != 0)
-            ++r;
-    }
-    return r;
+    return study->dayStats().total().testdays;
 }
 
 int WordDeck::skippedDayCount() const
@@ -2091,100 +2123,51 @@ int WordDeck::skippedDayCount() const
 
 void WordDeck::sortDueList()
 {
-    StudyDeck *study = studyDeck();
-
-    // Computing the due time is slow. The map caches the result.
-    // [word index, due time]
-    std::map<int, QDateTime> datecache;
+    candidatesdirty = true;
 
-    std::sort(duelist.begin(), duelist.end(), [this, study, &datecache](int aix, int bix){
-        if (aix == bix)
-            return false;
-
-        const LockedWordDeckItem *a = lockitems.items(aix);
-        const LockedWordDeckItem *b = lockitems.items(bix);
-
-        QDateTime ta;
-        auto it = datecache.find(aix);
-        if (it == datecache.end())
-        {
-            ta = study->cardNextTestDate(a->cardid);
-            datecache.insert(std::make_pair(aix, ta));
-        }
-        else
-            ta = it->second;
-
-        QDateTime tb;
-        it = datecache.find(bix);
-        if (it == datecache.end())
-        {
-            tb = study->cardNextTestDate(b->cardid);
-            datecache.insert(std::make_pair(bix, tb));
-        }
-        else
-            tb = it->second;
-
-        if (ta == tb)
-        {
-            if (a->data->index == b->data->index)
-                return (int)a->questiontype < (int)b->questiontype;
-            return a->data->index < b->data->index;
-        }
+    StudyDeck *study = studyDeck();
 
-        return ta < tb;
+    // The due times are looked up once for every item.
+    // [due time, lock index]
+    std::vector<std::pair<qint64, int>> order;
+    order.reserve(duelist.size());
+    for (int ix : duelist)
+        order.push_back(std::make_pair(study->cardNextTestTime(lockitems.items(ix)->cardid), ix));
+
+    std::sort(order.begin(), order.end(), [this](const std::pair<qint64, int> &a, const std::pair<qint64, int> &b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return dueItemLess(lockitems.items(a.second), lockitems.items(b.second));
     });
+
+    for (int ix = 0, siz = order.size(); ix != siz; ++ix)
+        duelist[ix] = order[ix].second;
 }
 
 int WordDeck::dueIndex(int lockindex) const
 {
     const StudyDeck *study = studyDeck();
 
-    // Computing the due time is slow. The map caches the result.
-    std::map<int, QDateTime> datecache;
-    QDateTime lockdate = study->cardNextTestDate(lockitems.items(lockindex)->cardid);
-    datecache.insert(std::make_pair(lockindex, lockdate));
+    const LockedWordDeckItem *b = lockitems.items(lockindex);
+    qint64 locktime = study->cardNextTestTime(b->cardid);
 
-    auto it = std::lower_bound(duelist.begin(), duelist.end(), lockindex, [this, study, lockdate, &datecache](int aix, int lockindex){
+    auto it = std::lower_bound(duelist.begin(), duelist.end(), lockindex, [this, study, b, locktime](int aix, int lockindex){
         if (aix == lockindex)
             return false;
 
         const LockedWordDeckItem *a = lockitems.items(aix);
-        const LockedWordDeckItem *b = lockitems.items(lockindex);
+        qint64 ta = study->cardNextTestTime(a->cardid);
 
-        QDateTime ta;
-        auto it = datecache.find(aix);
-        if (it == datecache.end())
-        {
-            ta = study->cardNextTestDate(a->cardid);
-            datecache.insert(std::make_pair(aix, ta));
-        }
-        else
-            ta = it->second;
-
-        //QDateTime tb = lockdate;
-        //it = datecache.find(bix);
-        //if (it == datecache.end())
-        //{
-        //    tb = study->cardNextTestDate(b->cardid);
-        //    datecache.insert(std::make_pair(bix, tb));
-        //}
-        //else
-        //    tb = it->second;
-
-        if (ta == lockdate)
+        if (ta == locktime)
         {
-            if (a->data->index == b->data->index)
-            {
 #ifdef _DEBUG
-                // This is an error, items with the same word index shouldn't share the question type.
-                if ((int)a->questiontype == (int)b->questiontype)
-                    throw "Invalid items, question types match.";
+            // This is an error, items with the same word index shouldn't share the question type.
+            if (a->data->index == b->data->index && (int)a->questiontype == (int)b->questiontype)
+                throw "Invalid items, question types match.";
 #endif
-                return (int)a->questiontype < (int)b->questiontype;
-            }
-            return a->data->index < b->data->index;
+            return dueItemLess(a, b);
         }
-        return ta < lockdate;
+        return ta < locktime;
     });
 
     if (it == duelist.end() || *it != lockindex)
@@ -2192,6 +2175,26 @@ int WordDeck::dueIndex(int lockindex) const
     return it - duelist.begin();
 }
 
+int WordDeck::dueCount(QDate day) const
+{
+    const StudyDeck *study = studyDeck();
+
+    // Items due after the end of the day are not counted.
+    qint64 end = ltDayStart(day.addDays(1)).toMSecsSinceEpoch();
+
+    auto it = std::lower_bound(duelist.begin(), duelist.end(), end, [this, study](int ix, qint64 end) {
+        return study->cardNextTestTime(lockitems.items(ix)->cardid) < end;
+    });
+    return it - duelist.begin();
+}
+
+bool WordDeck::dueItemLess(const LockedWordDeckItem *a, const LockedWordDeckItem *b)
+{
+    if (a->data->index == b->data->index)
+        return (int)a->questiontype < (int)b->questiontype;
+    return a->data->index < b->data->index;
+}
+
 #ifdef _DEBUG
 void WordDeck::checkDueList()
 {
@@ -2200,13 +2203,13 @@ void WordDeck::checkDueList()
 
     StudyDeck *study = studyDeck();
 
-    QDateTime prevdate = study->cardNextTestDate(lockitems.items(duelist[0])->cardid);
+    qint64 prevdate = study->cardNextTestTime(lockitems.items(duelist[0])->cardid);
     for (int ix = 1, siz = duelist.size(); ix < siz; ++ix)
     {
         const LockedWordDeckItem *a = lockitems.items(duelist[ix - 1]);
         const LockedWordDeckItem *b = lockitems.items(duelist[ix]);
 
-        QDateTime thisdate = study->cardNextTestDate(lockitems.items(duelist[ix])->cardid);
+        qint64 thisdate = study->cardNextTestTime(lockitems.items(duelist[ix])->cardid);
         if (thisdate == prevdate)
         {
             // This is an error, items with the same word index shouldn't share the question type.
@@ -2391,8 +2394,16 @@ bool WordDeck::nextFailedCard() const
 void WordDeck::generateNextItem()
 {
     abortgenerating = false;
-    NextWordDeckItemThread *thread = new NextWordDeckItemThread(this);
-    QThreadPool::globalInstance()->start(thread);
+    shownewest = rnd(1, 10) <= 2;
+    {
+        std::lock_guard<std::mutex> lock(generatemutex);
+#ifdef _DEBUG
+        if (generatingnext)
+            throw "Generating the next item while the previous one is not finished.";
+#endif
+        generatingnext = true;
+    }
+    QThreadPool::globalInstance()->start(new NextWordDeckItemThread(this));
 }
 
 void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
@@ -2419,6 +2430,7 @@ void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
     LockedWordDeckItem *item;
 
     int dueindex;
+    int freeindex = currentix.free;
 
     // New items have a 0 or positive free index.
     if (currentix.free != -1)
@@ -2427,27 +2439,23 @@ void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
         // queue and a new card created for it on the deck.
 
         FreeWordDeckItem *freeitem = (FreeWordDeckItem*)current;
-        item = new LockedWordDeckItem;
-        item->added = freeitem->added;
-        item->data = freeitem->data;
-        item->mainhint = freeitem->mainhint;
-        item->questiontype = freeitem->questiontype;
 
         // The next item to be shown is the same as the current item. A new next item must be
         // found.
         if (nextix.locked == lockitems.size() /*== currentix*/)
             nextix.reset();
 
-        freeitems.remove(currentix.free);
-
-        item->cardid = study->createCard(item->data->groupid, (intptr_t)item);
-        if (item->data->groupid == nullptr)
-            item->data->groupid = item->cardid;
+        if (!candidatesdirty)
+        {
+            std::deque<FreeWordDeckItem*> &queue = newqueue[freeitem->priority - 1];
+            auto it = std::find(queue.begin(), queue.end(), freeitem);
+            if (it != queue.end())
+                queue.erase(it);
+        }
 
         currentix.free = -1;
-        currentix.locked = lockitems.add(item);
-
-        --newcnt;
+        currentix.locked = lockFreeItem(freeindex);
+        item = lockitems.items(currentix.locked);
     }
     else
     {
@@ -2505,7 +2513,17 @@ void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
     checkDueList();
 #endif
 
-    dictionary()->setToUserModified();
+    if (!candidatesdirty)
+    {
+        // The group of the answered item was included now, so its failed items are moved to
+        // the back of the failed queue. Their earlier entries become outdated.
+        qint64 included = item->data->lastinclude.toMSecsSinceEpoch();
+        for (int ix : failedlist)
+            if (lockitems.items(ix)->data == item->data)
+                failedqueue.push_back(std::make_pair(included, ix));
+    }
+
+    journalChange(WordDeckChange::Answer, freeindex);
 }
 
 StudyCard::AnswerType WordDeck::lastAnswer() const
@@ -2551,8 +2569,11 @@ void WordDeck::changeLastAnswer(StudyCard::AnswerType a)
     else
         failedlist.push_back(lastindex);
 
+    candidatesdirty = true;
+    // The change is written before the thread looking for the next item could access the
+    // study deck.
+    journalChange(WordDeckChange::Answer);
     generateNextItem();
-    dictionary()->setToUserModified();
 }
 
 bool WordDeck::canUndo() const
@@ -2584,6 +2605,7 @@ QString WordDeck::correctReading()
 void WordDeck::practiceReadingAnswered()
 {
     testreadings.readingAnswered();
+    journalChange(WordDeckChange::Readings);
 }
 
 void WordDeck::nextPracticeReadingWords(std::vector<int> &words)
@@ -2591,6 +2613,140 @@ void WordDeck::nextPracticeReadingWords(std::vector<int> &words)
     testreadings.nextWords(words);
 }
 
+void WordDeck::journalChange(WordDeckChange change, int freeindex)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream << (quint8)change;
+
+    const StudyDeck *study = studyDeck();
+    switch (change)
+    {
+    case WordDeckChange::Answer:
+    {
+        LockedWordDeckItem *item = (LockedWordDeckItem*)study->cardData(study->lastCard());
+        int lockedindex = lockitems.indexOf(item);
+
+        stream << (qint32)freeindex;
+        stream << (qint32)lockedindex;
+        stream << make_zdate(item->data->lastinclude);
+        stream << (quint8)(std::find(failedlist.begin(), failedlist.end(), lockedindex) != failedlist.end());
+        study->saveAnswer(stream);
+        testreadings.save(stream);
+        break;
+    }
+    case WordDeckChange::TestDay:
+        study->saveTestDay(stream);
+        break;
+    case WordDeckChange::Readings:
+        testreadings.save(stream);
+        break;
+    case WordDeckChange::NewStudy:
+        stream << (qint32)newcnt;
+        break;
+    }
+
+    dictionary()->setToUserModified(this, std::move(data));
+}
+
+void WordDeck::loadChange(QDataStream &stream)
+{
+    StudyDeck *study = studyDeck();
+    candidatesdirty = true;
+
+    quint8 b;
+    qint32 i;
+
+    stream >> b;
+    switch ((WordDeckChange)b)
+    {
+    case WordDeckChange::Answer:
+    {
+        qint32 freeindex;
+        qint32 lockedindex;
+        stream >> freeindex;
+        stream >> lockedindex;
+
+        // The item is removed from the lists the same way answer() did, and added back after
+        // its card was updated, which decides its place in duelist.
+        if (freeindex != -1)
+        {
+            if (freeindex < 0 || freeindex >= freeitems.size() || lockedindex != lockitems.size())
+                throw ZException("Invalid item in user data journal.");
+            lockFreeItem(freeindex);
+        }
+        else
+        {
+            if (lockedindex < 0 || lockedindex >= lockitems.size())
+                throw ZException("Invalid item in user data journal.");
+
+            int dueindex = dueIndex(lockedindex);
+            if (dueindex >= 0)
+                duelist.erase(duelist.begin() + dueindex);
+            else
+            {
+                auto it = std::find(failedlist.begin(), failedlist.end(), lockedindex);
+                if (it == failedlist.end())
+                    throw ZException("Invalid item in user data journal.");
+                failedlist.erase(it);
+            }
+        }
+
+        LockedWordDeckItem *item = lockitems.items(lockedindex);
+        stream >> make_zdate(item->data->lastinclude);
+        stream >> b;
+        study->loadAnswer(stream);
+
+        if (b != 0)
+            failedlist.push_back(lockedindex);
+        else
+            duelist.insert(duelist.begin() + (-1 - dueIndex(lockedindex)), lockedindex);
+
+        testreadings.clear();
+        testreadings.load(stream);
+        break;
+    }
+    case WordDeckChange::TestDay:
+        study->loadTestDay(stream);
+        beginTestDay();
+        break;
+    case WordDeckChange::Readings:
+        testreadings.clear();
+        testreadings.load(stream);
+        break;
+    case WordDeckChange::NewStudy:
+        stream >> i;
+        newcnt = i;
+        break;
+    default:
+        throw ZException("Invalid change in user data journal.");
+    }
+}
+
+int WordDeck::lockFreeItem(int freeindex)
+{
+    FreeWordDeckItem *freeitem = freeitems.items(freeindex);
+    LockedWordDeckItem *item = new LockedWordDeckItem;
+    item->added = freeitem->added;
+    item->data = freeitem->data;
+    item->mainhint = freeitem->mainhint;
+    item->questiontype = freeitem->questiontype;
+
+    freeitems.remove(freeindex);
+
+    StudyDeck *study = studyDeck();
+    item->cardid = study->createCard(item->data->groupid, (intptr_t)item);
+    if (item->data->groupid == nullptr)
+        item->data->groupid = item->cardid;
+
+    --newcnt;
+
+    return lockitems.add(item);
+}
+
 WordDeckWord* WordDeck::addWordWithIndex(int windex)
 {
     auto it = std::lower_bound(list.begin(), list.end(), windex, [](WordDeckWord *w, int index) {
@@ -2620,13 +2776,12 @@ void WordDeck::removeWordData(WordDeckWord *dat)
 
 bool WordDeck::waitForNextItem() const 
 {
-    if (generatingnext == false)
+    std::unique_lock<std::mutex> lock(generatemutex);
+    if (!generatingnext)
         return true;
 
-    auto mil1 = std::chrono::milliseconds(1);
-    while (generatingnext)
-        std::this_thread::sleep_for(mil1 /*std::chrono::milliseconds(1)*/);
-    return nextix.locked != -1;
+    generatecond.wait(lock, [this]() { return !generatingnext; });
+    return nextix.isValid();
 }
 
 void WordDeck::abortGenerateNextItem()
@@ -2653,142 +2808,83 @@ void WordDeck::doGenerateNextItem()
     StudyDeck *study = studyDeck();
     //const StudyCard *c;
 
-    // Holds every item that was tested in the previous 10 minutes in the order
-    // they were tested.
-    std::vector<LockedWordDeckItem*> past;
-
     QDateTime now = QDateTime::currentDateTimeUtc();
     QDate testday = study->testDay(); //ltDay(now);
 
-    // Get the number of possible items for today's test for convenience.
-    auto dueit = interruptUpperBound(duelist.begin(), duelist.end(), testday, [this, study](QDate &testday, int ix, bool &stop){
-        stop = abortgenerating;
-        if (stop)
-            return false;
-
-        QDateTime d = study->cardNextTestDate(lockitems.items(ix)->cardid);
-        return testday < ltDay(d);
-    });
-
-    int duecnt = dueit - duelist.begin();
-
-    //int duecnt = 0;
-    //for (int ix : duelist)
-    //{
-    //    QDateTime d = study->cardNextTestDate(lockitems.items(ix)->cardid);
-
-    //    // Duelist is sorted by the date of future tests so we can stop once
-    //    // the first future item is encountered.
-    //    if (ltDay(d) > testday || abortgenerating)
-    //        break;
-    //    ++duecnt;
-    //}
-
-    // Collect items tested in past 10 minutes. The currentitem is also one
-    // of those, even if its data is not updated yet.
-    for (int ix = 0; ix != duecnt && !abortgenerating; ++ix)
-    {
-        LockedWordDeckItem *item = lockitems.items(duelist[ix]);
-        if (item == current || item->data->lastinclude.msecsTo(now) < 60 * 1000 * minutestowait)
-            past.push_back(item);
-    }
-    for (int ix = 0; ix != failedlist.size() && !abortgenerating; ++ix)
-    {
-        LockedWordDeckItem *item = lockitems.items(failedlist[ix]);
-        if (item == current || item->data->lastinclude.msecsTo(now) < 60 * 1000 * minutestowait)
-            past.push_back(item);
-    }
+    if (candidatesdirty || candidateday != testday)
+        buildCandidates(testday);
 
-    if (abortgenerating)
-        return;
+    // Get the number of possible items for today's test for convenience.
+    int duecnt = dueCount(testday);
 
-    // The past items are sorted in the order their group was last included in
-    // the test today. Those come first that were tested the shortest time
-    // ago. The current item and its group is the first one even though its
-    // lastinclude is not updated yet.
-    if (interruptSort(past.begin(), past.end(), [this, current](LockedWordDeckItem *a, LockedWordDeckItem *b, bool &aborted) {
-        aborted = abortgenerating;
-        if (current != nullptr)
-        {
-            if (a->data == current->data && b->data != current->data)
-                return true;
-            if (b->data == current->data)
-                return false;
-        }
-        return a->data->lastinclude > b->data->lastinclude;
-    }))
-        return;
+    // Returns whether the item's group was included in the test in the past 10 minutes. The
+    // current item's group counts as such, even if its data is not updated yet.
+    auto tested10 = [current, &now, minutestowait](const WordDeckItem *item) {
+        return (current != nullptr && item->data == current->data) || item->data->lastinclude.msecsTo(now) < 60 * 1000 * minutestowait;
+    };
 
     // New items are tested first. Look for one with the highest priority that
     // wasn't tested today, then for one not tested in the past 10 minutes. If
     // none are found try to get one that was tested the earliest.
     if (newcnt - (currentix.free != -1 ? 1 : 0) != 0)
     {
-        // Count the number of items in each priority group and go from highest to lowest.
-        int priorities[9];
-        memset(priorities, 0, sizeof(int) * 9);
-        for (int ix = 0; ix != freeitems.size() && !abortgenerating; ++ix)
-        {
-#ifdef _DEBUG
-            if (freeitems.items(ix)->priority < 1 || freeitems.items(ix)->priority > 9)
-                throw "Invalid";
-#endif
-            ++priorities[freeitems.items(ix)->priority - 1];
-        }
-
-        // Index of item in the free items list if found. If not, use previx.
-        int foundix = -1;
+        FreeWordDeckItem *found = nullptr;
 
-        // Index of possible word match. It was tested in the past 10 minutes but still
-        // earlier than the others.
-        int previx = -1;
+        // Possible item match. It was tested in the past 10 minutes but still earlier than
+        // the others.
+        FreeWordDeckItem *previtem = nullptr;
         // Time a possible result was last tested.
         QDateTime prevtime = now;
 
-        int p = 8;
-        while (foundix == -1 && p != -1 && !abortgenerating)
+        // The items in the priority queues are in order, and those not tested today are
+        // usually found at the front.
+        for (int p = 8; found == nullptr && p != -1 && !abortgenerating; --p)
         {
-            for (int ix = 0; ix != freeitems.size() && priorities[p] != 0 && !abortgenerating; ++ix)
+            // First item in the priority queue not tested in the past 10 minutes.
+            FreeWordDeckItem *found10 = nullptr;
+            for (FreeWordDeckItem *item : newqueue[p])
             {
-                FreeWordDeckItem *item = freeitems.items(ix);
-                if (item == current || item->priority != p + 1)
+                if (item == current)
                     continue;
-                --priorities[p];
 
                 // Group was not tested today.
                 if ((current == nullptr || item->data != current->data) && ltDay(item->data->lastinclude) < testday)
                 {
-                    foundix = ix;
+                    found = item;
                     break;
                 }
 
                 // Group was not tested in past 10 minutes.
-                if ((current == nullptr || item->data != current->data) && std::find_if(past.begin(), past.end(), [item](LockedWordDeckItem *a) { return (a->data == item->data); }) == past.end())
-                    foundix = ix;
-                else if (previx == -1 || previx == currentix.free || ((current == nullptr || current->data != item->data) && item->data->lastinclude < prevtime))
+                if (!tested10(item))
+                {
+                    if (found10 == nullptr)
+                        found10 = item;
+                }
+                else if (previtem == nullptr || ((current == nullptr || current->data != item->data) && item->data->lastinclude < prevtime))
                 {
                     // Group was tested in the past 10 minutes, save it in case nothing else
                     // is found. The currentitem's lastinclude is not updated yet, make sure
                     // its group is handled correctly.
                     prevtime = (current != nullptr && item->data == current->data ? now : item->data->lastinclude);
-                    previx = ix;
+                    previtem = item;
                 }
+
+                if (abortgenerating)
+                    break;
             }
 
-            --p;
+            if (found == nullptr)
+                found = found10;
         }
 
         if (abortgenerating)
             return;
 
-        if (foundix == -1)
-        {
-            // Only true if the current item is the only item tested today.
-            if (previx == -1)
-                previx = currentix.free;
-            foundix = previx;
-        }
+        if (found == nullptr)
+            found = previtem;
 
+        // Only -1 if the current item is the only item tested today.
+        int foundix = found != nullptr ? freeitems.indexOf(found) : currentix.free;
 
         if (foundix != -1)
             nextix.setFree(foundix);
@@ -2822,22 +2918,26 @@ void WordDeck::doGenerateNextItem()
     // minutes and is due. If no such item is found try one that was tested the earliest.
 
     // Items failed the last time are used in the order their group was last. tested. We
-    // select the item from the group tested the longest time ago.
+    // select the item from the group tested the longest time ago, which is the first one in
+    // the failed queue with an up to date entry.
+    auto failedEntryValid = [this](const std::pair<qint64, int> &entry) {
+        return entry.first == lockitems.items(entry.second)->data->lastinclude.toMSecsSinceEpoch() && dueIndex(entry.second) < 0;
+    };
+    while (!failedqueue.empty() && !failedEntryValid(failedqueue.front()))
+        failedqueue.pop_front();
+
     qint64 failedmsecs = -1;
     int failedindex = -1;
-    for (int ix : failedlist)
+    for (const std::pair<qint64, int> &entry : failedqueue)
     {
-        LockedWordDeckItem *litem = lockitems.items(ix);
+        LockedWordDeckItem *litem = lockitems.items(entry.second);
 
-        if (current != nullptr && current->data == litem->data)
+        if ((current != nullptr && current->data == litem->data) || !failedEntryValid(entry))
             continue;
-        if (litem->data->lastinclude.msecsTo(now) > failedmsecs)
-        {
-            failedindex = ix;
-            failedmsecs = litem->data->lastinclude.msecsTo(now);
-        }
-        if (abortgenerating)
-            break;
+
+        failedindex = entry.second;
+        failedmsecs = litem->data->lastinclude.msecsTo(now);
+        break;
     }
     if (failedmsecs >= 60 * 1000 * minutestowait || abortgenerating)
     {
@@ -2859,7 +2959,25 @@ void WordDeck::doGenerateNextItem()
         // no matter what's before them in the due list. This number is not proven to be
         // correct, so it might change in future tests.
 
-        bool shownewest = rnd(1, 10) <= 2;
+        // Items at the front of the due queues whose group has been tested today are dropped.
+        // Only the items of the current group are skipped, as they might be tested later.
+        auto testedToday = [this, testday](int ix) {
+            return !(ltDay(lockitems.items(ix)->data->lastinclude) < testday);
+        };
+        while (!duequeue.empty() && testedToday(duequeue.front()))
+            duequeue.pop_front();
+        while (!shortqueue.empty() && testedToday(shortqueue.front()))
+            shortqueue.pop_front();
+
+        // Returns the first item in queue from a group not tested today, or -1.
+        auto firstUntested = [this, current, &testedToday](const std::deque<int> &queue) {
+            for (int ix : queue)
+            {
+                if ((current == nullptr || lockitems.items(ix)->data != current->data) && !testedToday(ix))
+                    return ix;
+            }
+            return -1;
+        };
 
         if (!shownewest)
         {
@@ -2867,6 +2985,10 @@ void WordDeck::doGenerateNextItem()
             // previous 10 minutes. Otherwise remember the item that was included the longest
             // time ago.
 
+            nextix.setLocked(firstUntested(duequeue));
+            if (nextix.isValid())
+                return;
+
             for (int ix = 0; ix != duecnt && !abortgenerating; ++ix)
             {
                 LockedWordDeckItem *ditem = lockitems.items(duelist[ix]);
@@ -2899,6 +3021,10 @@ void WordDeck::doGenerateNextItem()
             // not found in the previous 10 minutes if possible. Otherwise remember the item
             // whose group was included the longest time ago.
 
+            nextix.setLocked(firstUntested(shortqueue));
+            if (nextix.isValid())
+                return;
+
             quint32 shorttime = -1;
             int shortindex = -1;
             quint32 shorttime10 = -1;
@@ -3010,6 +3136,43 @@ void WordDeck::doGenerateNextItem()
     nextix.setLocked(previndex);
 }
 
+void WordDeck::buildCandidates(QDate testday)
+{
+    StudyDeck *study = studyDeck();
+
+    duequeue.clear();
+    for (int ix = 0, siz = dueCount(testday); ix != siz; ++ix)
+        if (ltDay(lockitems.items(duelist[ix])->data->lastinclude) < testday)
+            duequeue.push_back(duelist[ix]);
+
+    shortqueue = duequeue;
+    std::stable_sort(shortqueue.begin(), shortqueue.end(), [this, study](int a, int b) {
+        return study->cardSpacing(lockitems.items(a)->cardid) < study->cardSpacing(lockitems.items(b)->cardid);
+    });
+
+    failedqueue.clear();
+    for (int ix : failedlist)
+        failedqueue.push_back(std::make_pair(lockitems.items(ix)->data->lastinclude.toMSecsSinceEpoch(), ix));
+    std::stable_sort(failedqueue.begin(), failedqueue.end(), [](const std::pair<qint64, int> &a, const std::pair<qint64, int> &b) {
+        return a.first < b.first;
+    });
+
+    for (std::deque<FreeWordDeckItem*> &queue : newqueue)
+        queue.clear();
+    for (int ix = 0, siz = freeitems.size(); ix != siz; ++ix)
+    {
+        FreeWordDeckItem *item = freeitems.items(ix);
+#ifdef _DEBUG
+        if (item->priority < 1 || item->priority > 9)
+            throw "Invalid";
+#endif
+        newqueue[item->priority - 1].push_back(item);
+    }
+
+    candidateday = testday;
+    candidatesdirty = false;
+}
+
 WordDeckItem* WordDeck::currentItem()
 {
     if (!currentix.isValid())
@@ -3062,18 +3225,16 @@ StudyDeck* WordDeck::studyDeck()
 
 NextWordDeckItemThread::NextWordDeckItemThread(WordDeck *owner) : base(), owner(owner)
 {
-    owner->generatingnext = true;
-}
-
-NextWordDeckItemThread::~NextWordDeckItemThread()
-{
-    owner->generatingnext = false;
 }
 
 void NextWordDeckItemThread::run()
 {
     owner->doGenerateNextItem();
-}
 
+    // The owner can be destroyed as soon as it's notified, so it's done under the lock.
+    std::lock_guard<std::mutex> lock(owner->generatemutex);
+    owner->generatingnext = false;
+    owner->generatecond.notify_all();
+}
 
 //-------------------------------------------------------------
@@ -11,6 +11,9 @@
 #include <QRunnable>
 #include <QSet>
 #include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 #include "smartvector.h"
 #include "qcharstring.h"
@@ -69,6 +72,7 @@ struct LockedWordDeckItem : public WordDeckItem // - ex TLockedWordStudyItem
 };
 
 class WordDeck;
+class WordIndexMap;
 template<typename T> // T is either FreeWordDeckItem or LockedWordDeckItem
 class WordDeckItems //: public TextSearchTreeBase // - ex TItemTree
 {
@@ -91,7 +95,7 @@ public:
     // types are kept, the others are deleted.
     // mainword: [new index, word data]
     // kept: [(old?) word data, question type used from that word data]
-    void applyChanges(const std::map<int, int> &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<WordDeckWord*, int> &kept);
+    void applyChanges(const WordIndexMap &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<WordDeckWord*, int> &kept);
 
     // Creates an exact copy of source, apart from the owner, which is kept unchanged. The
     // copied data will be created for this list and not just moved by pointer.
@@ -203,7 +207,7 @@ public:
     //           with the same new index is exact match.
     // Every reading for words where the match is not exact, or mergedest does not contain it
     // must be removed from the readings test.
-    void applyChanges(const std::map<int, int> &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<int, bool> &match);
+    void applyChanges(const WordIndexMap &changes, const std::map<int, WordDeckWord*> &mainword, const std::map<int, bool> &match);
 
     void copy(ReadingTestList *src);
 
@@ -286,9 +290,14 @@ public:
     void load(QDataStream &stream);
     void save(QDataStream &stream) const;
 
+    // Replaces the deck at index and its study deck with those written by saveDeck().
+    void loadDeck(int index, QDataStream &stream, int version);
+    // Writes the deck at index together with its study deck, for the user data journal.
+    void saveDeck(int index, QDataStream &stream) const;
+
     void clear();
 
-    void applyChanges(Dictionary *olddict, std::map<int, int> &changes);
+    void applyChanges(Dictionary *olddict, const WordIndexMap &changes);
     //void swap(WordDeckList *other);
 
     void copy(WordDeckList *src);
@@ -340,20 +349,24 @@ private:
     typedef QObject base;
 };
 
+// Computes the item to be tested next in a word deck on the global thread pool, while the
+// current item is shown.
 class NextWordDeckItemThread : public QRunnable
 {
 public:
     NextWordDeckItemThread(WordDeck *owner);
-    ~NextWordDeckItemThread();
 
     virtual void run() override;
-
 private:
     WordDeck *owner;
 
     typedef QRunnable base;
 };
 
+// Changes of a word deck written to the user data journal on their own, instead of writing
+// the whole deck.
+enum class WordDeckChange : uchar { Answer, TestDay, Readings, NewStudy };
+
 class WordDeck : public QObject
 {
     Q_OBJECT
@@ -378,6 +391,9 @@ public:
     void load(QDataStream &stream);
     void save(QDataStream &stream) const;
 
+    // Replays a change of the deck written to the user data journal.
+    void loadChange(QDataStream &stream);
+
     void saveWordDeckItem(QDataStream &stream, const WordDeckItem *w) const;
     void loadWordDeckItem(QDataStream &stream, WordDeckItem *w);
     void loadFreeDeckItem(QDataStream &stream, FreeWordDeckItem *w);
@@ -400,7 +416,7 @@ public:
     // If more words are mapped to a single new index, their data is merged when possible.
     // Otherwise some data will be lost. Olddict is the dictionary holding the old word
     // entries. The dictionary() is already updated.
-    void applyChanges(Dictionary *olddict, std::map<int, int> &changes);
+    void applyChanges(Dictionary *olddict, const WordIndexMap &changes);
 
     // Copies the deck data from source. Requests a new study deck for itself and fills the
     // deck with data copied from src as well. The owner is not changed.
@@ -520,6 +536,10 @@ public:
     // in types to an OR-ed combination of WordPartBits. Only those items will be added that
     // were missing. Returns the number of word parts that were added.
     int queueWordItems(const std::vector<std::pair<int, int>> &parts);
+    // Removes the queued and studied items of words. The passed vector should hold
+    // [dictionary word index, word parts] pairs like in queueWordItems(). The words' data is
+    // removed with their last item. Returns the number of items that were removed.
+    int removeWordItems(const std::vector<std::pair<int, int>> &parts);
 
     // Number of words in the queue, only counting one of the question types.
     int queueUniqueSize() const;
@@ -565,6 +585,11 @@ public:
     // If the item is not in duelist, the result is -[insert index] - 1. For
     // example a result of -1 means the index should be 0.
     int dueIndex(int lockindex) const;
+    // Returns the number of items at the front of the sorted duelist which are due on day
+    // of the long-term study, or earlier.
+    int dueCount(QDate day) const;
+    // Ordering of items in duelist with the same due time.
+    static bool dueItemLess(const LockedWordDeckItem *a, const LockedWordDeckItem *b);
 
 #ifdef _DEBUG
     // Checks the correct ordering of the due list and throws on error.
@@ -673,6 +698,19 @@ private:
     // removed and the cards of its items must be deleted separately.
     void removeWordData(WordDeckWord *dat);
 
+    // Writes a change of the deck to be appended to the user data journal, and marks the user
+    // data as modified. For an answer, pass the index the answered item had in freeitems in
+    // freeindex if it was new, and -1 otherwise.
+    void journalChange(WordDeckChange change, int freeindex = -1);
+
+    // Moves the item at freeindex in freeitems to lockitems, creating a card for it on the
+    // study deck. Returns the item's index in lockitems.
+    int lockFreeItem(int freeindex);
+
+    // Updates the item lists after the study deck started a new test day. The items failed
+    // on the last test day are moved to duelist, and the readings test is cleared.
+    void beginTestDay();
+
     // Blocks the main thread while a next item is being computed, unless
     // it's already found. Returns false if the item thread was running
     // but found no items to be shown next. Returns true if no item thread
@@ -685,12 +723,16 @@ private:
 
     // Computes the item to be shown next in a word test. It is called from
     // a separate thread and should only change the value of nextitem and
-    // nextindex.
+    // nextindex, and the candidate queues.
     // Accesses the following values: (that must be protected in the main thread)
     //      LockedWordDeckItem::data->lastinclude.
     //      items list.
     void doGenerateNextItem();
 
+    // Fills the candidate queues used in doGenerateNextItem() from the item lists, for the
+    // test on testday.
+    void buildCandidates(QDate testday);
+
     // Returns an item from either freeitems or lockitems, that is currently
     // being shown in a test.
     WordDeckItem* currentItem();
@@ -734,12 +776,43 @@ private:
     // separate thread.
     FLIndex nextix;
 
-    // Next item is being generated. Don't access nextix from the main thread.
-    std::atomic_bool generatingnext;
+    // Next item is being generated on the thread pool. Don't access nextix from the main
+    // thread while it's set. Guarded by generatemutex.
+    bool generatingnext;
+    mutable std::mutex generatemutex;
+    // Notified when generatingnext is cleared.
+    mutable std::condition_variable generatecond;
+    // Whether the next item should be taken from the newest due items. It's decided before
+    // the item is generated, so the random engine is only used on the main thread.
+    bool shownewest;
     // Set to true to abort generating the next item, and call the blocking
     // waitForNextItem(). Or call abortGenerateNextItem() which does that.
     std::atomic_bool abortgenerating;
 
+    // Candidate queues for the next item. They are filled by buildCandidates() the first time
+    // they are needed on a test day, and kept up to date by answer(), so finding the next
+    // item doesn't depend on the size of the deck.
+
+    // Set when the item lists or the cards changed outside answer(), and the candidate queues
+    // must be filled again before their next use.
+    bool candidatesdirty;
+    // Test day the candidate queues were filled for.
+    QDate candidateday;
+    // Indexes in lockitems of items due on the test day in the order of duelist, whose group
+    // hasn't been tested that day yet. Items of groups tested since are only skipped and
+    // dropped when they get to the front.
+    std::deque<int> duequeue;
+    // Items of duequeue ordered by their spacing, starting with the shortest.
+    std::deque<int> shortqueue;
+    // [time the group was last included in milliseconds since epoch, index in lockitems]
+    // pairs of items in failedlist, in the order their group was last included. When a group
+    // is tested again, its failed items are added to the back again, and the entries with an
+    // outdated time are skipped.
+    std::deque<std::pair<qint64, int>> failedqueue;
+    // Items of freeitems for each priority starting with priority 1, in their order in
+    // freeitems.
+    std::deque<FreeWordDeckItem*> newqueue[9];
+
     // -- End of temporary values.
 
     // Name of the deck. At most 255 characters long.
@@ -0,0 +1,225 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <algorithm>
+
+#include "wordformindex.h"
+#include "zkanjimain.h"
+#include "qcharstring.h"
+#include "words.h"
+#include "grammar.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Maximum number of characters following the part of an inflected word that's written
+    // the same way as its dictionary form.
+    const int maxInflectionLength = 10;
+}
+
+WordFormIndex::WordFormIndex(const Dictionary *dict) : dict(dict)
+{
+    list.reserve(dict->entryCount() * 2);
+    for (int ix = 0, siz = dict->entryCount(); ix != siz; ++ix)
+    {
+        const WordEntry *w = dict->wordEntry(ix);
+
+        Form f;
+        f.windex = ix;
+        f.len = w->kanji.size();
+        f.kana = false;
+        list.push_back(f);
+
+        // Words written in kana have the same kanji and kana forms.
+        if (w->kana == w->kanji)
+            continue;
+
+        f.len = w->kana.size();
+        f.kana = true;
+        list.push_back(f);
+    }
+
+    std::sort(list.begin(), list.end(), [this](const Form &a, const Form &b) {
+        int r = qcharcmp(formData(a), formData(b));
+        return r < 0 || (r == 0 && a.windex < b.windex);
+    });
+}
+
+void WordFormIndex::find(const QChar *str, int len, std::vector<int> &result) const
+{
+    if (len == 0)
+        return;
+
+    int first = 0;
+    int last = list.size();
+    for (int ix = 0; ix != len && first != last; ++ix)
+        narrow(first, last, ix, str[ix]);
+
+    // Forms equal to str come first in the range of forms starting with it.
+    for (; first != last && list[first].len == len; ++first)
+        result.push_back(list[first].windex);
+}
+
+void WordFormIndex::segment(const QString &text, std::vector<TextSegment> &result) const
+{
+    result.clear();
+
+    const QChar *dat = text.constData();
+    const int len = text.size();
+
+    // Every word matching the text. The matches at pos are between starts[pos] and
+    // starts[pos + 1].
+    std::vector<TextSegment> matches;
+    std::vector<int> starts(len + 1);
+    for (int pos = 0; pos != len; ++pos)
+    {
+        starts[pos] = matches.size();
+        matchesAt(dat, pos, len, matches);
+    }
+    starts[len] = matches.size();
+
+    // Number of characters covered by words and the number of words used from each position
+    // to the end of the text along the best split. The length of the first word of that
+    // split is in step, which is 0 when the character at the position is skipped.
+    std::vector<int> cover(len + 1, 0);
+    std::vector<int> count(len + 1, 0);
+    std::vector<int> step(len + 1, 0);
+    for (int pos = len - 1; pos != -1; --pos)
+    {
+        cover[pos] = cover[pos + 1];
+        count[pos] = count[pos + 1];
+
+        for (int ix = starts[pos]; ix != starts[pos + 1]; ++ix)
+        {
+            int l = matches[ix].len;
+            int c = l + cover[pos + l];
+            int n = count[pos + l] + 1;
+            if (c > cover[pos] || (c == cover[pos] && (n < count[pos] || (n == count[pos] && l > step[pos]))))
+            {
+                cover[pos] = c;
+                count[pos] = n;
+                step[pos] = l;
+            }
+        }
+    }
+
+    for (int pos = 0; pos != len; )
+    {
+        if (step[pos] == 0)
+        {
+            ++pos;
+            continue;
+        }
+
+        for (int ix = starts[pos]; ix != starts[pos + 1]; ++ix)
+            if (matches[ix].len == step[pos])
+                result.push_back(std::move(matches[ix]));
+        pos += step[pos];
+    }
+}
+
+const QChar* WordFormIndex::formData(const Form &f) const
+{
+    const WordEntry *w = dict->wordEntry(f.windex);
+    return f.kana ? w->kana.data() : w->kanji.data();
+}
+
+void WordFormIndex::narrow(int &first, int &last, int pos, QChar ch) const
+{
+    // Every form in the range is at least pos characters long, and the null character
+    // terminating a form at pos sorts it before the longer forms.
+    auto b = list.begin();
+    first = std::lower_bound(b + first, b + last, ch.unicode(), [this, pos](const Form &f, ushort c) {
+        return formData(f)[pos].unicode() < c;
+    }) - b;
+    last = std::upper_bound(b + first, b + last, ch.unicode(), [this, pos](ushort c, const Form &f) {
+        return c < formData(f)[pos].unicode();
+    }) - b;
+}
+
+void WordFormIndex::matchesAt(const QChar *text, int pos, int len, std::vector<TextSegment> &result) const
+{
+    int start = result.size();
+
+    // Number of characters from pos that are the start of at least one written form.
+    int reach = 0;
+
+    int first = 0;
+    int last = list.size();
+    while (pos + reach != len)
+    {
+        narrow(first, last, reach, text[pos + reach]);
+        if (first == last)
+            break;
+        ++reach;
+
+        for (int ix = first; ix != last && list[ix].len == reach; ++ix)
+        {
+            TextSegment s;
+            s.pos = pos;
+            s.len = reach;
+            s.windex = list[ix].windex;
+            result.push_back(s);
+        }
+    }
+
+    if (reach == 0)
+        return;
+
+    // Inflections only change the kana at the end of words. The changed part starts within
+    // the characters matching a written form and can only continue in hiragana.
+    int infend = pos + reach;
+    while (infend != len && infend - pos - reach != maxInflectionLength && HIRAGANA(text[infend].unicode()))
+        ++infend;
+
+    smartvector<InflectionForm> deinfs;
+    std::vector<int> words;
+    for (int end = pos + 1; end <= infend; ++end)
+    {
+        if (!HIRAGANA(text[end - 1].unicode()))
+            continue;
+
+        deinfs.clear();
+        deinflect(QString(text + pos, end - pos), deinfs);
+
+        for (int ix = 0; ix != deinfs.size(); ++ix)
+        {
+            const InflectionForm *inf = deinfs[ix];
+
+            words.clear();
+            find(inf->form.constData(), inf->form.size(), words);
+
+            for (int windex : words)
+            {
+                // The same word can be found through different inflections, or written in
+                // the text in its dictionary form.
+                if (std::find_if(result.begin() + start, result.end(), [end, pos, windex](const TextSegment &s) { return s.len == end - pos && s.windex == windex; }) != result.end())
+                    continue;
+
+                const WordEntry *w = dict->wordEntry(windex);
+                bool typematch = false;
+                for (int iy = 0; !typematch && iy != w->defs.size(); ++iy)
+                    typematch = (w->defs[iy].attrib.types & (1 << (int)inf->type)) != 0;
+                if (!typematch)
+                    continue;
+
+                TextSegment s;
+                s.pos = pos;
+                s.len = end - pos;
+                s.windex = windex;
+                s.inf = inf->inf;
+                result.push_back(s);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------
+
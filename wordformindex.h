@@ -0,0 +1,72 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef WORDFORMINDEX_H
+#define WORDFORMINDEX_H
+
+#include <QString>
+#include <vector>
+
+enum class InfTypes : int;
+
+// A word found in a text by WordFormIndex::segment().
+struct TextSegment
+{
+    // Position of the first character of the word in the text.
+    int pos;
+    // Number of characters the word takes up in the text.
+    int len;
+    // Index of the word in the dictionary.
+    int windex;
+    // Inflections that were removed from the text to get the written form of the word. Empty
+    // when the word is written in the text the same way as in the dictionary.
+    std::vector<InfTypes> inf;
+};
+
+class Dictionary;
+// Written kanji and kana forms of every word in a dictionary, ordered by their characters.
+// The forms matching the start of any text are found by narrowing the range of forms
+// starting with the text one character at a time.
+class WordFormIndex
+{
+public:
+    WordFormIndex(const Dictionary *dict);
+
+    // Adds the index of words to result that have a written form exactly matching str.
+    void find(const QChar *str, int len, std::vector<int> &result) const;
+
+    // Splits text into the longest dictionary words that cover the most characters of the
+    // text, with as few words as possible. Inflected words are found in their dictionary
+    // forms. The result holds every word matching each part of the text in the order of their
+    // position. Parts of the text not matching any word are skipped.
+    void segment(const QString &text, std::vector<TextSegment> &result) const;
+private:
+    struct Form
+    {
+        int windex;
+        // Number of characters in the written form.
+        ushort len;
+        // The form is the kana of the word, not the kanji.
+        bool kana;
+    };
+
+    // Returns the characters of the written form f, terminated by a null character.
+    const QChar* formData(const Form &f) const;
+
+    // Narrows the range of forms from first to last, which all start with the same pos
+    // number of characters, to the forms having ch as their next character.
+    void narrow(int &first, int &last, int pos, QChar ch) const;
+
+    // Adds the words to result that match the text at pos either as written or inflected.
+    void matchesAt(const QChar *text, int pos, int len, std::vector<TextSegment> &result) const;
+
+    const Dictionary *dict;
+
+    std::vector<Form> list;
+};
+
+
+#endif // WORDFORMINDEX_H
@@ -18,6 +18,10 @@
 
 #include <QXmlStreamWriter>
 #include <QXmlStreamReader>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QSaveFile>
+#include <QTimer>
 
 #include <algorithm>
 #include <set>
@@ -28,6 +32,8 @@
 #include "romajizer.h"
 #include "groups.h"
 #include "kanji.h"
+#include "kanjiindex.h"
+#include "wordformindex.h"
 #include "studydecks.h"
 #include "worddeck.h"
 #include "grammar.h"
@@ -47,7 +53,24 @@ extern char ZKANJI_PROGRAM_VERSION[];
 static char ZKANJI_BASE_FILE_VERSION[] = "002";
 static char ZKANJI_DICTIONARY_FILE_VERSION[] = "001";
 
-static char ZKANJI_GROUP_FILE_VERSION[] = "002";
+static char ZKANJI_GROUP_FILE_VERSION[] = "003";
+static char ZKANJI_JOURNAL_FILE_VERSION[] = "003";
+static char ZKANJI_DELTA_FILE_VERSION[] = "002";
+
+// Size of the user data journal in bytes that is always allowed before the user data file is
+// rewritten instead. Larger journals are allowed up to USER_JOURNAL_RATIO times the size of
+// the user data file.
+static const qint64 USER_JOURNAL_LIMIT = 4 * 1024 * 1024;
+static const int USER_JOURNAL_RATIO = 4;
+
+// Record types in the user data journal apart from the UserDataSection values, which are
+// used for records holding a whole section of the user data.
+// A single word deck with its study deck, after the index of the deck.
+static const quint8 USER_JOURNAL_DECK = 0xff;
+// A change of a word deck written by the deck, after the index of the deck.
+static const quint8 USER_JOURNAL_DECK_CHANGE = 0xfe;
+// The items of a single group, after the type of the group and its full encoded name.
+static const quint8 USER_JOURNAL_GROUP = 0xfd;
 
 const QChar GLOSS_SEP_CHAR = QChar(0x0082);
 
@@ -306,7 +329,7 @@ namespace ZKanji
         }
     }
 
-    void saveUserData(bool forced)
+    void saveUserData(bool forced, bool journaled)
     {
         if (forced || ZKanji::profile().isModified())
             ZKanji::profile().save(userFolder() + "/data/student.zkp");
@@ -357,7 +380,9 @@ namespace ZKanji
                 d->save(userFolder() + QString("/data/%1.zkdict").arg(d->name()));
             }
 
-            if (forced || d->isUserModified())
+            if (!forced && journaled && d->isUserModified())
+                d->journalUserData(userFolder() + QString("/data/%1.zkuser").arg(d->name()));
+            else if (forced || d->isUserModified())
                 d->saveUserData(userFolder() + QString("/data/%1.zkuser").arg(d->name()));
         }
     }
@@ -451,7 +476,8 @@ namespace ZKanji
         }
 
         bool fail = false;
-        fail = QFile::exists(ZKanji::userFolder() + "/data/English.zkuser") && !QFile::copy(ZKanji::userFolder() + "/data/English.zkuser", dir.absolutePath() + "/Engilsh.zkuser");
+        fail = QFile::exists(ZKanji::userFolder() + "/data/English.zkuser") && !QFile::copy(ZKanji::userFolder() + "/data/English.zkuser", dir.absolutePath() + "/English.zkuser");
+        fail = (QFile::exists(ZKanji::userFolder() + "/data/English.zkuser.journal") && !QFile::copy(ZKanji::userFolder() + "/data/English.zkuser.journal", dir.absolutePath() + "/English.zkuser.journal")) || fail;
         fail = (QFile::exists(ZKanji::userFolder() + "/data/student.zkp") && !QFile::copy(ZKanji::userFolder() + "/data/student.zkp", dir.absolutePath() + "/student.zkp")) || fail;
 
         for (int ix = 1, siz = ZKanji::dictionaryCount(); !fail && ix != siz; ++ix)
@@ -459,6 +485,7 @@ namespace ZKanji
             QString n = ZKanji::dictionary(ix)->name();
             fail = (QFile::exists(ZKanji::userFolder() + QString("/data/%1.zkdict").arg(n)) && !QFile::copy(ZKanji::userFolder() + QString("/data/%1.zkdict").arg(n), dir.absolutePath() + QString("/%1.zkdict").arg(n))) || fail;
             fail = (QFile::exists(ZKanji::userFolder() + QString("/data/%1.zkuser").arg(n)) && !QFile::copy(ZKanji::userFolder() + QString("/data/%1.zkuser").arg(n), dir.absolutePath() + QString("/%1.zkuser").arg(n))) || fail;
+            fail = (QFile::exists(ZKanji::userFolder() + QString("/data/%1.zkuser.journal").arg(n)) && !QFile::copy(ZKanji::userFolder() + QString("/data/%1.zkuser.journal").arg(n), dir.absolutePath() + QString("/%1.zkuser.journal").arg(n))) || fail;
         }
 
         if (fail)
@@ -717,109 +744,82 @@ void WordAttributeFilterList::add(const QString &name, const WordDefAttrib &attr
     emit filterCreated();
 }
 
-bool WordAttributeFilterList::match(const WordEntry *w, const WordFilterConditions *conditions) const
+WordFilterProgram WordAttributeFilterList::compile(const WordFilterConditions *conditions) const
 {
-    if (conditions->groups != Inclusion::Ignore)
-    {
-        if ((conditions->groups == Inclusion::Include) == ((w->dat & (1 << (int)WordRuntimeData::InGroup)) == 0) /*((w->inf & (1 << (int)WordInfo::InGroup)) == 0)*/)
-            return false;
-    }
-
-    const WordCommons *commons = nullptr;
+    WordFilterProgram result;
+    if (conditions == nullptr)
+        return result;
 
-    if (conditions->examples != Inclusion::Ignore)
-        commons = ZKanji::commons.findWord(w->kanji.data(), w->kana.data(), w->romaji.data());
-
-    if (conditions->examples != Inclusion::Ignore && (conditions->examples == Inclusion::Include) == (commons == nullptr || commons->examples.empty()))
-        return false;
-
-    for (int ix = 0; commons == nullptr && ix != conditions->inclusions.size(); ++ix)
-    {
-        if (list[ix].jlpt != 0)
-        {
-            commons = ZKanji::commons.findWord(w->kanji.data(), w->kana.data(), w->romaji.data());
-            break;
-        }
-    }
+    result.examples = conditions->examples;
+    result.groups = conditions->groups;
 
     for (int ix = 0; ix != conditions->inclusions.size(); ++ix)
     {
-        if (conditions->inclusions[ix] != Inclusion::Ignore && domatch(w, commons, ix) != (conditions->inclusions[ix] == Inclusion::Include))
-            return false;
+        if (conditions->inclusions[ix] == Inclusion::Ignore)
+            continue;
+
+        const WordAttributeFilter &f = list[ix];
+        result.steps.push_back({ f.attrib, f.inf, f.jlpt, f.matchtype == FilterMatchType::AllMustMatch, conditions->inclusions[ix] == Inclusion::Include });
     }
-    return true;
+
+    return result;
 }
 
-bool WordAttributeFilterList::domatch(const WordEntry *w, const WordCommons *commons,  int index) const
+
+//-------------------------------------------------------------
+
+
+WordFilterProgram::WordFilterProgram() : examples(Inclusion::Ignore), groups(Inclusion::Ignore)
 {
-    const WordAttributeFilter &f = list[index];
 
-    if (f.matchtype == FilterMatchType::AllMustMatch)
-    {
-        if (f.inf != 0)
-        {
-            if ((f.inf & w->inf) != f.inf)
-                return false;
-        }
+}
 
-        WordDefAttrib attrib;
-        for (int ix = 0; ix != w->defs.size(); ++ix)
-        {
-            attrib.types |= w->defs[ix].attrib.types;
-            attrib.notes |= w->defs[ix].attrib.notes;
-            attrib.fields |= w->defs[ix].attrib.fields;
-            attrib.dialects |= w->defs[ix].attrib.dialects;
-        }
+bool WordFilterProgram::empty() const
+{
+    return examples == Inclusion::Ignore && groups == Inclusion::Ignore && steps.empty();
+}
 
-        if ((f.attrib.types & attrib.types) != f.attrib.types ||
-            (f.attrib.notes & attrib.notes) != f.attrib.notes ||
-            (f.attrib.fields & attrib.fields) != f.attrib.fields ||
-            (f.attrib.dialects & attrib.dialects) != f.attrib.dialects)
-            return false;
+bool WordFilterProgram::match(const Dictionary *dict, int windex) const
+{
+    const WordEntry *w = dict->wordEntry(windex);
 
-        if (f.jlpt != 0)
-        {
-            //if (!commonsset)
-            //{
-            //    commons = ZKanji::commons.findWord(w->kanji.data(), w->kana.data(), w->romaji.data());
-            //    commonsset = true;
-            //}
+    if (groups != Inclusion::Ignore && (groups == Inclusion::Include) == ((w->dat & (1 << (int)WordRuntimeData::InGroup)) == 0))
+        return false;
 
-            if (commons == nullptr || (1 << (5 - commons->jlptn)) != f.jlpt)
-                return false;
-        }
+    if (examples == Inclusion::Ignore && steps.empty())
         return true;
-    }
 
-    // Any match counts.
+    const WordAttributes &a = dict->wordAttributes(windex);
 
-    if (f.inf != 0)
-    {
-        if ((f.inf & w->inf) != 0)
-            return true;
-    }
+    if (examples != Inclusion::Ignore && (examples == Inclusion::Include) != a.examples)
+        return false;
 
-    for (int ix = 0; ix != w->defs.size(); ++ix)
-    {
-        if ((f.attrib.types & w->defs[ix].attrib.types) != 0 ||
-            (f.attrib.notes & w->defs[ix].attrib.notes) != 0 ||
-            (f.attrib.fields & w->defs[ix].attrib.fields) != 0 ||
-            (f.attrib.dialects & w->defs[ix].attrib.dialects))
-            return true;
-    }
-    if (f.jlpt != 0)
+    for (const Step &step : steps)
     {
-        //if (!commonsset)
-        //{
-        //    commons = ZKanji::commons.findWord(w->kanji.data(), w->kana.data(), w->romaji.data());
-        //    commonsset = true;
-        //}
+        bool matched;
+        if (step.all)
+        {
+            matched = (step.inf & w->inf) == step.inf &&
+                (step.attrib.types & a.attrib.types) == step.attrib.types &&
+                (step.attrib.notes & a.attrib.notes) == step.attrib.notes &&
+                (step.attrib.fields & a.attrib.fields) == step.attrib.fields &&
+                (step.attrib.dialects & a.attrib.dialects) == step.attrib.dialects &&
+                (step.jlpt == 0 || step.jlpt == a.jlpt);
+        }
+        else
+        {
+            matched = (step.inf & w->inf) != 0 ||
+                (step.attrib.types & a.attrib.types) != 0 ||
+                (step.attrib.notes & a.attrib.notes) != 0 ||
+                (step.attrib.fields & a.attrib.fields) != 0 ||
+                (step.attrib.dialects & a.attrib.dialects) != 0 ||
+                (step.jlpt & a.jlpt) != 0;
+        }
 
-        if (commons != nullptr && ((1 << (5 - commons->jlptn)) & f.jlpt) != 0)
-            return true;
+        if (matched != step.include)
+            return false;
     }
-
-    return false;
+    return true;
 }
 
 //-------------------------------------------------------------
@@ -1656,6 +1656,8 @@ void TextSearchTree::findWords(std::vector<int> &result, QString search, bool ex
         wordpooldata = wordpool->data();
     }
 
+    WordFilterProgram filter = ZKanji::wordfilters().compile(conditions);
+
     if (!kana)
     {
         QString str = search.toLower();
@@ -1734,12 +1736,8 @@ void TextSearchTree::findWords(std::vector<int> &result, QString search, bool ex
             int line = lines[ix];
             int windex = wordForLine(lines[ix]);
 
-            if (conditions != nullptr)
-            {
-                const WordEntry *w = dict->wordEntry(windex);
-                if (!ZKanji::wordfilters().match(w, conditions))
-                    continue;
-            }
+            if (!filter.empty() && !filter.match(dict, windex))
+                continue;
 
             bool found = false;
 
@@ -1835,12 +1833,10 @@ void TextSearchTree::findWords(std::vector<int> &result, QString search, bool ex
 
         int windex = lines[ix];
 
+        if (!filter.empty() && !filter.match(dict, windex))
+            continue;
+
         WordEntry *w = dict->wordEntry(windex);
-        if (conditions != nullptr)
-        {
-            if (!ZKanji::wordfilters().match(w, conditions))
-                continue;
-        }
 
         //int klen;
 
@@ -2151,7 +2147,7 @@ void StudyDefinitionTree::copy(StudyDefinitionTree *src)
     list = src->list;
 }
 
-void StudyDefinitionTree::applyChanges(std::map<int, int> &changes)
+void StudyDefinitionTree::applyChanges(const WordIndexMap &changes)
 {
     std::set<int> found;
     int delcnt = 0;
@@ -2159,16 +2155,13 @@ void StudyDefinitionTree::applyChanges(std::map<int, int> &changes)
     {
         int newval = changes[list[ix].first];
 
-        if (newval == -1 || found.count(newval) != 0)
+        if (newval == -1 || (changes.merged(newval) && !found.insert(newval).second))
         {
             list[ix].first = -1;
             ++delcnt;
         }
         else
-        {
             list[ix].first = newval;
-            found.insert(newval);
-        }
     }
 
     std::sort(list.begin(), list.end(), [](const std::pair<int, QCharString> &a, const std::pair<int, QCharString> &b) { 
@@ -2319,7 +2312,7 @@ std::vector<std::pair<int, QCharString>>::const_iterator StudyDefinitionTree::wo
 //-------------------------------------------------------------
 
 
-WordCommonsTree::WordCommonsTree() : base(/*false,*/)
+WordCommonsTree::WordCommonsTree() : base(/*false,*/), rev(0)
 {
 }
 
@@ -2329,12 +2322,14 @@ WordCommonsTree::~WordCommonsTree()
 
 void WordCommonsTree::clear()
 {
+    ++rev;
     list.clear();
     base::clear();
 }
 
 void WordCommonsTree::load(QDataStream &stream)
 {
+    ++rev;
     quint32 cnt;
 
     stream >> cnt;
@@ -2377,6 +2372,7 @@ void WordCommonsTree::save(QDataStream &stream) const
 
 void WordCommonsTree::clearJLPTData()
 {
+    ++rev;
     int cnt = list.size();
     bool erased = false;
     for (int ix = cnt - 1; ix >= 0; --ix)
@@ -2398,6 +2394,7 @@ void WordCommonsTree::clearJLPTData()
 
 void WordCommonsTree::clearExamplesData()
 {
+    ++rev;
     int cnt = list.size();
     bool erased = false;
     for (int ix = cnt - 1; ix >= 0; --ix)
@@ -2419,6 +2416,7 @@ void WordCommonsTree::clearExamplesData()
 
 int WordCommonsTree::addJLPTN(const QChar *kanji, const QChar *kana, int jlptN, bool insertsorted)
 {
+    ++rev;
     int ix = list.size();
     
     WordCommons *wc = nullptr;
@@ -2450,6 +2448,7 @@ int WordCommonsTree::addJLPTN(const QChar *kanji, const QChar *kana, int jlptN,
 
 bool WordCommonsTree::removeJLPTN(int commonsindex)
 {
+    ++rev;
 #ifdef _DEBUG
     if (commonsindex < 0 || commonsindex >= list.size())
         throw "Index out of bounds.";
@@ -2468,6 +2467,7 @@ bool WordCommonsTree::removeJLPTN(int commonsindex)
 
 int WordCommonsTree::addExample(const QChar *kanji, const QChar *kana, const WordCommonsExample &data)
 {
+    ++rev;
     int ix = -1;
 
     if (!insertIndex(kanji, kana, ix))
@@ -2494,6 +2494,7 @@ int WordCommonsTree::addExample(const QChar *kanji, const QChar *kana, const Wor
 
 void WordCommonsTree::rebuild(bool checkandsort, const std::function<bool()> &callback)
 {
+    ++rev;
     if (checkandsort && list.size() > 1)
     {
 
@@ -2583,6 +2584,7 @@ WordCommons* WordCommonsTree::findWord(const QChar *kanji, const QChar *kana, co
 
 WordCommons* WordCommonsTree::addWord(const QChar *kanji, const QChar *kana)
 {
+    ++rev;
     WordCommons *dat = new WordCommons;
     dat->kanji.copy(kanji);
     dat->kana.copy(kana);
@@ -2597,6 +2599,11 @@ const smartvector<WordCommons>& WordCommonsTree::getItems()
     return list;
 }
 
+int WordCommonsTree::revision() const
+{
+    return rev;
+}
+
 void WordCommonsTree::doGetWord(int index, QStringList &texts) const
 {
     texts << romanize(list[index]->kana.data());
@@ -2785,7 +2792,7 @@ void WordExamplesTree::linkExample(const QChar *kanji, const QChar *kana, int ex
         list.push_back(wex);
         doExpand(list.size() - 1);
 
-        ZKanji::dictionary(0)->setToUserModified();
+        ZKanji::dictionary(0)->setToUserModified(UserDataSection::Originals);
         return;
     }
 
@@ -2805,7 +2812,7 @@ void WordExamplesTree::linkExample(const QChar *kanji, const QChar *kana, int ex
     if (match == set)
         return;
 
-    ZKanji::dictionary(0)->setToUserModified();
+    ZKanji::dictionary(0)->setToUserModified(UserDataSection::Originals);
 
     if (set)
     {
@@ -2883,7 +2890,69 @@ int WordExamplesTree::findWordIndex(const QChar *kanji, const QChar *kana, const
 //-------------------------------------------------------------
 
 
-Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false), ktree(this, true, false), btree(this, true, true), wordstudydefs(this), studydecks(new StudyDeckList)
+WordIndexMap::WordIndexMap()
+{
+
+}
+
+void WordIndexMap::reset(int oldsize, int newsize)
+{
+    table.assign(oldsize, -1);
+    refs.assign(newsize, 0);
+}
+
+int WordIndexMap::size() const
+{
+    return table.size();
+}
+
+int WordIndexMap::operator[](int windex) const
+{
+    if (windex < 0 || windex >= table.size())
+        return -1;
+    return table[windex];
+}
+
+void WordIndexMap::set(int windex, int newindex)
+{
+#ifdef _DEBUG
+    if (windex < 0 || windex >= table.size() || newindex < -1 || newindex >= (int)refs.size())
+        throw "Word index out of range.";
+#endif
+
+    if (table[windex] != -1)
+        --refs[table[windex]];
+    table[windex] = newindex;
+    if (newindex != -1)
+        ++refs[newindex];
+}
+
+bool WordIndexMap::merged(int newindex) const
+{
+    return refs[newindex] > 1;
+}
+
+void WordIndexMap::apply(std::vector<int> &list) const
+{
+    // Only new indexes with more than one word mapped to them can be duplicates.
+    std::set<int> found;
+
+    int pos = 0;
+    for (int ix = 0, siz = list.size(); ix != siz; ++ix)
+    {
+        int val = operator[](list[ix]);
+        if (val == -1 || (merged(val) && !found.insert(val).second))
+            continue;
+        list[pos++] = val;
+    }
+    list.resize(pos);
+}
+
+
+//-------------------------------------------------------------
+
+
+Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false), ktree(this, true, false), btree(this, true, true), wordstudydefs(this), studydecks(new StudyDeckList), userjournal(false), userchanges(0), userjournalqueued(false), compactiondone(false), compactionfailed(false), attribsrevision(-1)
 {
     groups = new Groups(this);
 
@@ -2901,7 +2970,7 @@ Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false)
 Dictionary::Dictionary(smartvector<WordEntry> &&words, TextSearchTree &&dtree, TextSearchTree &&ktree, TextSearchTree &&btree,
     smartvector<KanjiDictData> &&kanjidata, std::map<ushort, std::vector<int>> &&symdata, std::map<ushort, std::vector<int>> &&kanadata,
     std::vector<int> &&abcde, std::vector<int> &&aiueo) : words(std::move(words)), dtree(this, std::move(dtree)), ktree(this, std::move(ktree)), btree(this, std::move(btree)),
-    kanjidata(std::move(kanjidata)), symdata(std::move(symdata)), kanadata(std::move(kanadata)), abcde(std::move(abcde)), aiueo(std::move(aiueo)), wordstudydefs(this), studydecks(new StudyDeckList)
+    kanjidata(std::move(kanjidata)), symdata(std::move(symdata)), kanadata(std::move(kanadata)), abcde(std::move(abcde)), aiueo(std::move(aiueo)), wordstudydefs(this), studydecks(new StudyDeckList), userjournal(false), userchanges(0), userjournalqueued(false), compactiondone(false), compactionfailed(false), attribsrevision(-1)
 {
     groups = new Groups(this);
     decks = new WordDeckList(this);
@@ -2909,6 +2978,8 @@ Dictionary::Dictionary(smartvector<WordEntry> &&words, TextSearchTree &&dtree, T
 
 Dictionary::~Dictionary()
 {
+    finishUserCompaction(true);
+
     delete groups;
     delete decks;
     studydecks.release();
@@ -3112,6 +3183,97 @@ void Dictionary::loadBase(QDataStream &stream)
     ZKanji::radlist.load(stream);
 }
 
+namespace
+{
+    // Reads the data of a single word written by writeWordEntry() into w.
+    void readWordEntry(QDataStream &stream, WordEntry *w)
+    {
+        quint8 u8;
+        quint16 u16;
+        quint32 u32;
+
+        stream >> make_zstr(w->kanji, ZStrFormat::Byte);
+        stream >> make_zstr(w->kana, ZStrFormat::Byte);
+        stream >> make_zstr(w->romaji, ZStrFormat::Byte);
+
+        stream >> u16;
+        w->freq = u16;
+        stream >> u8;
+        w->inf = u8;
+
+        stream >> u8;
+        w->defs.resize(u8);
+        for (int iy = 0; iy != w->defs.size(); ++iy)
+        {
+            WordDefinition &d = w->defs[iy];
+            stream >> make_zstr(d.def, ZStrFormat::Word);
+
+            stream >> u8;
+            quint8 which = u8;
+
+            if ((which & 1) != 0)
+            {
+                stream >> u32;
+                d.attrib.types = u32;
+            }
+            if ((which & 2) != 0)
+            {
+                stream >> u32;
+                d.attrib.notes = u32;
+            }
+            if ((which & 4) != 0)
+            {
+                stream >> u32;
+                d.attrib.fields = u32;
+            }
+            if ((which & 8) != 0)
+            {
+                stream >> u16;
+                d.attrib.dialects = u16;
+            }
+        }
+    }
+
+    // Writes the data of the word w to stream in the format of the dictionary file.
+    void writeWordEntry(QDataStream &stream, const WordEntry *w)
+    {
+        stream << make_zstr(w->kanji, ZStrFormat::Byte);
+        stream << make_zstr(w->kana, ZStrFormat::Byte);
+        stream << make_zstr(w->romaji, ZStrFormat::Byte);
+
+        stream << (quint16)w->freq;
+        stream << (quint8)(w->inf & 0xff);
+        quint8 cnt = w->defs.size();
+        stream << cnt;
+        for (int iy = 0; iy != cnt; ++iy)
+        {
+            const WordDefinition &d = w->defs[iy];
+            stream << make_zstr(d.def, ZStrFormat::Word);
+
+            quint8 which = 0;
+            if (d.attrib.types != 0)
+                which |= 1;
+            if (d.attrib.notes != 0)
+                which |= 2;
+            if (d.attrib.fields != 0)
+                which |= 4;
+            if (d.attrib.dialects != 0)
+                which |= 8;
+
+            stream << which;
+
+            if (d.attrib.types != 0)
+                stream << (quint32)d.attrib.types;
+            if (d.attrib.notes != 0)
+                stream << (quint32)d.attrib.notes;
+            if (d.attrib.fields != 0)
+                stream << (quint32)d.attrib.fields;
+            if (d.attrib.dialects != 0)
+                stream << (quint16)d.attrib.dialects;
+        }
+    }
+}
+
 void Dictionary::loadFile(const QString &filename, bool basedict, bool skiporiginals)
 {
     QFile f(filename);
@@ -3146,6 +3308,10 @@ void Dictionary::loadFile(const QString &filename, bool basedict, bool skiporigi
         loadLegacy(stream, version, basedict, skiporiginals);
     else
         load(stream);
+    meaningindex.reset();
+    formindex.reset();
+    attribs.clear();
+    attribsvalid.clear();
 
     quint32 u32;
     stream >> u32;
@@ -3179,7 +3345,6 @@ void Dictionary::load(QDataStream &stream)
 
     words.reserve(cnt);
 
-    quint8 u8;
     quint16 u16;
     quint32 u32;
 
@@ -3191,48 +3356,7 @@ void Dictionary::load(QDataStream &stream)
     while (cnt--)
     {
         WordEntry *w = new WordEntry;
-
-        stream >> make_zstr(w->kanji, ZStrFormat::Byte);
-        stream >> make_zstr(w->kana, ZStrFormat::Byte);
-        stream >> make_zstr(w->romaji, ZStrFormat::Byte);
-
-        stream >> u16;
-        w->freq = u16;
-        stream >> u8;
-        w->inf = u8;
-
-        stream >> u8;
-        w->defs.resize(u8);
-        for (int iy = 0; iy != w->defs.size(); ++iy)
-        {
-            WordDefinition &d = w->defs[iy];
-            stream >> make_zstr(d.def, ZStrFormat::Word);
-
-            stream >> u8;
-            quint8 which = u8;
-
-            if ((which & 1) != 0)
-            {
-                stream >> u32;
-                d.attrib.types = u32;
-            }
-            if ((which & 2) != 0)
-            {
-                stream >> u32;
-                d.attrib.notes = u32;
-            }
-            if ((which & 4) != 0)
-            {
-                stream >> u32;
-                d.attrib.fields = u32;
-            }
-            if ((which & 8) != 0)
-            {
-                stream >> u16;
-                d.attrib.dialects = u16;
-            }
-        }
-
+        readWordEntry(stream, w);
         words.push_back(w);
     }
 
@@ -3369,6 +3493,8 @@ void Dictionary::load(QDataStream &stream)
 
 void Dictionary::loadUserDataFile(const QString &filename)
 {
+    finishUserCompaction(true);
+
     QFile f(filename);
 
     if (!f.open(QIODevice::ReadOnly))
@@ -3415,9 +3541,42 @@ void Dictionary::loadUserDataFile(const QString &filename)
         clearUserData();
         loadUserData(stream, version);
     }
+    f.close();
+
+    meaningindex.reset();
+    attribs.clear();
+    attribsvalid.clear();
 
     usermod = false;
-    emit userDataModified(false);
+    userchanges = 0;
+    userdecks.clear();
+    userdeckchanges.clear();
+    usergroups.clear();
+    userfilename = filename;
+    // Nothing is appended to the journal while it's replayed.
+    userjournal = false;
+
+    // The journal is only kept between saves. The user data is written in full when it was
+    // replayed, which also removes the journal. The journal is looked for under its new name
+    // too, in case the program stopped while the file was rewritten in the background. A
+    // journal that couldn't be replayed belongs to a different file, and is removed so later
+    // changes are not appended to it.
+    if (!oldversion && (replayUserDataJournal(filename, filename + ".journal") || replayUserDataJournal(filename, filename + ".journal.new")))
+    {
+        meaningindex.reset();
+        if (!saveUserData(filename))
+            setToUserModified();
+    }
+    else
+    {
+        // Legacy files must be written in the new format before they get a journal.
+        userjournal = !oldversion;
+        if ((QFile::exists(filename + ".journal") && !QFile::remove(filename + ".journal")) ||
+            (QFile::exists(filename + ".journal.new") && !QFile::remove(filename + ".journal.new")))
+            userjournal = false;
+    }
+
+    emit userDataModified(usermod);
     emit dictionaryReset();
 }
 
@@ -3500,7 +3659,17 @@ void Dictionary::loadUserData(QDataStream &stream, int version)
         }
 
         if (version >= 2)
-            ZKanji::wordexamples.load(stream);
+        {
+            // The word examples are shared, and only loaded for the registered dictionary,
+            // not for a copy like the base of a dictionary delta.
+            if (ZKanji::dictionaryIndex(this) != -1)
+                ZKanji::wordexamples.load(stream);
+            else
+            {
+                WordExamplesTree examples;
+                examples.load(stream);
+            }
+        }
     }
 
 #if TIMED_LOAD == 1
@@ -3509,7 +3678,7 @@ void Dictionary::loadUserData(QDataStream &stream, int version)
     t.start();
 #endif
 
-    groups->load(stream);
+    loadUserDataSection(UserDataSection::Groups, stream, version);
 
 #if TIMED_LOAD == 1
     qint64 t2 = t.nsecsElapsed();
@@ -3517,24 +3686,16 @@ void Dictionary::loadUserData(QDataStream &stream, int version)
     t.start();
 #endif
 
-    decks->clear();
-    studydecks->load(stream);
+    loadUserDataSection(UserDataSection::Decks, stream, version);
 
 #if TIMED_LOAD == 1
     qint64 t3 = t.nsecsElapsed();
     t.invalidate();
     t.start();
+    qint64 t4 = 0;
 #endif
 
-    decks->load(stream);
-
-#if TIMED_LOAD == 1
-    qint64 t4 = t.nsecsElapsed();
-    t.invalidate();
-    t.start();
-#endif
-
-    wordstudydefs.load(stream);
+    loadUserDataSection(UserDataSection::StudyDefinitions, stream, version);
 
 #if TIMED_LOAD == 1
     qint64 t5 = t.nsecsElapsed();
@@ -3542,20 +3703,7 @@ void Dictionary::loadUserData(QDataStream &stream, int version)
     t.start();
 #endif
 
-    quint16 us = 1;
-    while (us != 0)
-    {
-        stream >> us;
-        quint16 ix = us;
-        stream >> us;
-        quint16 endix = ix + us;
-        while (ix != endix)
-        {
-            stream >> kanjidata[ix]->meanings;
-            stream >> make_zvec<qint32, qint32>(kanjidata[ix]->ex);
-            ++ix;
-        }
-    }
+    loadUserDataSection(UserDataSection::Kanji, stream, version);
 
 #if TIMED_LOAD == 1
     qint64 t6 = t.nsecsElapsed();
@@ -3590,6 +3738,9 @@ void Dictionary::clearUserData()
         kanjidata[ix]->ex.clear();
         kanjidata[ix]->meanings.clear();
     }
+    meaningindex.reset();
+    attribs.clear();
+    attribsvalid.clear();
 }
 
 QDateTime Dictionary::fileWriteDate(const QString &filename)
@@ -3804,45 +3955,7 @@ Error Dictionary::save(const QString &filename)
 
         // Writing the words.
         for (int ix = 0; ix != words.size(); ++ix)
-        {
-            WordEntry *w = words[ix];
-
-            stream << make_zstr(w->kanji, ZStrFormat::Byte);
-            stream << make_zstr(w->kana, ZStrFormat::Byte);
-            stream << make_zstr(w->romaji, ZStrFormat::Byte);
-
-            stream << (quint16)w->freq;
-            stream << (quint8)(w->inf & 0xff);
-            quint8 cnt = w->defs.size();
-            stream << cnt;
-            for (int iy = 0; iy != cnt; ++iy)
-            {
-                const WordDefinition &d = w->defs[iy];
-                stream << make_zstr(d.def, ZStrFormat::Word);
-
-                quint8 which = 0;
-                if (d.attrib.types != 0)
-                    which |= 1;
-                if (d.attrib.notes != 0)
-                    which |= 2;
-                if (d.attrib.fields != 0)
-                    which |= 4;
-                if (d.attrib.dialects != 0)
-                    which |= 8;
-
-                stream << which;
-
-                if (d.attrib.types != 0)
-                    stream << (quint32)d.attrib.types;
-                if (d.attrib.notes != 0)
-                    stream << (quint32)d.attrib.notes;
-                if (d.attrib.fields != 0)
-                    stream << (quint32)d.attrib.fields;
-                if (d.attrib.dialects != 0)
-                    stream << (quint16)d.attrib.dialects;
-
-            }
-        }
+            writeWordEntry(stream, words[ix]);
 
         errorcode = 4;
 
@@ -3984,8 +4097,45 @@ Error Dictionary::save(const QString &filename)
     return true;
 }
 
+namespace
+{
+    // Returns the SHA-1 hash of the contents of the file at path, or an empty array if the
+    // file couldn't be read.
+    QByteArray fileHash(const QString &path)
+    {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly))
+            return QByteArray();
+
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        if (!hash.addData(&f))
+            return QByteArray();
+        return hash.result();
+    }
+
+    // Writes the header of a user data journal. The journal identifies the user data file it
+    // belongs to by its size and the hash of its contents. The modification time would
+    // change in copies.
+    void writeJournalHeader(QDataStream &stream, qint64 size, const QByteArray &hash)
+    {
+        stream.writeRawData("zuj", 3);
+        stream.writeRawData(ZKANJI_JOURNAL_FILE_VERSION, 3);
+        stream.writeRawData(ZKANJI_GROUP_FILE_VERSION, 3);
+        stream << size;
+        stream << hash;
+    }
+}
+
 Error Dictionary::saveUserData(const QString &filename)
 {
+    // A rewrite of the file running in the background would replace the new data.
+    finishUserCompaction(true);
+
+    // The journal must not be replayed over the new data, or appended to after it.
+    if ((QFile::exists(filename + ".journal") && !QFile::remove(filename + ".journal")) ||
+        (QFile::exists(filename + ".journal.new") && !QFile::remove(filename + ".journal.new")))
+        return Error::Access;
+
     QFile f(filename);
     if (!f.open(QIODevice::WriteOnly))
         return Error::Access;
@@ -3998,16 +4148,315 @@ Error Dictionary::saveUserData(const QString &filename)
 
     try
     {
-        stream.writeRawData("zud", 3);
-        stream.writeRawData(ZKANJI_GROUP_FILE_VERSION, 3);
+        writeUserData(stream, errorcode);
+    }
+    catch (...)
+    {
+        userjournal = false;
+        return Error(Error::Write, errorcode);
+    }
+
+    userjournal = true;
+    userfilename = filename;
+    userDataWritten();
+
+    return true;
+}
+
+void Dictionary::writeUserData(QDataStream &stream, int &errorcode) const
+{
+    errorcode = 1;
+
+    stream.writeRawData("zud", 3);
+    stream.writeRawData(ZKANJI_GROUP_FILE_VERSION, 3);
+
+    errorcode = 2;
+
+    QDateTime lastwrite = lastWriteDate();
+    stream << make_zdate(lastwrite);
+
+    // Sections are written as errorcode 3 to 7.
+    for (int ix = 0; ix != (int)UserDataSection::Count; ++ix)
+    {
+        errorcode = 3 + ix;
+
+        QByteArray data = userDataSection((UserDataSection)ix);
+        if (stream.writeRawData(data.constData(), data.size()) != data.size())
+            throw ZException("Couldn't write user data.");
+    }
+}
+
+Error Dictionary::journalUserData(const QString &filename)
+{
+    finishUserCompaction(false);
+
+    // The changed words of the main dictionary can't be replaced in the journal.
+    if (!userjournal || filename != userfilename || (userchanges & (1 << (int)UserDataSection::Originals)) != 0 || !QFileInfo::exists(filename))
+        return saveUserData(filename);
+
+    QByteArray records = userJournalRecords();
+    if (!records.isEmpty() && !appendUserJournal(filename, records))
+        return saveUserData(filename);
+
+    userDataWritten();
+
+    // The journal is not allowed to grow too large. The file is rewritten in the background
+    // instead, while the changes are still appended to the old journal.
+    if (usercompaction == nullptr && QFileInfo(filename + ".journal").size() > std::max(QFileInfo(filename).size() * USER_JOURNAL_RATIO, USER_JOURNAL_LIMIT))
+        startUserCompaction();
+
+    return true;
+}
+
+QByteArray Dictionary::userJournalRecords() const
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // Each record starts with its type and the data size, and ends with a checksum to detect
+    // partially written records.
+    auto writeRecord = [&stream](quint8 type, const QByteArray &data) {
+        stream << type;
+        stream << (qint32)data.size();
+        stream.writeRawData(data.constData(), data.size());
+        stream << (quint16)qChecksum(data.constData(), data.size());
+    };
+
+    for (int ix = 0; ix != (int)UserDataSection::Count; ++ix)
+    {
+        if ((userchanges & (1 << ix)) != 0)
+            writeRecord((quint8)ix, userDataSection((UserDataSection)ix));
+    }
+
+    // Decks removed after they were marked are not found, but their removal marked the whole
+    // section, which cleared userdecks and userdeckchanges.
+    for (WordDeck *deck : userdecks)
+    {
+        int index = decks->indexOf(deck);
+        if (index == -1)
+            continue;
+
+        QByteArray data;
+        QDataStream dstream(&data, QIODevice::WriteOnly);
+        dstream.setVersion(QDataStream::Qt_5_5);
+        dstream.setByteOrder(QDataStream::LittleEndian);
+
+        dstream << (qint32)index;
+        decks->saveDeck(index, dstream);
+
+        writeRecord(USER_JOURNAL_DECK, data);
+    }
+
+    for (const std::pair<WordDeck*, QByteArray> &change : userdeckchanges)
+    {
+        int index = decks->indexOf(change.first);
+        if (index == -1)
+            continue;
+
+        QByteArray data;
+        QDataStream dstream(&data, QIODevice::WriteOnly);
+        dstream.setVersion(QDataStream::Qt_5_5);
+        dstream.setByteOrder(QDataStream::LittleEndian);
+
+        dstream << (qint32)index;
+        dstream.writeRawData(change.second.constData(), change.second.size());
+
+        writeRecord(USER_JOURNAL_DECK_CHANGE, data);
+    }
+
+    for (GroupBase *group : usergroups)
+    {
+        QByteArray data;
+        QDataStream dstream(&data, QIODevice::WriteOnly);
+        dstream.setVersion(QDataStream::Qt_5_5);
+        dstream.setByteOrder(QDataStream::LittleEndian);
+
+        QString name = group->fullEncodedName();
+        dstream << (quint8)group->groupType();
+        dstream << make_zstr(name, ZStrFormat::Word);
+        group->save(dstream);
+
+        writeRecord(USER_JOURNAL_GROUP, data);
+    }
+
+    return result;
+}
+
+Error Dictionary::appendUserJournal(const QString &filename, const QByteArray &records)
+{
+    // A rewrite of the user data file in the background replaces the journal while holding
+    // the mutex.
+    std::lock_guard<std::mutex> lock(compactionmutex);
+
+    QFile f(filename + ".journal");
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
+        return Error::Access;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    int errorcode = 1;
+    try
+    {
+        if (f.size() == 0)
+        {
+            QByteArray filehash = fileHash(filename);
+            if (filehash.isEmpty())
+                throw ZException("Couldn't read user data.");
+            writeJournalHeader(stream, QFileInfo(filename).size(), filehash);
+        }
 
         errorcode = 2;
 
-        QDateTime lastwrite = lastWriteDate();
-        stream << make_zdate(lastwrite);
+        if (stream.writeRawData(records.constData(), records.size()) != records.size() || !f.flush() || stream.status() != QDataStream::Ok)
+            throw ZException("Couldn't write user data journal.");
+    }
+    catch (...)
+    {
+        // Records appended after a partially written one would be ignored.
+        userjournal = false;
+        return Error(Error::Write, errorcode);
+    }
 
-        errorcode = 3;
+    // The running rewrite of the user data file holds the data from before these records.
+    if (usercompaction != nullptr && !compactiondone)
+        compactionrecords.append(records);
+
+    return true;
+}
+
+void Dictionary::userDataWritten()
+{
+    userchanges = 0;
+    userdecks.clear();
+    userdeckchanges.clear();
+    usergroups.clear();
+
+    // Update modified status.
+    usermod = false;
+    emit userDataModified(false);
+}
+
+void Dictionary::queueUserJournal()
+{
+    if (userjournalqueued || !userjournal)
+        return;
+
+    // Changes made together, like the edits of several groups, are appended in one go.
+    userjournalqueued = true;
+    QTimer::singleShot(0, this, [this]() {
+        userjournalqueued = false;
+
+        // Changed dictionary words must be saved together with the user data, which is left
+        // for the next save.
+        if (!usermod || mod || !userjournal || (userchanges & (1 << (int)UserDataSection::Originals)) != 0)
+            return;
+
+        // The data is saved in full if it was loaded from a file in a different folder.
+        journalUserData(ZKanji::userFolder() + QString("/data/%1.zkuser").arg(name()));
+    });
+}
+
+void Dictionary::startUserCompaction()
+{
+    // The data is serialized right after the marked changes were appended to the journal,
+    // so it holds the data of the old file with its whole journal.
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    int errorcode;
+    try
+    {
+        writeUserData(stream, errorcode);
+    }
+    catch (...)
+    {
+        return;
+    }
+
+    compactionrecords.clear();
+    compactiondone = false;
+    compactionfailed = false;
+
+    QString filename = userfilename;
+    usercompaction.reset(new ParallelRanges(1, 1, [this, filename, data](int, int, int) {
+        compactUserData(filename, data);
+    }));
+}
+
+void Dictionary::compactUserData(const QString &filename, const QByteArray &data)
+{
+    QSaveFile f(filename);
+    if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size())
+    {
+        std::lock_guard<std::mutex> lock(compactionmutex);
+        compactionfailed = true;
+        return;
+    }
+
+    QByteArray filehash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    QString journalname = filename + ".journal";
+
+    std::lock_guard<std::mutex> lock(compactionmutex);
+
+    // The journal of the new file is written before the file replaces the old one. If the
+    // program stops before the journal is renamed, it's replayed under its new name.
+    QFile j(journalname + ".new");
+    bool good = j.open(QIODevice::WriteOnly);
+    if (good)
+    {
+        QDataStream stream(&j);
+        stream.setVersion(QDataStream::Qt_5_5);
+        stream.setByteOrder(QDataStream::LittleEndian);
+
+        writeJournalHeader(stream, data.size(), filehash);
+        good = stream.writeRawData(compactionrecords.constData(), compactionrecords.size()) == compactionrecords.size() && j.flush() && stream.status() == QDataStream::Ok;
+        j.close();
+    }
+
+    // The old file and its journal are kept if the new ones couldn't be written.
+    if (!good || !f.commit())
+    {
+        QFile::remove(journalname + ".new");
+        compactionfailed = true;
+        return;
+    }
+
+    if ((QFile::exists(journalname) && !QFile::remove(journalname)) || !QFile::rename(journalname + ".new", journalname))
+        compactionfailed = true;
+
+    compactiondone = true;
+    compactionrecords.clear();
+}
+
+void Dictionary::finishUserCompaction(bool wait)
+{
+    if (usercompaction == nullptr || (!wait && !usercompaction->finished()))
+        return;
+
+    usercompaction.reset();
+
+    // The journal can't be trusted after a failed rewrite, and the user data is saved in full
+    // the next time.
+    if (compactionfailed)
+        userjournal = false;
+}
+
+QByteArray Dictionary::userDataSection(UserDataSection section) const
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
 
+    switch (section)
+    {
+    case UserDataSection::Originals:
         if (this == ZKanji::dictionary(0))
         {
             stream << (quint8)1;
@@ -4044,27 +4493,20 @@ Error Dictionary::saveUserData(const QString &filename)
         }
         else
             stream << (quint8)0;
-
-        errorcode = 4;
-
+        break;
+    case UserDataSection::Groups:
         groups->save(stream);
-
-        errorcode = 5;
-
+        break;
+    case UserDataSection::Decks:
         // Student data must be saved before anything else which uses the spaced
         // repetition system.
         studydecks->save(stream);
-
-        errorcode = 6;
-
         decks->save(stream);
-
-        errorcode = 7;
-
+        break;
+    case UserDataSection::StudyDefinitions:
         wordstudydefs.save(stream);
-
-        errorcode = 8;
-
+        break;
+    case UserDataSection::Kanji:
         // Save a sparse list of kanji data. Only those are saved which have examples or a custom
         // meaning. The data is saved in blocks. Each block starts with the kanji index (16bit
         // ushort) and number of kanji in the block (16bit ushort). Writes a 0 length block after
@@ -4093,29 +4535,224 @@ Error Dictionary::saveUserData(const QString &filename)
                 break;
         }
 
-        errorcode = 9;
-
         stream << (qint32)0;
+        break;
+    default:
+        break;
     }
-    catch (...)
+
+    return result;
+}
+
+void Dictionary::loadUserDataSection(UserDataSection section, QDataStream &stream, int version)
+{
+    switch (section)
     {
-        return Error(Error::Write, errorcode);
+    case UserDataSection::Groups:
+        groups->clear();
+        groups->load(stream);
+        break;
+    case UserDataSection::Decks:
+        decks->clear();
+        studydecks->load(stream, version);
+        decks->load(stream);
+        break;
+    case UserDataSection::StudyDefinitions:
+        wordstudydefs.clear();
+        wordstudydefs.load(stream);
+        break;
+    case UserDataSection::Kanji:
+    {
+        for (int ix = 0, siz = kanjidata.size(); ix != siz; ++ix)
+        {
+            kanjidata[ix]->ex.clear();
+            kanjidata[ix]->meanings.clear();
+        }
+
+        quint16 us = 1;
+        while (us != 0)
+        {
+            stream >> us;
+            quint16 ix = us;
+            stream >> us;
+            quint16 endix = ix + us;
+            while (ix != endix)
+            {
+                stream >> kanjidata[ix]->meanings;
+                stream >> make_zvec<qint32, qint32>(kanjidata[ix]->ex);
+                ++ix;
+            }
+        }
+        break;
+    }
+    default:
+        break;
     }
+}
 
-    // Update modified status.
-    usermod = false;
-    emit userDataModified(false);
+bool Dictionary::replayUserDataJournal(const QString &filename, const QString &journalname)
+{
+    QFile f(journalname);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
 
-    return true;
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    char tmp[10];
+    tmp[9] = 0;
+    if (stream.readRawData(tmp, 9) != 9 || strncmp("zuj", tmp, 3))
+        return false;
+
+    int version = strtol(tmp + 6, 0, 10);
+    tmp[6] = 0;
+    int journalversion = strtol(tmp + 3, 0, 10);
+
+    qint64 size;
+    QByteArray filehash;
+    stream >> size;
+    stream >> filehash;
+
+    if (journalversion < 2 || journalversion > 3 || stream.status() != QDataStream::Ok || size != QFileInfo(filename).size() || filehash != fileHash(filename))
+        return false;
+
+    bool replayed = false;
+    while (!stream.atEnd())
+    {
+        quint8 type;
+        qint32 datasize;
+        stream >> type;
+        stream >> datasize;
+        if (stream.status() != QDataStream::Ok || datasize < 0 || (type != USER_JOURNAL_DECK && type != USER_JOURNAL_DECK_CHANGE && type != USER_JOURNAL_GROUP && (type == (int)UserDataSection::Originals || type >= (int)UserDataSection::Count)))
+            break;
+
+        QByteArray data;
+        data.resize(datasize);
+        quint16 checksum;
+        if (stream.readRawData(data.data(), datasize) != datasize)
+            break;
+        stream >> checksum;
+        // The last record might be incomplete if the program stopped while writing it.
+        if (stream.status() != QDataStream::Ok || checksum != qChecksum(data.constData(), data.size()))
+            break;
+
+        QDataStream sectionstream(data);
+        sectionstream.setVersion(QDataStream::Qt_5_5);
+        sectionstream.setByteOrder(QDataStream::LittleEndian);
+        if (type == USER_JOURNAL_DECK)
+        {
+            qint32 index;
+            sectionstream >> index;
+            if (index < 0 || index >= decks->size())
+                break;
+            decks->loadDeck(index, sectionstream, version);
+        }
+        else if (type == USER_JOURNAL_DECK_CHANGE)
+        {
+            qint32 index;
+            sectionstream >> index;
+            if (index < 0 || index >= decks->size())
+                break;
+            decks->items(index)->loadChange(sectionstream);
+        }
+        else if (type == USER_JOURNAL_GROUP)
+        {
+            quint8 grouptype;
+            QString name;
+            sectionstream >> grouptype;
+            sectionstream >> make_zstr(name, ZStrFormat::Word);
+
+            // Groups are only created and renamed in records holding the whole section.
+            GroupBase *group;
+            if (grouptype == (int)GroupTypes::Words)
+                group = groups->wordGroups().groupFromEncodedName(name);
+            else
+                group = groups->kanjiGroups().groupFromEncodedName(name);
+            if (group == nullptr)
+                break;
+            group->load(sectionstream);
+        }
+        else
+            loadUserDataSection((UserDataSection)type, sectionstream, version);
+
+        replayed = true;
+    }
+
+    return replayed;
 }
 
-void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings)
+namespace
 {
-    // TODO: error reporting to users, generally in every file operation.
+    // Number of items formatted together on a thread by exportItems().
+    const int exportChunkSize = 4096;
+
+    // Writes count items to f in the order of their index. The items are formatted by format
+    // in chunks of exportChunkSize on the global thread pool, while the previously formatted
+    // chunks are written. The format function is called with the index of the first and one past the
+    // last item in a chunk, and appends their text to str. The callback is called with the
+    // number of items written after each write, and returns false to interrupt. Returns false
+    // on a write error or when interrupted.
+    bool exportItems(QFile &f, int count, const std::function<void(int, int, QString&)> &format, const std::function<bool(int)> &callback)
+    {
+        int chunks = (count + exportChunkSize - 1) / exportChunkSize;
+        int tcnt = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+
+        // UTF-8 text of the chunks being written and of the chunks being formatted.
+        std::vector<QByteArray> writing;
+        std::vector<QByteArray> formatting;
+
+        // Index of the first chunk not yet formatted.
+        int next = 0;
+        // Number of items written to the file.
+        int written = 0;
+        while (next != chunks || !writing.empty())
+        {
+            int cnt = std::min(tcnt, chunks - next);
+            formatting.resize(cnt);
+
+            ParallelRanges formatter(cnt, 1, [&format, &formatting, count, next](int, int cfirst, int clast) {
+                for (int ix = cfirst; ix != clast; ++ix)
+                {
+                    int first = (next + ix) * exportChunkSize;
+                    int last = std::min(count, first + exportChunkSize);
+                    QString str;
+                    str.reserve((last - first) * 128);
+                    format(first, last, str);
+                    formatting[ix] = str.toUtf8();
+                }
+            });
 
+            bool ok = true;
+            for (int ix = 0; ok && ix != writing.size(); ++ix)
+                ok = f.write(writing[ix]) == writing[ix].size();
+
+            formatter.finish();
+
+            if (!ok)
+                return false;
+
+            if (!writing.empty())
+            {
+                written = std::min(count, written + (int)writing.size() * exportChunkSize);
+                if (callback && !callback(written))
+                    return false;
+            }
+
+            std::swap(writing, formatting);
+            formatting.clear();
+            next += cnt;
+        }
+
+        return true;
+    }
+}
+
+bool Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings)
+{
     QFile f(filename);
     if (!f.open(QIODevice::WriteOnly | QIODevice::Text))
-        return;
+        return false;
 
     QTextStream stream(&f);
     stream.setCodec("UTF-8");
@@ -4179,15 +4816,15 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
     // Word indexes paired with their user definition string. Each item is
     // unique.
     std::vector<std::pair<int, const QCharString&>> defs;
-    // Indexes of words already checked for user definition. If the index is
-    // in found, it shouldn't be added to defs.
-    std::set<int> found;
+    // Words already checked for user definition. If a word is marked as found, it shouldn't
+    // be added to defs.
+    std::vector<char> found(usermeanings ? words.size() : 0, 0);
 
     // Word examples selected for kanji. The numbers in the pair are:
     // <kanji_index, word_index_list>
     std::vector<std::pair<int, const std::vector<int>&>> kwords;
-    // Indexes of kanji already checked for example words.
-    std::set<int> kfound;
+    // Kanji already checked for example words.
+    std::vector<char> kfound(kexamples ? kanjidata.size() : 0, 0);
 
     // Check if there are words as kanji examples, and whether there are user definitions for
     // them (unless usermeanings is false).
@@ -4199,18 +4836,18 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
             int kix = g->items(iy)->index;
             const std::vector<int> &ex = kanjidata[kix]->ex;
 
-            if (kexamples && !kfound.count(kix))
+            if (kexamples && !kfound[kix])
             {
-                kfound.insert(kix);
+                kfound[kix] = 1;
                 kwords.push_back(std::make_pair(kix, ex));
             }
 
             for (int iz = 0; usermeanings && iz != ex.size(); ++iz)
             {
                 int wix = ex[iz];
-                if (found.count(wix) != 0)
+                if (found[wix])
                     continue;
-                found.insert(wix);
+                found[wix] = 1;
                 const QCharString *str = wordstudydefs.itemDef(wix);
                 if (str == nullptr)
                     continue;
@@ -4227,9 +4864,9 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
         for (int iy = 0; iy != indexes.size(); ++iy)
         {
             int wix = indexes[iy];
-            if (found.count(wix))
+            if (found[wix])
                 continue;
-            found.insert(wix);
+            found[wix] = 1;
             const QCharString *str = wordstudydefs.itemDef(wix);
             if (str == nullptr)
                 continue;
@@ -4326,15 +4963,16 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
         }
         stream << "\n\n";
     }
+
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
 }
 
-void Dictionary::exportDictionary(const QString &filename, bool limit, const std::vector<ushort> &kanjilimit, const std::vector<int> wordlimit)
+bool Dictionary::exportDictionary(const QString &filename, bool limit, const std::vector<ushort> &kanjilimit, const std::vector<int> &wordlimit, const std::function<bool(int, int)> &callback)
 {
-    // TODO: error reporting to users, generally in every file operation.
-
     QFile f(filename);
     if (!f.open(QIODevice::WriteOnly | QIODevice::Text))
-        return;
+        return false;
 
     QTextStream stream(&f);
     stream.setCodec("UTF-8");
@@ -4394,71 +5032,484 @@ void Dictionary::exportDictionary(const QString &filename, bool limit, const std
         "\n";
     stream << desc;
 
-    if (this == ZKanji::dictionary(0))
+    if (this == ZKanji::dictionary(0))
+    {
+        stream << "[Base]\n";
+        stream << QString("This file holds a compilation of the JMdict (http://www.edrdg.org/jmdict/j_jmdict.html)\n"
+            "dictionary file which is the property of The Electronic Dictionary Research and Development\n"
+            "Group, Monash University.\n"
+            "The file is made available under a Creative Commons Attribution-ShareAlike Licence (V3.0).\n"
+            "The group can be found at: http://www.edrdg.org/") << "\n\n";
+    }
+    else if (!info.isEmpty())
+    {
+        stream << "[About]\n";
+        QStringList infs = info.split("\n");
+
+        for (int ix = 0, siz = infs.size(); ix != siz; ++ix)
+        {
+            QString str = infs.at(ix);
+            stream << "*";
+            do
+            {
+                stream << str.left(255) << "\n";
+                str = str.mid(255);
+                if (!str.isEmpty())
+                    stream << "-";
+            } while (!str.isEmpty());
+        }
+    }
+
+
+    if (!limit || !wordlimit.empty())
+        stream << "[Words]\n";
+    stream.flush();
+
+    int wcnt = !limit ? words.size() : wordlimit.size();
+    int kcnt = !limit ? kanjidata.size() : kanjilimit.size();
+
+    auto wordsformat = [this, limit, &wordlimit](int first, int last, QString &str) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            WordEntry *e = words[!limit ? ix : wordlimit[ix]];
+            str += e->kanji.toQStringRaw() % QChar('(') % e->kana.toQStringRaw() % QStringLiteral(") ") % QString::number(e->freq) % QChar(' ') % Strings::wordInfoTags(e->inf) % QChar('\n');
+
+            for (int iy = 0, siy = e->defs.size(); iy != siy; ++iy)
+            {
+                auto &def = e->defs[iy];
+                str += QStringLiteral("D: ") % Strings::wordTypeTags(def.attrib.types) % Strings::wordNoteTags(def.attrib.notes) % Strings::wordFieldTags(def.attrib.fields) % Strings::wordDialectTags(def.attrib.dialects) % QChar('\t') % def.def.toQStringRaw() % QChar('\n');
+            }
+        }
+    };
+
+    auto progress = [&callback, wcnt, kcnt](int done) {
+        return !callback || callback(done, wcnt + kcnt);
+    };
+
+    if (!exportItems(f, wcnt, wordsformat, progress))
+    {
+        f.close();
+        f.remove();
+        return false;
+    }
+
+    if (!limit || !kanjilimit.empty())
+    {
+        stream << "\n";
+        stream << "[KanjiDefinitions]\n";
+    }
+    stream.flush();
+
+    auto kanjiformat = [this, limit, &kanjilimit](int first, int last, QString &str) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            int kix = !limit ? ix : kanjilimit[ix];
+            KanjiDictData *dat = kanjidata[kix];
+            if (dat->meanings.empty())
+                continue;
+            str += ZKanji::kanjis[kix]->ch;
+            str += QChar('\t');
+            for (int iy = 0, siy = dat->meanings.size(); iy != siy; ++iy)
+            {
+                if (iy != 0)
+                    str += GLOSS_SEP_CHAR;
+                str += dat->meanings[iy].toQStringRaw();
+            }
+            str += QChar('\n');
+        }
+    };
+
+    if (!exportItems(f, kcnt, kanjiformat, [&progress, wcnt](int done) { return progress(wcnt + done); }))
+    {
+        f.close();
+        f.remove();
+        return false;
+    }
+
+    return true;
+}
+
+Error Dictionary::saveDelta(const QString &filename, Dictionary *base)
+{
+    std::vector<std::pair<int, int>> pairs;
+    diff(base, pairs);
+
+    // Words of base missing from this dictionary.
+    std::vector<int> removed;
+    // Words of this dictionary missing from base or different in it.
+    std::vector<int> changed;
+    // Index in this dictionary of each word of base, or -1 for removed words.
+    std::vector<int> baseindexes(base->words.size(), -1);
+    for (const std::pair<int, int> &p : pairs)
+    {
+        if (p.first == -1)
+        {
+            removed.push_back(p.second);
+            continue;
+        }
+
+        if (p.second != -1)
+            baseindexes[p.second] = p.first;
+        if (p.second == -1 || !ZKanji::sameWord(words[p.first], base->words[p.second]))
+            changed.push_back(p.first);
+    }
+
+    // Words in the groups of this dictionary and of base by the full names of the groups.
+    // The words of base are listed by their index in this dictionary.
+    std::map<QString, std::set<int>> groupwords;
+    std::map<QString, std::set<int>> basegroupwords;
+    for (int ix = 0, siz = words.size(); ix != siz; ++ix)
+    {
+        std::vector<WordGroup*> *wg = wordGroups().groupsOfWord(ix, false);
+        for (int iy = 0; wg != nullptr && iy != wg->size(); ++iy)
+            groupwords[(*wg)[iy]->fullEncodedName()].insert(ix);
+    }
+    for (int ix = 0, siz = base->words.size(); ix != siz; ++ix)
+    {
+        if (baseindexes[ix] == -1)
+            continue;
+        std::vector<WordGroup*> *wg = base->wordGroups().groupsOfWord(ix, false);
+        for (int iy = 0; wg != nullptr && iy != wg->size(); ++iy)
+            basegroupwords[(*wg)[iy]->fullEncodedName()].insert(baseindexes[ix]);
+    }
+
+    // Words added to and removed from groups since base, by the full names of the groups.
+    std::map<QString, std::vector<int>> groupadded;
+    std::map<QString, std::vector<int>> groupremoved;
+    for (const auto &g : groupwords)
+    {
+        auto it = basegroupwords.find(g.first);
+        for (int windex : g.second)
+            if (it == basegroupwords.end() || it->second.count(windex) == 0)
+                groupadded[g.first].push_back(windex);
+    }
+    for (const auto &g : basegroupwords)
+    {
+        auto it = groupwords.find(g.first);
+        for (int windex : g.second)
+            if (it == groupwords.end() || it->second.count(windex) == 0)
+                groupremoved[g.first].push_back(windex);
+    }
+
+    // Studied parts of the words in the decks of this dictionary and of base, by the names
+    // of the decks. The words of base are listed by their index in this dictionary.
+    std::map<QString, std::map<int, int>> deckwords;
+    std::map<QString, std::map<int, int>> basedeckwords;
+    for (int ix = 0; ix != decks->size(); ++ix)
+    {
+        WordDeck *deck = decks->items(ix);
+        std::map<int, int> &dw = deckwords[deck->getName()];
+        for (int iy = 0, siy = deck->wordDataSize(); iy != siy; ++iy)
+            dw[deck->wordData(iy)->index] |= deck->wordData(iy)->types;
+    }
+    for (int ix = 0; ix != base->decks->size(); ++ix)
+    {
+        WordDeck *deck = base->decks->items(ix);
+        std::map<int, int> &dw = basedeckwords[deck->getName()];
+        for (int iy = 0, siy = deck->wordDataSize(); iy != siy; ++iy)
+        {
+            int windex = baseindexes[deck->wordData(iy)->index];
+            if (windex != -1)
+                dw[windex] |= deck->wordData(iy)->types;
+        }
+    }
+
+    // Parts of words added to and removed from decks since base, by the names of the decks.
+    // The words are paired with the added or removed parts.
+    std::map<QString, std::vector<std::pair<int, int>>> deckadded;
+    std::map<QString, std::vector<std::pair<int, int>>> deckremoved;
+    for (const auto &d : deckwords)
+    {
+        auto it = basedeckwords.find(d.first);
+        for (const std::pair<const int, int> &w : d.second)
+        {
+            int basetypes = 0;
+            if (it != basedeckwords.end())
+            {
+                auto wit = it->second.find(w.first);
+                if (wit != it->second.end())
+                    basetypes = wit->second;
+            }
+            if ((w.second & ~basetypes) != 0)
+                deckadded[d.first].push_back(std::make_pair(w.first, w.second & ~basetypes));
+        }
+    }
+    for (const auto &d : basedeckwords)
+    {
+        auto it = deckwords.find(d.first);
+        for (const std::pair<const int, int> &w : d.second)
+        {
+            int types = 0;
+            if (it != deckwords.end())
+            {
+                auto wit = it->second.find(w.first);
+                if (wit != it->second.end())
+                    types = wit->second;
+            }
+            if ((w.second & ~types) != 0)
+                deckremoved[d.first].push_back(std::make_pair(w.first, w.second & ~types));
+        }
+    }
+
+    QFile f(filename);
+    if (!f.open(QIODevice::WriteOnly))
+        return Error::Access;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream.writeRawData("zkdlt", 5);
+    stream.writeRawData(ZKANJI_DELTA_FILE_VERSION, 3);
+
+    // The delta can only be applied to the same dictionary as base.
+    QDateTime basedate = base->lastWriteDate();
+    stream << make_zdate(basedate);
+
+    auto writeWord = [&stream](const WordEntry *w) {
+        stream << make_zstr(w->kanji, ZStrFormat::Byte);
+        stream << make_zstr(w->kana, ZStrFormat::Byte);
+    };
+
+    stream << (quint32)removed.size();
+    for (int windex : removed)
+        writeWord(base->words[windex]);
+
+    stream << (quint32)changed.size();
+    for (int windex : changed)
+        writeWordEntry(stream, words[windex]);
+
+    for (const std::map<QString, std::vector<int>> *list : { &groupadded, &groupremoved })
     {
-        stream << "[Base]\n";
-        stream << QString("This file holds a compilation of the JMdict (http://www.edrdg.org/jmdict/j_jmdict.html)\n"
-            "dictionary file which is the property of The Electronic Dictionary Research and Development\n"
-            "Group, Monash University.\n"
-            "The file is made available under a Creative Commons Attribution-ShareAlike Licence (V3.0).\n"
-            "The group can be found at: http://www.edrdg.org/") << "\n\n";
+        stream << (quint32)list->size();
+        for (const auto &g : *list)
+        {
+            stream << make_zstr(g.first, ZStrFormat::Word);
+            stream << (quint32)g.second.size();
+            for (int windex : g.second)
+                writeWord(words[windex]);
+        }
     }
-    else if (!info.isEmpty())
+
+    for (const std::map<QString, std::vector<std::pair<int, int>>> *list : { &deckadded, &deckremoved })
     {
-        stream << "[About]\n";
-        QStringList infs = info.split("\n");
+        stream << (quint32)list->size();
+        for (const auto &d : *list)
+        {
+            stream << make_zstr(d.first, ZStrFormat::Word);
+            stream << (quint32)d.second.size();
+            for (const std::pair<int, int> &p : d.second)
+            {
+                writeWord(words[p.first]);
+                stream << (quint8)p.second;
+            }
+        }
+    }
 
-        for (int ix = 0, siz = infs.size(); ix != siz; ++ix)
+    if (stream.status() != QDataStream::Ok)
+        return Error(Error::Write);
+
+    return true;
+}
+
+Error Dictionary::applyDelta(const QString &filename)
+{
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly))
+        return Error::Access;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // A word in the delta identified by its kanji and kana.
+    typedef std::pair<QCharString, QCharString> DeltaWord;
+
+    std::vector<DeltaWord> removed;
+    smartvector<WordEntry> changed;
+    // Words to add to and remove from groups.
+    std::vector<std::pair<QString, std::vector<DeltaWord>>> groupadded;
+    std::vector<std::pair<QString, std::vector<DeltaWord>>> groupremoved;
+    // Words to add to and remove from decks with the parts of the word to study.
+    std::vector<std::pair<QString, std::vector<std::pair<DeltaWord, int>>>> deckadded;
+    std::vector<std::pair<QString, std::vector<std::pair<DeltaWord, int>>>> deckremoved;
+
+    // The whole delta is read before making any changes, so a corrupted file doesn't leave
+    // the dictionary half updated.
+    try
+    {
+        char tmp[9];
+        tmp[8] = 0;
+        stream.readRawData(tmp, 8);
+        if (strncmp("zkdlt", tmp, 5) != 0 || strncmp(ZKANJI_DELTA_FILE_VERSION, tmp + 5, 3) != 0)
+            return Error(Error::General, 1);
+
+        // The words in the delta are only found by kanji and kana, but their groups, decks
+        // and removal would be wrong in any other dictionary than the one the delta was
+        // written against.
+        QDateTime basedate;
+        stream >> make_zdate(basedate);
+        if (stream.status() != QDataStream::Ok || basedate != lastWriteDate())
+            return Error(Error::General, 3, "The update was written for a different version of the dictionary.");
+
+        quint32 cnt;
+        quint8 u8;
+
+        auto readWord = [&stream](DeltaWord &w) {
+            stream >> make_zstr(w.first, ZStrFormat::Byte);
+            stream >> make_zstr(w.second, ZStrFormat::Byte);
+        };
+
+        stream >> cnt;
+        removed.resize(cnt);
+        for (DeltaWord &w : removed)
+            readWord(w);
+
+        stream >> cnt;
+        changed.reserve(cnt);
+        while (cnt-- && stream.status() == QDataStream::Ok)
         {
-            QString str = infs.at(ix);
-            stream << "*";
-            do
+            WordEntry *w = new WordEntry;
+            changed.push_back(w);
+            readWordEntry(stream, w);
+        }
+
+        for (std::vector<std::pair<QString, std::vector<DeltaWord>>> *list : { &groupadded, &groupremoved })
+        {
+            stream >> cnt;
+            list->resize(cnt);
+            for (auto &g : *list)
             {
-                stream << str.left(255) << "\n";
-                str = str.mid(255);
-                if (!str.isEmpty())
-                    stream << "-";
-            } while (!str.isEmpty());
+                stream >> make_zstr(g.first, ZStrFormat::Word);
+                stream >> cnt;
+                g.second.resize(cnt);
+                for (DeltaWord &w : g.second)
+                    readWord(w);
+            }
+        }
+
+        for (std::vector<std::pair<QString, std::vector<std::pair<DeltaWord, int>>>> *list : { &deckadded, &deckremoved })
+        {
+            stream >> cnt;
+            list->resize(cnt);
+            for (auto &d : *list)
+            {
+                stream >> make_zstr(d.first, ZStrFormat::Word);
+                stream >> cnt;
+                d.second.resize(cnt);
+                for (auto &w : d.second)
+                {
+                    readWord(w.first);
+                    stream >> u8;
+                    w.second = u8;
+                }
+            }
         }
     }
+    catch (...)
+    {
+        return Error(Error::General, 2);
+    }
 
+    if (stream.status() != QDataStream::Ok)
+        return Error(Error::General, 2);
 
-    if (!limit || !wordlimit.empty())
-        stream << "[Words]\n";
+    // Only the lines of the search trees belonging to the changed words are updated.
+
+    for (const DeltaWord &w : removed)
+    {
+        int windex = findKanjiKanaWord(w.first, w.second);
+        if (windex != -1)
+            removeEntry(windex);
+    }
+
+    for (int ix = 0; ix != changed.size(); ++ix)
+    {
+        WordEntry *w = changed[ix];
+        int windex = findKanjiKanaWord(w->kanji, w->kana);
+        if (windex == -1)
+            addWordCopy(w, true);
+        else if (!ZKanji::sameWord(words[windex], w))
+            cloneWordData(windex, w, true, true);
+    }
 
-    for (int ix = 0, siz = !limit ? words.size() : wordlimit.size(); ix != siz; ++ix)
+    std::vector<int> indexes;
+    std::vector<int> positions;
+    for (const auto &g : groupremoved)
     {
-        WordEntry *e = words[!limit ? ix : wordlimit[ix]];
-        stream << QString("%1(%2) %3 %4\n").arg(e->kanji.toQStringRaw()).arg(e->kana.toQStringRaw()).arg(e->freq).arg(Strings::wordInfoTags(e->inf));
+        WordGroup *group = wordGroups().groupFromEncodedName(g.first);
+        if (group == nullptr)
+            continue;
 
-        for (int iy = 0, siy = e->defs.size(); iy != siy; ++iy)
+        indexes.clear();
+        for (const DeltaWord &w : g.second)
         {
-            auto &def = e->defs[iy];
-            stream << QString("D: %1%2%3%4\t%5\n").arg(Strings::wordTypeTags(def.attrib.types)).arg(Strings::wordNoteTags(def.attrib.notes)).arg(Strings::wordFieldTags(def.attrib.fields)).arg(Strings::wordDialectTags(def.attrib.dialects)).arg(def.def.toQStringRaw());
+            int windex = findKanjiKanaWord(w.first, w.second);
+            if (windex != -1)
+                indexes.push_back(windex);
         }
+        group->indexOf(indexes, positions);
+        if (positions.empty())
+            continue;
+
+        std::sort(positions.begin(), positions.end());
+        smartvector<Range> ranges;
+        _rangeFromIndexes(positions, ranges);
+        group->remove(ranges);
     }
 
-    if (!limit || !kanjilimit.empty())
+    for (const auto &g : groupadded)
     {
-        stream << "\n";
-        stream << "[KanjiDefinitions]\n";
+        WordGroup *group = wordGroups().groupFromEncodedName(g.first, 0, -1, true);
+        if (group == nullptr)
+            continue;
+
+        indexes.clear();
+        for (const DeltaWord &w : g.second)
+        {
+            int windex = findKanjiKanaWord(w.first, w.second);
+            if (windex != -1)
+                indexes.push_back(windex);
+        }
+        group->add(indexes);
     }
-    for (int ix = 0, siz = !limit ? kanjidata.size() : kanjilimit.size(); ix != siz; ++ix)
+
+    std::vector<std::pair<int, int>> parts;
+    for (const auto &d : deckremoved)
     {
-        int kix = !limit ? ix : kanjilimit[ix];
-        if (kanjidata[kix]->meanings.empty())
+        int dindex = decks->indexOf(d.first);
+        if (dindex == -1)
             continue;
-        QChar ch = ZKanji::kanjis[kix]->ch;
-        KanjiDictData *dat = kanjidata[kix];
-        stream << ch << "\t";
-        for (int iy = 0, siy = dat->meanings.size(); iy != siy; ++iy)
+
+        parts.clear();
+        for (const auto &w : d.second)
         {
-            if (iy != 0)
-                stream << GLOSS_SEP_CHAR;
-            stream << dat->meanings[iy].toQStringRaw();
+            int windex = findKanjiKanaWord(w.first.first, w.first.second);
+            if (windex != -1)
+                parts.push_back(std::make_pair(windex, w.second));
         }
-        stream << "\n";
+        decks->items(dindex)->removeWordItems(parts);
+    }
+
+    for (const auto &d : deckadded)
+    {
+        int dindex = decks->indexOf(d.first);
+        if (dindex == -1 && decks->add(d.first))
+            dindex = decks->indexOf(d.first);
+        if (dindex == -1)
+            continue;
+
+        parts.clear();
+        for (const auto &w : d.second)
+        {
+            int windex = findKanjiKanaWord(w.first.first, w.first.second);
+            if (windex != -1)
+                parts.push_back(std::make_pair(windex, w.second));
+        }
+        decks->items(dindex)->queueWordItems(parts);
     }
+
+    return true;
 }
 
 //void Dictionary::importUserData(const QString &filename, KanjiGroupCategory *kanjiroot, WordGroupCategory *wordsroot)
@@ -4652,7 +5703,7 @@ void Dictionary::setInfoText(QString text)
     setToModified();
 }
 
-void Dictionary::swapDictionaries(Dictionary *src, std::map<int, int> &changes)
+void Dictionary::swapDictionaries(Dictionary *src, const WordIndexMap &changes)
 {
     //basedate.swap(src->basedate);
 
@@ -4665,6 +5716,14 @@ void Dictionary::swapDictionaries(Dictionary *src, std::map<int, int> &changes)
     ktree.swap(src->ktree);
     btree.swap(src->btree);
     std::swap(kanjidata, src->kanjidata);
+    meaningindex.reset();
+    src->meaningindex.reset();
+    formindex.reset();
+    src->formindex.reset();
+    attribs.clear();
+    attribsvalid.clear();
+    src->attribs.clear();
+    src->attribsvalid.clear();
     std::swap(symdata, src->symdata);
     std::swap(kanadata, src->kanadata);
     std::swap(abcde, src->abcde);
@@ -4676,30 +5735,25 @@ void Dictionary::swapDictionaries(Dictionary *src, std::map<int, int> &changes)
     src->studydecks.reset(new StudyDeckList);
     src->decks->copy(decks);
 
+    // The kanji examples and the study definitions are remapped first, because the groups
+    // and decks notify others of their changes, which might read them.
     for (int ix = 0, siz = src->kanjidata.size(); ix != siz; ++ix)
     {
         if (src->kanjidata[ix]->ex.empty())
             continue;
 
-        std::set<int> found;
-        kanjidata[ix]->ex.clear();
-        kanjidata[ix]->ex.reserve(src->kanjidata[ix]->ex.size());
-        for (int iy = 0, siy = src->kanjidata[ix]->ex.size(); iy != siy; ++iy)
-        {
-            int val = changes[src->kanjidata[ix]->ex[iy]];
-
-            if (val == -1 || found.count(val) != 0)
-                continue;
-
-            kanjidata[ix]->ex.push_back(val);
-            found.insert(val);
-        }
+        kanjidata[ix]->ex = src->kanjidata[ix]->ex;
+        changes.apply(kanjidata[ix]->ex);
     }
 
     wordstudydefs.applyChanges(changes);
+
     groups->applyChanges(changes);
     decks->applyChanges(src, changes);
 
+    // The word indexes changed in every section of the user data.
+    setToUserModified();
+
     emit dictionaryReset();
 }
 
@@ -4714,6 +5768,14 @@ void Dictionary::restoreChanges(Dictionary *src)
     ktree.swap(src->ktree);
     btree.swap(src->btree);
     std::swap(kanjidata, src->kanjidata);
+    meaningindex.reset();
+    src->meaningindex.reset();
+    formindex.reset();
+    src->formindex.reset();
+    attribs.clear();
+    attribsvalid.clear();
+    src->attribs.clear();
+    src->attribsvalid.clear();
     std::swap(symdata, src->symdata);
     std::swap(kanadata, src->kanadata);
     std::swap(abcde, src->abcde);
@@ -4725,6 +5787,9 @@ void Dictionary::restoreChanges(Dictionary *src)
     studydecks.reset(new StudyDeckList);
     decks->copy(src->decks);
 
+    // The decks marked as changed were replaced by the copies.
+    setToUserModified(UserDataSection::Decks);
+
     emit dictionaryReset();
 }
 
@@ -4748,6 +5813,89 @@ bool Dictionary::isUserModified() const
 
 void Dictionary::setToUserModified()
 {
+    userchanges = (1 << (int)UserDataSection::Count) - 1;
+    userdecks.clear();
+    userdeckchanges.clear();
+    usergroups.clear();
+    queueUserJournal();
+
+    if (usermod)
+        return;
+
+    usermod = true;
+    emit userDataModified(true);
+}
+
+void Dictionary::setToUserModified(UserDataSection section)
+{
+    userchanges |= 1 << (int)section;
+    if (section == UserDataSection::Decks)
+    {
+        userdecks.clear();
+        userdeckchanges.clear();
+    }
+    else if (section == UserDataSection::Groups)
+        usergroups.clear();
+    queueUserJournal();
+
+    if (usermod)
+        return;
+
+    usermod = true;
+    emit userDataModified(true);
+}
+
+void Dictionary::setToUserModified(WordDeck *deck)
+{
+    if ((userchanges & (1 << (int)UserDataSection::Decks)) == 0 && userdecks.insert(deck).second)
+    {
+        // The recorded changes are part of the deck written whole.
+        userdeckchanges.erase(std::remove_if(userdeckchanges.begin(), userdeckchanges.end(), [deck](const std::pair<WordDeck*, QByteArray> &change) {
+            return change.first == deck;
+        }), userdeckchanges.end());
+    }
+    queueUserJournal();
+
+    if (usermod)
+        return;
+
+    usermod = true;
+    emit userDataModified(true);
+}
+
+void Dictionary::setToUserModified(WordDeck *deck, QByteArray &&change)
+{
+    // Without a journal the user data is saved in full.
+    if (!userjournal)
+    {
+        setToUserModified(deck);
+        return;
+    }
+
+    if ((userchanges & (1 << (int)UserDataSection::Decks)) == 0 && userdecks.find(deck) == userdecks.end())
+        userdeckchanges.push_back(std::make_pair(deck, std::move(change)));
+    queueUserJournal();
+
+    if (usermod)
+        return;
+
+    usermod = true;
+    emit userDataModified(true);
+}
+
+void Dictionary::setToUserModified(GroupBase *group)
+{
+    // Without a journal the user data is saved in full.
+    if (!userjournal)
+    {
+        setToUserModified(UserDataSection::Groups);
+        return;
+    }
+
+    if ((userchanges & (1 << (int)UserDataSection::Groups)) == 0)
+        usergroups.insert(group);
+    queueUserJournal();
+
     if (usermod)
         return;
 
@@ -4851,6 +5999,11 @@ void Dictionary::removeEntry(int windex)
     decks->processRemovedWord(windex);
 
     words.erase(words.begin() + windex);
+    if (windex < attribs.size())
+    {
+        attribs.erase(attribs.begin() + windex);
+        attribsvalid.erase(attribsvalid.begin() + windex);
+    }
 
     emit entryRemoved(windex, abcdeix, aiueoix);
 
@@ -5047,7 +6200,7 @@ void Dictionary::setWordStudyDefinition(int index, QString def)
         def.clear();
     if (wordstudydefs.setDefinition(index, def))
     {
-        setToUserModified();
+        setToUserModified(UserDataSection::StudyDefinitions);
         emit entryChanged(index, true);
     }
 }
@@ -5097,7 +6250,7 @@ void Dictionary::addKanjiExample(short kindex, int windex)
         return;
 
     ex.push_back(windex);
-    setToUserModified();
+    setToUserModified(UserDataSection::Kanji);
     emit kanjiExampleAdded(kindex, windex);
 }
 
@@ -5110,7 +6263,7 @@ void Dictionary::removeKanjiExample(short kindex, int windex)
 
     //emit kanjiExampleAboutToBeRemoved(kindex, windex);
     ex.erase(it);
-    setToUserModified();
+    setToUserModified(UserDataSection::Kanji);
     emit kanjiExampleRemoved(kindex, windex);
 }
 
@@ -5146,8 +6299,11 @@ void Dictionary::setKanjiMeaning(short ix, QString str)
     if (ZKanji::kanjis[ix]->meanings == kanjidata[ix]->meanings)
         kanjidata[ix]->meanings.clear();
 
+    if (meaningindex != nullptr)
+        meaningindex->update(ix);
+
     emit kanjiMeaningChanged(ix);
-    setToUserModified();
+    setToUserModified(UserDataSection::Kanji);
 }
 
 void Dictionary::setKanjiMeaning(short ix, QStringList &list)
@@ -5162,8 +6318,58 @@ void Dictionary::setKanjiMeaning(short ix, QStringList &list)
     if (ZKanji::kanjis[ix]->meanings == kanjidata[ix]->meanings)
         kanjidata[ix]->meanings.clear();
 
+    if (meaningindex != nullptr)
+        meaningindex->update(ix);
+
     emit kanjiMeaningChanged(ix);
-    setToUserModified();
+    setToUserModified(UserDataSection::Kanji);
+}
+
+const KanjiMeaningIndex& Dictionary::kanjiMeaningIndex() const
+{
+    if (meaningindex == nullptr)
+        meaningindex.reset(new KanjiMeaningIndex(this));
+    return *meaningindex;
+}
+
+const WordFormIndex& Dictionary::wordFormIndex() const
+{
+    if (formindex == nullptr)
+        formindex.reset(new WordFormIndex(this));
+    return *formindex;
+}
+
+const WordAttributes& Dictionary::wordAttributes(int windex) const
+{
+    if (attribs.size() != words.size() || attribsrevision != ZKanji::commons.revision())
+    {
+        attribs.clear();
+        attribs.resize(words.size());
+        attribsvalid.assign(words.size(), false);
+        attribsrevision = ZKanji::commons.revision();
+    }
+
+    WordAttributes &a = attribs[windex];
+    if (attribsvalid[windex])
+        return a;
+
+    const WordEntry *w = words[windex];
+    a.attrib = WordDefAttrib();
+    for (int ix = 0, siz = w->defs.size(); ix != siz; ++ix)
+    {
+        const WordDefAttrib &attrib = w->defs[ix].attrib;
+        a.attrib.types |= attrib.types;
+        a.attrib.notes |= attrib.notes;
+        a.attrib.fields |= attrib.fields;
+        a.attrib.dialects |= attrib.dialects;
+    }
+
+    const WordCommons *c = ZKanji::commons.findWord(w->kanji.data(), w->kana.data(), w->romaji.data());
+    a.jlpt = c != nullptr && c->jlptn != 0 ? (1 << (5 - c->jlptn)) : 0;
+    a.examples = c != nullptr && !c->examples.empty();
+
+    attribsvalid[windex] = true;
+    return a;
 }
 
 //WordResultList&& Dictionary::browseWords(WordResultList &&result, BrowseOrder order, const WordFilterConditions *conditions) const
@@ -5368,7 +6574,7 @@ bool Dictionary::wordMatches(int windex, SearchMode searchmode, QString search,
     //if (search.isEmpty())
     //    return false;
 
-    if (search.isEmpty() && conditions != nullptr && !ZKanji::wordfilters().match(words[windex], conditions))
+    if (search.isEmpty() && conditions != nullptr && !ZKanji::wordfilters().compile(conditions).match(this, windex))
         return false;
 
 
@@ -5566,6 +6772,8 @@ void Dictionary::findKanjiWords(std::vector<int> &result, QString search, Search
         ++symfound;
     }
 
+    WordFilterProgram filter = ZKanji::wordfilters().compile(conditions);
+
     // Create a new list which only holds words found in all kanji and the wordpool. Check
     // the filter conditions too.
     if (symfound > 1)
@@ -5585,16 +6793,16 @@ void Dictionary::findKanjiWords(std::vector<int> &result, QString search, Search
                 foundsym = 1;
                 last = temp[ix];
             }
-            if (foundsym == symfound && (conditions == nullptr || ZKanji::wordfilters().match(words[temp[ix]], conditions)))
+            if (foundsym == symfound && (filter.empty() || filter.match(this, temp[ix])))
                 wordlist.push_back(temp[ix]);
         }
     }
-    else if (conditions != nullptr)
+    else if (!filter.empty())
     {
         std::vector<int> temp;
         temp.swap(wordlist);
         for (int ix = 0; ix != temp.size(); ++ix)
-            if (ZKanji::wordfilters().match(words[temp[ix]], conditions))
+            if (filter.match(this, temp[ix]))
                 wordlist.push_back(temp[ix]);
     }
 
@@ -5783,6 +6991,8 @@ void Dictionary::findKanaWords(std::vector<int> &result, QString search, SearchW
 
     // Remove duplicates and find real matches that also fit the conditions.
 
+    WordFilterProgram filter = ZKanji::wordfilters().compile(conditions);
+
     QString romaji;
     if (!sameform)
         romaji = romanize(search);
@@ -5797,7 +7007,7 @@ void Dictionary::findKanaWords(std::vector<int> &result, QString search, SearchW
             ++found;
 
         if (found == hlen &&
-            (conditions == nullptr || ZKanji::wordfilters().match(words[list[ix]], conditions)) &&
+            (filter.empty() || filter.match(this, list[ix])) &&
             ((!sameform && words[list[ix]]->romaji.find(romaji.constData()) != -1) ||
             (sameform && words[list[ix]]->kana.find(search.constData()) != -1)))
             result.push_back(list[ix]);
@@ -6242,11 +7452,10 @@ void Dictionary::listUsedWords(std::vector<int> &result)
     // - words marked as kanji example
     // - user defined word study definitions
     // the list might not be full.
-    for (int ix = 0; ix != groups->wordGroups().size(); ++ix)
-    {
-        auto vec = groups->wordGroups().items(ix)->getIndexes();
+    groups->wordGroups().walkGroups([&result](GroupBase *g) {
+        auto &vec = ((WordGroup*)g)->getIndexes();
         result.insert(result.end(), vec.begin(), vec.end());
-    }
+    });
 
     for (int ix = 0, siz = decks->size(); ix != siz; ++ix)
     {
@@ -6276,18 +7485,16 @@ void Dictionary::listUsedWords(std::vector<int> &result)
     result.resize(std::unique(result.begin(), result.end()) - result.begin());
 }
 
-std::map<int, int> Dictionary::mapWords(Dictionary *src, const std::vector<int> &wlist)
+void Dictionary::mapWords(Dictionary *src, WordIndexMap &result)
 {
-    std::map<int, int> tmp;
-    //tmp.reserve(wlist.size());
+    result.reset(src->entryCount(), entryCount());
 
-    for (int ix = 0; ix != wlist.size(); ++ix)
-    {
-        WordEntry *e = src->wordEntry(wlist[ix]);
-        tmp.insert(std::make_pair(wlist[ix], findKanjiKanaWord(e)));
-    }
+    std::vector<std::pair<int, int>> pairs;
+    src->diff(this, pairs);
 
-    return tmp;
+    for (const std::pair<int, int> &p : pairs)
+        if (p.first != -1 && p.second != -1)
+            result.set(p.first, p.second);
 }
 
 //std::map<int, int> Dictionary::mapOriginalWords()
@@ -6307,6 +7514,122 @@ std::map<int, int> Dictionary::mapWords(Dictionary *src, const std::vector<int>
 //    return tmp;
 //}
 
+namespace
+{
+    // Keys of the words of a dictionary in abcde order, used by Dictionary::diff(). The key
+    // of a word is its romaji, hiragana converted kana, kana and kanji, each followed by a 0.
+    // Comparing two keys compares the words by each of these in order, the way the abcde
+    // list is sorted.
+    class WordDiffKeys
+    {
+    public:
+        WordDiffKeys(const smartvector<WordEntry> &words, const std::vector<int> &abcde) : abcde(abcde)
+        {
+            offsets.reserve(abcde.size());
+
+            // Reserving for the four parts of average length words.
+            buf.reserve(abcde.size() * 24);
+            for (int ix = 0, siz = abcde.size(); ix != siz; ++ix)
+            {
+                const WordEntry *w = words[abcde[ix]];
+                offsets.push_back(buf.size());
+                append(w->romaji.data(), w->romaji.size());
+                QString hira = hiraganize(w->kana);
+                append(hira.constData(), hira.size());
+                append(w->kana.data(), w->kana.size());
+                append(w->kanji.data(), w->kanji.size());
+            }
+        }
+
+        int size() const
+        {
+            return offsets.size();
+        }
+
+        // Word index of the word at pos in the abcde order.
+        int wordIndex(int pos) const
+        {
+            return abcde[pos];
+        }
+
+        const ushort* key(int pos) const
+        {
+            return buf.data() + offsets[pos];
+        }
+
+        // Returns the position of the first key not less than k.
+        int lowerBound(const ushort *k) const
+        {
+            int first = 0;
+            int len = offsets.size();
+            while (len > 0)
+            {
+                int half = len / 2;
+                if (compare(key(first + half), k) < 0)
+                {
+                    first += half + 1;
+                    len -= half + 1;
+                }
+                else
+                    len = half;
+            }
+            return first;
+        }
+
+        static int compare(const ushort *a, const ushort *b)
+        {
+            // The last part of the keys ends in a 0 after 4 parts.
+            int parts = 0;
+            while (*a == *b)
+            {
+                if (*a == 0 && ++parts == 4)
+                    return 0;
+                ++a;
+                ++b;
+            }
+            return (int)*a - (int)*b;
+        }
+    private:
+        void append(const QChar *str, int len)
+        {
+            for (int ix = 0; ix != len; ++ix)
+                buf.push_back(str[ix].unicode());
+            buf.push_back(0);
+        }
+
+        const std::vector<int> &abcde;
+
+        std::vector<ushort> buf;
+        std::vector<int> offsets;
+    };
+
+    // Adds the diff of the words between lfirst and llast in l and ofirst and olast in o to
+    // result. The words in both ranges must be in the same key range.
+    void diffRange(const WordDiffKeys &l, int lfirst, int llast, const WordDiffKeys &o, int ofirst, int olast, std::vector<std::pair<int, int>> &result)
+    {
+        int lpos = lfirst;
+        int opos = ofirst;
+        while (lpos != llast && opos != olast)
+        {
+            int d = WordDiffKeys::compare(l.key(lpos), o.key(opos));
+
+            // When d is 0 the words match. Otherwise the one that comes first is determined
+            // by the sign of d.
+            if (d == 0)
+                result.push_back(std::make_pair(l.wordIndex(lpos++), o.wordIndex(opos++)));
+            else if (d < 0)
+                result.push_back(std::make_pair(l.wordIndex(lpos++), -1));
+            else
+                result.push_back(std::make_pair(-1, o.wordIndex(opos++)));
+        }
+
+        while (lpos != llast)
+            result.push_back(std::make_pair(l.wordIndex(lpos++), -1));
+        while (opos != olast)
+            result.push_back(std::make_pair(-1, o.wordIndex(opos++)));
+    }
+}
+
 void Dictionary::diff(Dictionary *other, std::vector<std::pair<int, int>> &result)
 {
     result.clear();
@@ -6326,78 +7649,34 @@ void Dictionary::diff(Dictionary *other, std::vector<std::pair<int, int>> &resul
         return;
     }
 
-    // Compare words in abc ordering.
+    // Compare words in abc ordering. The keys of the two dictionaries are independent and
+    // are computed at the same time.
 
-    int lpos = 0;
-    int opos = 0;
-    int lsiz = words.size();
-    int osiz = other->words.size();
+    std::unique_ptr<WordDiffKeys> lkeys;
+    std::unique_ptr<WordDiffKeys> okeys;
+    ParallelRanges::run(2, 1, [&](int ix, int first, int last) {
+        if (ix == 0)
+            lkeys.reset(new WordDiffKeys(words, abcde));
+        else
+            okeys.reset(new WordDiffKeys(other->words, other->abcde));
+    });
 
-    WordEntry *l = words[abcde[0]];
-    WordEntry *o = other->words[other->abcde[0]];
+    int lsiz = lkeys->size();
+    int osiz = okeys->size();
+
+    // The words of this dictionary are split into ranges, and the words of the other
+    // dictionary at the same keys are merged with them on the thread pool.
+    std::vector<std::vector<std::pair<int, int>>> parts(ParallelRanges::rangeCount(lsiz, 10000));
+    ParallelRanges::run(lsiz, 10000, [&](int ix, int first, int last) {
+        int ofirst = first == 0 ? 0 : okeys->lowerBound(lkeys->key(first));
+        int olast = last == lsiz ? osiz : okeys->lowerBound(lkeys->key(last));
+        parts[ix].reserve(std::max(last - first, olast - ofirst) * 1.2);
+        diffRange(*lkeys, first, last, *okeys, ofirst, olast, parts[ix]);
+    });
 
-    int siz = std::min(lsiz, osiz);
     result.reserve(std::max(lsiz, osiz) * 1.2);
-
-    std::map<QCharString, QString> hira;
-    QString lstr;
-    QString ostr;
-    while (lpos != lsiz && opos != osiz)
-    {
-        int d = qcharcmp(l->romaji.data(), o->romaji.data());
-        if (d == 0)
-        {
-            auto it = hira.find(l->kana);
-            if (it == hira.end())
-                hira[l->kana] = lstr = hiraganize(l->kana);
-            else
-                lstr = it->second;
-            it = hira.find(o->kana);
-            if (it == hira.end())
-                hira[o->kana] = ostr = hiraganize(o->kana);
-            else
-                ostr = it->second;
-            d = qcharcmp(lstr.constData(), ostr.constData());
-        }
-        if (d == 0)
-            d = qcharcmp(l->kana.data(), o->kana.data());
-        if (d == 0)
-            d = qcharcmp(l->kanji.data(), o->kanji.data());
-
-        // By this time if d is 0 the words match. Otherwise the one that
-        // comes first is determined by the sign of d.
-        if (d == 0)
-        {
-            result.push_back(std::make_pair(abcde[lpos++], other->abcde[opos++]));
-            if (lpos != lsiz)
-                l = words[abcde[lpos]];
-            if (opos != osiz)
-                o = other->words[other->abcde[opos]];
-            continue;
-        }
-
-        if (d < 0)
-        {
-            result.push_back(std::make_pair(abcde[lpos++], -1));
-            if (lpos != lsiz)
-                l = words[abcde[lpos]];
-            continue;
-        }
-
-        // d > 0
-        result.push_back(std::make_pair(-1, other->abcde[opos++]));
-        if (opos != osiz)
-            o = other->words[other->abcde[opos]];
-        continue;
-    }
-
-    while (lpos != lsiz || opos != osiz)
-    {
-        if (lpos != lsiz)
-            result.push_back(std::make_pair(abcde[lpos++], -1));
-        else
-            result.push_back(std::make_pair(-1, other->abcde[opos++]));
-    }
+    for (const auto &part : parts)
+        result.insert(result.end(), part.begin(), part.end());
 }
 
 int Dictionary::addWordCopy(WordEntry *src, bool originals)
@@ -6417,6 +7696,11 @@ int Dictionary::addWordCopy(WordEntry *src, bool originals)
     addWordData();
 
     int windex = words.size() - 1;
+    if (attribs.size() == windex)
+    {
+        attribs.resize(windex + 1);
+        attribsvalid.push_back(false);
+    }
     emit entryAdded(windex);
 
     if (this != ZKanji::dictionary(0))
@@ -6442,6 +7726,9 @@ void Dictionary::cloneWordData(int windex, WordEntry *src, bool originals, bool
     dtree.removeLine(windex, false);
     dtree.expandWith(windex, false);
 
+    if (windex < attribsvalid.size())
+        attribsvalid[windex] = false;
+
     emit entryChanged(windex, false);
 
     if (!orichanged && this != ZKanji::dictionary(0))
@@ -6461,6 +7748,9 @@ void Dictionary::revertEntry(int windex)
     dtree.removeLine(windex, false);
     dtree.expandWith(windex, false);
 
+    if (windex < attribsvalid.size())
+        attribsvalid[windex] = false;
+
     emit entryChanged(windex, false);
 
     setToUserModified();
@@ -6468,6 +7758,8 @@ void Dictionary::revertEntry(int windex)
 
 void Dictionary::addWordData()
 {
+    formindex.reset();
+
     WordEntry *w = words.back();
 
     int windex = words.size() - 1;
@@ -6601,6 +7893,8 @@ void Dictionary::addWordData()
 
 void Dictionary::removeWordData(int index, int &abcdeindex, int &aiueoindex)
 {
+    formindex.reset();
+
     // Remove word from alphabetic ordering.
 
     int *abcdat = abcde.data();
@@ -15,6 +15,8 @@
 
 #include <memory>
 #include <map>
+#include <set>
+#include <mutex>
 
 #include "zkanjimain.h"
 #include "fastarray.h"
@@ -121,6 +123,51 @@ bool operator==(const WordFilterConditions &a, const WordFilterConditions &b);
 bool operator!=(const WordFilterConditions &a, const WordFilterConditions &b);
 bool operator!(const WordFilterConditions &a);
 
+// Attributes of a word checked by the word filters, collected from every definition of the
+// word and from the word commons data.
+struct WordAttributes
+{
+    // Attributes of every definition of the word combined.
+    WordDefAttrib attrib;
+    // JLPT level of the word as a single bit in the format of WordAttributeFilter::jlpt. 0
+    // when the word has no JLPT level.
+    uchar jlpt = 0;
+    // The word has example sentences.
+    bool examples = false;
+};
+
+class Dictionary;
+// Word filter conditions prepared with WordAttributeFilterList::compile() for checking many
+// words. Each filter that's not ignored in the conditions becomes a single step of mask
+// comparisons, with the word's attributes taken from Dictionary::wordAttributes().
+class WordFilterProgram
+{
+public:
+    WordFilterProgram();
+
+    // Returns whether the program has no conditions and every word matches.
+    bool empty() const;
+    // Returns whether the word at windex in dict matches the conditions.
+    bool match(const Dictionary *dict, int windex) const;
+private:
+    struct Step
+    {
+        WordDefAttrib attrib;
+        uchar inf;
+        uchar jlpt;
+        // Every attribute of the step must be found in a word for a match, instead of any.
+        bool all;
+        // Words must match the step, instead of not matching it.
+        bool include;
+    };
+
+    Inclusion examples;
+    Inclusion groups;
+    std::vector<Step> steps;
+
+    friend class WordAttributeFilterList;
+};
+
 struct WordCommons;
 class QXmlStreamWriter;
 class QXmlStreamReader;
@@ -164,9 +211,9 @@ public:
     // signal.
     void add(const QString &name, const WordDefAttrib &attrib, uchar info, uchar jlpt, FilterMatchType matchtype);
 
-    // Returns whether the passed word matches the filters inclusion list. Calls the other
-    // match function with every filter not ignored and evaluates the result.
-    bool match(const WordEntry *w, const WordFilterConditions *conditions) const;
+    // Returns the filters in the inclusion list of conditions prepared for checking words.
+    // When conditions is null, the returned program matches every word.
+    WordFilterProgram compile(const WordFilterConditions *conditions) const;
 signals:
     // Signaled when a new filter has been added.
     void filterCreated();
@@ -180,10 +227,6 @@ signals:
     // Signaled after a filter was moved.
     void filterMoved(int index, int to);
 private:
-    // Returns whether the passed word matches the filter at index. Commons must be set if
-    // it's needed (to look up JLPT of word).
-    bool domatch(const WordEntry *w, const WordCommons *commons, int index) const;
-
     std::vector<WordAttributeFilter> list;
 
     typedef QObject base;
@@ -448,6 +491,7 @@ private:
 	bool reversed;
 };
 
+class WordIndexMap;
 // Search tree for user defined word definitions used for studying.
 class StudyDefinitionTree : public TextSearchTree
 {
@@ -471,7 +515,7 @@ public:
     // Updates the definition list's word indexes by the changes mapping and rebuilds the
     // tree. If multiple definitions are changed to the same new word index, the first one is
     // kept and the rest will be lost. Definitions with a new index of -1 are removed.
-    void applyChanges(std::map<int, int> &changes);
+    void applyChanges(const WordIndexMap &changes);
 
     // Called when a word was removed from the dictionary.
     void processRemovedWord(int windex);
@@ -589,12 +633,19 @@ public:
 
     // Returns a read-only list storing the data in the commons tree.
     const smartvector<WordCommons>& getItems();
+
+    // Number incremented every time the commons data changes. Data derived from the commons
+    // must be updated when the value is different from when it was computed.
+    int revision() const;
 protected:
     virtual void doGetWord(int index, QStringList &texts) const override;
     virtual int size() const override;
 private:
     smartvector<WordCommons> list;
 
+    // Value returned by revision().
+    int rev;
+
     // Stores the index where a word with the kanji and kana is found or would be inserted to
     // if not found, when the tree has a sorted list. Returns false if the word was found at
     // index and shouldn't be inserted again.
@@ -668,10 +719,45 @@ struct KanjiDictData
     std::vector<int> ex;
 };
 
+// Mapping of every word index in a dictionary to the index of the same word in another
+// dictionary that replaces it, or to -1 if the word has no replacement. Used to update the
+// word indexes in user data when a dictionary is updated.
+class WordIndexMap
+{
+public:
+    WordIndexMap();
+
+    // Sets up the mapping between a dictionary with oldsize words and another with newsize
+    // words. No word is mapped after the call.
+    void reset(int oldsize, int newsize);
+
+    // Number of words in the original dictionary.
+    int size() const;
+
+    // Returns the new index of the word at windex, or -1 if the word has no new index.
+    int operator[](int windex) const;
+    // Changes the new index of the word at windex. Pass -1 to remove the word's mapping.
+    void set(int windex, int newindex);
+
+    // Returns whether more than one word is mapped to newindex.
+    bool merged(int newindex) const;
+
+    // Replaces the word indexes in list with their new values. Words with no new index and
+    // words mapped to the same new index as a word before them are removed from the list.
+    void apply(std::vector<int> &list) const;
+private:
+    // New index of each word in the original dictionary.
+    std::vector<int> table;
+    // Number of words mapped to each word of the new dictionary.
+    std::vector<int> refs;
+};
+
 class Groups;
+class GroupBase;
 class WordGroups;
 class KanjiGroups;
 class WordDeckList;
+class WordDeck;
 class KanjiGroup;
 class WordGroup;
 struct Range;
@@ -682,6 +768,11 @@ enum class SearchWildcard : uchar { AnyBefore = 0x0001, AnyAfter = 0x0002 };
 Q_DECLARE_FLAGS(SearchWildcards, SearchWildcard);
 
 class StudyDeckList;
+class KanjiMeaningIndex;
+class WordFormIndex;
+// Parts of the user data file in the order they are saved. Every part apart from the
+// originals can be replaced by a newer copy appended to the journal of the user data.
+enum class UserDataSection : uchar { Originals, Groups, Decks, StudyDefinitions, Kanji, Count };
 class Dictionary : public QObject
 {
     Q_OBJECT
@@ -776,19 +867,46 @@ public:
     Error save(const QString &filename);
 
     // Saves the user data, including changed dictionary words for the main dictionary.
-    // Updates user data modified status to false.
+    // Updates user data modified status to false. Removes the journal of the user data file.
     Error saveUserData(const QString &filename);
+    // Appends the sections, word decks, deck changes and groups of user data marked as
+    // changed since the last save to the journal next to the user data file. Saves the whole
+    // file with saveUserData() instead when no file was saved or loaded yet, or the
+    // dictionary words changed. When the journal grows too large, the user data file is
+    // rewritten in the background. Updates user data modified status to false.
+    // The changes are also journaled without calling this, when the event loop is reached
+    // after they were marked.
+    Error journalUserData(const QString &filename);
 
     // Writes an export file of user data that can be imported later.  Pass the kanji groups
     // to write in kgroups and the words groups to write in wgroups. Set kexamples to true to
     // write the word examples selected for the kanji in the groups. Set usermeanings to true
-    // to write the user defined word meanings.
-    void exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings);
+    // to write the user defined word meanings. Returns false if the file couldn't be written.
+    bool exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings);
 
     // Writes a full or partial dictionary export to file. When limit is true, the export is
     // only partial with the kanji and words found in the passed lists. The items in the lists
-    // should be unique or they will be exported multiple times.
-    void exportDictionary(const QString &filename, bool limit, const std::vector<ushort> &kanjilimit, const std::vector<int> wordlimit);
+    // should be unique or they will be exported multiple times. The words and kanji are
+    // formatted on multiple threads. If a callback is passed, it's called with the number of
+    // words and kanji written so far and their total, and should return false to interrupt
+    // the export. Returns false if the file couldn't be written or the export was
+    // interrupted. The unfinished file is deleted in that case.
+    bool exportDictionary(const QString &filename, bool limit, const std::vector<ushort> &kanjilimit, const std::vector<int> &wordlimit, const std::function<bool(int, int)> &callback = std::function<bool(int, int)>());
+
+    // Writes the changes to filename that turn the base dictionary into this one. Words are
+    // identified by their kanji and kana. The file lists the words missing from this
+    // dictionary, and the full data of words that are new or different. Words added to or
+    // removed from word groups and decks since base are listed by the names of the groups and
+    // decks, so base should have its user data loaded. The write date of base is saved to
+    // identify the dictionary the changes can be applied to.
+    Error saveDelta(const QString &filename, Dictionary *base);
+
+    // Applies the changes written with saveDelta() to this dictionary. Only the changed
+    // words are updated in the search trees. The listed words are added to or removed from
+    // the groups and decks with the same names. Groups and decks are created for the added
+    // words if they don't exist. The dictionary is not changed if the file can't be read, or
+    // if it was written against a dictionary with a different write date.
+    Error applyDelta(const QString &filename);
 
     // Reads an export file of user data and merges it with the dictionary.
     //void importUserData(const QString &filename, KanjiGroupCategory *kanjiroot, WordGroupCategory *wordsroot);
@@ -822,7 +940,7 @@ public:
     // data. The word indexes in the user data is then updated with the changes mapping.
     // After the swap, src will hold a copy of the original dictionary data, and user data.
     // This data can be restored by calling restoreChanges() with the same dictionary.
-    void swapDictionaries(Dictionary *src, std::map<int, int> &changes);
+    void swapDictionaries(Dictionary *src, const WordIndexMap &changes);
     // Restores the dictionary after an update made with applyChanges(). Passing any other
     // source dictionary than that in applyChanges() will result in undefined behavior.
     void restoreChanges(Dictionary *src);
@@ -833,8 +951,22 @@ public:
     void setToModified();
     // Whether the user data has been modified since the last load or save.
     bool isUserModified() const;
-    // Changes the user data modified flag to true.
+    // Changes the user data modified flag to true, marking every section of the user data as
+    // changed.
     void setToUserModified();
+    // Changes the user data modified flag to true, marking a single section of the user data
+    // as changed.
+    void setToUserModified(UserDataSection section);
+    // Changes the user data modified flag to true, marking only the data of deck and its
+    // study deck as changed. Changes to the list of decks must mark the whole section.
+    void setToUserModified(WordDeck *deck);
+    // Changes the user data modified flag to true, recording a single change of deck written
+    // by the deck, to be replayed with WordDeck::loadChange(). The change is dropped when the
+    // whole deck is written instead.
+    void setToUserModified(WordDeck *deck, QByteArray &&change);
+    // Changes the user data modified flag to true, marking only the items of group as
+    // changed. Changes to the names or the place of groups must mark the whole section.
+    void setToUserModified(GroupBase *group);
 
     WordGroups& wordGroups();
     KanjiGroups& kanjiGroups();
@@ -939,6 +1071,18 @@ public:
     // dictionary. Setting an empty list clears the meaning and the dictionary meaning will be
     // be used for the kanji.
     void setKanjiMeaning(short kindex, QStringList &list);
+    // Returns the index for looking up kanji by the words in their meanings in this
+    // dictionary. The index is built on first use and kept up to date when a meaning
+    // changes.
+    const KanjiMeaningIndex& kanjiMeaningIndex() const;
+    // Returns the index of the written forms of words in this dictionary, used for finding
+    // the words in a text. The index is built on first use and rebuilt after words are added
+    // or removed.
+    const WordFormIndex& wordFormIndex() const;
+
+    // Returns the attributes of the word at windex checked by word filters. The attributes
+    // are collected on first use and kept up to date when the word changes.
+    const WordAttributes& wordAttributes(int windex) const;
 
     // Fills result with the word indexes in the dictionary in the specified browse order.
     // Pass a list for the results in result. The same (updated) list is returned for
@@ -1093,9 +1237,9 @@ public:
     // imports. The returned list is sorted by index and every index is unique.
     void listUsedWords(std::vector<int> &result);
 
-    // Returns a mapping of word indexes from src to this dictionary, for the
-    // word indexes passed in wlist.
-    std::map<int, int> mapWords(Dictionary *src, const std::vector<int> &wlist);
+    // Fills result with the mapping of every word index in src to the index of the same word
+    // in this dictionary.
+    void mapWords(Dictionary *src, WordIndexMap &result);
 
     // Returns a mapping of word indexes from the main dictionary to this dictionary for
     // originalwords.
@@ -1131,6 +1275,40 @@ private:
     // aiueo indexes to the word's index in these lists.
     void removeWordData(int index, int &abcdeindex, int &aiueoindex);
 
+    // Returns a section of the user data as written in the user data file.
+    QByteArray userDataSection(UserDataSection section) const;
+    // Reads a section of the user data from stream, replacing the same data in memory.
+    void loadUserDataSection(UserDataSection section, QDataStream &stream, int version);
+    // Replaces the user data sections and word decks found in the journal of the user data
+    // file, and replays the deck changes and groups in it. The journal is ignored if it was
+    // written for a different file. Returns whether any data was replaced.
+    bool replayUserDataJournal(const QString &filename, const QString &journalname);
+
+    // Writes the user data in the format of the user data file. The errorcode is set to the
+    // part being written. Throws on write errors.
+    void writeUserData(QDataStream &stream, int &errorcode) const;
+    // Returns the records of the user data marked as changed since the last write, in the
+    // format they are appended to the journal.
+    QByteArray userJournalRecords() const;
+    // Appends records to the journal of the user data file, writing the journal header first
+    // if the journal is new.
+    Error appendUserJournal(const QString &filename, const QByteArray &records);
+    // Clears the changes marked since the last write of the user data, and updates the user
+    // data modified status to false.
+    void userDataWritten();
+    // Appends the marked changes of the user data to the journal once the event loop is
+    // reached, unless the user data must be saved in full.
+    void queueUserJournal();
+    // Rewrites the user data file with the current data on the thread pool. The changes
+    // appended to the journal in the meantime are kept in a new journal for the new file.
+    void startUserCompaction();
+    // Writes data as the new user data file, and replaces its journal with the records
+    // appended since the data was serialized. Runs on the thread pool.
+    void compactUserData(const QString &filename, const QByteArray &data);
+    // Releases the background rewrite of the user data file if it finished. Set wait to
+    // wait for it to finish.
+    void finishUserCompaction(bool wait);
+
     //// Sets the kanji and kana strings to those found in line starting at pos up to len
     //// characters. The format of the line's substring should be kanji(kana). Returns whether
     //// the strings were found and filled correctly.
@@ -1203,6 +1381,55 @@ private:
 
     WordDeckList *decks;
     std::unique_ptr<StudyDeckList> studydecks;
+
+    // Lookup of kanji by their meanings. Null until first requested, or after the kanji
+    // meanings were replaced.
+    mutable std::unique_ptr<KanjiMeaningIndex> meaningindex;
+    // Lookup of words by their written forms. Null until first requested, or after words
+    // were added or removed.
+    mutable std::unique_ptr<WordFormIndex> formindex;
+
+    // Whether the user data file holds the user data apart from the changes marked since, so
+    // the changes can be appended to its journal. False if the user data wasn't saved or
+    // loaded yet.
+    bool userjournal;
+    // Bits of the user data sections marked as changed since the user data was last written
+    // to its file or journal. The bit positions are the values of UserDataSection.
+    uint userchanges;
+    // Word decks marked as changed since the user data was last written, while the decks
+    // section itself is not marked in userchanges.
+    std::set<WordDeck*> userdecks;
+    // Changes of word decks recorded since the user data was last written, in the order they
+    // were made. Changes of decks in userdecks or when the decks section is marked are not
+    // written, as their whole deck is.
+    std::vector<std::pair<WordDeck*, QByteArray>> userdeckchanges;
+    // Groups with items changed since the user data was last written, while the groups
+    // section itself is not marked in userchanges.
+    std::set<GroupBase*> usergroups;
+    // Path of the user data file last loaded or saved, which the journal belongs to.
+    QString userfilename;
+    // Set when the marked changes are going to be appended to the journal once the event
+    // loop is reached.
+    bool userjournalqueued;
+
+    // Rewrite of the user data file running on the thread pool, or null.
+    std::unique_ptr<ParallelRanges> usercompaction;
+    // Guards the journal files and the compaction values below while usercompaction runs.
+    std::mutex compactionmutex;
+    // Records appended to the old journal since the data of the running compaction was
+    // serialized. They are written to the journal of the new user data file.
+    QByteArray compactionrecords;
+    // Set by the compaction when the new user data file and its journal replaced the old.
+    bool compactiondone;
+    // Set by the compaction when the new user data file couldn't be written.
+    bool compactionfailed;
+
+    // Attributes of each word for word filters, filled in wordAttributes() on first use.
+    mutable std::vector<WordAttributes> attribs;
+    // Whether the attributes of each word in attribs are valid.
+    mutable std::vector<bool> attribsvalid;
+    // Revision of the word commons when attribs was created.
+    mutable int attribsrevision;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(SearchWildcards)
@@ -1294,8 +1521,9 @@ namespace ZKanji
     void changeDictionaryOrder(const std::list<quint8> &order);
 
     // Saves every modified dictionary and group to the user data folder. Set
-    // forced to true to save unmodified data too.
-    void saveUserData(bool forced = false);
+    // forced to true to save unmodified data too. Set journaled to only append the changed
+    // user data to the journals of the user data files, unless forced is also set.
+    void saveUserData(bool forced = false, bool journaled = false);
 
     // Checks whether the user data files should be backed up according to the user settings,
     // and creates a backup of the current files in so. Removes any extra backup files first,
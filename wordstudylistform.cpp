@@ -32,6 +32,7 @@
 #include "colorsettings.h"
 #include "generalsettings.h"
 #include "ztooltip.h"
+#include "studyforecast.h"
 
 
 //-------------------------------------------------------------
@@ -148,14 +149,7 @@ QString WordStudyTestsModel::tooltip(int col) const
 
 WordStudyLevelsModel::WordStudyLevelsModel(WordDeck *deck, QObject *parent) : base(parent), deck(deck), maxval(0)
 {
-    list.resize(12);
-    for (int ix = 0, siz = deck->studySize(); ix != siz; ++ix)
-    {
-        int lv = deck->studyLevel(ix);
-        if (list.size() <= lv)
-            list.resize(lv + 1);
-        ++list[lv];
-    }
+    deck->getStudyDeck()->levelCounts(list, 12);
 
     for (int ix = 0, siz = list.size(); ix != siz; ++ix)
         maxval = std::max(maxval, list[ix]);
@@ -339,7 +333,7 @@ QString WordStudyAreaModel::tooltip(int col) const
     if (type == DeckStatAreaType::Items)
         return tr("Items: %1\nLearned: %2\nTested: %3\n%4").arg(itemcount).arg(learnedcount).arg(testcount).arg(DateTimeFunctions::formatDay(date.date()));
     else if (type == DeckStatAreaType::Forecast)
-        return tr("Items: %1\n%2").arg(itemcount).arg(DateTimeFunctions::formatDay(date.date()));
+        return tr("Items: %1\nEstimated time: %2\n%3").arg(itemcount).arg(DateTimeFunctions::formatPassedTime(forecasttimes[col], true)).arg(DateTimeFunctions::formatDay(date.date()));
 
     return QString();
 }
@@ -435,64 +429,28 @@ void WordStudyAreaModel::update()
     }
     else if (type == DeckStatAreaType::Forecast)
     {
-        const StudyDeck *study = deck->getStudyDeck();
-
         std::vector<int> items;
         deck->dueItems(items);
 
-        std::vector<int> days;
-        days.resize(365);
+        std::vector<CardId*> cardids;
+        cardids.reserve(items.size());
+        for (int ix = 0, siz = items.size(); ix != siz; ++ix)
+            cardids.push_back(deck->studiedItems(items[ix])->cardid);
 
         QDateTime now = QDateTime::currentDateTimeUtc();
-        QDate nowday = ltDay(now);
 
-        // [which date to test next, next spacing, multiplier]
-        std::vector<std::tuple<QDateTime, int, double>> data;
-        for (int ix = 0, siz = items.size(); ix != siz; ++ix)
-        {
-            const LockedWordDeckItem *i = deck->studiedItems(items[ix]);
-            quint32 ispace = study->cardSpacing(i->cardid);
-            QDateTime idate = study->cardItemDate(i->cardid).addSecs(ispace);
-            QDate iday = ltDay(idate);
-            if (iday.daysTo(nowday) > 0)
-            {
-                idate = now;
-                iday = nowday;
-            }
-            int pos = nowday.daysTo(iday);
-            if (pos >= days.size())
-                continue;
-            data.push_back(std::make_tuple(idate, ispace * study->cardMultiplier(i->cardid), study->cardMultiplier(i->cardid)));
-            ++days[pos];
-        }
-
-        while (!data.empty())
-        {
-            std::vector<std::tuple<QDateTime, int, double>> tmp;
-            std::swap(tmp, data);
-            for (int ix = 0, siz = tmp.size(); ix != siz; ++ix)
-            {
-                quint32 ispace = std::get<1>(tmp[ix]);
-                QDateTime idate = std::get<0>(tmp[ix]).addSecs(ispace);
-                QDate iday = ltDay(idate);
-                if (iday.daysTo(nowday) >= 0)
-                {
-                    idate = now.addDays(1);
-                    iday = nowday.addDays(1);
-                }
-                int pos = nowday.daysTo(iday);
-                if (pos >= days.size())
-                    continue;
-                double multi = std::get<2>(tmp[ix]);
-                data.push_back(std::make_tuple(idate, ispace * multi, multi));
-                ++days[pos];
-            }
-        }
+        // The tests are simulated with answers picked from the recorded answers of the deck,
+        // and the results of the simulations are averaged.
+        StudyForecast forecast(study, cardids, now);
+        forecast.simulate(365, 32);
 
+        forecasttimes.clear();
+        forecasttimes.reserve(forecast.size());
         qint64 timesince = QDateTime(now.date(), QTime()).toMSecsSinceEpoch();
-        for (int val : days)
+        for (int ix = 0, siz = forecast.size(); ix != siz; ++ix)
         {
-            list.push_back(std::make_pair(timesince, std::make_tuple(val, 0, 0)));
+            list.push_back(std::make_pair(timesince, std::make_tuple((int)std::round(forecast.dueCount(ix)), 0, 0)));
+            forecasttimes.push_back((int)std::round(forecast.testTime(ix) / 10));
             timesince += 1000 * 60 * 60 * 24;
         }
     }
@@ -132,6 +132,9 @@ private:
     // Maximum of val0+val1+val2 in list. Recalculated when set to -1, but shouldn't change
     // unless changing the deck data.
     mutable int maxval;
+    // Estimated seconds spent testing on each day of the forecast, matching the items in
+    // list.
+    std::vector<int> forecasttimes;
 
     typedef ZAbstractAreaStatModel  base;
 };
@@ -631,6 +631,7 @@ void ZDictionaryListView::signalSelectionChanged()
 void ZDictionaryListView::settingsChanged()
 {
     base::settingsChanged();
+    itemDelegate()->clearLayoutCache();
     setAutoSizeColumns(Settings::dictionary.autosize);
 }
 
@@ -1719,7 +1720,7 @@ void ZDictionaryListView::showPopup(const QPoint &pos, QModelIndex index, QStrin
 //QImage* DictionaryListDelegate::midpop = nullptr;
 //QImage* DictionaryListDelegate::unpop = nullptr;
 
-DictionaryListDelegate::DictionaryListDelegate(ZDictionaryListView *parent) : base(parent), showgroup(false)
+DictionaryListDelegate::DictionaryListDelegate(ZDictionaryListView *parent) : base(parent), showgroup(false), layoutdict(nullptr), layoutheight(-1)
 {
 
 }
@@ -1938,9 +1939,10 @@ void DictionaryListDelegate::paint(QPainter *painter, const QStyleOptionViewItem
         if (Settings::dictionary.showingroup && showgroup && (e->dat & (1 << (int)WordRuntimeData::InGroup)))
         {
             QRect imgrect = QRect(r.left() + 3, r.top() + 3, r.height() - 6, r.height() - 6);
-            QImage img = imageFromSvg(":/box.svg", imgrect.width(), imgrect.height(), owner()->sizeBase() == ListSizeBase::Popup ? 1 : 0);
-            painter->drawImage(imgrect, img);
-            r.setLeft(r.left() + 6 + img.width());
+            if (boximage.width() != imgrect.width() || boximage.height() != imgrect.height())
+                boximage = imageFromSvg(":/box.svg", imgrect.width(), imgrect.height(), owner()->sizeBase() == ListSizeBase::Popup ? 1 : 0);
+            painter->drawImage(imgrect, boximage);
+            r.setLeft(r.left() + 6 + boximage.width());
         }
         r.setLeft(r.left() + 4);
 
@@ -2029,8 +2031,8 @@ void DictionaryListDelegate::paintDefinition(QPainter *painter, QColor textcolor
     // with small font. This is repeated for each definition.
     // In case only a single definition is drawn on the line, the number is omitted.
     // (Unless using multiple table lines.)
-
-    bool multidef = e->defs.size() > 1;
+    // Everything but the inflection text is measured once in definitionLayout(), and only
+    // drawn here.
 
     if (selected)
         painter->setPen(textcolor);
@@ -2046,180 +2048,167 @@ void DictionaryListDelegate::paintDefinition(QPainter *painter, QColor textcolor
     // Font used for drawing def number.
     QFont fsf = Settings::mainFont();
     fsf.setPixelSize(f.pixelSize());
-    QFont fse = Settings::extraFont();
-    fse.setPixelSize(f.pixelSize());
+
+    if (inf != nullptr)
+    {
+        QFont fse = Settings::extraFont();
+        fse.setPixelSize(f.pixelSize());
+        QFontMetrics fsemet{ fse };
+
+        painter->setFont(fse);
+        QString str = Strings::wordInflectionText(*inf);
+        drawTextBaseline(painter, r.left(), y, false, r, str);
+        //painter->drawText(r.left(), y, str);
+        r.setLeft(r.left() + fsemet.boundingRect(str).width() + QFontMetrics(f).averageCharWidth());
+    }
+
+    const QFont *fonts[] = { &f, &fs, &fsf };
+
+    const std::vector<DefinitionSegment> &segments = definitionLayout(e, defix, r.height());
+    int left = r.left();
+    int lastfont = -1;
+    for (const DefinitionSegment &seg : segments)
+    {
+        r.setLeft(left + seg.left);
+        if (r.left() > r.right())
+            break;
+
+        if (seg.font != lastfont)
+        {
+            painter->setFont(*fonts[seg.font]);
+            lastfont = seg.font;
+        }
+        if (!selected)
+            painter->setPen(seg.color == -1 ? textcolor : Settings::uiColor((ColorSettings::UIColorTypes)seg.color));
+
+        drawTextBaseline(painter, r.left(), y, false, r, seg.text);
+        //painter->drawText(r.left(), y, seg.text);
+    }
+}
+
+void DictionaryListDelegate::clearLayoutCache()
+{
+    layoutcache.clear();
+    layoutheight = -1;
+}
+
+const std::vector<DictionaryListDelegate::DefinitionSegment>& DictionaryListDelegate::definitionLayout(WordEntry *e, int defix, int height) const
+{
+    validateLayoutCache(height);
+
+    std::vector<DefinitionSegment> &segments = layoutcache[std::make_pair((const WordEntry*)e, defix)];
+    if (!segments.empty())
+        return segments;
+
+    bool multidef = e->defs.size() > 1;
+
+    // Main definition font.
+    QFont f = Settings::mainFont();
+    f.setPixelSize(height * defRowSize);
+    // Small font for word notes text.
+    QFont fs = Settings::notesFont();
+    fs.setPixelSize(height * notesRowSize);
+    // Font used for drawing def number.
+    QFont fsf = Settings::mainFont();
+    fsf.setPixelSize(f.pixelSize());
 
     QFontMetrics fmet{ f };
     QFontMetrics fsmet{ fs };
     QFontMetrics fsfmet{ fsf };
-    QFontMetrics fsemet{ fse };
-
-    QString str;
 
     int spacewidth = fmet.averageCharWidth();
 
-    QColor textcol = painter->pen().color();
+    // Horizontal position of the next segment.
+    int left = 0;
 
-    if (inf != nullptr)
-    {
-        painter->setFont(fse);
-        str = Strings::wordInflectionText(*inf);
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fsemet.boundingRect(str).width() + spacewidth);
-    }
+    // Adds a segment with the text, and moves left past it by the text's width and space.
+    auto add = [&segments, &left](QString text, uchar font, int color, const QFontMetrics &fm, int space) {
+        segments.push_back({ text, font, color, left });
+        left += fm.boundingRect(text).width() + space;
+    };
 
     // Looking for JLPT data in the commons tree.
     if (Settings::dictionary.showjlpt && (Settings::dictionary.jlptcolumn == DictionarySettings::Definition || Settings::dictionary.jlptcolumn == DictionarySettings::Both))
     {
         WordCommons *c = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data());
-        if (c != nullptr && c->jlptn != 0)
+        if (c != nullptr && c->jlptn >= 1 && c->jlptn <= 5)
         {
-            painter->setFont(fs);
-
-            if (!selected)
-            {
-                switch (c->jlptn)
-                {
-                case 1:
-                    painter->setPen(Settings::uiColor(ColorSettings::N1));
-                    break;
-                case 2:
-                    painter->setPen(Settings::uiColor(ColorSettings::N2));
-                    break;
-                case 3:
-                    painter->setPen(Settings::uiColor(ColorSettings::N3));
-                    break;
-                case 4:
-                    painter->setPen(Settings::uiColor(ColorSettings::N4));
-                    break;
-                case 5:
-                    painter->setPen(Settings::uiColor(ColorSettings::N5));
-                    break;
-                }
-            }
-            else
-                painter->setPen(textcol);
-
-            str = QString("N%1").arg((int)c->jlptn);
-            //drawTextBaseline(painter, r.left(), y, false, r, str);
-            painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth);
+            const ColorSettings::UIColorTypes jlptcolors[] = { ColorSettings::N1, ColorSettings::N2, ColorSettings::N3, ColorSettings::N4, ColorSettings::N5 };
+            add(QString("N%1").arg((int)c->jlptn), 1, jlptcolors[c->jlptn - 1], fsmet, spacewidth);
         }
     }
 
-    // Drawing the global word info field.
-
-    str = Strings::wordInfoText(e->inf);
+    // The global word info field.
 
+    QString str = Strings::wordInfoText(e->inf);
     if (!str.isEmpty())
-    {
-        painter->setFont(fs);
-        if (!selected)
-            painter->setPen(Settings::uiColor(ColorSettings::Attrib));
-
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-    }
+        add(str, 1, ColorSettings::Attrib, fsmet, spacewidth / 2);
 
     QString separator = qApp->translate("Dictionary", ", ");
 
     // Definitions.
 
-    for (int ix = 0; ix < e->defs.size(); ++ix)
+    for (int ix = defix == -1 ? 0 : defix, siz = defix == -1 ? e->defs.size() : defix + 1; ix < siz; ++ix)
     {
-        if (defix != -1)
-            ix = defix;
-
-        painter->setFont(fsf);
         if (multidef)
-        {
-            str = QStringLiteral("%1.").arg(ix + 1);
-            if (!selected)
-                painter->setPen(textcolor);
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsfmet.boundingRect(str).width() + spacewidth);
-        }
-        if (r.left() > r.right())
-            break;
-
-        painter->setFont(fs);
+            add(QStringLiteral("%1.").arg(ix + 1), 2, -1, fsfmet, spacewidth);
 
         WordDefinition &def = e->defs[ix];
         if (def.attrib.types != 0)
-        {
-            str = Strings::wordTypesText(def.attrib.types) + " ";
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Types));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-        if (r.left() > r.right())
-            break;
-
+            add(Strings::wordTypesText(def.attrib.types) + " ", 1, ColorSettings::Types, fsmet, spacewidth / 2);
         if (def.attrib.notes != 0)
-        {
-            str = Strings::wordNotesText(def.attrib.notes) + " ";
-
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Notes));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-        if (r.left() > r.right())
-            break;
+            add(Strings::wordNotesText(def.attrib.notes) + " ", 1, ColorSettings::Notes, fsmet, spacewidth / 2);
 
-
-        painter->setFont(f);
         str = def.def.toQStringRaw();
         str.replace(GLOSS_SEP_CHAR, separator);
-        if (!selected)
-            painter->setPen(textcolor);
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fmet.boundingRect(str).width() + spacewidth / 2);
-        if (r.left() > r.right())
-            break;
-
-        painter->setFont(fs);
+        add(str, 0, -1, fmet, spacewidth / 2);
 
         if (def.attrib.fields != 0)
-        {
-            str = Strings::wordFieldsText(def.attrib.fields) + " ";
+            add(Strings::wordFieldsText(def.attrib.fields) + " ", 1, ColorSettings::Fields, fsmet, spacewidth / 2);
+        if (def.attrib.dialects != 0)
+            add(Strings::wordDialectsText(def.attrib.dialects) + " ", 1, ColorSettings::Dialects, fsmet, spacewidth / 2);
 
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Fields));
+        left += spacewidth;
+    }
 
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
+    return segments;
+}
 
-        if (def.attrib.dialects != 0)
-        {
-            str = Strings::wordDialectsText(def.attrib.dialects) + " ";
+void DictionaryListDelegate::validateLayoutCache(int height) const
+{
+    // Number of words kept in the cache before it's cleared to free up memory.
+    const int cachelimit = 4096;
 
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Dialects));
+    Dictionary *d = owner()->dictionary();
+    if (d != layoutdict)
+    {
+        if (layoutdict != nullptr)
+            disconnect(layoutdict, nullptr, this, nullptr);
+        layoutdict = d;
+        layoutcache.clear();
 
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
+        if (d != nullptr)
+        {
+            // Removed entries might be replaced by new ones at the same address, and entry
+            // indexes can't be used after a reset, so the cache is cleared in those cases.
+            connect(d, &Dictionary::entryChanged, this, [this](int windex, bool studydef) {
+                if (studydef)
+                    return;
+                WordEntry *e = layoutdict->wordEntry(windex);
+                auto it = layoutcache.lower_bound(std::make_pair((const WordEntry*)e, -1));
+                while (it != layoutcache.end() && it->first.first == e)
+                    it = layoutcache.erase(it);
+            });
+            connect(d, &Dictionary::entryRemoved, this, [this]() { layoutcache.clear(); });
+            connect(d, &Dictionary::dictionaryReset, this, [this]() { layoutcache.clear(); });
+            connect(d, &QObject::destroyed, this, [this]() { layoutcache.clear(); layoutdict = nullptr; });
         }
+    }
 
-        r.setLeft(r.left() + spacewidth);
-
-        if (r.left() > r.right())
-            break;
-
-        if (defix != -1)
-            break;
+    if (height != layoutheight || layoutcache.size() >= cachelimit)
+    {
+        layoutcache.clear();
+        layoutheight = height;
     }
 }
 
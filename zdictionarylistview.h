@@ -8,7 +8,9 @@
 #define ZDICTIONARYLISTVIEW_H
 
 #include <QMenu>
+#include <QImage>
 #include <memory>
+#include <map>
 #include "zlistview.h"
 #include "zlistviewitemdelegate.h"
 #include "smartvector.h"
@@ -336,6 +338,10 @@ public:
     // Paints the kanji string passed in str with painter at left and baseline y.
     virtual void paintKanji(QPainter *painter, const QModelIndex &index, int left, int top, int basey, QRect r) const;
 
+    // Discards the measured definition texts of every word, so they are measured again on
+    // next paint. Call when the fonts or the displayed word information change.
+    void clearLayoutCache();
+
     // Returns the index of a kanji in the global kanji list at the given point position. The
     // rectangle and index of the item under pos must be provided. Returns -1 if no kanji
     // would be drawn at the passed position, or the column of the index doesn't have the
@@ -357,8 +363,39 @@ private:
     // for drawing the selected part. Font and other attributes should already be set.
     void drawSelectionText(QPainter *p, int x, int basey, const QRect &clip, QString str) const;
 
+    // Part of a definition cell's text, measured and positioned for painting.
+    struct DefinitionSegment
+    {
+        QString text;
+        // Font of the text. 0: main definition font, 1: notes font, 2: definition number font.
+        uchar font;
+        // Color of the text when the row is not selected. Either a value of
+        // ColorSettings::UIColorTypes or -1 for the text color of the row.
+        int color;
+        // Horizontal position of the text from the left of the painted area.
+        int left;
+    };
+
+    // Returns the definition texts of e, measured for a row of the given height. When defix
+    // is -1, every definition is included, otherwise only the one at defix. The result is
+    // cached and only measured again when the word changes.
+    const std::vector<DefinitionSegment>& definitionLayout(WordEntry *e, int defix, int height) const;
+    // Makes sure the layout cache holds measurements of the owner's dictionary and rows of
+    // the given height, clearing it otherwise.
+    void validateLayoutCache(int height) const;
+
     bool showgroup;
 
+    // Cached definition texts of words that were painted, by entry and definition index.
+    mutable std::map<std::pair<const WordEntry*, int>, std::vector<DefinitionSegment>> layoutcache;
+    // Dictionary of the words in layoutcache. The cache is cleared when it changes.
+    mutable Dictionary *layoutdict;
+    // Height of the rows the cached definitions were measured for.
+    mutable int layoutheight;
+
+    // Group box image painted next to words in a group, to avoid getting it for every row.
+    mutable QImage boximage;
+
     typedef ZListViewItemDelegate base;
 };
 
@@ -1250,11 +1250,12 @@ void DictionaryBrowseItemModel::setFilterConditions(WordFilterConditions *fcond)
     beginResetModel();
     list.clear();
     const std::vector<int> &wordlist = dict->wordOrdering(order);
+    WordFilterProgram filter = ZKanji::wordfilters().compile(cond.get());
 
     for (int ix = 0; ix != wordlist.size(); ++ix)
     {
         int wix = wordlist[ix];
-        if (ZKanji::wordfilters().match(dict->wordEntry(wix), cond.get()))
+        if (filter.match(dict, wix))
             list.push_back(wix);
     }
     endResetModel();
@@ -1467,7 +1468,7 @@ void DictionaryBrowseItemModel::entryAdded(int windex)
         return;
     }
 
-    if (!ZKanji::wordfilters().match(dict->wordEntry(windex), cond.get()))
+    if (!ZKanji::wordfilters().compile(cond.get()).match(dict, windex))
         return;
 
     // The entry must be inserted at the same position it is in the source dictionary. Find
@@ -62,6 +62,7 @@ SOURCES += \
     kanji.cpp \
     kanjidefform.cpp \
     kanjigroupwidget.cpp \
+    kanjiindex.cpp \
     kanjiinfoform.cpp \
     kanjilegacy.cpp \
     kanjireadingpracticeform.cpp \
@@ -86,12 +87,15 @@ SOURCES += \
     sites.cpp \
     studydecks.cpp \
     studydeckslegacy.cpp \
+    studyforecast.cpp \
+    textvocabulary.cpp \
     treebuilder.cpp \
     wordattribwidget.cpp \
     worddeck.cpp \
     worddeckform.cpp \
     worddecklegacy.cpp \
     wordeditorform.cpp \
+    wordformindex.cpp \
     wordgroupwidget.cpp \
     words.cpp \
     wordslegacy.cpp \
@@ -187,6 +191,7 @@ HEADERS += \
     kanji.h \
     kanjidefform.h \
     kanjigroupwidget.h \
+    kanjiindex.h \
     kanjiinfoform.h \
     kanjireadingpracticeform.h \
     kanjisearchwidget.h \
@@ -215,12 +220,15 @@ HEADERS += \
     sites.h \
     smartvector.h \
     studydecks.h \
+    studyforecast.h \
     studysettings.h \
+    textvocabulary.h \
     treebuilder.h \
     wordattribwidget.h \
     worddeck.h \
     worddeckform.h \
     wordeditorform.h \
+    wordformindex.h \
     wordgroupwidget.h \
     words.h \
     wordstudyform.h \
@@ -1483,6 +1483,9 @@ void ZKanjiForm::fillMainMenu()
         a = inmenu->addAction(tr("Export dictionary..."));
         connect(a, &QAction::triggered, gUI, &GlobalUI::dictExportAction);
 
+        a = inmenu->addAction(tr("Export dictionary update..."));
+        connect(a, &QAction::triggered, gUI, &GlobalUI::dictDeltaExportAction);
+
         inmenu->addSeparator();
 
         a = inmenu->addAction(tr("Import user data..."));
@@ -1491,6 +1494,17 @@ void ZKanjiForm::fillMainMenu()
         a = inmenu->addAction(tr("Import dictionary..."));
         connect(a, &QAction::triggered, gUI, &GlobalUI::dictImportAction);
 
+        a = inmenu->addAction(tr("Import dictionary update..."));
+        connect(a, &QAction::triggered, gUI, &GlobalUI::dictDeltaImportAction);
+
+        inmenu->addSeparator();
+
+        a = inmenu->addAction(tr("Words from text files..."));
+        connect(a, &QAction::triggered, gUI, &GlobalUI::textWordsAction);
+
+        a = inmenu->addAction(tr("Words from text folder..."));
+        connect(a, &QAction::triggered, gUI, &GlobalUI::textFolderWordsAction);
+
         //a = new QAction(tr("Save user data"), this);
         //connect(a, &QAction::triggered, gUI, &GlobalUI::saveUserData);
         //filemenu->addAction(a);
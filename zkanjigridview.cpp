@@ -13,6 +13,7 @@
 #include <QDrag>
 #include <QMimeData>
 #include <QPixmap>
+#include <QApplication>
 
 #include <cmath>
 
@@ -41,6 +42,221 @@
 //-------------------------------------------------------------
 
 
+namespace
+{
+    // Pre-rendered kanji cells of every kanji grid view. Cells with the same font, size,
+    // colors and device pixel ratio are rendered once into large pixmaps, called atlas pages,
+    // and copied from there when painting. Painting a grid or scrolling it this way doesn't
+    // rasterize the kanji again.
+    class KanjiTileCache
+    {
+    public:
+        KanjiTileCache();
+
+        // Draws the cell of the kanji at kindex with its top left corner at pos, filling the
+        // background with bgcolor and drawing the kanji with textcolor. The size of the cell
+        // is cellsize - 1 to leave room for the grid lines. The cell is rendered for the device
+        // pixel ratio of the painted device.
+        void draw(QPainter &p, QPoint pos, const QFont &font, int cellsize, QColor textcolor, QColor bgcolor, int kindex);
+        // Renders the cell of the kanji at kindex in the cache for a device with the pixel
+        // ratio dpr, if it's not there yet. Returns whether the cell had to be rendered.
+        bool prepare(const QFont &font, int cellsize, qreal dpr, QColor textcolor, QColor bgcolor, int kindex);
+
+        // Discards every cached cell.
+        void clear();
+    private:
+        struct Style
+        {
+            QString fontkey;
+            int cellsize;
+            qreal dpr;
+            QRgb textcolor;
+            QRgb bgcolor;
+
+            bool operator<(const Style &other) const;
+        };
+
+        struct Atlas
+        {
+            // Pages holding pagesize * pagesize cells each.
+            std::vector<QPixmap> pages;
+            // Slot of each kanji in pages, or -1 if the kanji wasn't rendered yet.
+            std::vector<int> slots;
+            // Number of used slots.
+            int used = 0;
+            // Value of counter when the atlas was last used.
+            quint64 lastused = 0;
+        };
+
+        // Returns the atlas of the style, creating it when it doesn't exist yet.
+        Atlas& atlas(const Style &style);
+        // Returns the slot of the kanji in the atlas, rendering it if it's not there yet.
+        int slot(Atlas &a, const Style &style, const QFont &font, int kindex);
+        // Rectangle of the cell at slot in its atlas page, in device independent pixels.
+        QRect slotRect(const Style &style, int slot) const;
+        // Width and height of an atlas page in device pixels.
+        int pageSize(const Style &style) const;
+
+        // Removes the least recently used atlases until the cells take up no more than the
+        // allowed size with a new page of the given style added. Returns false if only the
+        // atlas a remains, which should be cleared.
+        bool limitSize(const Atlas &a, const Style &style);
+
+        // Number of cells in a row and column of an atlas page.
+        static const int pagesize = 16;
+        // Maximum number of pixels in all atlas pages together.
+        static const int maxpixels = 16 * 1024 * 1024;
+
+        std::map<Style, Atlas> atlases;
+        // Incremented each time an atlas is used.
+        quint64 counter;
+    };
+
+    KanjiTileCache::KanjiTileCache() : counter(0)
+    {
+
+    }
+
+    void KanjiTileCache::draw(QPainter &p, QPoint pos, const QFont &font, int cellsize, QColor textcolor, QColor bgcolor, int kindex)
+    {
+        Style style = { font.key(), cellsize, p.device()->devicePixelRatioF(), textcolor.rgba(), bgcolor.rgba() };
+        Atlas &a = atlas(style);
+        int s = slot(a, style, font, kindex);
+
+        // The source rectangle of drawPixmap() is in the device pixels of the pixmap.
+        QRect r = slotRect(style, s);
+        QRectF src(r.left() * style.dpr, r.top() * style.dpr, r.width() * style.dpr, r.height() * style.dpr);
+        p.drawPixmap(QRectF(pos, r.size()), a.pages[s / (pagesize * pagesize)], src);
+    }
+
+    bool KanjiTileCache::prepare(const QFont &font, int cellsize, qreal dpr, QColor textcolor, QColor bgcolor, int kindex)
+    {
+        Style style = { font.key(), cellsize, dpr, textcolor.rgba(), bgcolor.rgba() };
+        Atlas &a = atlas(style);
+        if (a.slots[kindex] != -1)
+            return false;
+        slot(a, style, font, kindex);
+        return true;
+    }
+
+    void KanjiTileCache::clear()
+    {
+        atlases.clear();
+    }
+
+    bool KanjiTileCache::Style::operator<(const Style &other) const
+    {
+        if (cellsize != other.cellsize)
+            return cellsize < other.cellsize;
+        if (dpr != other.dpr)
+            return dpr < other.dpr;
+        if (textcolor != other.textcolor)
+            return textcolor < other.textcolor;
+        if (bgcolor != other.bgcolor)
+            return bgcolor < other.bgcolor;
+        return fontkey < other.fontkey;
+    }
+
+    KanjiTileCache::Atlas& KanjiTileCache::atlas(const Style &style)
+    {
+        Atlas &a = atlases[style];
+        if (a.slots.empty())
+            a.slots.resize(ZKanji::kanjicount, -1);
+        a.lastused = ++counter;
+        return a;
+    }
+
+    int KanjiTileCache::slot(Atlas &a, const Style &style, const QFont &font, int kindex)
+    {
+        if (a.slots[kindex] != -1)
+            return a.slots[kindex];
+
+        int cnt = pagesize * pagesize;
+        if (a.used == (int)a.pages.size() * cnt)
+        {
+            if (!limitSize(a, style))
+            {
+                a.pages.clear();
+                a.used = 0;
+                std::fill(a.slots.begin(), a.slots.end(), -1);
+            }
+            int siz = pageSize(style);
+            a.pages.push_back(QPixmap(siz, siz));
+            a.pages.back().setDevicePixelRatio(style.dpr);
+        }
+
+        int s = a.used++;
+        a.slots[kindex] = s;
+
+        QRect r = slotRect(style, s);
+        QPainter p(&a.pages[s / cnt]);
+        p.fillRect(r, QColor::fromRgba(style.bgcolor));
+        p.setFont(font);
+        p.setPen(QColor::fromRgba(style.textcolor));
+        drawTextBaseline(&p, r.left(), r.top() + style.cellsize * 0.86, true, r, ZKanji::kanjis[kindex]->ch);
+
+        return s;
+    }
+
+    QRect KanjiTileCache::slotRect(const Style &style, int slot) const
+    {
+        int siz = style.cellsize - 1;
+        slot %= pagesize * pagesize;
+        return QRect((slot % pagesize) * siz, (slot / pagesize) * siz, siz, siz);
+    }
+
+    int KanjiTileCache::pageSize(const Style &style) const
+    {
+        return std::ceil(pagesize * (style.cellsize - 1) * style.dpr);
+    }
+
+    bool KanjiTileCache::limitSize(const Atlas &a, const Style &style)
+    {
+        qint64 pagepixels = qint64(pageSize(style)) * pageSize(style);
+        while (true)
+        {
+            qint64 pixels = pagepixels;
+            auto oldest = atlases.end();
+            for (auto it = atlases.begin(); it != atlases.end(); ++it)
+            {
+                if (!it->second.pages.empty())
+                    pixels += qint64(it->second.pages.front().width()) * it->second.pages.front().height() * it->second.pages.size();
+                if (&it->second == &a)
+                    continue;
+                if (oldest == atlases.end() || it->second.lastused < oldest->second.lastused)
+                    oldest = it;
+            }
+
+            if (pixels <= maxpixels)
+                return true;
+            if (oldest == atlases.end())
+                return false;
+            atlases.erase(oldest);
+        }
+    }
+
+    KanjiTileCache *tilecache = nullptr;
+
+    // Returns the cache shared by the kanji grid views, creating it on first use. Pixmaps
+    // can't outlive the application object, so the cache is deleted before it quits.
+    KanjiTileCache& tileCache()
+    {
+        if (tilecache == nullptr)
+        {
+            tilecache = new KanjiTileCache;
+            QObject::connect(qApp, &QApplication::aboutToQuit, []() {
+                delete tilecache;
+                tilecache = nullptr;
+            });
+        }
+        return *tilecache;
+    }
+}
+
+
+//-------------------------------------------------------------
+
+
 ZKanjiGridView::ZKanjiGridView(QWidget *parent) : base(parent), itemmodel(nullptr), connected(false), dict(ZKanji::dictionary(0)), popup(nullptr), status(nullptr),
         state(State::None), cellsize(Settings::scaled(std::ceil(Settings::fonts.kanjifontsize / 0.7))), autoscrollmargin(24), cols(0), rows(0), mousedown(false),
         current(-1), selpivot(-1), selection(new RangeSelection), kanjitipcell(-1), kanjitipkanji(-1), dragind(-1)
@@ -213,6 +429,10 @@ void ZKanjiGridView::settingsChanged()
 {
     Settings::updatePalette(this);
 
+    // Cells rendered with the old font and colors won't be used again.
+    if (tilecache != nullptr)
+        tilecache->clear();
+
     cellsize = Settings::scaled(std::ceil(Settings::fonts.kanjifontsize / 0.7));
     recompute(viewport()->size());
     recompute(viewport()->size());
@@ -968,7 +1188,8 @@ bool ZKanjiGridView::cancelActions()
 
 void ZKanjiGridView::scrollContentsBy(int dx, int dy)
 {
-    base::scrollContentsBy(dx, dy);
+    // Only the newly uncovered area is painted. The rest is moved on screen.
+    viewport()->scroll(dx, dy);
 
     if (state != State::Dragging)
         return;
@@ -1000,6 +1221,13 @@ void ZKanjiGridView::timerEvent(QTimerEvent *e)
         return;
     }
 
+    if (e->timerId() == prerenderTimer.timerId())
+    {
+        if (!prerenderCells())
+            prerenderTimer.stop();
+        return;
+    }
+
     base::timerEvent(e);
 }
 
@@ -1098,42 +1326,12 @@ void ZKanjiGridView::paintEvent(QPaintEvent *event)
             continue;
 
         bool sel = selected(drawpos);
-        if (!sel)
-        {
-            QColor c = itemmodel->textColorAt(drawpos);
-            if (!c.isValid())
-            {
-                if (dict->kanjiWordCount(itemmodel->kanjiAt(drawpos)) == 0)
-                    c = Settings::uiColor(ColorSettings::KanjiNoWords);
-                else
-                    c = Settings::textColor(this, ColorSettings::Text); // opts.palette.color(colorgrp, QPalette::Text);
-            }
-            p.setPen(c);
-            c = itemmodel->backColorAt(drawpos);
-            if (!c.isValid())
-                c = Settings::textColor(this, ColorSettings::Bg); // opts.palette.color(colorgrp, QPalette::Base);
-            p.setBrush(c);
-        }
-        else
-        {
-            QColor cc = itemmodel->textColorAt(drawpos);
-            QColor c = Settings::textColor(this, ColorSettings::SelText); // opts.palette.color(state == State::Dragging ? QPalette::Inactive : colorgrp, QPalette::HighlightedText)
-            if (!cc.isValid() && dict->kanjiWordCount(itemmodel->kanjiAt(drawpos)) == 0)
-                cc = Settings::uiColor(ColorSettings::KanjiNoWords);
-            if (cc.isValid())
-                c = colorFromBase(Settings::textColor(this, ColorSettings::Text), c, cc);
-            p.setPen(c);
-
-            c = Settings::textColor(this, ColorSettings::SelBg);// opts.palette.color(state == State::Dragging ? QPalette::Inactive : colorgrp, QPalette::Highlight)
-            cc = itemmodel->backColorAt(drawpos);
-            if (cc.isValid())
-                c = colorFromBase(Settings::textColor(this, ColorSettings::Bg), c, cc);
-
-            p.setBrush(c);
-        }
-        p.fillRect(QRect(x, y, cellsize - 1, cellsize - 1), p.brush());
+        QColor textcolor;
+        QColor bgcolor;
+        cellColors(drawpos, sel, textcolor, bgcolor);
+        p.setBrush(bgcolor);
 
-        drawTextBaseline(&p, x, y + cellsize * 0.86, true, QRect(x, y, cellsize - 1, cellsize - 1), ZKanji::kanjis[itemmodel->kanjiAt(drawpos)]->ch);
+        tileCache().draw(p, QPoint(x, y), kfont, cellsize, textcolor, bgcolor, itemmodel->kanjiAt(drawpos));
 
         if (current == drawpos && hasFocus())
         {
@@ -1198,6 +1396,9 @@ void ZKanjiGridView::paintEvent(QPaintEvent *event)
     p.setBrush(oldbrush);
     p.setPen(oldpen);
     p.setFont(oldfont);
+
+    if (!prerenderTimer.isActive())
+        prerenderTimer.start(0, this);
 }
 
 void ZKanjiGridView::resizeEvent(QResizeEvent *event)
@@ -1807,6 +2008,74 @@ QMimeData* ZKanjiGridView::dragMimeData()
     return model()->mimeData(indexes);
 }
 
+void ZKanjiGridView::cellColors(int index, bool sel, QColor &textcolor, QColor &bgcolor) const
+{
+    if (!sel)
+    {
+        textcolor = itemmodel->textColorAt(index);
+        if (!textcolor.isValid())
+        {
+            if (dict->kanjiWordCount(itemmodel->kanjiAt(index)) == 0)
+                textcolor = Settings::uiColor(ColorSettings::KanjiNoWords);
+            else
+                textcolor = Settings::textColor(this, ColorSettings::Text); // opts.palette.color(colorgrp, QPalette::Text);
+        }
+        bgcolor = itemmodel->backColorAt(index);
+        if (!bgcolor.isValid())
+            bgcolor = Settings::textColor(this, ColorSettings::Bg); // opts.palette.color(colorgrp, QPalette::Base);
+        return;
+    }
+
+    QColor cc = itemmodel->textColorAt(index);
+    textcolor = Settings::textColor(this, ColorSettings::SelText); // opts.palette.color(state == State::Dragging ? QPalette::Inactive : colorgrp, QPalette::HighlightedText)
+    if (!cc.isValid() && dict->kanjiWordCount(itemmodel->kanjiAt(index)) == 0)
+        cc = Settings::uiColor(ColorSettings::KanjiNoWords);
+    if (cc.isValid())
+        textcolor = colorFromBase(Settings::textColor(this, ColorSettings::Text), textcolor, cc);
+
+    bgcolor = Settings::textColor(this, ColorSettings::SelBg);// opts.palette.color(state == State::Dragging ? QPalette::Inactive : colorgrp, QPalette::Highlight)
+    cc = itemmodel->backColorAt(index);
+    if (cc.isValid())
+        bgcolor = colorFromBase(Settings::textColor(this, ColorSettings::Bg), bgcolor, cc);
+}
+
+bool ZKanjiGridView::prerenderCells()
+{
+    if (itemmodel == nullptr || itemmodel->empty() || cols == 0 || !isVisible())
+        return false;
+
+    // Number of rows to prepare above and below the visible area.
+    const int extrarows = 2;
+    // Maximum number of cells to render in a single call, to keep the UI responsive.
+    const int maxcells = 16;
+
+    int vpos = verticalScrollBar()->value();
+    int top = vpos / cellsize;
+    int bottom = (vpos + viewport()->height() - 1) / cellsize;
+
+    QFont kfont = Settings::kanjiFont();
+    QColor textcolor;
+    QColor bgcolor;
+
+    int rendered = 0;
+    for (int ix = 1; ix <= extrarows; ++ix)
+    {
+        for (int row : { bottom + ix, top - ix })
+        {
+            if (row < 0 || row >= rows)
+                continue;
+            for (int pos = row * cols, last = std::min(pos + cols, itemmodel->size()); pos != last; ++pos)
+            {
+                cellColors(pos, selected(pos), textcolor, bgcolor);
+                if (tileCache().prepare(kfont, cellsize, viewport()->devicePixelRatioF(), textcolor, bgcolor, itemmodel->kanjiAt(pos)) && ++rendered == maxcells)
+                    return true;
+            }
+        }
+    }
+
+    return rendered != 0;
+}
+
 void ZKanjiGridView::updateDragIndicator()
 {
     if (dragind == -1)
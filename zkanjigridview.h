@@ -20,6 +20,7 @@
 class QMenu;
 class QMimeData;
 class QPixmap;
+class QColor;
 class KanjiGroup;
 class KanjiGridModel;
 class Dictionary;
@@ -190,6 +191,14 @@ private:
     // Computes scrollbar ranges depending on the passed viewport size and row count.
     void recomputeScrollbar(const QSize &size);
 
+    // Sets the colors of the cell at index for painting. Set sel to whether the cell is
+    // selected.
+    void cellColors(int index, bool sel, QColor &textcolor, QColor &bgcolor) const;
+    // Renders a few cells of the rows just above and below the visible area into the shared
+    // cell cache, so they are ready when the grid is scrolled. Returns false when all those
+    // cells are already rendered.
+    bool prerenderCells();
+
     // Generates data needed to start a drag and drop operation and returns it in a mime data
     // to transfer. Returns null when no data is present.
     QMimeData* dragMimeData();
@@ -259,6 +268,9 @@ private:
 
     QBasicTimer autoScrollTimer;
 
+    // Started after painting to render the cells outside the visible area while idle.
+    QBasicTimer prerenderTimer;
+
     // Number of columns currently shown in the grid. This value
     // automatically changes as the user resizes the widget.
     int cols;
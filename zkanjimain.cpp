@@ -7,6 +7,14 @@
 #include <QPoint>
 #include <QDir>
 #include <QStringBuilder>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
 #include "zkanjimain.h"
 #include "kanji.h"
 #include "studydecks.h"
@@ -884,6 +892,111 @@ std::default_random_engine& random_engine()
 }
 
 
+//-------------------------------------------------------------
+
+
+struct ParallelRangesData
+{
+    std::function<void(int, int, int)> func;
+    int count;
+    int ranges;
+
+    // Index of the next range to be processed.
+    std::atomic_int next;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    // Number of ranges processed. Guarded by mutex.
+    int done;
+};
+
+namespace
+{
+    // Processes ranges of data until none is left.
+    void processRanges(ParallelRangesData &data)
+    {
+        int ix;
+        while ((ix = data.next++) < data.ranges)
+        {
+            data.func(ix, (qint64)data.count * ix / data.ranges, (qint64)data.count * (ix + 1) / data.ranges);
+
+            std::lock_guard<std::mutex> lock(data.mutex);
+            if (++data.done == data.ranges)
+                data.cond.notify_all();
+        }
+    }
+
+    class ParallelRangesRunnable : public QRunnable
+    {
+    public:
+        ParallelRangesRunnable(const std::shared_ptr<ParallelRangesData> &data) : data(data) {}
+        virtual void run() override
+        {
+            processRanges(*data);
+        }
+    private:
+        // Runnables only start after every range was taken when the pool is busy, so they
+        // must keep the data alive.
+        std::shared_ptr<ParallelRangesData> data;
+    };
+}
+
+ParallelRanges::ParallelRanges(int count, int minsize, const std::function<void(int, int, int)> &func) : data(new ParallelRangesData)
+{
+    data->func = func;
+    data->count = count;
+    data->ranges = rangeCount(count, minsize);
+    data->next = 0;
+    data->done = 0;
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    for (int ix = 0, siz = std::min(std::max(1, pool->maxThreadCount()), data->ranges); ix != siz; ++ix)
+        pool->start(new ParallelRangesRunnable(data));
+}
+
+ParallelRanges::~ParallelRanges()
+{
+    finish();
+}
+
+int ParallelRanges::size() const
+{
+    return data->ranges;
+}
+
+bool ParallelRanges::finished() const
+{
+    std::lock_guard<std::mutex> lock(data->mutex);
+    return data->done == data->ranges;
+}
+
+bool ParallelRanges::wait(int msecs)
+{
+    std::unique_lock<std::mutex> lock(data->mutex);
+    return data->cond.wait_for(lock, std::chrono::milliseconds(msecs), [this]() { return data->done == data->ranges; });
+}
+
+void ParallelRanges::finish()
+{
+    processRanges(*data);
+
+    std::unique_lock<std::mutex> lock(data->mutex);
+    data->cond.wait(lock, [this]() { return data->done == data->ranges; });
+}
+
+void ParallelRanges::run(int count, int minsize, const std::function<void(int, int, int)> &func)
+{
+    ParallelRanges ranges(count, minsize, func);
+    ranges.finish();
+}
+
+int ParallelRanges::rangeCount(int count, int minsize)
+{
+    int tcnt = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+    return std::max(1, std::min(tcnt * 4, count / std::max(1, minsize)));
+}
+
+
 //-------------------------------------------------------------
 
 namespace ZKanji
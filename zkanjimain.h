@@ -17,6 +17,7 @@
 #include <functional>
 #include <random>
 #include <exception>
+#include <memory>
 
 #include "qcharstring.h"
 #include "smartvector.h"
@@ -581,6 +582,44 @@ int rnd(int lo, int hi);
 std::default_random_engine& random_engine();
 
 
+struct ParallelRangesData;
+// Processes items split into consecutive ranges on the threads of the global thread pool.
+// Threads take the next unprocessed range when they finish one, so ranges of uneven work
+// don't keep the others waiting.
+class ParallelRanges
+{
+public:
+    // Starts calling func on the thread pool for every range of count items. Each range has
+    // at least minsize items, unless count is smaller, and there are at most four ranges for
+    // each thread of the pool. The arguments of func are the index of the range, and the
+    // first and one past the last item in the range.
+    ParallelRanges(int count, int minsize, const std::function<void(int, int, int)> &func);
+    // Calls finish().
+    ~ParallelRanges();
+
+    // Number of ranges the items were split into.
+    int size() const;
+
+    // Returns whether every range was processed.
+    bool finished() const;
+    // Waits at most msecs milliseconds for the ranges to be processed. The calling thread
+    // doesn't take part in the work, so this can be used in a loop that updates the GUI.
+    // Returns whether every range was processed.
+    bool wait(int msecs);
+    // Processes the ranges not yet taken by the pool on the calling thread as well, and
+    // waits until every range was processed.
+    void finish();
+
+    // Processes every range of count items with func, and returns when they are all done.
+    static void run(int count, int minsize, const std::function<void(int, int, int)> &func);
+    // Returns the number of ranges count items are split into with the passed minimum range
+    // size.
+    static int rangeCount(int count, int minsize);
+private:
+    std::shared_ptr<ParallelRangesData> data;
+};
+
+
 // Quicksort used for big lists that the user must be able to interrupt, or a progress must be
 // shown. Same as std::sort with the one difference that the cmp function gets passed a third
 // argument of type bool&. Set it to true to abandon the sort. Returns true if it was stopped
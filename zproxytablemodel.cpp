@@ -352,20 +352,47 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
     int bottom = source_bottom_right.row();
     auto srcit = std::lower_bound(srclist.begin(), srclist.end(), top, [this](int src, int top) { return list[src].first < top; });
 
+    // Many changed rows are checked together with a single search instead of one by one.
+    bool together = filtering && bottom - top + 1 >= 100;
+
+    // [source model index, inflections] Changed rows matching the filters when checked
+    // together.
+    std::vector<std::pair<int, InfVector*>> matches;
+    if (together)
+    {
+        std::vector<int> rows(bottom - top + 1);
+        std::iota(rows.begin(), rows.end(), top);
+        filterRows(model, rows, matches);
+    }
+    auto mit = matches.begin();
+
     // Check what to do with the changed rows and put them in the appropriate list.
     for (int ix = top, last = bottom + 1; ix != last; ++ix)
     {
-        std::vector<InfTypes> winfs;
-        bool match = !filtering || dict->wordMatches(model->indexes(ix), smode, ssearchstr, swildcards, sstrict, sinflections, sstudydefs, scond.get(), &winfs);
+        bool match;
+        InfVector *inf = nullptr;
+        if (together)
+        {
+            match = mit != matches.end() && mit->first == ix;
+            if (match)
+                inf = (mit++)->second;
+        }
+        else
+        {
+            std::vector<InfTypes> winfs;
+            match = !filtering || dict->wordMatches(model->indexes(ix), smode, ssearchstr, swildcards, sstrict, sinflections, sstudydefs, scond.get(), &winfs);
+            if (match && !winfs.empty())
+                inf = new InfVector(winfs);
+        }
 
         bool found = srcit != srclist.end() && list[*srcit].first == ix;
 
         if (!match && found)
             toremove.push_back(*srcit);
         else if (match && !found)
-            toadd.emplace_back(ix, winfs.empty() ? nullptr : new InfVector(winfs));
+            toadd.emplace_back(ix, inf);
         else if (match)
-            toupdate.emplace_back(ix, winfs.empty() ? nullptr : new InfVector(winfs));
+            toupdate.emplace_back(ix, inf);
 
         if (found)
             ++srcit;
@@ -731,12 +758,8 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
     {
         // Finding the inserted rows and their inflections that match the word filters.
 
-        WordResultList wlist(dict);
-        // Index of words in dictionary that were inserted.
-        std::vector<int> wpool;
-        wpool.reserve(insertcnt);
-        // [word index, source model index]
-        std::vector<std::pair<int, int>> worder;
+        std::vector<int> rows;
+        rows.reserve(insertcnt);
 
         // Delta position of the current interval. Each interval start at the original line
         // where they were inserted.
@@ -745,42 +768,11 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
         {
             const Interval *i = intervals[ix];
             for (int iy = 0; iy != i->count; ++iy)
-            {
-                int index = ipos + i->index + iy;
-                int windex = model->indexes(index);
-                wpool.push_back(windex);
-                worder.emplace_back(windex, index);
-            }
+                rows.push_back(ipos + i->index + iy);
             ipos += i->count;
         }
 
-        std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.first < b.first; });
-
-        dict->findWords(wlist, smode, ssearchstr, swildcards, sstrict, sinflections, sstudydefs, &wpool, scond.get());
-
-        const auto &ixs = wlist.getIndexes();
-        auto &infs = wlist.getInflections();
-        for (int ix = 0; ix != wlist.size(); ++ix)
-        {
-            bool hasinf = infs.size() > ix;
-            toadd.emplace_back(ixs[ix], hasinf ? infs[ix] : nullptr);
-            if (hasinf)
-                infs[ix] = nullptr;
-        }
-        infs.clear();
-
-        // The first value in toadd pairs is currently the word index in the dictionary, but
-        // we need source model indexes instead. Map the word indexes using worder.
-
-        std::sort(toadd.begin(), toadd.end(), [](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) { return a.first < b.first; });
-
-        int orderpos = 0;
-        for (int ix = 0, siz = toadd.size(); ix != siz; ++ix)
-        {
-            while (worder[orderpos].first != toadd[ix].first)
-                ++orderpos;
-            toadd[ix].first = worder[orderpos].second;
-        }
+        filterRows(model, rows, toadd);
     }
 
 
@@ -1685,109 +1677,120 @@ void DictionarySearchFilterProxyModel::fillLists(DictionaryItemModel *model)
     }
     else
     {
-        Dictionary *dict = model->dictionary();
+        std::vector<int> rows(cnt);
+        std::iota(rows.begin(), rows.end(), 0);
+        filterRows(model, rows, list);
+    }
 
-        WordResultList wlist(dict);
-        std::vector<int> wfilter;
-        wfilter.reserve(cnt);
-        // [word index, source model index]
-        std::vector<std::pair<int, int>> worder;
-        for (int ix = 0; ix != cnt; ++ix)
-        {
-            int windex = model->indexes(ix);
-            wfilter.push_back(windex);
-            worder.emplace_back(windex, ix);
-        }
-        std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { 
-            if (a.first != b.first)
-                return a.first < b.first;
-            return a.second < b.second;
+    // Rebuilding srclist.
+    srclist.resize(list.size());
+    for (int ix = 0; ix != list.size(); ++ix)
+        srclist[ix] = ix;
+
+    if (sortfunc)
+    {
+        std::sort(list.begin(), list.end(), [this, model](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
+            return sortfunc(model, sortcolumn, a.first, b.first) != (sortorder == Qt::DescendingOrder);
         });
 
-        if (!ssearchstr.isEmpty())
-            dict->findWords(wlist, smode, ssearchstr, swildcards, sstrict, sinflections, sstudydefs, &wfilter, scond.get());
-        else if (scond)
-        {
-            for (int ix = 0, siz = wfilter.size(); ix != siz; ++ix)
-                if (ZKanji::wordfilters().match(dict->wordEntry(wfilter[ix]), scond.get()))
-                    wlist.add(wfilter[ix]);
-        }
-        std::vector<int>().swap(wfilter);
+        std::sort(srclist.begin(), srclist.end(), [this](int a, int b) { return list[a].first < list[b].first; });
+    }
+}
 
-        const auto &windexes = wlist.getIndexes();
-        auto &winfs = wlist.getInflections();
 
-        // [word index, inflection] This list will hold the result from findWords in word
-        // index order, used for building list from worder.
-        std::vector<std::pair<int, InfVector*>> tmplist;
+void DictionarySearchFilterProxyModel::filterRows(DictionaryItemModel *model, const std::vector<int> &rows, std::vector<std::pair<int, InfVector*>> &result) const
+{
+    Dictionary *dict = model->dictionary();
 
-        for (int ix = 0; ix != wlist.size(); ++ix)
-        {
-            bool hasinf = winfs.size() > ix;
-            tmplist.emplace_back(windexes[ix], hasinf ? winfs[ix] : nullptr);
-            if (hasinf)
-                winfs[ix] = nullptr;
-        }
-        wlist.clear();
+    WordResultList wlist(dict);
+    std::vector<int> wfilter;
+    wfilter.reserve(rows.size());
+    // [word index, source model index]
+    std::vector<std::pair<int, int>> worder;
+    worder.reserve(rows.size());
+    for (int row : rows)
+    {
+        int windex = model->indexes(row);
+        wfilter.push_back(windex);
+        worder.emplace_back(windex, row);
+    }
+    std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return a.second < b.second;
+    });
 
-        std::sort(tmplist.begin(), tmplist.end(), [](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) { 
-            if (a.first != b.first)
-                return a.first < b.first;
-            // Make the null inflection come last if present.
-            return (intptr_t)a.second > (intptr_t)b.second;
-        });
+    if (!ssearchstr.isEmpty())
+        dict->findWords(wlist, smode, ssearchstr, swildcards, sstrict, sinflections, sstudydefs, &wfilter, scond.get());
+    else if (scond)
+    {
+        WordFilterProgram filter = ZKanji::wordfilters().compile(scond.get());
+        for (int ix = 0, siz = wfilter.size(); ix != siz; ++ix)
+            if (filter.match(dict, wfilter[ix]))
+                wlist.add(wfilter[ix]);
+    }
+    std::vector<int>().swap(wfilter);
 
-        int wpos = 0;
-        bool first;
-        InfVector *inf;
-        for (int ix = 0, siz = tmplist.size(), wsiz = worder.size(); ix != siz && wpos != wsiz; ++ix)
-        {
-            while (worder[wpos].first != tmplist[ix].first)
-                ++wpos;
-            // Duplicate word indexes are possible in the filtered model (worder), but the
-            // inflection list pointer can't be shared between them. When first is false, the
-            // inflections are copied.
-            first = true;
-            inf = tmplist[ix].second;
-
-            // tmplist can have duplicate word indexes where one item has inflection and an
-            // other hasn't. It should be shown in dictionary listings, but when filtering a
-            // model it's not possible to handle this correctly. The duplicates with
-            // inflection are ignored. Above tmplist was sorted with the null inflection
-            // coming last. If such item is not present, the last inflection is used.
-
-            while (ix != siz - 1 && tmplist[ix].first == tmplist[ix + 1].first)
-            {
-                inf = tmplist[ix + 1].second;
-                delete tmplist[ix].second;
-                ++ix;
-            }
+    const auto &windexes = wlist.getIndexes();
+    auto &winfs = wlist.getInflections();
 
-            while (wpos != wsiz && worder[wpos].first == tmplist[ix].first)
-            {
-                list.emplace_back(worder[wpos].second, !inf || first ? inf : new InfVector(*inf));
-                ++wpos;
-                first = false;
-            }
-        }
+    // [word index, inflection] This list will hold the result from findWords in word
+    // index order, used for building result from worder.
+    std::vector<std::pair<int, InfVector*>> tmplist;
 
-        if (!sortfunc)
-            std::sort(list.begin(), list.end(), [](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) { return a.first < b.first; });
+    for (int ix = 0; ix != wlist.size(); ++ix)
+    {
+        bool hasinf = winfs.size() > ix;
+        tmplist.emplace_back(windexes[ix], hasinf ? winfs[ix] : nullptr);
+        if (hasinf)
+            winfs[ix] = nullptr;
     }
+    wlist.clear();
 
-    // Rebuilding srclist.
-    srclist.resize(list.size());
-    for (int ix = 0; ix != list.size(); ++ix)
-        srclist[ix] = ix;
+    std::sort(tmplist.begin(), tmplist.end(), [](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        // Make the null inflection come last if present.
+        return (intptr_t)a.second > (intptr_t)b.second;
+    });
 
-    if (sortfunc)
+    result.reserve(result.size() + tmplist.size());
+
+    int wpos = 0;
+    bool first;
+    InfVector *inf;
+    for (int ix = 0, siz = tmplist.size(), wsiz = worder.size(); ix != siz && wpos != wsiz; ++ix)
     {
-        std::sort(list.begin(), list.end(), [this, model](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-            return sortfunc(model, sortcolumn, a.first, b.first) != (sortorder == Qt::DescendingOrder);
-        });
+        while (worder[wpos].first != tmplist[ix].first)
+            ++wpos;
+        // Duplicate word indexes are possible in the filtered model (worder), but the
+        // inflection list pointer can't be shared between them. When first is false, the
+        // inflections are copied.
+        first = true;
+        inf = tmplist[ix].second;
+
+        // tmplist can have duplicate word indexes where one item has inflection and an
+        // other hasn't. It should be shown in dictionary listings, but when filtering a
+        // model it's not possible to handle this correctly. The duplicates with
+        // inflection are ignored. Above tmplist was sorted with the null inflection
+        // coming last. If such item is not present, the last inflection is used.
+
+        while (ix != siz - 1 && tmplist[ix].first == tmplist[ix + 1].first)
+        {
+            inf = tmplist[ix + 1].second;
+            delete tmplist[ix].second;
+            ++ix;
+        }
 
-        std::sort(srclist.begin(), srclist.end(), [this](int a, int b) { return list[a].first < list[b].first; });
+        while (wpos != wsiz && worder[wpos].first == tmplist[ix].first)
+        {
+            result.emplace_back(worder[wpos].second, !inf || first ? inf : new InfVector(*inf));
+            ++wpos;
+            first = false;
+        }
     }
+
+    std::sort(result.begin(), result.end(), [](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) { return a.first < b.first; });
 }
 
 
@@ -109,6 +109,10 @@ private:
     // Rebuilds list and infs from the passed model. Model should match the current
     // sourceModel() or the model which is about to be set as sourceModel().
     void fillLists(DictionaryItemModel *model);
+    // Fills result with the rows in the passed list of model rows whose words match the
+    // saved search and conditions, together with their inflections. The words are looked up
+    // with a single search limited to the words in rows. The result is ordered by row.
+    void filterRows(DictionaryItemModel *model, const std::vector<int> &rows, std::vector<std::pair<int, InfVector*>> &result) const;
 
     // [Source model index, Inflection types] Mapping from this model to the source model. The list
     // may be sorted by a sorting function.
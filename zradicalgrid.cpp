@@ -209,6 +209,10 @@ void ZRadicalGrid::setActiveFilter(const RadicalFilter &rad)
     mode = rad.mode;
     setMouseTracking(mode == RadicalFilterModes::NamedRadicals);
     group = rad.grouped;
+
+    radsel.setMode(mode, group);
+    for (ushort val : selection)
+        radsel.add(filterValue(val));
     if (isVisible())
         viewport()->update();
 
@@ -229,6 +233,7 @@ void ZRadicalGrid::setDisplayMode(RadicalFilterModes newmode)
     clearSelection();
     mode = newmode;
     setMouseTracking(mode == RadicalFilterModes::NamedRadicals);
+    radsel.setMode(mode, group);
     filterIncluded();
     filter();
 
@@ -278,6 +283,7 @@ void ZRadicalGrid::setGroupDisplay(bool newgroup)
         return;
     group = newgroup;
     clearSelection();
+    radsel.setMode(mode, group);
     filterIncluded();
     filter();
 
@@ -338,6 +344,7 @@ void ZRadicalGrid::finalizeSelection()
 
     filters.push_back(selectionToFilter());
     selection.clear();
+    radsel.clear();
 
     emit selectionChanged();
     emit selectionTextChanged(generateFiltersText());
@@ -356,6 +363,7 @@ void ZRadicalGrid::clearSelection()
     }
     selection.clear();
     filters.clear();
+    radsel.clear();
 
     emit selectionChanged();
     emit selectionTextChanged(QString());
@@ -380,7 +388,7 @@ std::vector<ushort> ZRadicalGrid::selectionToFilter()
         if (ix != -1)
             viewport()->update(itemRect(ix));
         if (mode == RadicalFilterModes::Radicals)
-            sels.push_back(radindexes[num]);
+            sels.push_back(filterValue(num));
         else
         {
             sels.push_back(num);
@@ -398,6 +406,11 @@ std::vector<ushort> ZRadicalGrid::selectionToFilter()
     return sels;
 }
 
+void ZRadicalGrid::selectionKanji(std::vector<ushort> &result) const
+{
+    radsel.result().toList(result);
+}
+
 void ZRadicalGrid::paintEvent(QPaintEvent *event)
 {
     QStylePainter p(viewport());
@@ -511,9 +524,15 @@ void ZRadicalGrid::mousePressEvent(QMouseEvent *e)
         return;
     auto it = std::find(selection.begin(), selection.end(), list[index]);
     if (it != selection.end())
+    {
         selection.erase(it);
+        radsel.remove(filterValue(list[index]));
+    }
     else
+    {
         selection.insert(list[index]);
+        radsel.add(filterValue(list[index]));
+    }
     viewport()->update(itemRect(indexOf(list[index])));
 
     emit selectionChanged();
@@ -681,6 +700,7 @@ void ZRadicalGrid::setFromModel(KanjiGridModel *model)
     if (kanjilist != dest)
     {
         kanjilist = dest;
+        radsel.setBase(kanjilist);
 
         filterIncluded();
         filter();
@@ -695,6 +715,7 @@ void ZRadicalGrid::setFromList(const std::vector<ushort> &src)
     if (kanjilist != dest)
     {
         kanjilist = dest;
+        radsel.setBase(kanjilist);
 
         filterIncluded();
         filter();
@@ -706,97 +727,27 @@ void ZRadicalGrid::filterIncluded()
     included.clear();
     if (mode == RadicalFilterModes::Radicals)
     {
-        for (int ix = 0, siz = kanjilist.size(); ix != siz; ++ix)
-            included.insert(ZKanji::kanjis[kanjilist[ix]]->rad);
+        for (int ix = 1; ix != 215; ++ix)
+            if (radsel.found(ix))
+                included.insert(ix);
     }
     else if (mode == RadicalFilterModes::Parts)
     {
-        //for (int iy = 0; iy != 252; ++iy)
-        //{
-        //    for (int ix = 0; ix != kanjilist.size(); ++ix)
-        //    {
-        //        if (std::binary_search(ZKanji::partlist[iy].begin(), ZKanji::partlist[iy].end(), kanjilist[ix]))
-        //        {
-        //            included.insert(iy + 1);
-        //            break;
-        //        }
-        //    }
-        //}
-
-        for (int ix = 0, siz = kanjilist.size(); ix != siz; ++ix)
-        {
-            auto &rads = ZKanji::kanjis[kanjilist[ix]]->radks;
-            //included.insert(rads.begin(), rads.end());
-            for (ushort r : rads)
-                included.insert(r);
-        }
+        for (int ix = 0, siz = ZKanji::radklist.size(); ix != siz; ++ix)
+            if (radsel.found(ix))
+                included.insert(ix);
     }
     else
     {
-        //int radpos = 0;
-        //for (int iy = 0; iy != ZKanji::radlist.size(); ++iy)
-        //{
-        //    if (!group || (group && iy != 0 && ZKanji::radlist[iy]->radical != ZKanji::radlist[iy - 1]->radical))
-        //        radpos = iy;
-        //    if (included.count(radpos))
-        //        continue;
-
-        //    for (int ix = 0; ix != kanjilist.size(); ++ix)
-        //    {
-        //        if (std::binary_search(ZKanji::radlist[iy]->kanji.begin(), ZKanji::radlist[iy]->kanji.end(), kanjilist[ix]))
-        //        {
-        //            included.insert(radpos);
-        //            break;
-        //        }
-        //    }
-        //}
-
-        std::vector<ushort> v;
-
-        if (kanjilist.size() != ZKanji::kanjicount)
-        {
-            for (int ix = 0, siz = kanjilist.size(); ix != siz; ++ix)
-            {
-                auto &rads = ZKanji::kanjis[kanjilist[ix]]->rads;
-                if (group)
-                    v.insert(v.end(), rads.begin(), rads.end());
-                else
-                    for (ushort r : rads)
-                        included.insert(r);
-
-                //included.insert(rads.begin(), rads.end());
-            }
-        }
-        else
-        {
-            v.reserve(ZKanji::radlist.size());
-            for (int ix = 0, siz = ZKanji::radlist.size(); ix != siz; ++ix)
-                if (group)
-                    v.push_back(ix);
-                else
-                    included.insert(ix);
-        }
-
-        if (group)
+        // In group mode the first form of a radical stands for every other form. It's
+        // included if any of the forms are found.
+        int radpos = 0;
+        for (int ix = 0, siz = ZKanji::radlist.size(); ix != siz; ++ix)
         {
-            std::sort(v.begin(), v.end());
-            v.resize(std::unique(v.begin(), v.end()) - v.begin());
-
-            int vpos = 0;
-            bool inserted = false;
-            for (int ix = 0, siz = ZKanji::radlist.size(), vsiz = v.size(); ix != siz && vpos != vsiz; ++ix)
-            {
-                if (ix == 0 || ZKanji::radlist[ix]->radical != ZKanji::radlist[ix - 1]->radical)
-                    inserted = false;
-
-                if (inserted || ZKanji::radlist[v[vpos]]->radical > ZKanji::radlist[ix]->radical)
-                    continue;
-
-                included.insert(ix);
-                inserted = true;
-
-                ++vpos;
-            }
+            if (!group || ix == 0 || ZKanji::radlist[ix]->radical != ZKanji::radlist[ix - 1]->radical)
+                radpos = ix;
+            if (radsel.found(ix))
+                included.insert(radpos);
         }
     }
 }
@@ -1238,6 +1189,13 @@ int ZRadicalGrid::indexOf(ushort val)
     return it - list.begin();
 }
 
+ushort ZRadicalGrid::filterValue(ushort val) const
+{
+    if (mode == RadicalFilterModes::Radicals)
+        return radindexes[val];
+    return val;
+}
+
 ZRect ZRadicalGrid::itemRect(int index)
 {
     if (index < 0 || index >= list.size())
@@ -13,6 +13,7 @@
 #include <unordered_set>
 #include "qcharstring.h"
 #include "smartvector.h"
+#include "kanjiindex.h"
 
 class QStylePainter;
 class ZRect;
@@ -117,6 +118,9 @@ public:
     // Creates a list of radical indexes from the current selection that can be added to the
     // finalized filters.
     std::vector<ushort> selectionToFilter();
+    // Fills result with the kanji from the list set with setFromList() or setFromModel()
+    // that match the current selection. The result is sorted by kanji index.
+    void selectionKanji(std::vector<ushort> &result) const;
 signals:
     // The selection has changed, resulting in new kanji to be displayed.
     void selectionChanged();
@@ -179,6 +183,9 @@ private:
     // Returns the index of the given value in the list.
     int indexOf(ushort val);
 
+    // Converts a value in selection to the value used in filters.
+    ushort filterValue(ushort val) const;
+
     // Returns the rectangle of the item at the index in list.
     ZRect itemRect(int index);
 
@@ -249,6 +256,9 @@ private:
     // Radicals found in the current kanji list that can be shown.
     QSet<ushort> included;
 
+    // Kanji in kanjilist matching the current selection, updated on every click.
+    RadicalSelection radsel;
+
     typedef QAbstractScrollArea base;
 };
 
@@ -331,8 +331,8 @@ bool StudyListModel::sortOrder(int column, int rowa, int rowb)
         }
         case (int)DeckColumnTypes::NextDate:
         {
-            QDateTime nda = study->cardNextTestDate(itema->cardid);
-            QDateTime ndb = study->cardNextTestDate(itemb->cardid);
+            qint64 nda = study->cardNextTestTime(itema->cardid);
+            qint64 ndb = study->cardNextTestTime(itemb->cardid);
             if (nda != ndb)
                 return nda < ndb;
             // To the next case:
@@ -436,8 +436,8 @@ bool StudyListModel::sortOrder(int column, int rowa, int rowb)
         }
         case (int)DeckColumnTypes::NextDate:
         {
-            QDateTime nda = study->cardNextTestDate(itema->cardid);
-            QDateTime ndb = study->cardNextTestDate(itemb->cardid);
+            qint64 nda = study->cardNextTestTime(itema->cardid);
+            qint64 ndb = study->cardNextTestTime(itemb->cardid);
             if (nda != ndb)
                 return nda < ndb;
             // To the next case:
@@ -741,6 +741,11 @@ QDate ltDay(const QDateTime &d)
     return DateTimeFunctions::getLTDay(d);
 }
 
+QDateTime ltDayStart(QDate day)
+{
+    return DateTimeFunctions::getLTDayStart(day);
+}
+
 
 //QImage* makeImageFromSvg(QImage* &img, QString svgpath, int width, int height)
 //{
@@ -1856,6 +1861,11 @@ QDate DateTimeFunctions::getLTDay(const QDateTime &dt)
     return dt.addMSecs(-1000 * 60 * 60 * Settings::study.starthour).toLocalTime().date();
 }
 
+QDateTime DateTimeFunctions::getLTDayStart(QDate day)
+{
+    return QDateTime(day, QTime(0, 0), Qt::LocalTime).toUTC().addMSecs(1000 * 60 * 60 * Settings::study.starthour);
+}
+
 QString DateTimeFunctions::formatPassedTime(int seconds, bool showhours)
 {
     int h = (seconds / 60 / 60);
@@ -208,6 +208,9 @@ QString fixFormatNextDate(const QDateTime &d);
 // study list, by subtracting hours from it. Beware that the time part is
 // not cleared, though its value becomes unusable.
 QDate ltDay(const QDateTime &d);
+// Returns the UTC date time when the given day of the long-term study list starts. Every
+// date time from this point until the start of the next day has the same ltDay().
+QDateTime ltDayStart(QDate day);
 
 
 // Pass an image pointer and a path to an SVG file (usually resource.) If the
@@ -427,6 +430,9 @@ public:
     // study list, by subtracting hours from it. Beware that the time part is
     // not cleared, though its value becomes unusable.
     static QDate getLTDay(const QDateTime &dt);
+    // Returns the UTC date time when the day of the long-term study list starts. This is the
+    // first date time for which getLTDay() returns day.
+    static QDateTime getLTDayStart(QDate day);
 
     // Returns a string formatting a number as passed time, like the format 00:00:00. If
     // 'showhours' is false, only the minutes and seconds are returned.